@@ -18,6 +18,7 @@
 #include <utility>
 
 #include "absl/time/time.h"
+#include "platform/base/feature_flags.h"
 #include "platform/public/logging.h"
 #include "platform/public/mutex_lock.h"
 #include "platform/public/system_clock.h"
@@ -130,6 +131,7 @@ void AnalyticsRecorder::OnStartAdvertising(
       is_extended_advertisement_supported);
   advertising_metadata->set_connected_ap_frequency(connected_ap_frequency);
   advertising_metadata->set_supports_nfc_technology(is_nfc_available);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnStopAdvertising() {
@@ -170,6 +172,7 @@ void AnalyticsRecorder::OnStartDiscovery(
       is_extended_advertisement_supported);
   discovery_metadata->set_connected_ap_frequency(connected_ap_frequency);
   discovery_metadata->set_supports_nfc_technology(is_nfc_available);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnStopDiscovery() {
@@ -195,6 +198,7 @@ void AnalyticsRecorder::OnEndpointFound(Medium medium) {
   discovered_endpoint->set_medium(medium);
   discovered_endpoint->set_latency_millis(absl::ToInt64Milliseconds(
       SystemClock::ElapsedRealtime() - started_discovery_phase_time_));
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnConnectionRequestReceived(
@@ -236,6 +240,7 @@ void AnalyticsRecorder::OnRemoteEndpointAccepted(
     return;
   }
   RemoteEndpointRespondedLocked(remote_endpoint_id, ACCEPTED);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnLocalEndpointAccepted(
@@ -245,6 +250,7 @@ void AnalyticsRecorder::OnLocalEndpointAccepted(
     return;
   }
   LocalEndpointRespondedLocked(remote_endpoint_id, ACCEPTED);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnRemoteEndpointRejected(
@@ -254,6 +260,7 @@ void AnalyticsRecorder::OnRemoteEndpointRejected(
     return;
   }
   RemoteEndpointRespondedLocked(remote_endpoint_id, REJECTED);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnLocalEndpointRejected(
@@ -263,6 +270,7 @@ void AnalyticsRecorder::OnLocalEndpointRejected(
     return;
   }
   LocalEndpointRespondedLocked(remote_endpoint_id, REJECTED);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnIncomingConnectionAttempt(
@@ -317,6 +325,7 @@ void AnalyticsRecorder::OnIncomingConnectionAttempt(
       connection_attempt_metadata_params->max_wifi_rx_speed);
   connection_attempt_metadata->set_wifi_channel_width(
       connection_attempt_metadata_params->channel_width);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnOutgoingConnectionAttempt(
@@ -387,6 +396,7 @@ void AnalyticsRecorder::OnOutgoingConnectionAttempt(
       UpdateDiscovererConnectionRequestLocked(connection_request.get());
     }
   }
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnConnectionEstablished(
@@ -431,36 +441,25 @@ void AnalyticsRecorder::OnConnectionClosed(const std::string &endpoint_id,
         RepeatedFieldBackInserter(
             current_strategy_session_->mutable_established_connection()));
   }
+  MaybeFlushLocked();
 }
-void AnalyticsRecorder::OnIncomingPayloadStarted(
+AnalyticsRecorder::ChunkCounter AnalyticsRecorder::OnIncomingPayloadStarted(
     const std::string &endpoint_id, std::int64_t payload_id,
     connections::Payload::Type type, std::int64_t total_size_bytes) {
   MutexLock lock(&mutex_);
   if (!CanRecordAnalyticsLocked("OnIncomingPayloadStarted")) {
-    return;
+    return {};
   }
   auto it = active_connections_.find(endpoint_id);
   if (it == active_connections_.end()) {
-    return;
+    return {};
   }
   const std::unique_ptr<LogicalConnection> &logical_connection = it->second;
+  auto counters = std::make_shared<ChunkCounters>();
   logical_connection->IncomingPayloadStarted(
-      payload_id, PayloadTypeToProtoPayloadType(type), total_size_bytes);
-}
-
-void AnalyticsRecorder::OnPayloadChunkReceived(const std::string &endpoint_id,
-                                               std::int64_t payload_id,
-                                               std::int64_t chunk_size_bytes) {
-  MutexLock lock(&mutex_);
-  if (!CanRecordAnalyticsLocked("OnPayloadChunkReceived")) {
-    return;
-  }
-  auto it = active_connections_.find(endpoint_id);
-  if (it == active_connections_.end()) {
-    return;
-  }
-  const std::unique_ptr<LogicalConnection> &logical_connection = it->second;
-  logical_connection->ChunkReceived(payload_id, chunk_size_bytes);
+      payload_id, PayloadTypeToProtoPayloadType(type), total_size_bytes,
+      counters);
+  return ChunkCounter(std::move(counters));
 }
 
 void AnalyticsRecorder::OnIncomingPayloadDone(const std::string &endpoint_id,
@@ -478,37 +477,28 @@ void AnalyticsRecorder::OnIncomingPayloadDone(const std::string &endpoint_id,
   logical_connection->IncomingPayloadDone(payload_id, status);
 }
 
-void AnalyticsRecorder::OnOutgoingPayloadStarted(
+std::vector<AnalyticsRecorder::ChunkCounter>
+AnalyticsRecorder::OnOutgoingPayloadStarted(
     const std::vector<std::string> &endpoint_ids, std::int64_t payload_id,
     connections::Payload::Type type, std::int64_t total_size_bytes) {
+  std::vector<ChunkCounter> chunk_counters(endpoint_ids.size());
   MutexLock lock(&mutex_);
   if (!CanRecordAnalyticsLocked("OnOutgoingPayloadStarted")) {
-    return;
+    return chunk_counters;
   }
-  for (const auto &endpoint_id : endpoint_ids) {
-    auto it = active_connections_.find(endpoint_id);
+  for (std::size_t i = 0; i < endpoint_ids.size(); ++i) {
+    auto it = active_connections_.find(endpoint_ids[i]);
     if (it == active_connections_.end()) {
       continue;
     }
     const std::unique_ptr<LogicalConnection> &logical_connection = it->second;
+    auto counters = std::make_shared<ChunkCounters>();
     logical_connection->OutgoingPayloadStarted(
-        payload_id, PayloadTypeToProtoPayloadType(type), total_size_bytes);
+        payload_id, PayloadTypeToProtoPayloadType(type), total_size_bytes,
+        counters);
+    chunk_counters[i] = ChunkCounter(std::move(counters));
   }
-}
-
-void AnalyticsRecorder::OnPayloadChunkSent(const std::string &endpoint_id,
-                                           std::int64_t payload_id,
-                                           std::int64_t chunk_size_bytes) {
-  MutexLock lock(&mutex_);
-  if (!CanRecordAnalyticsLocked("OnPayloadChunkSent")) {
-    return;
-  }
-  auto it = active_connections_.find(endpoint_id);
-  if (it == active_connections_.end()) {
-    return;
-  }
-  const std::unique_ptr<LogicalConnection> &logical_connection = it->second;
-  logical_connection->ChunkSent(payload_id, chunk_size_bytes);
+  return chunk_counters;
 }
 
 void AnalyticsRecorder::OnOutgoingPayloadDone(const std::string &endpoint_id,
@@ -553,16 +543,22 @@ void AnalyticsRecorder::OnBandwidthUpgradeError(
     return;
   }
   FinishUpgradeAttemptLocked(endpoint_id, result, error_stage);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnBandwidthUpgradeSuccess(
-    const std::string &endpoint_id) {
+    const std::string &endpoint_id, absl::Duration write_stall) {
   MutexLock lock(&mutex_);
   if (!CanRecordAnalyticsLocked("OnBandwidthUpgradeSuccess")) {
     return;
   }
+  auto it = bandwidth_upgrade_attempts_.find(endpoint_id);
+  if (it != bandwidth_upgrade_attempts_.end()) {
+    it->second->set_write_stall_millis(absl::ToInt64Milliseconds(write_stall));
+  }
   FinishUpgradeAttemptLocked(endpoint_id, UPGRADE_RESULT_SUCCESS,
                              UPGRADE_SUCCESS);
+  MaybeFlushLocked();
 }
 
 void AnalyticsRecorder::OnErrorCode(const ErrorCodeParams &params) {
@@ -636,7 +632,7 @@ void AnalyticsRecorder::LogSession() {
   FinishStrategySessionLocked();
   client_session_->set_duration_millis(absl::ToInt64Milliseconds(
       SystemClock::ElapsedRealtime() - started_client_session_time_));
-  LogClientSession();
+  LogClientSession(std::move(client_session_));
   LogEvent(STOP_CLIENT_SESSION);
   session_was_logged_ = true;
 }
@@ -683,12 +679,14 @@ bool AnalyticsRecorder::CanRecordAnalyticsLocked(
   return true;
 }
 
-void AnalyticsRecorder::LogClientSession() {
+void AnalyticsRecorder::LogClientSession(
+    std::unique_ptr<ConnectionsLog::ClientSession> client_session) {
   serial_executor_.Execute(
-      "analytics-recorder", [this]() {
+      "analytics-recorder",
+      [this, client_session = client_session.release()]() {
         ConnectionsLog connections_log;
         connections_log.set_event_type(CLIENT_SESSION);
-        connections_log.set_allocated_client_session(client_session_.release());
+        connections_log.set_allocated_client_session(client_session);
         connections_log.set_version(kVersion);
 
         NEARBY_LOGS(VERBOSE)
@@ -953,6 +951,87 @@ void AnalyticsRecorder::FinishStrategySessionLocked() {
   }
 }
 
+void AnalyticsRecorder::MaybeFlushLocked() {
+  const FeatureFlags::Flags &flags = FeatureFlags::GetInstance().GetFlags();
+  if (!flags.enable_incremental_analytics_flush ||
+      ++events_since_flush_check_ < flags.analytics_flush_check_interval) {
+    return;
+  }
+  events_since_flush_check_ = 0;
+  if (BufferedBytesLocked() <
+      static_cast<std::size_t>(flags.analytics_flush_threshold_bytes)) {
+    return;
+  }
+  auto flushed = absl::make_unique<ConnectionsLog::ClientSession>();
+  flushed->Swap(client_session_.get());
+  if (current_strategy_session_ != nullptr &&
+      !TakeCompletedStrategySessionLocked(flushed->add_strategy_session())) {
+    flushed->mutable_strategy_session()->RemoveLast();
+  }
+  // What is buffered may all be still in progress.
+  if (flushed->strategy_session_size() == 0) return;
+  LogClientSession(std::move(flushed));
+}
+
+std::size_t AnalyticsRecorder::BufferedBytesLocked() const {
+  std::size_t size = client_session_->ByteSizeLong();
+  if (current_strategy_session_ != nullptr) {
+    size += current_strategy_session_->ByteSizeLong();
+  }
+  if (current_advertising_phase_ != nullptr) {
+    size += current_advertising_phase_->ByteSizeLong();
+  }
+  if (current_discovery_phase_ != nullptr) {
+    size += current_discovery_phase_->ByteSizeLong();
+  }
+  return size;
+}
+
+bool AnalyticsRecorder::TakeCompletedStrategySessionLocked(
+    ConnectionsLog::StrategySession *completed) {
+  completed->set_strategy(current_strategy_session_->strategy());
+  *completed->mutable_role() = current_strategy_session_->role();
+  completed->mutable_discovery_phase()->Swap(
+      current_strategy_session_->mutable_discovery_phase());
+  completed->mutable_advertising_phase()->Swap(
+      current_strategy_session_->mutable_advertising_phase());
+  completed->mutable_connection_attempt()->Swap(
+      current_strategy_session_->mutable_connection_attempt());
+  completed->mutable_established_connection()->Swap(
+      current_strategy_session_->mutable_established_connection());
+  completed->mutable_upgrade_attempt()->Swap(
+      current_strategy_session_->mutable_upgrade_attempt());
+
+  // Phases still running keep their settings, and hand over the endpoints and
+  // connection requests they are done with.
+  if (current_advertising_phase_ != nullptr &&
+      current_advertising_phase_->received_connection_request_size() > 0) {
+    ConnectionsLog::AdvertisingPhase *phase = completed->add_advertising_phase();
+    *phase->mutable_medium() = current_advertising_phase_->medium();
+    *phase->mutable_advertising_metadata() =
+        current_advertising_phase_->advertising_metadata();
+    phase->mutable_received_connection_request()->Swap(
+        current_advertising_phase_->mutable_received_connection_request());
+  }
+  if (current_discovery_phase_ != nullptr &&
+      (current_discovery_phase_->discovered_endpoint_size() > 0 ||
+       current_discovery_phase_->sent_connection_request_size() > 0)) {
+    ConnectionsLog::DiscoveryPhase *phase = completed->add_discovery_phase();
+    *phase->mutable_medium() = current_discovery_phase_->medium();
+    *phase->mutable_discovery_metadata() =
+        current_discovery_phase_->discovery_metadata();
+    phase->mutable_discovered_endpoint()->Swap(
+        current_discovery_phase_->mutable_discovered_endpoint());
+    phase->mutable_sent_connection_request()->Swap(
+        current_discovery_phase_->mutable_sent_connection_request());
+  }
+  return completed->discovery_phase_size() > 0 ||
+         completed->advertising_phase_size() > 0 ||
+         completed->connection_attempt_size() > 0 ||
+         completed->established_connection_size() > 0 ||
+         completed->upgrade_attempt_size() > 0;
+}
+
 ConnectionsStrategy AnalyticsRecorder::StrategyToConnectionStrategy(
     connections::Strategy strategy) {
   if (strategy == connections::Strategy::kP2pCluster) {
@@ -981,12 +1060,6 @@ PayloadType AnalyticsRecorder::PayloadTypeToProtoPayloadType(
   }
 }
 
-void AnalyticsRecorder::PendingPayload::AddChunk(
-    std::int64_t chunk_size_bytes) {
-  num_bytes_transferred_ += chunk_size_bytes;
-  num_chunks_++;
-}
-
 ConnectionsLog::Payload AnalyticsRecorder::PendingPayload::GetProtoPayload(
     PayloadStatus status) {
   ConnectionsLog::Payload payload;
@@ -994,8 +1067,10 @@ ConnectionsLog::Payload AnalyticsRecorder::PendingPayload::GetProtoPayload(
       absl::ToInt64Milliseconds(SystemClock::ElapsedRealtime() - start_time_));
   payload.set_type(type_);
   payload.set_total_size_bytes(total_size_bytes_);
-  payload.set_num_bytes_transferred(num_bytes_transferred_);
-  payload.set_num_chunks(num_chunks_);
+  payload.set_num_bytes_transferred(
+      counters_->num_bytes.exchange(0, std::memory_order_relaxed));
+  payload.set_num_chunks(
+      counters_->num_chunks.exchange(0, std::memory_order_relaxed));
   payload.set_status(status);
 
   return payload;
@@ -1089,19 +1164,11 @@ AnalyticsRecorder::LogicalConnection::GetEstablisedConnections() {
 }
 
 void AnalyticsRecorder::LogicalConnection::IncomingPayloadStarted(
-    std::int64_t payload_id, PayloadType type, std::int64_t total_size_bytes) {
+    std::int64_t payload_id, PayloadType type, std::int64_t total_size_bytes,
+    std::shared_ptr<ChunkCounters> counters) {
   incoming_payloads_.insert(
-      {payload_id, absl::make_unique<PendingPayload>(type, total_size_bytes)});
-}
-
-void AnalyticsRecorder::LogicalConnection::ChunkReceived(
-    std::int64_t payload_id, std::int64_t size_bytes) {
-  auto it = incoming_payloads_.find(payload_id);
-  if (it == incoming_payloads_.end()) {
-    return;
-  }
-  PendingPayload *pending_payload = it->second.get();
-  pending_payload->AddChunk(size_bytes);
+      {payload_id, absl::make_unique<PendingPayload>(type, total_size_bytes,
+                                                     std::move(counters))});
 }
 
 void AnalyticsRecorder::LogicalConnection::IncomingPayloadDone(
@@ -1125,19 +1192,11 @@ void AnalyticsRecorder::LogicalConnection::IncomingPayloadDone(
 }
 
 void AnalyticsRecorder::LogicalConnection::OutgoingPayloadStarted(
-    std::int64_t payload_id, PayloadType type, std::int64_t total_size_bytes) {
+    std::int64_t payload_id, PayloadType type, std::int64_t total_size_bytes,
+    std::shared_ptr<ChunkCounters> counters) {
   outgoing_payloads_.insert(
-      {payload_id, absl::make_unique<PendingPayload>(type, total_size_bytes)});
-}
-
-void AnalyticsRecorder::LogicalConnection::ChunkSent(std::int64_t payload_id,
-                                                     std::int64_t size_bytes) {
-  auto it = outgoing_payloads_.find(payload_id);
-  if (it == outgoing_payloads_.end()) {
-    return;
-  }
-  PendingPayload *payload = it->second.get();
-  payload->AddChunk(size_bytes);
+      {payload_id, absl::make_unique<PendingPayload>(type, total_size_bytes,
+                                                     std::move(counters))});
 }
 
 void AnalyticsRecorder::LogicalConnection::OutgoingPayloadDone(
@@ -1200,7 +1259,8 @@ AnalyticsRecorder::LogicalConnection::ResolvePendingPayloads(
       upgraded_payloads.insert(
           {item.first,
            absl::make_unique<PendingPayload>(
-               pending_payload->type(), pending_payload->total_size_bytes())});
+               pending_payload->type(), pending_payload->total_size_bytes(),
+               pending_payload->counters())});
     }
   }
   pending_payloads.clear();
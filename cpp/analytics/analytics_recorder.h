@@ -15,7 +15,11 @@
 #ifndef ANALYTICS_ANALYTICS_RECORDER_H_
 #define ANALYTICS_ANALYTICS_RECORDER_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/container/btree_map.h"
 #include "absl/time/time.h"
@@ -35,6 +39,36 @@ namespace analytics {
 
 class AnalyticsRecorder {
  public:
+  // Bytes and chunks of a payload transferred since they were last folded into
+  // the Payload proto. Updated on the chunk path without holding mutex_.
+  struct ChunkCounters {
+    std::atomic<std::int64_t> num_bytes{0};
+    std::atomic<int> num_chunks{0};
+  };
+
+  // Counts the chunks of a payload transferred to or from one endpoint. It is
+  // handed out when the payload starts and kept for the chunk path, so that
+  // counting a chunk takes no lock and no lookup. A default constructed
+  // ChunkCounter, like one for a payload that isn't recorded, counts nothing.
+  class ChunkCounter {
+   public:
+    ChunkCounter() = default;
+
+    void Count(std::int64_t chunk_size_bytes) const {
+      if (counters_ == nullptr) return;
+      counters_->num_bytes.fetch_add(chunk_size_bytes,
+                                     std::memory_order_relaxed);
+      counters_->num_chunks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+   private:
+    friend class AnalyticsRecorder;
+    explicit ChunkCounter(std::shared_ptr<ChunkCounters> counters)
+        : counters_(std::move(counters)) {}
+
+    std::shared_ptr<ChunkCounters> counters_;
+  };
+
   explicit AnalyticsRecorder(EventLogger *event_logger);
   virtual ~AnalyticsRecorder();
 
@@ -116,27 +150,21 @@ class AnalyticsRecorder {
       ABSL_LOCKS_EXCLUDED(mutex_);
 
   // Payload
-  void OnIncomingPayloadStarted(const std::string &endpoint_id,
-                                std::int64_t payload_id,
-                                connections::Payload::Type type,
-                                std::int64_t total_size_bytes)
-      ABSL_LOCKS_EXCLUDED(mutex_);
-  void OnPayloadChunkReceived(const std::string &endpoint_id,
-                              std::int64_t payload_id,
-                              std::int64_t chunk_size_bytes)
+  // Chunks of the payload are counted with the returned ChunkCounter.
+  ChunkCounter OnIncomingPayloadStarted(const std::string &endpoint_id,
+                                        std::int64_t payload_id,
+                                        connections::Payload::Type type,
+                                        std::int64_t total_size_bytes)
       ABSL_LOCKS_EXCLUDED(mutex_);
   void OnIncomingPayloadDone(
       const std::string &endpoint_id, std::int64_t payload_id,
       location::nearby::proto::connections::PayloadStatus status)
       ABSL_LOCKS_EXCLUDED(mutex_);
-  void OnOutgoingPayloadStarted(const std::vector<std::string> &endpoint_ids,
-                                std::int64_t payload_id,
-                                connections::Payload::Type type,
-                                std::int64_t total_size_bytes)
-      ABSL_LOCKS_EXCLUDED(mutex_);
-  void OnPayloadChunkSent(const std::string &endpoint_id,
-                          std::int64_t payload_id,
-                          std::int64_t chunk_size_bytes)
+  // Returns the ChunkCounter of the payload for each of |endpoint_ids|, in the
+  // same order.
+  std::vector<ChunkCounter> OnOutgoingPayloadStarted(
+      const std::vector<std::string> &endpoint_ids, std::int64_t payload_id,
+      connections::Payload::Type type, std::int64_t total_size_bytes)
       ABSL_LOCKS_EXCLUDED(mutex_);
   void OnOutgoingPayloadDone(
       const std::string &endpoint_id, std::int64_t payload_id,
@@ -156,7 +184,10 @@ class AnalyticsRecorder {
       location::nearby::proto::connections::BandwidthUpgradeResult result,
       location::nearby::proto::connections::BandwidthUpgradeErrorStage
           error_stage) ABSL_LOCKS_EXCLUDED(mutex_);
-  void OnBandwidthUpgradeSuccess(const std::string &endpoint_id)
+  // |write_stall| is how long outgoing writes to the endpoint were held back
+  // while switching over to the upgraded channel.
+  void OnBandwidthUpgradeSuccess(const std::string &endpoint_id,
+                                 absl::Duration write_stall)
       ABSL_LOCKS_EXCLUDED(mutex_);
 
   // Error Code
@@ -165,6 +196,14 @@ class AnalyticsRecorder {
   // Invokes event_logger_.Log() at the end of life of client. Log action is
   // called in a separate thread to allow synchronous potentially lengthy
   // execution.
+  //
+  // With FeatureFlags::enable_incremental_analytics_flush, parts of the
+  // client session that are finished are logged earlier, as CLIENT_SESSION
+  // logs of their own, whenever the analytics held in memory reach
+  // FeatureFlags::analytics_flush_threshold_bytes, as checked every
+  // FeatureFlags::analytics_flush_check_interval events. Flushed strategy
+  // sessions and phases that were still running carry no duration; the one
+  // logged here is the only one with the duration of the client session.
   void LogSession() ABSL_LOCKS_EXCLUDED(mutex_);
 
  private:
@@ -172,16 +211,16 @@ class AnalyticsRecorder {
   class PendingPayload {
    public:
     PendingPayload(location::nearby::proto::connections::PayloadType type,
-                   std::int64_t total_size_bytes)
+                   std::int64_t total_size_bytes,
+                   std::shared_ptr<ChunkCounters> counters)
         : start_time_(SystemClock::ElapsedRealtime()),
           type_(type),
           total_size_bytes_(total_size_bytes),
-          num_bytes_transferred_(0),
-          num_chunks_(0) {}
+          counters_(std::move(counters)) {}
     ~PendingPayload() = default;
 
-    void AddChunk(std::int64_t chunk_size_bytes);
-
+    // Moves the chunks counted so far out of the shared counters, so that a
+    // PendingPayload re-created on a new medium only reports its own chunks.
     proto::ConnectionsLog::Payload GetProtoPayload(
         location::nearby::proto::connections::PayloadStatus status);
 
@@ -191,12 +230,15 @@ class AnalyticsRecorder {
 
     std::int64_t total_size_bytes() const { return total_size_bytes_; }
 
+    const std::shared_ptr<ChunkCounters> &counters() const {
+      return counters_;
+    }
+
    private:
     absl::Time start_time_;
     location::nearby::proto::connections::PayloadType type_;
     std::int64_t total_size_bytes_;
-    std::int64_t num_bytes_transferred_;
-    int num_chunks_;
+    std::shared_ptr<ChunkCounters> counters_;
   };
 
   class LogicalConnection {
@@ -227,16 +269,14 @@ class AnalyticsRecorder {
     void IncomingPayloadStarted(
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadType type,
-        std::int64_t total_size_bytes);
-    void ChunkReceived(std::int64_t payload_id, std::int64_t size_bytes);
+        std::int64_t total_size_bytes, std::shared_ptr<ChunkCounters> counters);
     void IncomingPayloadDone(
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadStatus status);
     void OutgoingPayloadStarted(
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadType type,
-        std::int64_t total_size_bytes);
-    void ChunkSent(std::int64_t payload_id, std::int64_t size_bytes);
+        std::int64_t total_size_bytes, std::shared_ptr<ChunkCounters> counters);
     void OutgoingPayloadDone(
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadStatus status);
@@ -270,7 +310,8 @@ class AnalyticsRecorder {
 
   // Callbacks the ConnectionsLog proto byte array data to the EventLogger with
   // ClientSession sub-proto.
-  void LogClientSession();
+  void LogClientSession(
+      std::unique_ptr<proto::ConnectionsLog::ClientSession> client_session);
   // Callbacks the ConnectionsLog proto byte array data to the EventLogger.
   void LogEvent(location::nearby::proto::connections::EventType event_type);
 
@@ -312,6 +353,17 @@ class AnalyticsRecorder {
       bool erase_item = true) ABSL_SHARED_LOCKS_REQUIRED(mutex_);
   void FinishStrategySessionLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Logs and drops the finished parts of the client session if incremental
+  // flushing is enabled and they have grown past the flush threshold. Only
+  // every FeatureFlags::analytics_flush_check_interval-th call checks.
+  void MaybeFlushLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  std::size_t BufferedBytesLocked() const ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+  // Moves the finished records of the current StrategySession, and of its
+  // current phases, into |completed|. Returns false if there were none.
+  bool TakeCompletedStrategySessionLocked(
+      proto::ConnectionsLog::StrategySession *completed)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   location::nearby::proto::connections::ConnectionsStrategy
   StrategyToConnectionStrategy(connections::Strategy strategy);
   location::nearby::proto::connections::PayloadType
@@ -330,6 +382,8 @@ class AnalyticsRecorder {
       absl::make_unique<proto::ConnectionsLog::ClientSession>();
   absl::Time started_client_session_time_;
   bool session_was_logged_ ABSL_GUARDED_BY(mutex_) = false;
+  // Calls to MaybeFlushLocked() since it last checked the buffered size.
+  int events_since_flush_check_ ABSL_GUARDED_BY(mutex_) = 0;
 
   // Current StrategySession
   connections::Strategy current_strategy_ ABSL_GUARDED_BY(mutex_) =
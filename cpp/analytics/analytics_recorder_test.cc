@@ -23,8 +23,11 @@
 #include "analytics/connection_attempt_metadata_params.h"
 #include "platform/base/error_code_params.h"
 #include "platform/base/error_code_recorder.h"
+#include "platform/base/feature_flags.h"
+#include "platform/base/medium_environment.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/logging.h"
+#include "platform/public/multi_thread_executor.h"
 #include "proto/analytics/connections_log.pb.h"
 #include "proto/connections_enums.pb.h"
 
@@ -80,6 +83,7 @@ class FakeEventLogger : public EventLogger {
     if (event_type == CLIENT_SESSION) {
       logged_client_session_count_++;
       logged_client_session_ = connections_log.client_session();
+      logged_client_sessions_.push_back(connections_log.client_session());
     }
     if (event_type == ERROR_CODE) {
       error_code_ = connections_log.error_code();
@@ -97,6 +101,10 @@ class FakeEventLogger : public EventLogger {
     return logged_client_session_;
   }
 
+  const std::vector<ConnectionsLog::ClientSession>& GetLoggedClientSessions() {
+    return logged_client_sessions_;
+  }
+
   const ConnectionsLog::ErrorCode& GetErrorCode() { return error_code_; }
 
   std::vector<EventType> GetLoggedEventTypes() { return logged_event_types_; }
@@ -105,6 +113,7 @@ class FakeEventLogger : public EventLogger {
   int logged_client_session_count_ = 0;
   CountDownLatch& client_session_done_latch_;
   ConnectionsLog::ClientSession logged_client_session_;
+  std::vector<ConnectionsLog::ClientSession> logged_client_sessions_;
   ConnectionsLog::ErrorCode error_code_;
   std::vector<EventType> logged_event_types_;
 };
@@ -722,16 +731,18 @@ TEST(AnalyticsRecorderTest, OutgoingPayloadUpgraded) {
   analytics_recorder.OnStartAdvertising(strategy, mediums);
   analytics_recorder.OnConnectionEstablished(endpoint_id, BLUETOOTH,
                                              connection_token);
-  analytics_recorder.OnOutgoingPayloadStarted(
-      {endpoint_id}, payload_id, connections::Payload::Type::kFile, 50);
-  analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 10);
-  analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 10);
+  std::vector<AnalyticsRecorder::ChunkCounter> chunk_counters =
+      analytics_recorder.OnOutgoingPayloadStarted(
+          {endpoint_id}, payload_id, connections::Payload::Type::kFile, 50);
+  ASSERT_EQ(chunk_counters.size(), 1);
+  chunk_counters[0].Count(10);
+  chunk_counters[0].Count(10);
   analytics_recorder.OnConnectionClosed(endpoint_id, BLUETOOTH, UPGRADED);
   analytics_recorder.OnConnectionEstablished(endpoint_id, WIFI_LAN,
                                              connection_token);
-  analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 10);
-  analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 10);
-  analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 10);
+  chunk_counters[0].Count(10);
+  chunk_counters[0].Count(10);
+  chunk_counters[0].Count(10);
   analytics_recorder.OnOutgoingPayloadDone(endpoint_id, payload_id, SUCCESS);
   analytics_recorder.OnConnectionClosed(endpoint_id, WIFI_LAN,
                                         LOCAL_DISCONNECTION);
@@ -779,6 +790,205 @@ TEST(AnalyticsRecorderTest, OutgoingPayloadUpgraded) {
                 >)pb")));
 }
 
+TEST(AnalyticsRecorderTest, ConcurrentPayloadChunksAreAllCounted) {
+  connections::Strategy strategy = connections::Strategy::kP2pStar;
+  std::vector<Medium> mediums = {BLE, BLUETOOTH};
+  std::string endpoint_id = "endpoint_id";
+  std::int64_t incoming_payload_id = 123456789;
+  std::int64_t outgoing_payload_id = 987654321;
+  std::string connection_token = "connection_token";
+  constexpr int kThreads = 4;
+  constexpr int kChunksPerThread = 250;
+
+  CountDownLatch client_session_done_latch(1);
+  FakeEventLogger event_logger(client_session_done_latch);
+  AnalyticsRecorder analytics_recorder(&event_logger);
+
+  analytics_recorder.OnStartAdvertising(strategy, mediums);
+  analytics_recorder.OnConnectionEstablished(endpoint_id, BLUETOOTH,
+                                             connection_token);
+  AnalyticsRecorder::ChunkCounter incoming_chunk_counter =
+      analytics_recorder.OnIncomingPayloadStarted(
+          endpoint_id, incoming_payload_id, connections::Payload::Type::kFile,
+          kThreads * kChunksPerThread);
+  AnalyticsRecorder::ChunkCounter outgoing_chunk_counter =
+      analytics_recorder.OnOutgoingPayloadStarted(
+          {endpoint_id}, outgoing_payload_id,
+          connections::Payload::Type::kStream, -1)[0];
+  {
+    MultiThreadExecutor executor(kThreads);
+    CountDownLatch chunks_done_latch(kThreads);
+    for (int i = 0; i < kThreads; ++i) {
+      executor.Execute([&]() {
+        for (int j = 0; j < kChunksPerThread; ++j) {
+          incoming_chunk_counter.Count(1);
+          outgoing_chunk_counter.Count(2);
+        }
+        chunks_done_latch.CountDown();
+      });
+    }
+    ASSERT_TRUE(chunks_done_latch.Await(kDefaultTimeout).result());
+  }
+  analytics_recorder.OnIncomingPayloadDone(endpoint_id, incoming_payload_id,
+                                           SUCCESS);
+  analytics_recorder.OnOutgoingPayloadDone(endpoint_id, outgoing_payload_id,
+                                           SUCCESS);
+  // Chunks counted after a payload is done are dropped.
+  outgoing_chunk_counter.Count(2);
+  analytics_recorder.OnConnectionClosed(endpoint_id, BLUETOOTH,
+                                        LOCAL_DISCONNECTION);
+
+  analytics_recorder.LogSession();
+  ASSERT_TRUE(client_session_done_latch.Await(kDefaultTimeout).result());
+
+  EXPECT_THAT(event_logger.GetLoggedClientSession(), Partially(EqualsProto(R"pb(
+                strategy_session <
+                  established_connection <
+                    medium: BLUETOOTH
+                    received_payload <
+                      type: FILE
+                      total_size_bytes: 1000
+                      num_bytes_transferred: 1000
+                      num_chunks: 1000
+                      status: SUCCESS
+                    >
+                    sent_payload <
+                      type: STREAM
+                      total_size_bytes: -1
+                      num_bytes_transferred: 2000
+                      num_chunks: 1000
+                      status: SUCCESS
+                    >
+                    disconnection_reason: LOCAL_DISCONNECTION
+                  >
+                >)pb")));
+}
+
+TEST(AnalyticsRecorderTest, ChunksOfUnrecordedPayloadAreNotCounted) {
+  std::string endpoint_id = "endpoint_id";
+  std::int64_t payload_id = 123456789;
+
+  CountDownLatch client_session_done_latch(1);
+  FakeEventLogger event_logger(client_session_done_latch);
+  AnalyticsRecorder analytics_recorder(&event_logger);
+
+  // No connection to |endpoint_id| was established.
+  AnalyticsRecorder::ChunkCounter chunk_counter =
+      analytics_recorder.OnIncomingPayloadStarted(
+          endpoint_id, payload_id, connections::Payload::Type::kBytes, 10);
+  std::vector<AnalyticsRecorder::ChunkCounter> chunk_counters =
+      analytics_recorder.OnOutgoingPayloadStarted(
+          {endpoint_id}, payload_id, connections::Payload::Type::kBytes, 10);
+  chunk_counter.Count(10);
+  ASSERT_EQ(chunk_counters.size(), 1);
+  chunk_counters[0].Count(10);
+  AnalyticsRecorder::ChunkCounter().Count(10);
+
+  analytics_recorder.LogSession();
+  ASSERT_TRUE(client_session_done_latch.Await(kDefaultTimeout).result());
+  EXPECT_EQ(event_logger.GetLoggedClientSession().strategy_session_size(), 0);
+}
+
+TEST(AnalyticsRecorderTest, IncrementalFlushLogsFinishedConnectionsEarly) {
+  FeatureFlags::Flags flags;
+  flags.enable_incremental_analytics_flush = true;
+  flags.analytics_flush_threshold_bytes = 1;
+  flags.analytics_flush_check_interval = 1;
+  MediumEnvironment::Instance().SetFeatureFlags(flags);
+  connections::Strategy strategy = connections::Strategy::kP2pStar;
+  std::vector<Medium> mediums = {BLE, BLUETOOTH};
+  std::string endpoint_id = "endpoint_id";
+  std::string connection_token = "connection_token";
+
+  CountDownLatch client_session_done_latch(1);
+  FakeEventLogger event_logger(client_session_done_latch);
+  AnalyticsRecorder analytics_recorder(&event_logger);
+
+  analytics_recorder.OnStartAdvertising(strategy, mediums);
+  analytics_recorder.OnConnectionEstablished(endpoint_id, BLUETOOTH,
+                                             connection_token);
+  analytics_recorder.OnConnectionClosed(endpoint_id, BLUETOOTH,
+                                        LOCAL_DISCONNECTION);
+  analytics_recorder.OnStopAdvertising();
+
+  analytics_recorder.LogSession();
+  ASSERT_TRUE(client_session_done_latch.Await(kDefaultTimeout).result());
+
+  ASSERT_EQ(event_logger.GetLoggedClientSessionCount(), 2);
+  // The closed connection is logged as soon as it is done, without the
+  // advertising phase that was still running.
+  const ConnectionsLog::ClientSession &flushed_client_session =
+      event_logger.GetLoggedClientSessions()[0];
+  EXPECT_FALSE(flushed_client_session.has_duration_millis());
+  ASSERT_EQ(flushed_client_session.strategy_session_size(), 1);
+  EXPECT_EQ(flushed_client_session.strategy_session(0).advertising_phase_size(),
+            0);
+  EXPECT_THAT(flushed_client_session, Partially(EqualsProto(R"pb(
+                strategy_session <
+                  strategy: P2P_STAR
+                  role: ADVERTISER
+                  established_connection <
+                    medium: BLUETOOTH
+                    disconnection_reason: LOCAL_DISCONNECTION
+                    connection_token: "connection_token"
+                  >
+                >)pb")));
+  const ConnectionsLog::ClientSession &last_client_session =
+      event_logger.GetLoggedClientSessions()[1];
+  EXPECT_TRUE(last_client_session.has_duration_millis());
+  ASSERT_EQ(last_client_session.strategy_session_size(), 1);
+  EXPECT_EQ(
+      last_client_session.strategy_session(0).established_connection_size(), 0);
+  EXPECT_THAT(last_client_session, Partially(EqualsProto(R"pb(
+                strategy_session <
+                  strategy: P2P_STAR
+                  role: ADVERTISER
+                  advertising_phase < medium: BLE medium: BLUETOOTH >
+                >)pb")));
+  MediumEnvironment::Instance().SetFeatureFlags(FeatureFlags::Flags());
+}
+
+TEST(AnalyticsRecorderTest, IncrementalFlushChecksEveryFewEvents) {
+  FeatureFlags::Flags flags;
+  flags.enable_incremental_analytics_flush = true;
+  flags.analytics_flush_threshold_bytes = 1;
+  flags.analytics_flush_check_interval = 3;
+  MediumEnvironment::Instance().SetFeatureFlags(flags);
+  connections::Strategy strategy = connections::Strategy::kP2pStar;
+  std::vector<Medium> mediums = {BLE, BLUETOOTH};
+  std::string endpoint_id_1 = "endpoint_id_1";
+  std::string endpoint_id_2 = "endpoint_id_2";
+  std::string connection_token = "connection_token";
+
+  CountDownLatch client_session_done_latch(1);
+  FakeEventLogger event_logger(client_session_done_latch);
+  AnalyticsRecorder analytics_recorder(&event_logger);
+
+  analytics_recorder.OnStartAdvertising(strategy, mediums);
+  analytics_recorder.OnConnectionEstablished(endpoint_id_1, BLUETOOTH,
+                                             connection_token);
+  analytics_recorder.OnConnectionClosed(endpoint_id_1, BLUETOOTH,
+                                        LOCAL_DISCONNECTION);
+  analytics_recorder.OnConnectionEstablished(endpoint_id_2, BLUETOOTH,
+                                             connection_token);
+  // The third event checks, and flushes both closed connections at once.
+  analytics_recorder.OnConnectionClosed(endpoint_id_2, BLUETOOTH,
+                                        LOCAL_DISCONNECTION);
+  analytics_recorder.OnStopAdvertising();
+
+  analytics_recorder.LogSession();
+  ASSERT_TRUE(client_session_done_latch.Await(kDefaultTimeout).result());
+
+  ASSERT_EQ(event_logger.GetLoggedClientSessionCount(), 2);
+  const ConnectionsLog::ClientSession &flushed_client_session =
+      event_logger.GetLoggedClientSessions()[0];
+  ASSERT_EQ(flushed_client_session.strategy_session_size(), 1);
+  EXPECT_EQ(
+      flushed_client_session.strategy_session(0).established_connection_size(),
+      2);
+  MediumEnvironment::Instance().SetFeatureFlags(FeatureFlags::Flags());
+}
+
 TEST(AnalyticsRecorderTest, UpgradeAttemptWorks) {
   connections::Strategy strategy = connections::Strategy::kP2pStar;
   std::vector<Medium> mediums = {BLE, BLUETOOTH};
@@ -802,7 +1012,8 @@ TEST(AnalyticsRecorderTest, UpgradeAttemptWorks) {
   analytics_recorder.OnBandwidthUpgradeError(endpoint_id, WIFI_LAN_MEDIUM_ERROR,
                                              WIFI_LAN_SOCKET_CREATION);
   // Success to upgrade.
-  analytics_recorder.OnBandwidthUpgradeSuccess(endpoint_id_1);
+  analytics_recorder.OnBandwidthUpgradeSuccess(endpoint_id_1,
+                                               absl::Milliseconds(20));
   // Upgrade is unfinished.
   analytics_recorder.OnBandwidthUpgradeStarted(
       endpoint_id_2, BLUETOOTH, WIFI_LAN, INCOMING, connection_token);
@@ -838,6 +1049,7 @@ TEST(AnalyticsRecorderTest, UpgradeAttemptWorks) {
                     upgrade_result: UPGRADE_RESULT_SUCCESS
                     error_stage: UPGRADE_SUCCESS
                     connection_token: "connection_token"
+                    write_stall_millis: 20
                   >
                   upgrade_attempt {
                     direction: INCOMING
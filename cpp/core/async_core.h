@@ -0,0 +1,469 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_ASYNC_CORE_H_
+#define CORE_ASYNC_CORE_H_
+
+// Coroutine facade over Core. Every Core entry point reports its outcome via a
+// ResultCallback; AsyncCore turns those calls into awaitables, so that
+//
+//   Status status = co_await async_core.RequestConnection(id, info, options);
+//
+// reads top to bottom. PayloadProgressStream does the same for the stream of
+// PayloadProgressInfo updates delivered to a PayloadListener.
+//
+// This header requires C++20 coroutines, so targets that depend on async_core
+// have to be built with -std=c++20 themselves; C++14/17 code keeps using Core
+// directly.
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "core/async_core.h requires C++20 coroutines; build with -std=c++20."
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "core/core.h"
+#include "core/listeners.h"
+#include "core/options.h"
+#include "core/params.h"
+#include "core/payload.h"
+#include "core/status.h"
+#include "platform/api/executor.h"
+#include "platform/public/future.h"
+#include "platform/public/mutex.h"
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+namespace async_core_internal {
+
+// Resumes a suspended coroutine on |executor|, or on the calling thread if
+// |executor| is null.
+inline void Resume(std::coroutine_handle<> handle, api::Executor* executor) {
+  if (executor == nullptr) {
+    handle.resume();
+  } else {
+    executor->Execute([handle]() { handle.resume(); });
+  }
+}
+
+}  // namespace async_core_internal
+
+// Awaitable for a single Core call. The call is started when the awaitable is
+// co_await-ed (not when it is created), and the awaiting coroutine resumes
+// with the Status passed to the ResultCallback.
+//
+// Without an executor, if Core invokes the callback before the coroutine had a
+// chance to suspend, the coroutine simply continues on its current thread. If
+// Core never invokes the callback, the awaiting coroutine is never resumed.
+class StatusAwaitable {
+ public:
+  using Start = std::function<void(ResultCallback callback)>;
+
+  StatusAwaitable(Start start, api::Executor* executor)
+      : start_(std::move(start)), executor_(executor) {}
+  StatusAwaitable(const StatusAwaitable&) = delete;
+  StatusAwaitable& operator=(const StatusAwaitable&) = delete;
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    // With an executor, the callback always owns the resume; the frame (and
+    // this awaitable) may be gone by the time start() returns. That is why
+    // the call runs from a local rather than from start_.
+    const bool always_suspend = executor_ != nullptr;
+    handle_ = handle;
+    Start start = std::move(start_);
+    start(ResultCallback{[this](Status status) {
+      status_ = status;
+      // Otherwise whoever comes second (this callback or await_suspend) owns
+      // the resume.
+      if (executor_ != nullptr ||
+          completed_.exchange(true, std::memory_order_acq_rel)) {
+        async_core_internal::Resume(handle_, executor_);
+      }
+    }});
+    return always_suspend ||
+           !completed_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  Status await_resume() const noexcept { return status_; }
+
+ private:
+  Start start_;
+  api::Executor* executor_;
+  std::coroutine_handle<> handle_;
+  std::atomic<bool> completed_{false};
+  Status status_;
+};
+
+// Single-consumer asynchronous sequence of payload progress updates.
+//
+//   PayloadProgressStream progress;
+//   co_await async_core.AcceptConnection(id, progress.Listen(listener));
+//   while (auto update = co_await progress.Next()) { ... }
+//
+// A stream constructed for a payload id only yields updates of that payload
+// and ends after its terminal (non kInProgress) update. A stream constructed
+// without one yields updates of every payload until Close() is called.
+//
+// Updates are buffered, so a slow consumer never blocks the thread that
+// delivers PayloadListener callbacks. The stream may be destroyed while Core
+// still holds its listener; later updates are dropped.
+class PayloadProgressStream {
+ private:
+  class State;
+
+ public:
+  struct Update {
+    std::string endpoint_id;
+    PayloadProgressInfo info;
+  };
+
+  explicit PayloadProgressStream(api::Executor* executor = nullptr)
+      : state_(std::make_shared<State>(executor, absl::nullopt)) {}
+  explicit PayloadProgressStream(std::int64_t payload_id,
+                                 api::Executor* executor = nullptr)
+      : state_(std::make_shared<State>(executor, payload_id)) {}
+  ~PayloadProgressStream() { Close(); }
+  PayloadProgressStream(PayloadProgressStream&&) = default;
+  PayloadProgressStream& operator=(PayloadProgressStream&&) = default;
+
+  // Returns a copy of |listener| whose progress callback also feeds this
+  // stream.
+  PayloadListener Listen(PayloadListener listener = {}) {
+    auto progress_cb = std::move(listener.payload_progress_cb);
+    listener.payload_progress_cb =
+        [state = state_, progress_cb = std::move(progress_cb)](
+            const std::string& endpoint_id, const PayloadProgressInfo& info) {
+          state->Push(endpoint_id, info);
+          if (progress_cb) progress_cb(endpoint_id, info);
+        };
+    return listener;
+  }
+
+  // Ends the stream; a pending Next() resumes with absl::nullopt.
+  void Close() {
+    if (state_) state_->Close();
+  }
+
+  // Awaitable for the next update; yields absl::nullopt once the stream ended.
+  class NextAwaitable {
+   public:
+    explicit NextAwaitable(State* state) : state_(state) {}
+
+    bool await_ready() const { return state_->Ready(); }
+    bool await_suspend(std::coroutine_handle<> handle) {
+      return state_->Wait(handle);
+    }
+    absl::optional<Update> await_resume() { return state_->Pop(); }
+
+   private:
+    State* state_;
+  };
+
+  NextAwaitable Next() { return NextAwaitable(state_.get()); }
+
+ private:
+  class State {
+   public:
+    State(api::Executor* executor, absl::optional<std::int64_t> payload_id)
+        : executor_(executor), payload_id_(payload_id) {}
+
+    void Push(const std::string& endpoint_id, const PayloadProgressInfo& info) {
+      if (payload_id_.has_value() && *payload_id_ != info.payload_id) return;
+      bool terminal = payload_id_.has_value() &&
+                      info.status != PayloadProgressInfo::Status::kInProgress;
+      std::coroutine_handle<> waiter;
+      {
+        MutexLock lock(&mutex_);
+        if (closed_) return;
+        updates_.push_back({endpoint_id, info});
+        closed_ = terminal;
+        waiter = std::exchange(waiter_, nullptr);
+      }
+      if (waiter) async_core_internal::Resume(waiter, executor_);
+    }
+
+    void Close() {
+      std::coroutine_handle<> waiter;
+      {
+        MutexLock lock(&mutex_);
+        closed_ = true;
+        waiter = std::exchange(waiter_, nullptr);
+      }
+      if (waiter) async_core_internal::Resume(waiter, executor_);
+    }
+
+    bool Ready() const {
+      MutexLock lock(&mutex_);
+      return closed_ || !updates_.empty();
+    }
+
+    bool Wait(std::coroutine_handle<> handle) {
+      MutexLock lock(&mutex_);
+      if (closed_ || !updates_.empty()) return false;
+      waiter_ = handle;
+      return true;
+    }
+
+    absl::optional<Update> Pop() {
+      MutexLock lock(&mutex_);
+      if (updates_.empty()) return absl::nullopt;
+      Update update = std::move(updates_.front());
+      updates_.pop_front();
+      return update;
+    }
+
+   private:
+    api::Executor* const executor_;
+    const absl::optional<std::int64_t> payload_id_;
+    mutable Mutex mutex_;
+    std::deque<Update> updates_;
+    std::coroutine_handle<> waiter_;
+    bool closed_ = false;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+// Eagerly started coroutine producing a T; T must be default-constructible
+// (eg. Status). The result can be co_await-ed from another coroutine, or
+// waited for with Get() from a regular thread.
+//
+//   AsyncTask<Status> Connect(AsyncCore& core, std::string id) {
+//     Status status = co_await core.RequestConnection(id, info, options);
+//     if (!status.Ok()) co_return status;
+//     co_return co_await core.AcceptConnection(id, listener);
+//   }
+//
+// Dropping an AsyncTask does not cancel the coroutine; it runs to completion.
+template <typename T>
+class AsyncTask {
+ private:
+  struct State {
+    Future<T> result;
+    Mutex mutex;
+    bool done = false;
+    std::coroutine_handle<> continuation;
+  };
+
+ public:
+  class promise_type {
+   public:
+    AsyncTask get_return_object() { return AsyncTask(state_); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+
+    auto final_suspend() noexcept {
+      struct FinalAwaitable {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<promise_type> handle) noexcept {
+          std::coroutine_handle<> continuation = handle.promise().continuation_;
+          handle.destroy();
+          if (continuation) return continuation;
+          return std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+      };
+      return FinalAwaitable{};
+    }
+
+    void return_value(T value) {
+      state_->result.Set(std::move(value));
+      MutexLock lock(&state_->mutex);
+      state_->done = true;
+      continuation_ = std::exchange(state_->continuation, nullptr);
+    }
+
+    void unhandled_exception() noexcept { std::terminate(); }
+
+   private:
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+    std::coroutine_handle<> continuation_;
+  };
+
+  // Blocks until the coroutine finished, and returns its result.
+  ExceptionOr<T> Get() { return state_->result.Get(); }
+  ExceptionOr<T> Get(absl::Duration timeout) {
+    return state_->result.Get(timeout);
+  }
+  bool IsDone() const { return state_->result.IsSet(); }
+
+  bool await_ready() const noexcept { return IsDone(); }
+  bool await_suspend(std::coroutine_handle<> handle) {
+    MutexLock lock(&state_->mutex);
+    if (state_->done) return false;
+    state_->continuation = handle;
+    return true;
+  }
+  T await_resume() { return std::move(state_->result.Get().result()); }
+
+ private:
+  explicit AsyncTask(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+  std::shared_ptr<State> state_;
+};
+
+// Thin coroutine adapter over Core. Arguments are copied into the returned
+// awaitable, so it may outlive them; the call itself is made when the
+// awaitable is co_await-ed.
+//
+// Coroutines resume on |executor| when one is given. Otherwise they resume on
+// whatever thread delivered the Core callback, which is an internal Nearby
+// thread: code following a co_await must then not block, and must not call
+// back into Core synchronously.
+class AsyncCore {
+ public:
+  explicit AsyncCore(Core* core, api::Executor* executor = nullptr)
+      : core_(core), executor_(executor) {}
+
+  // See Core::StartAdvertising().
+  StatusAwaitable StartAdvertising(absl::string_view service_id,
+                                   ConnectionOptions options,
+                                   ConnectionRequestInfo info) {
+    return Await([core = core_, service_id = std::string(service_id), options,
+                  info](ResultCallback callback) {
+      core->StartAdvertising(service_id, options, info, std::move(callback));
+    });
+  }
+
+  // See Core::StopAdvertising().
+  StatusAwaitable StopAdvertising() {
+    return Await([core = core_](ResultCallback callback) {
+      core->StopAdvertising(std::move(callback));
+    });
+  }
+
+  // See Core::StartDiscovery().
+  StatusAwaitable StartDiscovery(absl::string_view service_id,
+                                 ConnectionOptions options,
+                                 DiscoveryListener listener) {
+    return Await([core = core_, service_id = std::string(service_id), options,
+                  listener](ResultCallback callback) {
+      core->StartDiscovery(service_id, options, listener, std::move(callback));
+    });
+  }
+
+  // See Core::StopDiscovery().
+  StatusAwaitable StopDiscovery() {
+    return Await([core = core_](ResultCallback callback) {
+      core->StopDiscovery(std::move(callback));
+    });
+  }
+
+  // See Core::RequestConnection().
+  StatusAwaitable RequestConnection(absl::string_view endpoint_id,
+                                    ConnectionRequestInfo info,
+                                    ConnectionOptions options) {
+    return Await([core = core_, endpoint_id = std::string(endpoint_id), info,
+                  options](ResultCallback callback) {
+      core->RequestConnection(endpoint_id, info, options, std::move(callback));
+    });
+  }
+
+  // See Core::AcceptConnection(). Use PayloadProgressStream::Listen() to
+  // observe transfers as a stream.
+  StatusAwaitable AcceptConnection(absl::string_view endpoint_id,
+                                   PayloadListener listener) {
+    return Await([core = core_, endpoint_id = std::string(endpoint_id),
+                  listener](ResultCallback callback) {
+      core->AcceptConnection(endpoint_id, listener, std::move(callback));
+    });
+  }
+
+  // See Core::RejectConnection().
+  StatusAwaitable RejectConnection(absl::string_view endpoint_id) {
+    return Await([core = core_, endpoint_id = std::string(endpoint_id)](
+                     ResultCallback callback) {
+      core->RejectConnection(endpoint_id, std::move(callback));
+    });
+  }
+
+  // See Core::SendPayload(). Resumes once the payload is queued for sending;
+  // await a PayloadProgressStream for its delivery.
+  StatusAwaitable SendPayload(absl::Span<const std::string> endpoint_ids,
+                              Payload payload) {
+    // Payload is move-only, while StatusAwaitable::Start must be copyable.
+    auto shared_payload = std::make_shared<Payload>(std::move(payload));
+    return Await([core = core_,
+                  endpoint_ids = std::vector<std::string>(endpoint_ids.begin(),
+                                                          endpoint_ids.end()),
+                  shared_payload](ResultCallback callback) {
+      core->SendPayload(endpoint_ids, std::move(*shared_payload),
+                        std::move(callback));
+    });
+  }
+
+  // See Core::CancelPayload().
+  StatusAwaitable CancelPayload(std::int64_t payload_id) {
+    return Await([core = core_, payload_id](ResultCallback callback) {
+      core->CancelPayload(payload_id, std::move(callback));
+    });
+  }
+
+  // See Core::DisconnectFromEndpoint().
+  StatusAwaitable DisconnectFromEndpoint(absl::string_view endpoint_id) {
+    return Await([core = core_, endpoint_id = std::string(endpoint_id)](
+                     ResultCallback callback) {
+      core->DisconnectFromEndpoint(endpoint_id, std::move(callback));
+    });
+  }
+
+  // See Core::StopAllEndpoints().
+  StatusAwaitable StopAllEndpoints() {
+    return Await([core = core_](ResultCallback callback) {
+      core->StopAllEndpoints(std::move(callback));
+    });
+  }
+
+  // See Core::InitiateBandwidthUpgrade().
+  StatusAwaitable InitiateBandwidthUpgrade(absl::string_view endpoint_id) {
+    return Await([core = core_, endpoint_id = std::string(endpoint_id)](
+                     ResultCallback callback) {
+      core->InitiateBandwidthUpgrade(endpoint_id, std::move(callback));
+    });
+  }
+
+  Core* GetCore() const { return core_; }
+
+ private:
+  StatusAwaitable Await(StatusAwaitable::Start start) {
+    return StatusAwaitable(std::move(start), executor_);
+  }
+
+  Core* core_;
+  api::Executor* executor_;
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_ASYNC_CORE_H_
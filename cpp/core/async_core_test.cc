@@ -0,0 +1,212 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/async_core.h"
+
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "core/core.h"
+#include "core/internal/mock_service_controller_router.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+using ::testing::_;
+using ::testing::Eq;
+
+constexpr absl::Duration kWaitTimeout = absl::Seconds(1);
+
+class AsyncCoreTest : public ::testing::Test {
+ protected:
+  AsyncCoreTest() {
+    // Called when Core is destroyed.
+    EXPECT_CALL(mock_, StopAllEndpoints)
+        .WillRepeatedly(
+            [](ClientProxy* client, const ResultCallback& callback) {
+              callback.result_cb({Status::kSuccess});
+            });
+  }
+
+  MockServiceControllerRouter mock_;
+  Core core_{&mock_};
+};
+
+AsyncTask<Status> Connect(AsyncCore& async_core, std::string endpoint_id) {
+  Status status = co_await async_core.RequestConnection(
+      endpoint_id, ConnectionRequestInfo{}, ConnectionOptions{});
+  if (!status.Ok()) co_return status;
+  co_return co_await async_core.AcceptConnection(endpoint_id,
+                                                 PayloadListener{});
+}
+
+AsyncTask<bool> StopAdvertisingOn(AsyncCore& async_core,
+                                  const std::thread::id& thread_id) {
+  co_await async_core.StopAdvertising();
+  co_return std::this_thread::get_id() == thread_id;
+}
+
+AsyncTask<Status> Send(AsyncCore& async_core,
+                       std::vector<std::string> endpoint_ids,
+                       Payload payload) {
+  co_return co_await async_core.SendPayload(endpoint_ids, std::move(payload));
+}
+
+AsyncTask<bool> Drain(PayloadProgressStream& stream,
+                      std::vector<PayloadProgressStream::Update>* updates) {
+  while (auto update = co_await stream.Next()) {
+    updates->push_back(*std::move(update));
+  }
+  co_return true;
+}
+
+TEST_F(AsyncCoreTest, CompletesWhenCallbackRunsInline) {
+  EXPECT_CALL(mock_, RequestConnection(_, Eq("endpoint"), _, _, _))
+      .WillOnce([](ClientProxy*, absl::string_view,
+                   const ConnectionRequestInfo&, const ConnectionOptions&,
+                   const ResultCallback& callback) {
+        callback.result_cb({Status::kSuccess});
+      });
+  EXPECT_CALL(mock_, AcceptConnection(_, Eq("endpoint"), _, _))
+      .WillOnce([](ClientProxy*, absl::string_view, const PayloadListener&,
+                   const ResultCallback& callback) {
+        callback.result_cb({Status::kSuccess});
+      });
+  AsyncCore async_core(&core_);
+
+  AsyncTask<Status> task = Connect(async_core, "endpoint");
+
+  EXPECT_TRUE(task.IsDone());
+  EXPECT_EQ(task.Get().result(), Status{Status::kSuccess});
+}
+
+TEST_F(AsyncCoreTest, ResumesWhenCallbackRunsLater) {
+  ResultCallback pending;
+  EXPECT_CALL(mock_, RequestConnection)
+      .WillOnce([&pending](ClientProxy*, absl::string_view,
+                           const ConnectionRequestInfo&,
+                           const ConnectionOptions&,
+                           const ResultCallback& callback) {
+        pending = callback;
+      });
+  EXPECT_CALL(mock_, AcceptConnection).Times(0);
+  AsyncCore async_core(&core_);
+
+  AsyncTask<Status> task = Connect(async_core, "endpoint");
+  EXPECT_FALSE(task.IsDone());
+  std::thread callback_thread(
+      [&pending]() { pending.result_cb({Status::kEndpointUnknown}); });
+  callback_thread.join();
+
+  EXPECT_EQ(task.Get(kWaitTimeout).result(),
+            Status{Status::kEndpointUnknown});
+}
+
+TEST_F(AsyncCoreTest, ResumesOnExecutor) {
+  std::thread callback_thread;
+  EXPECT_CALL(mock_, StopAdvertising)
+      .WillOnce([&callback_thread](ClientProxy*,
+                                   const ResultCallback& callback) {
+        callback_thread = std::thread(
+            [callback]() { callback.result_cb({Status::kSuccess}); });
+      });
+  SingleThreadExecutor executor;
+  std::thread::id executor_thread;
+  executor.Execute(
+      [&executor_thread]() { executor_thread = std::this_thread::get_id(); });
+  AsyncCore async_core(&core_, &executor);
+
+  AsyncTask<bool> task = StopAdvertisingOn(async_core, executor_thread);
+
+  EXPECT_TRUE(task.Get(kWaitTimeout).result());
+  callback_thread.join();
+  executor.Shutdown();
+}
+
+TEST_F(AsyncCoreTest, SendPayloadHandsOverPayload) {
+  Payload payload(ByteArray(std::string("data")));
+  const std::int64_t payload_id = payload.GetId();
+  std::vector<std::string> endpoint_ids = {"A", "B"};
+  EXPECT_CALL(mock_, SendPayload)
+      .WillOnce([&](ClientProxy*, absl::Span<const std::string> ids,
+                    Payload sent, const ResultCallback& callback) {
+        EXPECT_EQ(std::vector<std::string>(ids.begin(), ids.end()),
+                  endpoint_ids);
+        EXPECT_EQ(sent.GetId(), payload_id);
+        callback.result_cb({Status::kSuccess});
+      });
+  AsyncCore async_core(&core_);
+
+  AsyncTask<Status> task = Send(async_core, endpoint_ids, std::move(payload));
+
+  EXPECT_EQ(task.Get(kWaitTimeout).result(), Status{Status::kSuccess});
+}
+
+TEST(PayloadProgressStreamTest, YieldsUpdatesUntilTransferEnds) {
+  PayloadProgressStream stream(/*payload_id=*/7);
+  int forwarded = 0;
+  PayloadListener listener;
+  listener.payload_progress_cb = [&forwarded](const std::string&,
+                                              const PayloadProgressInfo&) {
+    forwarded++;
+  };
+  listener = stream.Listen(std::move(listener));
+
+  std::vector<PayloadProgressStream::Update> updates;
+  AsyncTask<bool> task = Drain(stream, &updates);
+  EXPECT_FALSE(task.IsDone());
+
+  using S = PayloadProgressInfo::Status;
+  listener.payload_progress_cb("endpoint", {7, S::kInProgress, 100, 10});
+  listener.payload_progress_cb("endpoint", {8, S::kInProgress, 100, 20});
+  listener.payload_progress_cb("endpoint", {7, S::kInProgress, 100, 50});
+  EXPECT_FALSE(task.IsDone());
+  listener.payload_progress_cb("endpoint", {7, S::kSuccess, 100, 100});
+  listener.payload_progress_cb("endpoint", {7, S::kSuccess, 100, 100});
+
+  EXPECT_TRUE(task.Get(kWaitTimeout).ok());
+  std::vector<std::int64_t> seen;
+  for (const auto& update : updates) {
+    EXPECT_EQ(update.endpoint_id, "endpoint");
+    seen.push_back(update.info.bytes_transferred);
+  }
+  EXPECT_EQ(seen, (std::vector<std::int64_t>{10, 50, 100}));
+  EXPECT_EQ(forwarded, 5);
+}
+
+TEST(PayloadProgressStreamTest, CloseEndsPendingNext) {
+  PayloadProgressStream stream;
+  PayloadListener listener = stream.Listen();
+  listener.payload_progress_cb(
+      "endpoint", {1, PayloadProgressInfo::Status::kSuccess, 1, 1});
+
+  std::vector<PayloadProgressStream::Update> updates;
+  AsyncTask<bool> task = Drain(stream, &updates);
+  EXPECT_FALSE(task.IsDone());
+  stream.Close();
+
+  EXPECT_TRUE(task.Get(kWaitTimeout).ok());
+  EXPECT_THAT(updates, ::testing::SizeIs(1));
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -27,6 +27,9 @@
 #include "core/listeners.h"
 #include "core/options.h"
 #include "core/params.h"
+#include "platform/public/executor_service.h"
+#include "platform/public/metrics.h"
+#include "platform/public/trace.h"
 
 namespace location {
 namespace nearby {
@@ -235,6 +238,34 @@ class Core {
   // Gets the local endpoint generated by Nearby Connections.
   std::string GetLocalEndpointId() { return client_.GetLocalEndpointId(); }
 
+  // Gets the current values of the metrics of Nearby Connections, such as
+  // queue depths, per-endpoint throughput and handshake latencies. Metrics
+  // are process-wide, so they cover all Core instances.
+  MetricsRegistry::Snapshot GetMetricsSnapshot() {
+    return MetricsRegistry::GetInstance().GetSnapshot();
+  }
+
+  // Same as GetMetricsSnapshot(), rendered in the Prometheus text exposition
+  // format, e.g. to be served to a scraper.
+  std::string ExportMetrics() {
+    return MetricsRegistry::GetInstance().ExportText();
+  }
+
+  // Gets the latest spans of the payload transfer pipeline as Chrome trace
+  // JSON, to be opened in chrome://tracing or Perfetto. Spans are only
+  // recorded in builds with -DNEARBY_TRACE; otherwise the trace is empty.
+  std::string ExportTrace() {
+    return Tracer::GetInstance().ExportChromeTrace();
+  }
+
+  // Lists the worker threads that the executors of all Core instances share,
+  // and the queue each of them is busy with, one thread per line. Executors
+  // only share threads if FeatureFlags::Flags::enable_shared_executors is set;
+  // otherwise the list is empty.
+  std::string DumpThreads() {
+    return ExecutorService::GetInstance().DumpThreads();
+  }
+
  private:
   ClientProxy client_;
   ServiceControllerRouter* router_ = nullptr;
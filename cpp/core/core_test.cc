@@ -46,6 +46,35 @@ TEST(CoreTest, DestructorReportsFatalFailure) {
       "Unable to shutdown");
 }
 
+TEST(CoreTest, ExportsMetrics) {
+  MockServiceControllerRouter mock;
+  EXPECT_CALL(mock, StopAllEndpoints)
+      .WillOnce([&](ClientProxy* client, const ResultCallback& callback) {
+        callback.result_cb({Status::kSuccess});
+      });
+  Core core{&mock};
+  MetricsRegistry::GetInstance()
+      .GetCounter("core_test_events_total", "Test events.")
+      ->Increment(2);
+
+  EXPECT_EQ(core.GetMetricsSnapshot().counters["core_test_events_total"], 2);
+  EXPECT_THAT(core.ExportMetrics(),
+              ::testing::HasSubstr("\ncore_test_events_total 2\n"));
+}
+
+TEST(CoreTest, ExportsTrace) {
+  MockServiceControllerRouter mock;
+  EXPECT_CALL(mock, StopAllEndpoints)
+      .WillOnce([&](ClientProxy* client, const ResultCallback& callback) {
+        callback.result_cb({Status::kSuccess});
+      });
+  Core core{&mock};
+  { TraceSpan span("CoreTestSpan", "ABCD", 1, 0); }
+
+  EXPECT_THAT(core.ExportTrace(),
+              ::testing::HasSubstr("\"name\":\"CoreTestSpan\""));
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
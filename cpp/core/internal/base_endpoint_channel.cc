@@ -19,11 +19,14 @@
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "core/internal/offline_frames.h"
+#include "platform/base/buffer_pool.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
 #include "platform/public/logging.h"
+#include "platform/public/metrics.h"
 #include "platform/public/mutex.h"
 #include "platform/public/mutex_lock.h"
+#include "platform/public/trace.h"
 #include "proto/connections_enums.pb.h"
 
 namespace location {
@@ -32,6 +35,28 @@ namespace connections {
 
 namespace {
 
+struct ChannelMetrics {
+  Counter* frames_read;
+  Counter* frames_written;
+  Histogram* write_latency;
+};
+
+const ChannelMetrics& GetChannelMetrics() {
+  static const ChannelMetrics* metrics = [] {
+    MetricsRegistry& registry = MetricsRegistry::GetInstance();
+    return new ChannelMetrics{
+        registry.GetCounter("nearby_channel_frames_read_total",
+                            "Frames read from all endpoint channels."),
+        registry.GetCounter("nearby_channel_frames_written_total",
+                            "Frames written to all endpoint channels."),
+        registry.GetHistogram(
+            "nearby_channel_write_latency_micros",
+            "Time to encrypt, write and flush a frame, in microseconds."),
+    };
+  }();
+  return *metrics;
+}
+
 std::int32_t BytesToInt(const ByteArray& bytes) {
   const char* int_bytes = bytes.data();
 
@@ -55,7 +80,7 @@ ByteArray IntToBytes(std::int32_t value) {
 }
 
 ExceptionOr<ByteArray> ReadExactly(InputStream* reader, std::int64_t size) {
-  ByteArray buffer(size);
+  ByteArray buffer;
   std::int64_t current_pos = 0;
 
   while (current_pos < size) {
@@ -63,12 +88,20 @@ ExceptionOr<ByteArray> ReadExactly(InputStream* reader, std::int64_t size) {
     if (!read_bytes.ok()) {
       return read_bytes;
     }
-    ByteArray result = read_bytes.result();
+    ByteArray result = std::move(read_bytes.result());
+    // Most reads return the whole frame at once; it needs no copying then.
+    if (current_pos == 0 &&
+        static_cast<std::int64_t>(result.size()) == size) {
+      return ExceptionOr<ByteArray>(std::move(result));
+    }
 
     if (result.Empty()) {
       NEARBY_LOGS(WARNING) << __func__ << ": Empty result when reading bytes.";
       return ExceptionOr<ByteArray>(Exception::kIo);
     }
+    if (buffer.Empty()) {
+      buffer = BufferPool::GetInstance().Acquire(size);
+    }
 
     buffer.CopyAt(current_pos, result);
     current_pos += result.size();
@@ -140,16 +173,21 @@ ExceptionOr<ByteArray> BaseEndpointChannel::Read() {
     }
     result = std::move(read_bytes.result());
   }
+  std::int64_t frame_size = sizeof(std::int32_t) + result.size();
 
   {
     MutexLock crypto_lock(&crypto_mutex_);
-    if (IsEncryptionEnabledLocked()) {
+    if (read_crypto_context_ != nullptr) {
       // If encryption is enabled, decode the message.
       std::string input(std::move(result));
-      std::unique_ptr<std::string> decrypted_data =
-          crypto_context_->DecodeMessageFromPeer(input);
+      std::unique_ptr<std::string> decrypted_data;
+      {
+        NEARBY_TRACE_SPAN(decode_span, "Ukey2Decode");
+        decrypted_data = read_crypto_context_->DecodeMessageFromPeer(input);
+      }
       if (decrypted_data) {
         result = ByteArray(std::move(*decrypted_data));
+        BufferPool::GetInstance().Release(std::move(input));
       } else {
         // It could be a protocol race, where remote party sends a KEEP_ALIVE
         // before encryption is setup on their side, and we receive it after
@@ -185,11 +223,22 @@ ExceptionOr<ByteArray> BaseEndpointChannel::Read() {
   {
     MutexLock lock(&last_read_mutex_);
     last_read_timestamp_ = SystemClock::ElapsedRealtime();
+    if (bytes_read_) bytes_read_->Increment(frame_size);
   }
+  GetChannelMetrics().frames_read->Increment();
   return ExceptionOr<ByteArray>(result);
 }
 
 Exception BaseEndpointChannel::Write(const ByteArray& data) {
+  return WriteFrame(data, /*is_last=*/false);
+}
+
+Exception BaseEndpointChannel::WriteLast(const ByteArray& data) {
+  return WriteFrame(data, /*is_last=*/true);
+}
+
+Exception BaseEndpointChannel::WriteFrame(const ByteArray& data,
+                                          bool is_last) {
   {
     MutexLock pause_lock(&is_paused_mutex_);
     if (is_paused_) {
@@ -197,6 +246,7 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
     }
   }
 
+  absl::Time start_time = SystemClock::ElapsedRealtime();
   ByteArray encrypted_data;
   const ByteArray* data_to_write = &data;
   {
@@ -205,10 +255,16 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
     // failure to decrypt on the reader side. However we need to release the
     // crypto lock after encrypting to ensure read decryption is not blocked.
     MutexLock lock(&writer_mutex_);
+    if (is_sealed_) {
+      NEARBY_LOGS(INFO) << __func__ << ": Writes are sealed on channel "
+                        << channel_name_;
+      return {Exception::kIo};
+    }
     {
       MutexLock crypto_lock(&crypto_mutex_);
       if (IsEncryptionEnabledLocked()) {
         // If encryption is enabled, encode the message.
+        NEARBY_TRACE_SPAN(encode_span, "Ukey2Encode");
         std::unique_ptr<std::string> encrypted =
             crypto_context_->EncodeMessageToPeer(std::string(data));
         if (!encrypted) {
@@ -220,6 +276,7 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
       }
     }
 
+    NEARBY_TRACE_SPAN(write_span, "SocketWrite");
     Exception write_exception =
         WriteInt(writer_, static_cast<std::int32_t>(data_to_write->size()));
     if (write_exception.Raised()) {
@@ -239,11 +296,22 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
                            << flush_exception.value;
       return flush_exception;
     }
+    is_sealed_ = is_last;
   }
 
+  absl::Time end_time = SystemClock::ElapsedRealtime();
   {
     MutexLock lock(&last_write_mutex_);
-    last_write_timestamp_ = SystemClock::ElapsedRealtime();
+    last_write_timestamp_ = end_time;
+    if (bytes_written_) {
+      bytes_written_->Increment(sizeof(std::int32_t) + data_to_write->size());
+    }
+  }
+  const ChannelMetrics& metrics = GetChannelMetrics();
+  metrics.frames_written->Increment();
+  metrics.write_latency->Record(end_time - start_time);
+  if (!encrypted_data.Empty()) {
+    BufferPool::GetInstance().Release(std::move(encrypted_data));
   }
   return {Exception::kSuccess};
 }
@@ -287,6 +355,21 @@ void BaseEndpointChannel::SetAnalyticsRecorder(
     const std::string& endpoint_id) {
   analytics_recorder_ = analytics_recorder;
   endpoint_id_ = endpoint_id;
+
+  MetricsRegistry& registry = MetricsRegistry::GetInstance();
+  MetricLabels labels = {{"endpoint_id", endpoint_id}};
+  {
+    MutexLock lock(&last_read_mutex_);
+    bytes_read_ = registry.GetScopedCounter(
+        "nearby_endpoint_bytes_read_total",
+        "Bytes read from an endpoint, including framing.", labels);
+  }
+  {
+    MutexLock lock(&last_write_mutex_);
+    bytes_written_ = registry.GetScopedCounter(
+        "nearby_endpoint_bytes_written_total",
+        "Bytes written to an endpoint, including framing.", labels);
+  }
 }
 
 void BaseEndpointChannel::Close(
@@ -320,15 +403,35 @@ int BaseEndpointChannel::GetMaxTransmitPacketSize() const {
   return kDefaultMaxTransmitPacketSize;
 }
 
+// Switching to new write keys also lifts the seal left by WriteLast(): what is
+// written next can't be mistaken for a frame encrypted with the old keys.
 void BaseEndpointChannel::EnableEncryption(
     std::shared_ptr<EncryptionContext> context) {
+  MutexLock lock(&writer_mutex_);
   MutexLock crypto_lock(&crypto_mutex_);
   crypto_context_ = context;
+  read_crypto_context_ = context;
+  is_sealed_ = false;
 }
 
 void BaseEndpointChannel::DisableEncryption() {
   MutexLock crypto_lock(&crypto_mutex_);
   crypto_context_.reset();
+  read_crypto_context_.reset();
+}
+
+void BaseEndpointChannel::EnableWriteEncryption(
+    std::shared_ptr<EncryptionContext> context) {
+  MutexLock lock(&writer_mutex_);
+  MutexLock crypto_lock(&crypto_mutex_);
+  crypto_context_ = context;
+  is_sealed_ = false;
+}
+
+void BaseEndpointChannel::EnableReadEncryption(
+    std::shared_ptr<EncryptionContext> context) {
+  MutexLock crypto_lock(&crypto_mutex_);
+  read_crypto_context_ = context;
 }
 
 bool BaseEndpointChannel::IsPaused() const {
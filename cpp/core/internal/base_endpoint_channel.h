@@ -28,6 +28,7 @@
 #include "platform/base/output_stream.h"
 #include "platform/public/atomic_reference.h"
 #include "platform/public/condition_variable.h"
+#include "platform/public/metrics.h"
 #include "platform/public/mutex.h"
 #include "platform/public/system_clock.h"
 
@@ -53,6 +54,10 @@ class BaseEndpointChannel : public EndpointChannel {
   Exception Write(const ByteArray& data)
       ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_) override;
 
+  // Writes |data|, then rejects further writes until the write keys change.
+  Exception WriteLast(const ByteArray& data)
+      ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_) override;
+
   // Closes this EndpointChannel, without tracking the closure in analytics.
   void Close() ABSL_LOCKS_EXCLUDED(is_paused_mutex_) override;
 
@@ -79,6 +84,13 @@ class BaseEndpointChannel : public EndpointChannel {
   // Disables encryption on the EndpointChannel.
   void DisableEncryption() override;
 
+  // Switches only the writes, or only the reads, of the EndpointChannel to
+  // encryption with |context|.
+  void EnableWriteEncryption(
+      std::shared_ptr<EncryptionContext> context) override;
+  void EnableReadEncryption(
+      std::shared_ptr<EncryptionContext> context) override;
+
   // True if the EndpointChannel is currently pausing all writes.
   bool IsPaused() const ABSL_LOCKS_EXCLUDED(is_paused_mutex_) override;
 
@@ -124,6 +136,8 @@ class BaseEndpointChannel : public EndpointChannel {
   // The default maximum transmit unit/packet size.
   static constexpr int kDefaultMaxTransmitPacketSize = 65536;  // 64 KB
 
+  Exception WriteFrame(const ByteArray& data, bool is_last)
+      ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_);
   bool IsEncryptionEnabledLocked() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(crypto_mutex_);
   void UnblockPausedWriter() ABSL_EXCLUSIVE_LOCKS_REQUIRED(is_paused_mutex_);
@@ -135,12 +149,16 @@ class BaseEndpointChannel : public EndpointChannel {
   mutable Mutex last_read_mutex_;
   absl::Time last_read_timestamp_ ABSL_GUARDED_BY(last_read_mutex_) =
       absl::InfinitePast();
+  // Bytes read from the endpoint, once it is known. Shares the timestamp
+  // mutex, which every read takes anyway.
+  std::shared_ptr<Counter> bytes_read_ ABSL_GUARDED_BY(last_read_mutex_);
 
   // We need a separate mutex to protect write timestamp, because if a write
   // blocks on IO, we don't want timestamp write access to block too.
   mutable Mutex last_write_mutex_;
   absl::Time last_write_timestamp_ ABSL_GUARDED_BY(last_write_mutex_) =
       absl::InfinitePast();
+  std::shared_ptr<Counter> bytes_written_ ABSL_GUARDED_BY(last_write_mutex_);
 
   const std::string channel_name_;
 
@@ -151,11 +169,16 @@ class BaseEndpointChannel : public EndpointChannel {
 
   Mutex writer_mutex_;
   OutputStream* writer_ ABSL_PT_GUARDED_BY(writer_mutex_);
+  // Set by WriteLast(); cleared when the write keys change.
+  bool is_sealed_ ABSL_GUARDED_BY(writer_mutex_) = false;
 
-  // An encryptor/decryptor. May be null.
+  // An encryptor and a decryptor. May be null. They are the same context,
+  // unless the channel is moving over to new keys.
   mutable Mutex crypto_mutex_;
   std::shared_ptr<EncryptionContext> crypto_context_
       ABSL_GUARDED_BY(crypto_mutex_) ABSL_PT_GUARDED_BY(crypto_mutex_);
+  std::shared_ptr<EncryptionContext> read_crypto_context_
+      ABSL_GUARDED_BY(crypto_mutex_) ABSL_PT_GUARDED_BY(crypto_mutex_);
 
   mutable Mutex is_paused_mutex_;
   ConditionVariable is_paused_cond_{&is_paused_mutex_};
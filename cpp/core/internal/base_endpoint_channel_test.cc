@@ -25,6 +25,7 @@
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "core/internal/encryption_runner.h"
+#include "core/internal/endpoint_channel_manager.h"
 #include "core/internal/offline_frames.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
@@ -287,6 +288,72 @@ TEST(BaseEndpointChannelTest, EncryptedReadWriteCanNotBeIntercepted) {
   channel_b.Close(DisconnectionReason::REMOTE_DISCONNECTION);
 }
 
+TEST(BaseEndpointChannelTest, EachDirectionCanSwitchKeys) {
+  Pipe pipe_a;  // channel_a writes to pipe_a, reads from pipe_b.
+  Pipe pipe_b;  // channel_b writes to pipe_b, reads from pipe_a.
+  TestEndpointChannel channel_a(&pipe_b.GetInputStream(),
+                                &pipe_a.GetOutputStream());
+  TestEndpointChannel channel_b(&pipe_a.GetInputStream(),
+                                &pipe_b.GetOutputStream());
+  auto [context_a, context_b] = DoDhKeyExchange(&channel_a, &channel_b);
+  ASSERT_NE(context_a, nullptr);
+  ASSERT_NE(context_b, nullptr);
+  channel_a.EnableEncryption(context_a);
+  channel_b.EnableEncryption(context_b);
+  ByteArray tx_message{"data message"};
+  channel_a.Write(tx_message);
+  EXPECT_EQ(channel_b.Read().result(), tx_message);
+
+  // Both sides derive matching stripe keys from their sessions.
+  ByteArray salt{std::string("salt")};
+  std::shared_ptr<EncryptionContext> stripe_a =
+      EndpointChannelManager::DeriveStripeContext(*context_a, salt,
+                                                  /*is_initiator=*/true);
+  std::shared_ptr<EncryptionContext> stripe_b =
+      EndpointChannelManager::DeriveStripeContext(*context_b, salt,
+                                                  /*is_initiator=*/false);
+  ASSERT_NE(stripe_a, nullptr);
+  ASSERT_NE(stripe_b, nullptr);
+  channel_a.EnableWriteEncryption(stripe_a);
+  channel_b.EnableReadEncryption(stripe_b);
+
+  ByteArray stripe_message{"stripe message"};
+  channel_a.Write(stripe_message);
+  EXPECT_EQ(channel_b.Read().result(), stripe_message);
+
+  // The other direction still uses the session keys.
+  ByteArray reply_message{"reply message"};
+  channel_b.Write(reply_message);
+  EXPECT_EQ(channel_a.Read().result(), reply_message);
+
+  // Until it moves over to the stripe keys too.
+  channel_b.EnableWriteEncryption(stripe_b);
+  channel_a.EnableReadEncryption(stripe_a);
+  ByteArray stripe_reply{"stripe reply"};
+  channel_b.Write(stripe_reply);
+  EXPECT_EQ(channel_a.Read().result(), stripe_reply);
+}
+
+TEST(BaseEndpointChannelTest, WriteLastSealsWritesUntilKeysChange) {
+  Pipe pipe_a;  // channel_a writes to pipe_a, reads from pipe_b.
+  Pipe pipe_b;  // channel_b writes to pipe_b, reads from pipe_a.
+  TestEndpointChannel channel_a(&pipe_b.GetInputStream(),
+                                &pipe_a.GetOutputStream());
+  TestEndpointChannel channel_b(&pipe_a.GetInputStream(),
+                                &pipe_b.GetOutputStream());
+  ByteArray last_message{"last message"};
+  EXPECT_TRUE(channel_a.WriteLast(last_message).Ok());
+  EXPECT_EQ(channel_b.Read().result(), last_message);
+  ByteArray late_message{"late message"};
+  EXPECT_TRUE(channel_a.Write(late_message).Raised(Exception::kIo));
+
+  // New write keys start over; here, no keys at all.
+  channel_a.EnableWriteEncryption(nullptr);
+  ByteArray next_message{"next message"};
+  EXPECT_TRUE(channel_a.Write(next_message).Ok());
+  EXPECT_EQ(channel_b.Read().result(), next_message);
+}
+
 TEST(BaseEndpointChannelTest, CanBesuspendedAndResumed) {
   // Setup test communication environment.
   Pipe pipe_a;  // channel_a writes to pipe_a, reads from pipe_b.
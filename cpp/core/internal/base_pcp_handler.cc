@@ -31,6 +31,7 @@
 #include "core/options.h"
 #include "platform/base/base64_utils.h"
 #include "platform/base/bluetooth_utils.h"
+#include "platform/base/feature_flags.h"
 #include "platform/public/logging.h"
 #include "platform/public/system_clock.h"
 #include "proto/connections_enums.pb.h"
@@ -42,6 +43,13 @@ namespace connections {
 using ::location::nearby::proto::connections::Medium;
 using ::securegcm::UKey2Handshake;
 
+namespace {
+// Whether to tell the remote device that we can resume a UKEY2 session.
+bool SupportsSessionResumption() {
+  return FeatureFlags::GetInstance().GetFlags().enable_ukey2_session_resumption;
+}
+}  // namespace
+
 constexpr absl::Duration BasePcpHandler::kConnectionRequestReadTimeout;
 constexpr absl::Duration BasePcpHandler::kRejectedConnectionCloseDelay;
 
@@ -303,7 +311,8 @@ EncryptionRunner::ResultListener BasePcpHandler::GetResultListener() {
                  raw_auth_token]() RUN_ON_PCP_HANDLER_THREAD() mutable {
                   OnEncryptionSuccessRunnable(
                       endpoint_id, std::unique_ptr<UKey2Handshake>(raw_ukey2),
-                      auth_token, raw_auth_token);
+                      /*resumed_context=*/nullptr, auth_token,
+                      raw_auth_token);
                 });
           },
       .on_failure_cb =
@@ -318,11 +327,29 @@ EncryptionRunner::ResultListener BasePcpHandler::GetResultListener() {
                   OnEncryptionFailureRunnable(endpoint_id, channel);
                 });
           },
+      .on_resumed_cb =
+          [this](const std::string& endpoint_id,
+                 std::unique_ptr<EndpointChannel::EncryptionContext> context,
+                 const std::string& auth_token,
+                 const ByteArray& raw_auth_token) {
+            RunOnPcpHandlerThread(
+                "encryption-resumed",
+                [this, endpoint_id, raw_context = context.release(),
+                 auth_token,
+                 raw_auth_token]() RUN_ON_PCP_HANDLER_THREAD() mutable {
+                  OnEncryptionSuccessRunnable(
+                      endpoint_id, /*ukey2=*/nullptr,
+                      std::unique_ptr<EndpointChannel::EncryptionContext>(
+                          raw_context),
+                      auth_token, raw_auth_token);
+                });
+          },
   };
 }
 
 void BasePcpHandler::OnEncryptionSuccessRunnable(
     const std::string& endpoint_id, std::unique_ptr<UKey2Handshake> ukey2,
+    std::unique_ptr<EndpointChannel::EncryptionContext> resumed_context,
     const std::string& auth_token, const ByteArray& raw_auth_token) {
   // Quick fail if we've been removed from pending connections while we were
   // busy running UKEY2.
@@ -337,7 +364,7 @@ void BasePcpHandler::OnEncryptionSuccessRunnable(
   BasePcpHandler::PendingConnectionInfo& connection_info = it->second;
   Medium medium = connection_info.channel->GetMedium();
 
-  if (!ukey2) {
+  if (!ukey2 && !resumed_context) {
     // Fail early, if there is no crypto context.
     ProcessPreConnectionInitiationFailure(
         connection_info.client, medium, endpoint_id,
@@ -348,6 +375,7 @@ void BasePcpHandler::OnEncryptionSuccessRunnable(
   }
 
   connection_info.SetCryptoContext(std::move(ukey2));
+  connection_info.resumed_context = std::move(resumed_context);
   connection_info.connection_token = GetHashedConnectionToken(raw_auth_token);
   NEARBY_LOGS(INFO)
       << "Register encrypted connection; wait for response; endpoint_id="
@@ -688,7 +716,7 @@ Exception BasePcpHandler::WriteConnectionRequestFrame(
   return endpoint_channel->Write(parser::ForConnectionRequest(
       local_endpoint_id, local_endpoint_info, nonce, /*supports_5_ghz =*/false,
       /*bssid=*/std::string{}, supported_mediums, keep_alive_interval_millis,
-      keep_alive_timeout_millis));
+      keep_alive_timeout_millis, SupportsSessionResumption()));
 }
 
 void BasePcpHandler::ProcessPreConnectionInitiationFailure(
@@ -774,7 +802,8 @@ Status BasePcpHandler::AcceptConnection(
         }
 
         Exception write_exception =
-            channel->Write(parser::ForConnectionResponse(Status::kSuccess));
+            channel->Write(parser::ForConnectionResponse(
+                Status::kSuccess, SupportsSessionResumption()));
         if (!write_exception.Ok()) {
           NEARBY_LOGS(INFO)
               << "AcceptConnection: failed to send response: endpoint_id="
@@ -830,8 +859,10 @@ Status BasePcpHandler::RejectConnection(ClientProxy* client,
           return;
         }
 
-        Exception write_exception = channel->Write(
-            parser::ForConnectionResponse(Status::kConnectionRejected));
+        Exception write_exception =
+            channel->Write(parser::ForConnectionResponse(
+                Status::kConnectionRejected,
+                /*supports_session_resumption=*/false));
         if (!write_exception.Ok()) {
           NEARBY_LOGS(INFO)
               << "RejectConnection: failed to send response: endpoint_id="
@@ -884,6 +915,11 @@ void BasePcpHandler::OnIncomingFrame(OfflineFrame& frame,
         } else {
           accepted = connection_response.status() == Status::kSuccess;
         }
+        auto item = pending_connections_.find(endpoint_id);
+        if (item != pending_connections_.end()) {
+          item->second.supports_session_resumption =
+              connection_response.supports_session_resumption();
+        }
         if (accepted) {
           NEARBY_LOGS(INFO)
               << "OnConnectionResponse: remote accepted; endpoint_id="
@@ -1154,8 +1190,16 @@ Exception BasePcpHandler::OnIncomingConnection(
   pendingConnectionInfo.options = options;
   pendingConnectionInfo.supported_mediums =
       parser::ConnectionRequestMediumsToMediums(connection_request);
+  pendingConnectionInfo.supports_session_resumption =
+      connection_request.supports_session_resumption();
   pendingConnectionInfo.channel = std::move(channel);
 
+  // A device that doesn't resume sessions (any more) can't present a ticket.
+  if (!connection_request.supports_session_resumption()) {
+    encryption_runner_.InvalidateResumptionTicket(
+        connection_request.endpoint_id());
+  }
+
   auto* owned_channel = pending_connections_
                             .emplace(connection_request.endpoint_id(),
                                      std::move(pendingConnectionInfo))
@@ -1354,12 +1398,23 @@ void BasePcpHandler::EvaluateConnectionResult(ClientProxy* client,
     // channels
     // Now, after both parties accepted connection (presumably after verifying &
     // matching security tokens), we are allowed to extract the shared key.
-    auto ukey2 = std::move(connection_info.ukey2);
-    bool succeeded = ukey2->VerifyHandshake();
-    CHECK(succeeded);  // If this fails, it's a UKEY2 protocol bug.
-    auto context = ukey2->ToConnectionContext();
-    CHECK(context);  // there is no way how this can fail, if Verify succeeded.
-    // If it did, it's a UKEY2 protocol bug.
+    // A resumed session has its keys already.
+    std::unique_ptr<EndpointChannel::EncryptionContext> context =
+        std::move(connection_info.resumed_context);
+    if (!context) {
+      auto ukey2 = std::move(connection_info.ukey2);
+      bool succeeded = ukey2->VerifyHandshake();
+      CHECK(succeeded);  // If this fails, it's a UKEY2 protocol bug.
+      context = ukey2->ToConnectionContext();
+      CHECK(context);  // there is no way how this can fail, if Verify
+                       // succeeded. If it did, it's a UKEY2 protocol bug.
+    }
+    // Only keep a ticket if both sides can resume the session with it.
+    if (connection_info.supports_session_resumption) {
+      encryption_runner_.IssueResumptionTicket(endpoint_id, context.get());
+    } else {
+      encryption_runner_.InvalidateResumptionTicket(endpoint_id);
+    }
 
     channel_manager_->EncryptChannelForEndpoint(endpoint_id,
                                                 std::move(context));
@@ -1372,6 +1427,8 @@ void BasePcpHandler::EvaluateConnectionResult(ClientProxy* client,
     NEARBY_LOGS(INFO) << "Pending connection rejected; endpoint_id="
                       << endpoint_id;
     response_code = {Status::kConnectionRejected};
+    // Don't let a rejected endpoint skip UKEY2 next time.
+    encryption_runner_.InvalidateResumptionTicket(endpoint_id);
   }
 
   // Invoke the client callback to let it know of the connection result.
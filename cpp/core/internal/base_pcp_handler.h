@@ -130,7 +130,7 @@ class BasePcpHandler : public PcpHandler,
   Status RejectConnection(ClientProxy* client,
                           const std::string& endpoint_id) override;
 
-  // @EndpointManagerReaderThread
+  // @EndpointManagerDispatchThread
   void OnIncomingFrame(OfflineFrame& frame, const std::string& endpoint_id,
                        ClientProxy* client,
                        proto::connections::Medium medium) override;
@@ -342,6 +342,10 @@ class BasePcpHandler : public PcpHandler,
     // Only (possibly) vector for incoming connections.
     std::vector<proto::connections::Medium> supported_mediums;
 
+    // Whether the remote device can resume a UKEY2 session, as told by its
+    // ConnectionRequestFrame or ConnectionResponseFrame.
+    bool supports_session_resumption = false;
+
     // Keep track of a channel before we pass it to EndpointChannelManager.
     std::unique_ptr<EndpointChannel> channel;
 
@@ -352,6 +356,8 @@ class BasePcpHandler : public PcpHandler,
     // accepted. Crypto context is passed over to channel_manager_ before
     // switching to connected state, where Payload may be exchanged.
     std::unique_ptr<securegcm::UKey2Handshake> ukey2;
+    // Set instead of ukey2 if a previous session was resumed.
+    std::unique_ptr<EndpointChannel::EncryptionContext> resumed_context;
 
     // Used in AnalyticsRecorder for devices connection tracking.
     std::string connection_token;
@@ -374,6 +380,7 @@ class BasePcpHandler : public PcpHandler,
   void OnEncryptionSuccessRunnable(
       const std::string& endpoint_id,
       std::unique_ptr<securegcm::UKey2Handshake> ukey2,
+      std::unique_ptr<EndpointChannel::EncryptionContext> resumed_context,
       const std::string& auth_token, const ByteArray& raw_auth_token);
   void OnEncryptionFailureRunnable(const std::string& endpoint_id,
                                    EndpointChannel* endpoint_channel);
@@ -495,8 +502,8 @@ class BasePcpHandler : public PcpHandler,
   BooleanMediumSelector ComputeIntersectionOfSupportedMediums(
       const PendingConnectionInfo& connection_info);
 
-  ScheduledExecutor alarm_executor_;
-  SingleThreadExecutor serial_executor_;
+  ScheduledExecutor alarm_executor_{"pcp-alarms"};
+  SingleThreadExecutor serial_executor_{"pcp"};
 
   // A map of endpoint id -> PendingConnectionInfo. Entries in this map imply
   // that there is an active connection to the endpoint and we're waiting for
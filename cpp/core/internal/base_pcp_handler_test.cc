@@ -623,8 +623,8 @@ TEST_P(BasePcpHandlerTest, OnIncomingFrameChangesState) {
   EXPECT_EQ(pcp_handler.AcceptConnection(&client, endpoint_id, {}),
             Status{Status::kSuccess});
   NEARBY_LOG(INFO, "Simulating remote accept: id=%s", endpoint_id.c_str());
-  auto frame =
-      parser::FromBytes(parser::ForConnectionResponse(Status::kSuccess));
+  auto frame = parser::FromBytes(parser::ForConnectionResponse(
+      Status::kSuccess, /*supports_session_resumption=*/false));
   pcp_handler.OnIncomingFrame(frame.result(), endpoint_id, &client,
                               connect_medium);
   NEARBY_LOGS(INFO) << "Closing connection: id=" << endpoint_id;
@@ -21,12 +21,14 @@
 #include "absl/time/time.h"
 #include "core/internal/bluetooth_bwu_handler.h"
 #include "core/internal/bwu_handler.h"
+#include "core/internal/mediums/utils.h"
 #include "core/internal/offline_frames.h"
 #include "core/internal/webrtc_bwu_handler.h"
 #include "core/internal/wifi_lan_bwu_handler.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/feature_flags.h"
 #include "platform/public/count_down_latch.h"
+#include "platform/public/metrics.h"
 #include "proto/connections_enums.pb.h"
 
 namespace location {
@@ -35,6 +37,20 @@ namespace connections {
 
 using ::location::nearby::proto::connections::DisconnectionReason;
 
+namespace {
+// Length of the salt the keys of a stripe are derived with.
+constexpr int kStripeSaltLength = 16;
+
+void CountUpgradeResult(Medium medium, bool success) {
+  MetricsRegistry::GetInstance()
+      .GetCounter("nearby_bwu_upgrades_total",
+                  "Bandwidth upgrades that finished, by medium and result.",
+                  {{"medium", proto::connections::Medium_Name(medium)},
+                   {"result", success ? "success" : "failure"}})
+      ->Increment();
+}
+}  // namespace
+
 // Required for C++ 14 support in Chrome
 constexpr absl::Duration BwuManager::kReadClientIntroductionFrameTimeout;
 
@@ -127,9 +143,14 @@ void BwuManager::Shutdown() {
     if (!channel) continue;
     channel->Close(DisconnectionReason::SHUTDOWN);
   }
+  stripe_salts_.clear();
+  striping_endpoints_.clear();
+  make_before_break_endpoints_.clear();
+  write_stall_start_times_.clear();
+  write_stalls_.clear();
 
   CancelAllRetryUpgradeAlarms();
-  medium_ = Medium::UNKNOWN_MEDIUM;
+  upgrade_mediums_.clear();
   for (auto& item : handlers_) {
     BwuHandler& handler = *item.second;
     handler.Revert();
@@ -139,8 +160,8 @@ void BwuManager::Shutdown() {
   NEARBY_LOGS(INFO) << "BwuHandler has shut down.";
 }
 
-// This is the point on the Initiator side where the
-// medium_ is set.
+// This is the point on the Initiator side where the upgrade medium of the
+// endpoint is set.
 void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
                                         const std::string& endpoint_id,
                                         Medium new_medium) {
@@ -148,19 +169,10 @@ void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
                     << " with medium " << new_medium;
   RunOnBwuManagerThread("bwu-init", [this, client, endpoint_id, new_medium]() {
     Medium proposed_medium = ChooseBestUpgradeMedium(
-        client->GetUpgradeMediums(endpoint_id).GetMediums(true));
+        endpoint_id, client->GetUpgradeMediums(endpoint_id).GetMediums(true));
     if (new_medium != Medium::UNKNOWN_MEDIUM) {
       proposed_medium = new_medium;
     }
-    auto* handler = SetCurrentBwuHandler(proposed_medium);
-    if (!handler) {
-      NEARBY_LOGS(ERROR)
-          << "BwuManager cannot initiate bandwidth upgrade for endpoint "
-          << endpoint_id
-          << " because the current BandwidthUpgradeMedium cannot be deduced.";
-      return;
-    }
-
     if (in_progress_upgrades_.contains(endpoint_id)) {
       NEARBY_LOGS(INFO)
           << "BwuManager is ignoring bandwidth upgrade for endpoint "
@@ -169,13 +181,23 @@ void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
 
       return;
     }
+
+    auto* handler = SetBwuHandlerForEndpoint(endpoint_id, proposed_medium);
+    if (!handler) {
+      NEARBY_LOGS(ERROR)
+          << "BwuManager cannot initiate bandwidth upgrade for endpoint "
+          << endpoint_id
+          << " because the BandwidthUpgradeMedium cannot be deduced.";
+      return;
+    }
     CancelRetryUpgradeAlarm(endpoint_id);
 
     auto channel = channel_manager_->GetChannelForEndpoint(endpoint_id);
     Medium channel_medium =
         channel ? channel->GetMedium() : Medium::UNKNOWN_MEDIUM;
     client->GetAnalyticsRecorder().OnBandwidthUpgradeStarted(
-        endpoint_id, channel_medium, medium_, proto::connections::INCOMING,
+        endpoint_id, channel_medium, proposed_medium,
+        proto::connections::INCOMING,
         client->GetConnectionToken(endpoint_id));
     if (channel == nullptr) {
       NEARBY_LOGS(INFO)
@@ -195,12 +217,11 @@ void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
     // LAN). Very specifically, this happens now when a device uses P2P_CLUSTER,
     // connects over Bluetooth, and is not connected to LAN. Bluetooth is the
     // best medium, and we attempt to upgrade from Bluetooth to Bluetooth.
-    // if (medium_ == channel->GetMedium()) {
-    NEARBY_LOGS(INFO) << "BwuManager ignoring the upgrade for endpoint "
-                      << endpoint_id
-                      << " because it is already connected over medium "
-                      << proto::connections::Medium_Name(medium_);
-    if (medium_ == channel->GetMedium()) {
+    if (proposed_medium == channel->GetMedium()) {
+      NEARBY_LOGS(INFO) << "BwuManager ignoring the upgrade for endpoint "
+                        << endpoint_id
+                        << " because it is already connected over medium "
+                        << proto::connections::Medium_Name(proposed_medium);
       return;
     }
 
@@ -214,11 +235,11 @@ void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
       NEARBY_LOGS(ERROR)
           << "BwuManager couldn't complete the upgrade for endpoint "
           << endpoint_id << " to medium "
-          << proto::connections::Medium_Name(medium_)
+          << proto::connections::Medium_Name(proposed_medium)
           << " because it failed to initialize the "
              "BWU_NEGOTIATION.UPGRADE_PATH_AVAILABLE OfflineFrame.";
       UpgradePathInfo info;
-      info.set_medium(parser::MediumToUpgradePathInfoMedium(medium_));
+      info.set_medium(parser::MediumToUpgradePathInfoMedium(proposed_medium));
 
       ProcessUpgradeFailureEvent(client, endpoint_id, info);
       client->GetAnalyticsRecorder().OnBandwidthUpgradeError(
@@ -230,7 +251,7 @@ void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
       NEARBY_LOGS(ERROR)
           << "BwuManager couldn't complete the upgrade for endpoint "
           << endpoint_id << " to medium "
-          << proto::connections::Medium_Name(medium_)
+          << proto::connections::Medium_Name(proposed_medium)
           << " because it failed to write the "
              "BWU_NEGOTIATION.UPGRADE_PATH_AVAILABLE OfflineFrame.";
       return;
@@ -241,7 +262,7 @@ void BwuManager::InitiateBwuForEndpoint(ClientProxy* client,
            "BWU_NEGOTIATION.UPGRADE_PATH_AVAILABLE OfflineFrame while "
            "upgrading endpoint "
         << endpoint_id << " to medium"
-        << proto::connections::Medium_Name(medium_);
+        << proto::connections::Medium_Name(proposed_medium);
     in_progress_upgrades_.emplace(endpoint_id, client);
   });
 }
@@ -280,18 +301,17 @@ void BwuManager::OnEndpointDisconnect(ClientProxy* client,
   RunOnBwuManagerThread(
       "bwu-on-endpoint-disconnect",
       [this, client, endpoint_id, barrier]() mutable {
-        if (medium_ == Medium::UNKNOWN_MEDIUM) {
+        BwuHandler* handler = GetBwuHandlerForEndpoint(endpoint_id);
+        if (handler == nullptr) {
           NEARBY_LOGS(INFO)
               << "BwuManager has processed endpoint disconnection for endpoint "
               << endpoint_id
-              << " because there is no current BandwidthUpgradeMedium.";
+              << " because there is no BandwidthUpgradeMedium for it.";
           barrier.CountDown();
           return;
         }
 
-        if (handler_) {
-          handler_->OnEndpointDisconnect(client, endpoint_id);
-        }
+        handler->OnEndpointDisconnect(client, endpoint_id);
 
         auto item = previous_endpoint_channels_.extract(endpoint_id);
 
@@ -303,43 +323,67 @@ void BwuManager::OnEndpointDisconnect(ClientProxy* client,
         }
         in_progress_upgrades_.erase(endpoint_id);
         retry_delays_.erase(endpoint_id);
+        stripe_salts_.erase(endpoint_id);
+        striping_endpoints_.erase(endpoint_id);
+        make_before_break_endpoints_.erase(endpoint_id);
+        TakeWriteStall(endpoint_id);
         CancelRetryUpgradeAlarm(endpoint_id);
 
         successfully_upgraded_endpoints_.erase(endpoint_id);
 
-        // If this was our very last endpoint:
-        //
-        // a) revert all the changes for currentBwuMedium.
-        // b) reset currentBwuMedium.
-        if (channel_manager_->GetConnectedEndpointsCount() <= 1) {
-          Revert();
-        }
+        // If this was the last endpoint upgraded to its medium, revert all
+        // the changes for that medium.
+        RevertBwuHandlerForEndpoint(endpoint_id);
         barrier.CountDown();
       });
 }
 
-BwuHandler* BwuManager::SetCurrentBwuHandler(Medium medium) {
-  NEARBY_LOGS(INFO) << "SetCurrentBwuHandler to medium "
-                    << proto::connections::Medium_Name(medium);
-  handler_ = nullptr;
-  medium_ = medium;
-  if (medium != Medium::UNKNOWN_MEDIUM) {
-    auto item = handlers_.find(medium);
-    if (item != handlers_.end()) {
-      handler_ = item->second.get();
-    }
-  }
-  return handler_;
+BwuHandler* BwuManager::GetBwuHandler(Medium medium) {
+  auto item = handlers_.find(medium);
+  return item == handlers_.end() ? nullptr : item->second.get();
+}
+
+BwuHandler* BwuManager::SetBwuHandlerForEndpoint(const std::string& endpoint_id,
+                                                 Medium medium) {
+  NEARBY_LOGS(INFO) << "SetBwuHandlerForEndpoint for endpoint " << endpoint_id
+                    << " to medium " << proto::connections::Medium_Name(medium);
+  BwuHandler* handler = GetBwuHandler(medium);
+  if (handler == nullptr) return nullptr;
+  upgrade_mediums_[endpoint_id] = medium;
+  return handler;
+}
+
+BwuHandler* BwuManager::GetBwuHandlerForEndpoint(
+    const std::string& endpoint_id) {
+  Medium medium = GetUpgradeMediumForEndpoint(endpoint_id);
+  return medium == Medium::UNKNOWN_MEDIUM ? nullptr : GetBwuHandler(medium);
+}
+
+Medium BwuManager::GetUpgradeMediumForEndpoint(
+    const std::string& endpoint_id) const {
+  auto item = upgrade_mediums_.find(endpoint_id);
+  return item == upgrade_mediums_.end() ? Medium::UNKNOWN_MEDIUM
+                                        : item->second;
 }
 
-void BwuManager::Revert() {
+void BwuManager::RevertBwuHandlerForEndpoint(const std::string& endpoint_id) {
+  auto item = upgrade_mediums_.extract(endpoint_id);
+  if (item.empty()) return;
+  Medium medium = item.mapped();
+  for (const auto& other : upgrade_mediums_) {
+    if (other.second == medium) {
+      NEARBY_LOGS(INFO) << "Revert keeping medium "
+                        << proto::connections::Medium_Name(medium)
+                        << ", still used by endpoint " << other.first;
+      return;
+    }
+  }
   NEARBY_LOGS(INFO) << "Revert reseting medium "
-                    << proto::connections::Medium_Name(medium_);
-  if (handler_) {
-    handler_->Revert();
-    handler_ = nullptr;
+                    << proto::connections::Medium_Name(medium);
+  BwuHandler* handler = GetBwuHandler(medium);
+  if (handler) {
+    handler->Revert();
   }
-  medium_ = Medium::UNKNOWN_MEDIUM;
 }
 
 void BwuManager::OnBwuNegotiationFrame(ClientProxy* client,
@@ -411,7 +455,20 @@ void BwuManager::OnIncomingConnection(
           return;
         }
 
-        if (!WriteClientIntroductionAckFrame(channel)) {
+        // Agree to keep the prior EndpointChannel as a stripe, if the remote
+        // device offered to.
+        ByteArray stripe_salt;
+        if (FeatureFlags::GetInstance().GetFlags().enable_multipath_striping &&
+            introduction.supports_striping() &&
+            !channel_manager_->HasStripeForEndpoint(
+                introduction.endpoint_id())) {
+          stripe_salt = Utils::GenerateRandomBytes(kStripeSaltLength);
+        }
+        bool make_before_break =
+            introduction.supports_make_before_break() &&
+            FeatureFlags::GetInstance().GetFlags().enable_make_before_break_bwu;
+        if (!WriteClientIntroductionAckFrame(channel, stripe_salt,
+                                             make_before_break)) {
           // This was never a fully EstablishedConnection, no need to provide a
           // closure reason.
           channel->Close();
@@ -437,6 +494,12 @@ void BwuManager::OnIncomingConnection(
         }
 
         CHECK(client == mapped_client);
+        if (!stripe_salt.Empty()) {
+          stripe_salts_[endpoint_id] = {stripe_salt, /*is_initiator=*/true};
+        }
+        if (make_before_break) {
+          make_before_break_endpoints_.emplace(endpoint_id);
+        }
 
         // The ConnectionAttempt has now succeeded, so record it as such.
         std::unique_ptr<ConnectionAttemptMetadataParams>
@@ -481,7 +544,12 @@ void BwuManager::RunUpgradeProtocol(
   // sequence numbers for writes and reads, and simultaneously sending Payloads
   // on the new channel and control messages on the old channel cause the other
   // side to read messages out of sequence
+  //
+  // With make-before-break, the pause only lasts until LAST_WRITE has been
+  // written to the old EndpointChannel. Everything we write after it goes over
+  // the new one, and the other side only reads the new one after LAST_WRITE.
   new_channel->Pause();
+  write_stall_start_times_[endpoint_id] = SystemClock::ElapsedRealtime();
   auto old_channel = channel_manager_->GetChannelForEndpoint(endpoint_id);
   if (!old_channel) {
     NEARBY_LOGS(INFO)
@@ -494,13 +562,32 @@ void BwuManager::RunUpgradeProtocol(
         proto::connections::PRIOR_ENDPOINT_CHANNEL);
     return;
   }
+  // If both sides agreed to it, keep the previous EndpointChannel around as a
+  // stripe once it is replaced.
+  auto stripe_key_params = stripe_salts_.extract(endpoint_id);
+  if (!stripe_key_params.empty() &&
+      channel_manager_->RetainChannelAsStripe(
+          endpoint_id, stripe_key_params.mapped().salt,
+          stripe_key_params.mapped().is_initiator)) {
+    striping_endpoints_.emplace(endpoint_id);
+  }
+  bool make_before_break = make_before_break_endpoints_.contains(endpoint_id);
+  EndpointChannel* paused_channel = new_channel.get();
   channel_manager_->ReplaceChannelForEndpoint(client, endpoint_id,
                                               std::move(new_channel));
 
   // Next, initiate a clean shutdown for the previous EndpointChannel used for
   // this endpoint by telling the remote device that it will not receive any
-  // more writes over that EndpointChannel.
-  if (!old_channel->Write(parser::ForBwuLastWrite()).Ok()) {
+  // more writes over that EndpointChannel. With make-before-break, any write
+  // that still races for the old EndpointChannel fails after LAST_WRITE, and
+  // EndpointManager retries it over the new one.
+  Exception last_write_exception =
+      make_before_break
+          ? old_channel->WriteLast(
+                parser::ForBwuLastWrite(/*make_before_break=*/true))
+          : old_channel->Write(
+                parser::ForBwuLastWrite(/*make_before_break=*/false));
+  if (!last_write_exception.Ok()) {
     NEARBY_LOGS(ERROR)
         << "BwuManager failed to write "
            "BWU_NEGOTIATION.LAST_WRITE_TO_PRIOR_CHANNEL OfflineFrame to "
@@ -516,6 +603,17 @@ void BwuManager::RunUpgradeProtocol(
                           "OfflineFrame while upgrading endpoint "
                        << endpoint_id;
 
+  if (make_before_break) {
+    // |paused_channel| is owned by the EndpointChannelManager, and only gets
+    // replaced on this thread.
+    paused_channel->Resume();
+    auto item = write_stall_start_times_.extract(endpoint_id);
+    if (!item.empty()) {
+      write_stalls_[endpoint_id] =
+          SystemClock::ElapsedRealtime() - item.mapped();
+    }
+  }
+
   // The remainder of this clean shutdown for the previous EndpointChannel will
   // continue when we receive a corresponding
   // BANDWIDTH_UPGRADE_NEGOTIATION.LAST_WRITE_TO_PRIOR_CHANNEL OfflineFrame from
@@ -553,6 +651,10 @@ void BwuManager::ProcessBwuPathAvailableEvent(
         previous_endpoint_channel->Close(DisconnectionReason::UNFINISHED);
       }
     }
+    stripe_salts_.erase(endpoint_id);
+    striping_endpoints_.erase(endpoint_id);
+    make_before_break_endpoints_.erase(endpoint_id);
+    TakeWriteStall(endpoint_id);
     std::shared_ptr<EndpointChannel> new_channel =
         channel_manager_->GetChannelForEndpoint(endpoint_id);
     if (new_channel) {
@@ -566,19 +668,18 @@ void BwuManager::ProcessBwuPathAvailableEvent(
   }
   Medium medium =
       parser::UpgradePathInfoMediumToMedium(upgrade_path_info.medium());
-  if (medium_ == Medium::UNKNOWN_MEDIUM) {
-    SetCurrentBwuHandler(medium);
-  }
-  // Check for the correct medium so we don't process an incorrect OfflineFrame.
-  if (medium != medium_) {
-    NEARBY_LOGS(INFO) << "Medium not matching";
+  // Check for a medium we can upgrade to, so we don't process an incorrect
+  // OfflineFrame.
+  if (!SetBwuHandlerForEndpoint(endpoint_id, medium)) {
+    NEARBY_LOGS(INFO) << "No BwuHandler for medium "
+                      << proto::connections::Medium_Name(medium);
     RunUpgradeFailedProtocol(client, endpoint_id, upgrade_path_info);
     return;
   }
 
   client->GetAnalyticsRecorder().OnBandwidthUpgradeStarted(
-      endpoint_id, medium, medium_, proto::connections::OUTGOING,
-      client->GetConnectionToken(endpoint_id));
+      endpoint_id, GetEndpointMedium(endpoint_id), medium,
+      proto::connections::OUTGOING, client->GetConnectionToken(endpoint_id));
 
   absl::Time connection_attempt_start_time = SystemClock::ElapsedRealtime();
   auto channel = ProcessBwuPathAvailableEventInternal(client, endpoint_id,
@@ -604,7 +705,7 @@ void BwuManager::ProcessBwuPathAvailableEvent(
             channel->GetFrequency(), channel->GetTryCount());
   }
   client->GetAnalyticsRecorder().OnOutgoingConnectionAttempt(
-      endpoint_id, proto::connections::UPGRADE, medium_,
+      endpoint_id, proto::connections::UPGRADE, medium,
       connection_attempt_result,
       SystemClock::ElapsedRealtime() - connection_attempt_start_time,
       client->GetConnectionToken(endpoint_id),
@@ -628,9 +729,12 @@ BwuManager::ProcessBwuPathAvailableEventInternal(
                     << endpoint_id << " medium "
                     << parser::UpgradePathInfoMediumToMedium(
                            upgrade_path_info.medium());
+  BwuHandler* handler = GetBwuHandlerForEndpoint(endpoint_id);
   std::unique_ptr<EndpointChannel> channel =
-      handler_->CreateUpgradedEndpointChannel(client, client->GetServiceId(),
-                                              endpoint_id, upgrade_path_info);
+      handler ? handler->CreateUpgradedEndpointChannel(
+                    client, client->GetServiceId(), endpoint_id,
+                    upgrade_path_info)
+              : nullptr;
   if (!channel) {
     NEARBY_LOGS(ERROR)
         << "BwuManager failed to create an endpoint channel to endpoint"
@@ -641,9 +745,23 @@ BwuManager::ProcessBwuPathAvailableEventInternal(
     return nullptr;
   }
 
+  // Offer to keep the prior EndpointChannel as a stripe. The answer comes in
+  // the CLIENT_INTRODUCTION_ACK, so only offer it if we're going to read one.
+  bool supports_striping =
+      FeatureFlags::GetInstance().GetFlags().enable_multipath_striping &&
+      upgrade_path_info.supports_client_introduction_ack() &&
+      !channel_manager_->HasStripeForEndpoint(endpoint_id);
+  // Likewise, offer to switch over make-before-break.
+  bool supports_make_before_break =
+      FeatureFlags::GetInstance().GetFlags().enable_make_before_break_bwu &&
+      upgrade_path_info.supports_client_introduction_ack();
+
   // Write the requisite BANDWIDTH_UPGRADE_NEGOTIATION.CLIENT_INTRODUCTION as
   // the first OfflineFrame on this new EndpointChannel.
-  if (!channel->Write(parser::ForBwuIntroduction(client->GetLocalEndpointId()))
+  if (!channel
+           ->Write(parser::ForBwuIntroduction(client->GetLocalEndpointId(),
+                                              supports_striping,
+                                              supports_make_before_break))
            .Ok()) {
     // This was never a fully EstablishedConnection, no need to provide a
     // closure reason.
@@ -660,7 +778,8 @@ BwuManager::ProcessBwuPathAvailableEventInternal(
   }
 
   if (upgrade_path_info.supports_client_introduction_ack()) {
-    if (!ReadClientIntroductionAckFrame(channel.get())) {
+    ClientIntroductionAck introduction_ack;
+    if (!ReadClientIntroductionAckFrame(channel.get(), introduction_ack)) {
       // This was never a fully EstablishedConnection, no need to provide a
       // closure reason.
       channel->Close();
@@ -672,6 +791,13 @@ BwuManager::ProcessBwuPathAvailableEventInternal(
 
       return {};
     }
+    if (supports_striping && !introduction_ack.stripe_salt().empty()) {
+      stripe_salts_[endpoint_id] = {ByteArray(introduction_ack.stripe_salt()),
+                                    /*is_initiator=*/false};
+    }
+    if (supports_make_before_break && introduction_ack.make_before_break()) {
+      make_before_break_endpoints_.emplace(endpoint_id);
+    }
   }
 
   NEARBY_LOGS(INFO) << "BwuManager successfully wrote "
@@ -692,6 +818,12 @@ void BwuManager::RunUpgradeFailedProtocol(
                     << " medium "
                     << parser::UpgradePathInfoMediumToMedium(
                            upgrade_path_info.medium());
+  channel_manager_->GetMediumQualityTracker().RecordUpgradeResult(
+      parser::UpgradePathInfoMediumToMedium(upgrade_path_info.medium()),
+      /*success=*/false);
+  CountUpgradeResult(
+      parser::UpgradePathInfoMediumToMedium(upgrade_path_info.medium()),
+      /*success=*/false);
   // We attempted to connect to the new medium that the remote device has set up
   // for us but we failed. We need to let the remote device know so that they
   // can pick another medium for us to try.
@@ -723,12 +855,12 @@ void BwuManager::RunUpgradeFailedProtocol(
     return;
   }
 
-  // And lastly, clean up our currentBwuMedium since we failed to
+  // And lastly, clean up the upgrade medium of the endpoint since we failed to
   // utilize it anyways.
-  if (medium_ != Medium::UNKNOWN_MEDIUM) {
-    Revert();
-  }
+  RevertBwuHandlerForEndpoint(endpoint_id);
   in_progress_upgrades_.erase(endpoint_id);
+  stripe_salts_.erase(endpoint_id);
+  make_before_break_endpoints_.erase(endpoint_id);
   NEARBY_LOGS(INFO) << "BwuManager has informed endpoint " << endpoint_id
                     << " that the bandwidth upgrade failed.";
 }
@@ -785,7 +917,8 @@ bool BwuManager::ReadClientIntroductionFrame(EndpointChannel* channel,
   return true;
 }
 
-bool BwuManager::ReadClientIntroductionAckFrame(EndpointChannel* channel) {
+bool BwuManager::ReadClientIntroductionAckFrame(
+    EndpointChannel* channel, ClientIntroductionAck& introduction_ack) {
   NEARBY_LOGS(INFO) << "ReadClientIntroductionAckFrame with channel name: "
                     << channel->GetName() << ", medium: "
                     << proto::connections::Medium_Name(channel->GetMedium());
@@ -812,14 +945,20 @@ bool BwuManager::ReadClientIntroductionAckFrame(EndpointChannel* channel) {
   if (frame.v1().bandwidth_upgrade_negotiation().event_type() !=
       BandwidthUpgradeNegotiationFrame::CLIENT_INTRODUCTION_ACK)
     return false;
+  introduction_ack =
+      frame.v1().bandwidth_upgrade_negotiation().client_introduction_ack();
   return true;
 }
 
-bool BwuManager::WriteClientIntroductionAckFrame(EndpointChannel* channel) {
+bool BwuManager::WriteClientIntroductionAckFrame(EndpointChannel* channel,
+                                                 const ByteArray& stripe_salt,
+                                                 bool make_before_break) {
   NEARBY_LOGS(INFO) << "WriteClientIntroductionAckFrame channel name: "
                     << channel->GetName()
                     << ", medium: " << channel->GetMedium();
-  return channel->Write(parser::ForBwuIntroductionAck()).Ok();
+  return channel
+      ->Write(parser::ForBwuIntroductionAck(stripe_salt, make_before_break))
+      .Ok();
 }
 
 void BwuManager::ProcessLastWriteToPriorChannelEvent(
@@ -846,11 +985,23 @@ void BwuManager::ProcessLastWriteToPriorChannelEvent(
     return;
   }
 
-  if (!previous_endpoint_channel->Write(parser::ForBwuSafeToClose()).Ok()) {
+  // With make-before-break, our LAST_WRITE sealed the prior EndpointChannel;
+  // like anything else we write from here on, SAFE_TO_CLOSE goes over the new
+  // one.
+  bool make_before_break = make_before_break_endpoints_.contains(endpoint_id);
+  std::shared_ptr<EndpointChannel> safe_to_close_channel =
+      make_before_break ? channel_manager_->GetChannelForEndpoint(endpoint_id)
+                        : previous_endpoint_channels_[endpoint_id];
+  if (safe_to_close_channel == nullptr ||
+      !safe_to_close_channel->Write(parser::ForBwuSafeToClose()).Ok()) {
     previous_endpoint_channel->Close(DisconnectionReason::IO_ERROR);
     // Remove this prior EndpointChannel from previous_endpoint_channels to
     // avoid leaks.
     previous_endpoint_channels_.erase(endpoint_id);
+    if (striping_endpoints_.erase(endpoint_id)) {
+      channel_manager_->RemoveStripeForEndpoint(endpoint_id,
+                                                previous_endpoint_channel);
+    }
 
     NEARBY_LOGS(ERROR) << "BwuManager failed to write "
                           "BWU_NEGOTIATION.SAFE_TO_CLOSE_PRIOR_CHANNEL "
@@ -867,6 +1018,13 @@ void BwuManager::ProcessLastWriteToPriorChannelEvent(
                           "OfflineFrame while trying to upgrade endpoint "
                        << endpoint_id;
 
+  // That was the last frame we write with the keys shared with the new
+  // EndpointChannel; if this EndpointChannel stays on as a stripe, any further
+  // writes use its own keys. (With make-before-break, that was LAST_WRITE.)
+  if (!make_before_break && striping_endpoints_.contains(endpoint_id)) {
+    channel_manager_->StartStripeWrites(endpoint_id);
+  }
+
   // The upgrade protocol's clean shutdown of the prior EndpointChannel will
   // conclude when we receive a corresponding
   // BANDWIDTH_UPGRADE_NEGOTIATION.SAFE_TO_CLOSE_PRIOR_CHANNEL OfflineFrame
@@ -890,6 +1048,7 @@ void BwuManager::ProcessSafeToClosePriorChannelEvent(
   // closed from the other end (as is the case with conventional TCP sockets)
   // or not (as is the case with Android's Bluetooth sockets, where closing
   // instantly throws an IOException on the remote device).
+  bool make_before_break = make_before_break_endpoints_.erase(endpoint_id) > 0;
   auto item = previous_endpoint_channels_.extract(endpoint_id);
   auto& previous_endpoint_channel = item.mapped();
   if (previous_endpoint_channel == nullptr) {
@@ -904,33 +1063,85 @@ void BwuManager::ProcessSafeToClosePriorChannelEvent(
       << "BWU_NEGOTIATION.SAFE_TO_CLOSE_PRIOR_CHANNEL OfflineFrame while "
       << "trying to upgrade endpoint " << endpoint_id;
 
-  // Each encrypted message includes the key to decrypt the next message. The
-  // disconnect message is optional and may not be received under normal
-  // circumstances so it is necessary to send it unencrypted. This way the
-  // serial crypto context does not increment here.
-  previous_endpoint_channel->DisableEncryption();
-  previous_endpoint_channel->Write(parser::ForDisconnection());
-
-  // Attempt to read the disconnect message from the previous channel. We don't
-  // care whether we successfully read it or whether we get an exception here.
-  // The idea is just to make sure the other side has had a chance to receive
-  // the full SAFE_TO_CLOSE_PRIOR_CHANNEL message before we actually close the
-  // channel. See b/172380349 for more context.
-  previous_endpoint_channel->Read();
-  previous_endpoint_channel->Close(DisconnectionReason::UPGRADED);
-
-  NEARBY_LOGS(VERBOSE)
-      << "BwuManager cleanly shut down prior "
-      << previous_endpoint_channel->GetType()
-      << " EndpointChannel to conclude upgrade protocol for endpoint "
-      << endpoint_id;
+  bool striping = striping_endpoints_.erase(endpoint_id) > 0;
+  if (striping && make_before_break) {
+    // The remote device has read our LAST_WRITE, the last frame we wrote with
+    // the keys shared with the new EndpointChannel.
+    channel_manager_->StartStripeWrites(endpoint_id);
+  }
+  if (striping && !channel_manager_->ActivateStripe(endpoint_id)) {
+    NEARBY_LOGS(ERROR) << "BwuManager failed to keep the prior "
+                       << previous_endpoint_channel->GetType()
+                       << " EndpointChannel as a stripe for endpoint "
+                       << endpoint_id << ", closing it instead.";
+    channel_manager_->RemoveStripeForEndpoint(endpoint_id,
+                                              previous_endpoint_channel.get());
+    striping = false;
+  }
+
+  if (striping) {
+    // The prior EndpointChannel stays open, and its reads already moved over
+    // to a reader of its own (see EndpointManager::HandleData()).
+    NEARBY_LOGS(VERBOSE)
+        << "BwuManager kept prior " << previous_endpoint_channel->GetType()
+        << " EndpointChannel as a stripe to conclude upgrade protocol for "
+           "endpoint "
+        << endpoint_id;
+  } else if (make_before_break) {
+    // Neither side writes to the prior EndpointChannel after LAST_WRITE, and
+    // both have read the other's by now, so there's nothing left to drain.
+    previous_endpoint_channel->Close(DisconnectionReason::UPGRADED);
+
+    NEARBY_LOGS(VERBOSE)
+        << "BwuManager shut down prior " << previous_endpoint_channel->GetType()
+        << " EndpointChannel to conclude make-before-break upgrade protocol "
+           "for endpoint "
+        << endpoint_id;
+  } else {
+    // Each encrypted message includes the key to decrypt the next message. The
+    // disconnect message is optional and may not be received under normal
+    // circumstances so it is necessary to send it unencrypted. This way the
+    // serial crypto context does not increment here.
+    previous_endpoint_channel->DisableEncryption();
+    previous_endpoint_channel->Write(parser::ForDisconnection());
+
+    // Attempt to read the disconnect message from the previous channel. We
+    // don't care whether we successfully read it or whether we get an
+    // exception here. The idea is just to make sure the other side has had a
+    // chance to receive the full SAFE_TO_CLOSE_PRIOR_CHANNEL message before we
+    // actually close the channel. See b/172380349 for more context.
+    previous_endpoint_channel->Read();
+    previous_endpoint_channel->Close(DisconnectionReason::UPGRADED);
+
+    NEARBY_LOGS(VERBOSE)
+        << "BwuManager cleanly shut down prior "
+        << previous_endpoint_channel->GetType()
+        << " EndpointChannel to conclude upgrade protocol for endpoint "
+        << endpoint_id;
+  }
 
   // Now the upgrade protocol has completed, record analytics for this new
   // upgraded bandwidth connection...
+  Medium medium = GetUpgradeMediumForEndpoint(endpoint_id);
+  channel_manager_->GetMediumQualityTracker().RecordUpgradeResult(
+      medium, /*success=*/true);
+  CountUpgradeResult(medium, /*success=*/true);
   client->GetAnalyticsRecorder().OnConnectionEstablished(
-      endpoint_id, medium_, client->GetConnectionToken(endpoint_id));
-  // ...and the success of the upgrade itself.
-  client->GetAnalyticsRecorder().OnBandwidthUpgradeSuccess(endpoint_id);
+      endpoint_id, medium, client->GetConnectionToken(endpoint_id));
+  // ...and the success of the upgrade itself, including how long our writes
+  // were held back for it.
+  absl::Duration write_stall = TakeWriteStall(endpoint_id);
+  static Histogram* write_stall_histogram =
+      MetricsRegistry::GetInstance().GetHistogram(
+          "nearby_bwu_write_stall_micros",
+          "Time writes were held back by a bandwidth upgrade, in "
+          "microseconds.");
+  write_stall_histogram->Record(write_stall);
+  NEARBY_LOGS(INFO) << "BwuManager held back writes to endpoint " << endpoint_id
+                    << " for " << absl::FormatDuration(write_stall)
+                    << " while upgrading it.";
+  client->GetAnalyticsRecorder().OnBandwidthUpgradeSuccess(endpoint_id,
+                                                           write_stall);
 
   // Now that the old channel has been drained, we can unpause the new channel
   std::shared_ptr<EndpointChannel> channel =
@@ -962,35 +1173,19 @@ void BwuManager::ProcessUpgradeFailureEvent(
   // one).
   in_progress_upgrades_.erase(endpoint_id);
 
-  // The first thing we have to do is to replace our
-  // currentBwuMedium with the next best upgrade medium we share
-  // with the remote device. The catch is that we can only do this if we only
-  // have one connected endpoint. Otherwise, we'll end up disrupting our other
-  // connected peers.
-  if (channel_manager_->GetConnectedEndpointsCount() > 1) {
-    // We can't change the currentBwuMedium, so there are no more
-    // upgrade attempts for this endpoint. Sorry.
-    NEARBY_LOGS(ERROR)
-        << "BwuManager failed to attempt a new bandwidth upgrade for endpoint "
-        << endpoint_id
-        << " because we have other connected endpoints and can't try a new "
-           "upgrade medium.";
-    client->GetAnalyticsRecorder().OnBandwidthUpgradeError(
-        endpoint_id, proto::connections::CHANNEL_ERROR,
-        proto::connections::NETWORK_AVAILABLE);
-    return;
-  }
-
-  // Revert the existing upgrade medium for now.
-  if (medium_ != Medium::UNKNOWN_MEDIUM) {
-    Revert();
-  }
+  // The first thing we have to do is to replace the upgrade medium of the
+  // endpoint with the next best upgrade medium we share with the remote
+  // device. Other endpoints keep theirs, so this doesn't disrupt them.
+  Medium last = parser::UpgradePathInfoMediumToMedium(upgrade_info.medium());
+  channel_manager_->GetMediumQualityTracker().RecordUpgradeResult(
+      last, /*success=*/false);
+  CountUpgradeResult(last, /*success=*/false);
+  RevertBwuHandlerForEndpoint(endpoint_id);
 
   // Loop through the ordered list of upgrade mediums. One by one, remove the
   // top element until we get to the medium we last attempted to upgrade to.
   // The remainder of the list will contain the mediums we haven't attempted
   // yet.
-  Medium last = parser::UpgradePathInfoMediumToMedium(upgrade_info.medium());
   std::vector<Medium> all_possible_mediums =
       client->GetUpgradeMediums(endpoint_id).GetMediums(true);
   std::vector<Medium> untried_mediums(all_possible_mediums);
@@ -1007,7 +1202,7 @@ void BwuManager::ProcessUpgradeFailureEvent(
 void BwuManager::RetryUpgradeMediums(ClientProxy* client,
                                      const std::string& endpoint_id,
                                      std::vector<Medium> upgrade_mediums) {
-  Medium next_medium = ChooseBestUpgradeMedium(upgrade_mediums);
+  Medium next_medium = ChooseBestUpgradeMedium(endpoint_id, upgrade_mediums);
   NEARBY_LOGS(INFO) << "RetryUpgradeMediums for endpoint " << endpoint_id
                     << " after ChooseBestUpgradeMedium: " << next_medium;
 
@@ -1021,8 +1216,8 @@ void BwuManager::RetryUpgradeMediums(ClientProxy* client,
     return;
   }
 
-  // Attempt to set the new upgrade medium.
-  if (!SetCurrentBwuHandler(next_medium)) {
+  // Check that we can attempt the new upgrade medium.
+  if (!GetBwuHandler(next_medium)) {
     NEARBY_LOGS(INFO)
         << "BwuManager failed to attempt a new bandwidth upgrade for endpoint "
         << endpoint_id
@@ -1066,53 +1261,25 @@ std::vector<Medium> BwuManager::StripOutUnavailableMediums(
 // Returns the optimal medium supported by both devices.
 // Each medium in the passed in list is checked for its availability with the
 // medium_manager_ to ensure that the chosen upgrade medium is supported and
-// available locally before continuing the upgrade. Once we pick a medium, all
-// future connections will use it too. eg. If we chose Wifi LAN, we'll attempt
-// to upgrade the 2nd, 3rd, etc remote endpoints with Wifi LAN even if they're
-// on a different network (or had a better medium). This is a quick and easy
-// way to prevent mediums, like Wifi Hotspot, from interfering with active
-// connections (although it's suboptimal for bandwidth throughput). When all
-// endpoints disconnect, we reset the bandwidth upgrade medium.
-Medium BwuManager::ChooseBestUpgradeMedium(const std::vector<Medium>& mediums) {
+// available locally before continuing the upgrade. Of the remaining mediums,
+// the first one is returned, since they are ordered by preference. With
+// enable_measured_upgrade_medium_choice, they are scored instead by the
+// throughput we've measured on them and by how often upgrades to them
+// succeeded, so each endpoint gets the medium that serves it best.
+Medium BwuManager::ChooseBestUpgradeMedium(const std::string& endpoint_id,
+                                           const std::vector<Medium>& mediums) {
   auto available_mediums = StripOutUnavailableMediums(mediums);
-  if (medium_ == Medium::UNKNOWN_MEDIUM) {
-    if (!available_mediums.empty()) {
-      // Case 1: This is our first time upgrading, and we have at least one
-      // supported medium to choose from. Return the first medium in the list,
-      // since they are ordered by preference.
-      return available_mediums[0];
-    }
-    // Case 2: This is our first time upgrading, but there are no available
-    // upgrade mediums. Fall through to returning UNKNOWN_MEDIUM at the
-    // bottom.
-    NEARBY_LOGS(INFO)
-        << "Current upgrade medium is unset, but there are no common supported "
-           "upgrade mediums.";
-  } else {
-    // Case 3: We have already upgraded, and there is a list of supported
-    // mediums to check against. Return the current upgrade medium if it's in
-    // the supported list.
-    if (std::find(available_mediums.begin(), available_mediums.end(),
-                  medium_) != available_mediums.end()) {
-      return medium_;
-    }
-    // Case 4: We have already upgraded, but the current medium is not
-    // supported by the remote endpoint (it's not in the list, or the list is
-    // empty). Fall through and return Medium.UNKNOWN_MEDIUM because we cannot
-    // continue with the current upgrade medium, and we are not allowed to
-    // switch.
-    std::string mediums_string;
-    for (const auto& medium : available_mediums) {
-      absl::StrAppend(&mediums_string, proto::connections::Medium_Name(medium),
-                      "; ");
-    }
-    NEARBY_LOGS(INFO)
-        << "Current upgrade medium " << proto::connections::Medium_Name(medium_)
-        << " is not supported by the remote endpoint (supported mediums: "
-        << mediums_string << ")";
+  if (available_mediums.empty()) {
+    NEARBY_LOGS(INFO) << "There are no common supported upgrade mediums.";
+    return Medium::UNKNOWN_MEDIUM;
   }
-
-  return Medium::UNKNOWN_MEDIUM;
+  if (!FeatureFlags::GetInstance()
+           .GetFlags()
+           .enable_measured_upgrade_medium_choice) {
+    return available_mediums[0];
+  }
+  return channel_manager_->GetMediumQualityTracker().ChooseBest(
+      endpoint_id, available_mediums);
 }
 
 void BwuManager::RetryUpgradesAfterDelay(ClientProxy* client,
@@ -1191,6 +1358,17 @@ absl::Duration BwuManager::CalculateNextRetryDelay(
   return std::min(delay, config_.bandwidth_upgrade_retry_max_delay);
 }
 
+absl::Duration BwuManager::TakeWriteStall(const std::string& endpoint_id) {
+  auto stall = write_stalls_.extract(endpoint_id);
+  auto start_time = write_stall_start_times_.extract(endpoint_id);
+  if (!stall.empty()) return stall.mapped();
+  // Writes are still held back; they are about to be resumed.
+  if (!start_time.empty()) {
+    return SystemClock::ElapsedRealtime() - start_time.mapped();
+  }
+  return absl::ZeroDuration();
+}
+
 void BwuManager::CancelRetryUpgradeAlarm(const std::string& endpoint_id) {
   NEARBY_LOGS(INFO) << "CancelRetryUpgradeAlarm for endpoint " << endpoint_id;
   auto item = retry_upgrade_alarms_.extract(endpoint_id);
@@ -57,6 +57,16 @@ namespace connections {
 //   - Both then wait to receive
 //     BANDWIDTH_UPGRADE_NEGOTIATION.SAFE_TO_CLOSE_PRIOR_CHANNEL from the
 //     other, and upon doing so, close the prior EndpointChannel.
+//
+// With FeatureFlags::enable_multipath_striping, the Responder offers to keep
+// the prior EndpointChannel in its CLIENT_INTRODUCTION, and the Initiator
+// accepts by sending a salt in its CLIENT_INTRODUCTION_ACK. Both then keep the
+// prior EndpointChannel open as a stripe instead of closing it (see
+// EndpointChannelManager::RetainChannelAsStripe()).
+//
+// Each endpoint is upgraded to a medium of its own, picked by how well the
+// mediums both devices support have been doing lately, so upgrades of several
+// endpoints to different mediums may be in progress at the same time.
 class BwuManager : public EndpointManager::FrameProcessor {
  public:
   using UpgradePathInfo = BwuHandler::UpgradePathInfo;
@@ -74,7 +84,8 @@ class BwuManager : public EndpointManager::FrameProcessor {
 
   ~BwuManager() override;
 
-  // This is the point on the outbound BWU protocol where the handler_ is set.
+  // This is the point on the outbound BWU protocol where the BwuHandler of the
+  // endpoint is set.
   // Function initiates the bandwidth upgrade and sends an
   // UPGRADE_PATH_AVAILABLE OfflineFrame.
   void InitiateBwuForEndpoint(ClientProxy* client_proxy,
@@ -82,15 +93,16 @@ class BwuManager : public EndpointManager::FrameProcessor {
                               Medium new_medium = Medium::UNKNOWN_MEDIUM);
 
   // == EndpointManager::FrameProcessor interface ==.
-  // This is the point on the inbound BWU protocol where the handler_ is set.
+  // This is the point on the inbound BWU protocol where the BwuHandler of the
+  // endpoint is set.
   // This is also an entry point for handling messages for both outbound and
   // inbound BWU protocol.
-  // @EndpointManagerReaderThread
+  // @EndpointManagerDispatchThread
   void OnIncomingFrame(OfflineFrame& frame, const std::string& endpoint_id,
                        ClientProxy* client, Medium medium) override;
 
   // Cleans up in-progress upgrades after endpoint disconnection.
-  // @EndpointManagerReaderThread
+  // @EndpointManagerDispatchThread
   void OnEndpointDisconnect(ClientProxy* client_proxy,
                             const std::string& endpoint_id,
                             CountDownLatch barrier) override;
@@ -99,16 +111,24 @@ class BwuManager : public EndpointManager::FrameProcessor {
  private:
   static constexpr absl::Duration kReadClientIntroductionFrameTimeout =
       absl::Seconds(5);
-  BwuHandler* SetCurrentBwuHandler(Medium medium);
+  BwuHandler* GetBwuHandler(Medium medium);
+  // Sets |medium| as the upgrade medium of the endpoint, and returns its
+  // BwuHandler, or nullptr if there is none for |medium|.
+  BwuHandler* SetBwuHandlerForEndpoint(const std::string& endpoint_id,
+                                       Medium medium);
+  BwuHandler* GetBwuHandlerForEndpoint(const std::string& endpoint_id);
+  Medium GetUpgradeMediumForEndpoint(const std::string& endpoint_id) const;
   void InitBwuHandlers();
   void RunOnBwuManagerThread(const std::string& name,
                              std::function<void()> runnable);
   std::vector<Medium> StripOutUnavailableMediums(
       const std::vector<Medium>& mediums);
-  Medium ChooseBestUpgradeMedium(const std::vector<Medium>& mediums);
+  Medium ChooseBestUpgradeMedium(const std::string& endpoint_id,
+                                 const std::vector<Medium>& mediums);
 
   // BaseBwuHandler
   using ClientIntroduction = BwuNegotiationFrame::ClientIntroduction;
+  using ClientIntroductionAck = BwuNegotiationFrame::ClientIntroductionAck;
 
   // Processes the BwuNegotiationFrames that come over the
   // EndpointChannel on both initiator and responder side of the upgrade.
@@ -117,8 +137,9 @@ class BwuManager : public EndpointManager::FrameProcessor {
                              const string& endpoint_id);
 
   // Called to revert any state changed by the Initiator or Responder in the
-  // course of setting up the upgraded medium for an endpoint.
-  void Revert();
+  // course of setting up the upgraded medium for an endpoint. The BwuHandler
+  // is only reverted once no other endpoint uses its medium.
+  void RevertBwuHandlerForEndpoint(const std::string& endpoint_id);
 
   // Common functionality to take an incoming connection and go through the
   // upgrade process. This is a callback, invoked by concrete handlers, once
@@ -144,8 +165,11 @@ class BwuManager : public EndpointManager::FrameProcessor {
                                            const std::string& endpoint_id);
   bool ReadClientIntroductionFrame(EndpointChannel* endpoint_channel,
                                    ClientIntroduction& introduction);
-  bool ReadClientIntroductionAckFrame(EndpointChannel* endpoint_channel);
-  bool WriteClientIntroductionAckFrame(EndpointChannel* endpoint_channel);
+  bool ReadClientIntroductionAckFrame(EndpointChannel* endpoint_channel,
+                                      ClientIntroductionAck& introduction_ack);
+  bool WriteClientIntroductionAckFrame(EndpointChannel* endpoint_channel,
+                                       const ByteArray& stripe_salt,
+                                       bool make_before_break);
   void ProcessEndpointDisconnection(ClientProxy* client,
                                     const std::string& endpoint_id,
                                     CountDownLatch* barrier);
@@ -163,24 +187,45 @@ class BwuManager : public EndpointManager::FrameProcessor {
   void AttemptToRecordBandwidthUpgradeErrorForUnknownEndpoint(
       proto::connections::BandwidthUpgradeResult result,
       proto::connections::BandwidthUpgradeErrorStage error_stage);
+  // Returns how long writes to the endpoint were held back while switching
+  // over to its new EndpointChannel, and forgets about it.
+  absl::Duration TakeWriteStall(const std::string& endpoint_id);
 
   Config config_;
 
-  Medium medium_ = Medium::UNKNOWN_MEDIUM;
-  BwuHandler* handler_ = nullptr;
+  // Maps endpointId -> the medium it is being, or has been, upgraded to.
+  absl::flat_hash_map<std::string, Medium> upgrade_mediums_;
   Mediums* mediums_;
   absl::flat_hash_map<Medium, std::unique_ptr<BwuHandler>> handlers_;
 
   EndpointManager* endpoint_manager_;
   EndpointChannelManager* channel_manager_;
-  ScheduledExecutor alarm_executor_;
-  SingleThreadExecutor serial_executor_;
+  ScheduledExecutor alarm_executor_{"bwu-alarms"};
+  SingleThreadExecutor serial_executor_{"bwu"};
   // Stores each upgraded endpoint's previous EndpointChannel (that was
   // displaced in favor of a new EndpointChannel) temporarily, until it can
   // safely be shut down for good in processLastWriteToPriorChannelEvent().
   absl::flat_hash_map<std::string, std::shared_ptr<EndpointChannel>>
       previous_endpoint_channels_;
   absl::flat_hash_set<std::string> successfully_upgraded_endpoints_;
+  // What the stripe keys are derived from, besides the endpoint's session.
+  struct StripeKeyParams {
+    ByteArray salt;
+    // True on the side of the upgrade that accepted the new EndpointChannel.
+    bool is_initiator;
+  };
+  // Maps endpointId -> StripeKeyParams, for the upgrades in which both sides
+  // agreed to keep the prior EndpointChannel as a stripe.
+  absl::flat_hash_map<std::string, StripeKeyParams> stripe_salts_;
+  // Endpoints whose prior EndpointChannel is being kept as a stripe.
+  absl::flat_hash_set<std::string> striping_endpoints_;
+  // Endpoints for which both sides agreed to switch writes over to the new
+  // EndpointChannel right after LAST_WRITE_TO_PRIOR_CHANNEL.
+  absl::flat_hash_set<std::string> make_before_break_endpoints_;
+  // Maps endpointId -> the time writes to the new EndpointChannel got paused,
+  // and, once they are resumed, how long they were held back.
+  absl::flat_hash_map<std::string, absl::Time> write_stall_start_times_;
+  absl::flat_hash_map<std::string, absl::Duration> write_stalls_;
   // Maps endpointId -> ClientProxy for which
   // initiateBwuForEndpoint() has been called but which have not
   // yet completed the upgrade via onIncomingConnection().
@@ -73,7 +73,7 @@ TEST(BwuManagerTest, CanProcessBandwidthUpgradeFrames) {
                               &client, Medium::WEB_RTC);
 
   ExceptionOr<OfflineFrame> last_write_frame =
-      parser::FromBytes(parser::ForBwuLastWrite());
+      parser::FromBytes(parser::ForBwuLastWrite(/*make_before_break=*/false));
   bwu_manager.OnIncomingFrame(last_write_frame.result(), endpoint_id, &client,
                               Medium::WEB_RTC);
 
@@ -0,0 +1,205 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/channel_stripes.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "platform/public/logging.h"
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr double StripeScheduler::kSmoothingFactor;
+constexpr int StripeScheduler::kNoLane;
+constexpr int ChannelStripes::kMaxQueuedWrites;
+constexpr int ChannelStripes::kPrimaryLane;
+constexpr int ChannelStripes::kStripeLane;
+
+StripeScheduler::StripeScheduler(int num_lanes) : lanes_(num_lanes) {}
+
+int StripeScheduler::PickLane(std::int64_t size, int skip_lane) {
+  int fallback_lane = kNoLane;
+  int probe_lane = kNoLane;
+  int best_lane = kNoLane;
+  double best_finish_time = 0;
+  for (int i = 0; i < static_cast<int>(lanes_.size()); i++) {
+    if (i == skip_lane) continue;
+    if (fallback_lane == kNoLane) fallback_lane = i;
+    const Lane& lane = lanes_[i];
+    if (lane.throughput <= 0) {
+      // Unmeasured lanes take turns, one chunk in flight at a time.
+      if (!lane.probing &&
+          (probe_lane == kNoLane ||
+           lane.probe_bytes < lanes_[probe_lane].probe_bytes)) {
+        probe_lane = i;
+      }
+      continue;
+    }
+    double finish_time = lane.finish_time + size / lane.throughput;
+    if (best_lane == kNoLane || finish_time < best_finish_time) {
+      best_lane = i;
+      best_finish_time = finish_time;
+    }
+  }
+  if (probe_lane != kNoLane) {
+    lanes_[probe_lane].probing = true;
+    lanes_[probe_lane].probe_bytes += size;
+    return probe_lane;
+  }
+  // Every lane is still being measured.
+  if (best_lane == kNoLane) return fallback_lane;
+
+  lanes_[best_lane].finish_time = best_finish_time;
+  // Keep the finish times relative to the lane that finishes first, so they
+  // don't grow without bound.
+  double min_finish_time = best_finish_time;
+  for (const Lane& lane : lanes_) {
+    if (lane.throughput > 0) {
+      min_finish_time = std::min(min_finish_time, lane.finish_time);
+    }
+  }
+  for (Lane& lane : lanes_) {
+    lane.finish_time = std::max(0.0, lane.finish_time - min_finish_time);
+  }
+  return best_lane;
+}
+
+void StripeScheduler::OnWriteDone(int lane, std::int64_t size,
+                                  absl::Time start_time, absl::Time end_time) {
+  Lane& target = lanes_[lane];
+  target.probing = false;
+  double sample = target.sampler.RecordWrite(size, start_time, end_time);
+  if (sample <= 0) return;
+  if (target.throughput <= 0) {
+    target.throughput = sample;
+  } else {
+    target.throughput = kSmoothingFactor * sample +
+                        (1 - kSmoothingFactor) * target.throughput;
+  }
+}
+
+double StripeScheduler::GetThroughput(int lane) const {
+  return lanes_[lane].throughput;
+}
+
+ChannelStripes::ChannelStripes(std::shared_ptr<EndpointChannel> stripe)
+    : stripe_(std::move(stripe)) {}
+
+ChannelStripes::~ChannelStripes() {
+  {
+    MutexLock lock(&mutex_);
+    broken_ = true;
+    cond_.Notify();
+  }
+  writer_.Shutdown();
+}
+
+Exception ChannelStripes::Write(EndpointChannel& primary,
+                                const ByteArray& bytes) {
+  Exception exception = WriteFailedFrames(primary);
+  if (!exception.Ok()) return exception;
+
+  {
+    MutexLock lock(&mutex_);
+    if (!broken_) {
+      // Rather than wait for a stripe that fell behind, keep the primary busy.
+      int skip_lane = queued_writes_ >= kMaxQueuedWrites
+                          ? kStripeLane
+                          : StripeScheduler::kNoLane;
+      if (scheduler_.PickLane(bytes.size(), skip_lane) == kStripeLane) {
+        queued_writes_++;
+        writer_.Execute("stripe-write",
+                        [this, bytes]() { WriteToStripe(bytes); });
+        return {Exception::kSuccess};
+      }
+    }
+  }
+
+  absl::Time start_time = SystemClock::ElapsedRealtime();
+  exception = primary.Write(bytes);
+  if (exception.Ok()) {
+    MutexLock lock(&mutex_);
+    scheduler_.OnWriteDone(kPrimaryLane, bytes.size(), start_time,
+                           SystemClock::ElapsedRealtime());
+  }
+  return exception;
+}
+
+Exception ChannelStripes::Flush(EndpointChannel& primary) {
+  {
+    MutexLock lock(&mutex_);
+    while (queued_writes_ > 0) {
+      cond_.Wait();
+    }
+  }
+  return WriteFailedFrames(primary);
+}
+
+bool ChannelStripes::IsBroken() const {
+  MutexLock lock(&mutex_);
+  return broken_;
+}
+
+void ChannelStripes::WriteToStripe(const ByteArray& bytes) {
+  bool broken;
+  {
+    MutexLock lock(&mutex_);
+    broken = broken_;
+  }
+  absl::Time start_time = SystemClock::ElapsedRealtime();
+  Exception exception =
+      broken ? Exception{Exception::kIo} : stripe_->Write(bytes);
+
+  MutexLock lock(&mutex_);
+  if (exception.Ok()) {
+    scheduler_.OnWriteDone(kStripeLane, bytes.size(), start_time,
+                           SystemClock::ElapsedRealtime());
+  } else {
+    if (!broken_) {
+      NEARBY_LOGS(WARNING) << "ChannelStripes failed to write to stripe "
+                           << stripe_->GetName()
+                           << "; falling back to the primary channel.";
+    }
+    broken_ = true;
+    failed_frames_.push_back(bytes);
+  }
+  queued_writes_--;
+  cond_.Notify();
+}
+
+Exception ChannelStripes::WriteFailedFrames(EndpointChannel& primary) {
+  std::vector<ByteArray> frames;
+  {
+    MutexLock lock(&mutex_);
+    frames.swap(failed_frames_);
+  }
+  for (const ByteArray& frame : frames) {
+    Exception exception = primary.Write(frame);
+    if (!exception.Ok()) return exception;
+  }
+  return {Exception::kSuccess};
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
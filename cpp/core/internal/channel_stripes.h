@@ -0,0 +1,143 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_CHANNEL_STRIPES_H_
+#define CORE_INTERNAL_CHANNEL_STRIPES_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
+#include "core/internal/endpoint_channel.h"
+#include "core/internal/medium_quality_tracker.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+#include "platform/public/condition_variable.h"
+#include "platform/public/mutex.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Decides which of several lanes (channels) carries the next chunk, so that
+// every lane gets a share of the bytes proportional to its throughput.
+//
+// Each lane is given a virtual finish time: the time it needs to write all the
+// bytes given to it so far at its measured throughput. The next chunk goes to
+// the lane that would finish it first. Throughput is sampled the same way as
+// MediumQualityTracker does it, over windows of back-to-back writes rather than
+// per write. Not thread-safe.
+class StripeScheduler {
+ public:
+  // Weight of the newest sample in the throughput estimate of a lane.
+  static constexpr double kSmoothingFactor = 0.25;
+  // Stands for no lane at all.
+  static constexpr int kNoLane = -1;
+
+  explicit StripeScheduler(int num_lanes);
+
+  // Returns the lane that should carry the next |size| bytes, other than
+  // |skip_lane|, which must not be the only lane. Lanes that haven't been
+  // measured yet take turns carrying one chunk at a time, until they have been
+  // written to for a whole sample window.
+  int PickLane(std::int64_t size, int skip_lane = kNoLane);
+
+  // Feeds a write of |size| bytes to |lane| that started at |start_time| and
+  // completed at |end_time| into the throughput estimate of the lane.
+  void OnWriteDone(int lane, std::int64_t size, absl::Time start_time,
+                   absl::Time end_time);
+
+  // Returns the estimated throughput of |lane| in bytes per second, or 0 if it
+  // hasn't been measured yet.
+  double GetThroughput(int lane) const;
+
+ private:
+  struct Lane {
+    // Bytes per second; 0 until measured.
+    double throughput = 0;
+    // Seconds; relative to the lane that finishes first.
+    double finish_time = 0;
+    // True while a chunk sent to measure the lane is in flight.
+    bool probing = false;
+    // Bytes given to the lane to measure it.
+    std::int64_t probe_bytes = 0;
+    ThroughputSampler sampler;
+  };
+
+  std::vector<Lane> lanes_;
+};
+
+// Spreads the data frames written to a striped endpoint over its current
+// EndpointChannel (the primary) and one more channel kept open next to it
+// (the stripe), in proportion to their throughput.
+//
+// Writes to the primary happen on the calling thread, as usual. Writes to the
+// stripe are handed over to a dedicated writer thread, so both channels are
+// busy at the same time. If a write to the stripe fails, the stripe is given
+// up and the frame is written to the primary instead, by the next call to
+// Write() or Flush().
+class ChannelStripes {
+ public:
+  // Maximum number of frames queued for the stripe writer. Once reached,
+  // frames go over the primary until the stripe has caught up.
+  static constexpr int kMaxQueuedWrites = 4;
+
+  explicit ChannelStripes(std::shared_ptr<EndpointChannel> stripe);
+  ~ChannelStripes();
+  ChannelStripes(const ChannelStripes&) = delete;
+  ChannelStripes& operator=(const ChannelStripes&) = delete;
+
+  // Writes a data frame over |primary| or the stripe.
+  Exception Write(EndpointChannel& primary, const ByteArray& bytes)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until the frames queued for the stripe have been written, and
+  // writes the ones that failed over |primary|. Lets a caller make sure all
+  // frames written so far are out before the ones that follow.
+  Exception Flush(EndpointChannel& primary) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the channel used as the stripe.
+  EndpointChannel* GetChannel() const { return stripe_.get(); }
+
+  // True once a write to the stripe has failed.
+  bool IsBroken() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  static constexpr int kPrimaryLane = 0;
+  static constexpr int kStripeLane = 1;
+
+  void WriteToStripe(const ByteArray& bytes) ABSL_LOCKS_EXCLUDED(mutex_);
+  Exception WriteFailedFrames(EndpointChannel& primary)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const std::shared_ptr<EndpointChannel> stripe_;
+  mutable Mutex mutex_;
+  ConditionVariable cond_{&mutex_};
+  StripeScheduler scheduler_ ABSL_GUARDED_BY(mutex_) = StripeScheduler(2);
+  int queued_writes_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool broken_ ABSL_GUARDED_BY(mutex_) = false;
+  // Frames that could not be written to the stripe.
+  std::vector<ByteArray> failed_frames_ ABSL_GUARDED_BY(mutex_);
+  // Declared last, so it is shut down before the state it uses goes away.
+  SingleThreadExecutor writer_{"stripe-writer"};
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_CHANNEL_STRIPES_H_
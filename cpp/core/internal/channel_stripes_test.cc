@@ -0,0 +1,263 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/channel_stripes.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "core/internal/endpoint_channel.h"
+#include "core/internal/medium_quality_tracker.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+#include "proto/connections_enums.pb.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+using ::location::nearby::proto::connections::DisconnectionReason;
+using ::location::nearby::proto::connections::Medium;
+using ::testing::NiceMock;
+using ::testing::UnorderedElementsAreArray;
+
+class MockEndpointChannel : public EndpointChannel {
+ public:
+  MOCK_METHOD(ExceptionOr<ByteArray>, Read, (), (override));
+  MOCK_METHOD(Exception, Write, (const ByteArray& data), (override));
+  MOCK_METHOD(Exception, WriteLast, (const ByteArray& data), (override));
+  MOCK_METHOD(void, Close, (), (override));
+  MOCK_METHOD(void, Close, (DisconnectionReason reason), (override));
+  MOCK_METHOD(proto::connections::ConnectionTechnology, GetTechnology, (),
+              (const override));
+  MOCK_METHOD(proto::connections::ConnectionBand, GetBand, (),
+              (const override));
+  MOCK_METHOD(int, GetFrequency, (), (const override));
+  MOCK_METHOD(int, GetTryCount, (), (const override));
+  MOCK_METHOD(std::string, GetType, (), (const override));
+  MOCK_METHOD(std::string, GetName, (), (const override));
+  MOCK_METHOD(Medium, GetMedium, (), (const override));
+  MOCK_METHOD(int, GetMaxTransmitPacketSize, (), (const override));
+  MOCK_METHOD(void, EnableEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(void, DisableEncryption, (), (override));
+  MOCK_METHOD(void, EnableWriteEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(void, EnableReadEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(bool, IsPaused, (), (const override));
+  MOCK_METHOD(void, Pause, (), (override));
+  MOCK_METHOD(void, Resume, (), (override));
+  MOCK_METHOD(absl::Time, GetLastReadTimestamp, (), (const override));
+  MOCK_METHOD(absl::Time, GetLastWriteTimestamp, (), (const override));
+  MOCK_METHOD(void, SetAnalyticsRecorder,
+              (analytics::AnalyticsRecorder*, const std::string&), (override));
+};
+
+// Records the frames written to a mock channel, optionally failing or holding
+// back the writes.
+class FrameRecorder {
+ public:
+  explicit FrameRecorder(MockEndpointChannel& channel) {
+    ON_CALL(channel, Write).WillByDefault([this](const ByteArray& data) {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(&unblocked_));
+      if (failing_) return Exception{Exception::kIo};
+      frames_.push_back(std::string(data));
+      return Exception{Exception::kSuccess};
+    });
+  }
+
+  void SetFailing() {
+    absl::MutexLock lock(&mutex_);
+    failing_ = true;
+  }
+  void Block() {
+    absl::MutexLock lock(&mutex_);
+    unblocked_ = false;
+  }
+  void Unblock() {
+    absl::MutexLock lock(&mutex_);
+    unblocked_ = true;
+  }
+  std::vector<std::string> GetFrames() const {
+    absl::MutexLock lock(&mutex_);
+    return frames_;
+  }
+
+ private:
+  mutable absl::Mutex mutex_;
+  bool failing_ ABSL_GUARDED_BY(mutex_) = false;
+  bool unblocked_ ABSL_GUARDED_BY(mutex_) = true;
+  std::vector<std::string> frames_ ABSL_GUARDED_BY(mutex_);
+};
+
+std::vector<std::string> Concat(std::vector<std::string> a,
+                                const std::vector<std::string>& b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+// Writes |bytes_per_second| to |lane| for a sample window, in back-to-back
+// writes of a tenth of a second each.
+void WriteForSampleWindow(StripeScheduler& scheduler, int lane,
+                          std::int64_t bytes_per_second,
+                          absl::Time start = absl::UnixEpoch()) {
+  absl::Duration write_time = absl::Milliseconds(100);
+  int writes = ThroughputSampler::kSampleWindow / write_time;
+  for (int i = 0; i < writes; ++i) {
+    scheduler.OnWriteDone(lane, bytes_per_second / 10, start + i * write_time,
+                          start + (i + 1) * write_time);
+  }
+}
+
+TEST(StripeSchedulerTest, ProbesEachLaneOnce) {
+  StripeScheduler scheduler(2);
+
+  EXPECT_EQ(scheduler.PickLane(100), 0);
+  EXPECT_EQ(scheduler.PickLane(100), 1);
+  // Neither lane has been measured yet.
+  EXPECT_EQ(scheduler.PickLane(100), 0);
+  EXPECT_EQ(scheduler.GetThroughput(1), 0);
+}
+
+TEST(StripeSchedulerTest, UnmeasuredLanesTakeTurns) {
+  StripeScheduler scheduler(2);
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(scheduler.PickLane(100), 0);
+    scheduler.OnWriteDone(0, 100, absl::UnixEpoch(),
+                          absl::UnixEpoch() + absl::Milliseconds(1));
+    EXPECT_EQ(scheduler.PickLane(100), 1);
+    scheduler.OnWriteDone(1, 100, absl::UnixEpoch(),
+                          absl::UnixEpoch() + absl::Milliseconds(1));
+  }
+  // A single write is not a sample.
+  EXPECT_EQ(scheduler.GetThroughput(0), 0);
+  EXPECT_EQ(scheduler.GetThroughput(1), 0);
+}
+
+TEST(StripeSchedulerTest, SplitsBytesByThroughput) {
+  StripeScheduler scheduler(2);
+  WriteForSampleWindow(scheduler, 0, 100);
+  WriteForSampleWindow(scheduler, 1, 300);
+  EXPECT_EQ(scheduler.GetThroughput(0), 100);
+  EXPECT_EQ(scheduler.GetThroughput(1), 300);
+
+  int picks[2] = {0, 0};
+  for (int i = 0; i < 400; i++) {
+    picks[scheduler.PickLane(10)]++;
+  }
+
+  EXPECT_NEAR(picks[0], 100, 2);
+  EXPECT_NEAR(picks[1], 300, 2);
+}
+
+TEST(StripeSchedulerTest, SkipsLane) {
+  StripeScheduler scheduler(2);
+  WriteForSampleWindow(scheduler, 0, 100);
+  WriteForSampleWindow(scheduler, 1, 300);
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(scheduler.PickLane(10, /*skip_lane=*/1), 0);
+  }
+}
+
+TEST(StripeSchedulerTest, ThroughputIsSmoothed) {
+  StripeScheduler scheduler(1);
+  WriteForSampleWindow(scheduler, 0, 100);
+  WriteForSampleWindow(scheduler, 0, 200,
+                       absl::UnixEpoch() + ThroughputSampler::kSampleWindow);
+
+  EXPECT_DOUBLE_EQ(
+      scheduler.GetThroughput(0),
+      StripeScheduler::kSmoothingFactor * 200 +
+          (1 - StripeScheduler::kSmoothingFactor) * 100);
+}
+
+TEST(ChannelStripesTest, EveryFrameIsWrittenOnce) {
+  NiceMock<MockEndpointChannel> primary;
+  auto stripe = std::make_shared<NiceMock<MockEndpointChannel>>();
+  FrameRecorder primary_frames(primary);
+  FrameRecorder stripe_frames(*stripe);
+  std::vector<std::string> expected;
+  {
+    ChannelStripes stripes(stripe);
+    for (int i = 0; i < 20; i++) {
+      expected.push_back("frame" + std::to_string(i));
+      EXPECT_TRUE(stripes.Write(primary, ByteArray(expected.back())).Ok());
+    }
+    EXPECT_TRUE(stripes.Flush(primary).Ok());
+    EXPECT_FALSE(stripes.IsBroken());
+  }
+
+  EXPECT_FALSE(stripe_frames.GetFrames().empty());
+  EXPECT_THAT(Concat(primary_frames.GetFrames(), stripe_frames.GetFrames()),
+              UnorderedElementsAreArray(expected));
+}
+
+TEST(ChannelStripesTest, FailedFramesAreWrittenToPrimary) {
+  NiceMock<MockEndpointChannel> primary;
+  auto stripe = std::make_shared<NiceMock<MockEndpointChannel>>();
+  FrameRecorder primary_frames(primary);
+  FrameRecorder stripe_frames(*stripe);
+  stripe_frames.SetFailing();
+  std::vector<std::string> expected;
+  ChannelStripes stripes(stripe);
+
+  for (int i = 0; i < 20; i++) {
+    expected.push_back("frame" + std::to_string(i));
+    EXPECT_TRUE(stripes.Write(primary, ByteArray(expected.back())).Ok());
+  }
+  EXPECT_TRUE(stripes.Flush(primary).Ok());
+
+  EXPECT_TRUE(stripes.IsBroken());
+  EXPECT_TRUE(stripe_frames.GetFrames().empty());
+  EXPECT_THAT(primary_frames.GetFrames(), UnorderedElementsAreArray(expected));
+}
+
+TEST(ChannelStripesTest, WriteDoesNotWaitForStripe) {
+  NiceMock<MockEndpointChannel> primary;
+  auto stripe = std::make_shared<NiceMock<MockEndpointChannel>>();
+  FrameRecorder primary_frames(primary);
+  FrameRecorder stripe_frames(*stripe);
+  stripe_frames.Block();
+  std::vector<std::string> expected;
+  ChannelStripes stripes(stripe);
+
+  for (int i = 0; i < 20; i++) {
+    expected.push_back("frame" + std::to_string(i));
+    EXPECT_TRUE(stripes.Write(primary, ByteArray(expected.back())).Ok());
+  }
+  EXPECT_GE(primary_frames.GetFrames().size(),
+            expected.size() - ChannelStripes::kMaxQueuedWrites);
+  stripe_frames.Unblock();
+  EXPECT_TRUE(stripes.Flush(primary).Ok());
+
+  EXPECT_FALSE(stripes.IsBroken());
+  EXPECT_THAT(Concat(primary_frames.GetFrames(), stripe_frames.GetFrames()),
+              UnorderedElementsAreArray(expected));
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/chunk_reorder_buffer.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "platform/public/logging.h"
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+namespace {
+// Moves the next expected offset past |frame|, if it holds the byte at that
+// offset; after a resumption, a chunk may start below it. Returns true if it
+// is the last chunk of its payload.
+bool Advance(std::int64_t& next_offset, const PayloadTransferFrame& frame) {
+  const PayloadTransferFrame::PayloadChunk& chunk = frame.payload_chunk();
+  if (chunk.offset() <= next_offset) {
+    next_offset = std::max<std::int64_t>(
+        next_offset, chunk.offset() + chunk.body().size());
+  }
+  return (chunk.flags() & PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
+}
+}  // namespace
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr int ChunkReorderBuffer::kMaxHeldChunksPerPayload;
+constexpr int ChunkReorderBuffer::kMaxFinishedPayloads;
+
+bool ChunkReorderBuffer::Add(const std::string& endpoint_id,
+                             PayloadTransferFrame frame,
+                             std::vector<PayloadTransferFrame>* ready) {
+  Key key(endpoint_id, frame.payload_header().id());
+  std::int64_t offset = frame.payload_chunk().offset();
+  MutexLock lock(&mutex_);
+
+  auto item = payloads_.find(key);
+  if (item == payloads_.end()) {
+    if (offset == 0) {
+      // A new transfer of the payload, maybe one that resumes an earlier one.
+      finished_.erase(std::remove(finished_.begin(), finished_.end(), key),
+                      finished_.end());
+    } else if (IsFinishedLocked(key)) {
+      ready->push_back(std::move(frame));
+      return true;
+    }
+    item = payloads_.emplace(key, PayloadState()).first;
+  }
+
+  PayloadState& state = item->second;
+  if (offset > state.next_offset) {
+    if (static_cast<int>(state.held.size()) >= kMaxHeldChunksPerPayload) {
+      NEARBY_LOGS(WARNING) << "ChunkReorderBuffer gave up on payload_id="
+                           << key.second << " from endpoint_id="
+                           << endpoint_id << "; chunk at offset "
+                           << state.next_offset << " never arrived.";
+      FinishLocked(item);
+      return false;
+    }
+    state.held.emplace(offset, std::move(frame));
+    return true;
+  }
+
+  bool is_last_chunk = Advance(state.next_offset, frame);
+  ready->push_back(std::move(frame));
+  if (is_last_chunk) {
+    FinishLocked(item);
+    return true;
+  }
+  DrainLocked(item, ready);
+  return true;
+}
+
+void ChunkReorderBuffer::TakeReady(const std::string& endpoint_id,
+                                   Payload::Id payload_id,
+                                   std::vector<PayloadTransferFrame>* ready) {
+  MutexLock lock(&mutex_);
+  auto item = payloads_.find(Key(endpoint_id, payload_id));
+  if (item != payloads_.end()) {
+    DrainLocked(item, ready);
+  }
+}
+
+void ChunkReorderBuffer::SkipTo(const std::string& endpoint_id,
+                                Payload::Id payload_id, std::int64_t offset) {
+  MutexLock lock(&mutex_);
+  auto item = payloads_.find(Key(endpoint_id, payload_id));
+  if (item != payloads_.end()) {
+    item->second.next_offset = std::max(item->second.next_offset, offset);
+  }
+}
+
+void ChunkReorderBuffer::Remove(const std::string& endpoint_id,
+                                Payload::Id payload_id) {
+  MutexLock lock(&mutex_);
+  auto item = payloads_.find(Key(endpoint_id, payload_id));
+  if (item != payloads_.end()) {
+    FinishLocked(item);
+  }
+}
+
+void ChunkReorderBuffer::RemoveEndpoint(const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+  for (auto item = payloads_.begin(); item != payloads_.end();) {
+    if (item->first.first == endpoint_id) {
+      payloads_.erase(item++);
+    } else {
+      ++item;
+    }
+  }
+}
+
+void ChunkReorderBuffer::DrainLocked(Payloads::iterator item,
+                                     std::vector<PayloadTransferFrame>* ready) {
+  PayloadState& state = item->second;
+  while (!state.held.empty() &&
+         state.held.begin()->first <= state.next_offset) {
+    auto first = state.held.begin();
+    bool is_last_chunk = Advance(state.next_offset, first->second);
+    ready->push_back(std::move(first->second));
+    state.held.erase(first);
+    if (is_last_chunk) {
+      FinishLocked(item);
+      return;
+    }
+  }
+}
+
+void ChunkReorderBuffer::FinishLocked(Payloads::iterator item) {
+  finished_.push_back(item->first);
+  if (static_cast<int>(finished_.size()) > kMaxFinishedPayloads) {
+    finished_.pop_front();
+  }
+  payloads_.erase(item);
+}
+
+bool ChunkReorderBuffer::IsFinishedLocked(const Key& key) const {
+  return std::find(finished_.begin(), finished_.end(), key) != finished_.end();
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
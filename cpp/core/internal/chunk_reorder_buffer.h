@@ -0,0 +1,109 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_CHUNK_REORDER_BUFFER_H_
+#define CORE_INTERNAL_CHUNK_REORDER_BUFFER_H_
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "core/payload.h"
+#include "platform/public/mutex.h"
+#include "proto/connections/offline_wire_formats.pb.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Puts the DATA frames of incoming payloads back in offset order.
+//
+// The chunks of a payload sent over several channels at once (see
+// ChannelStripes) may arrive out of order. Every chunk is expected to start
+// where the one before it ended; a chunk that arrives ahead of that is held
+// until the chunks before it have come in. Payloads are keyed by endpoint id
+// and payload id.
+class ChunkReorderBuffer {
+ public:
+  // Maximum number of chunks held for a single payload. A payload with more
+  // chunks waiting for a missing one is given up.
+  static constexpr int kMaxHeldChunksPerPayload = 64;
+  // Number of recently finished payloads remembered, so that their late chunks
+  // are passed on rather than held.
+  static constexpr int kMaxFinishedPayloads = 32;
+
+  ChunkReorderBuffer() = default;
+  ChunkReorderBuffer(const ChunkReorderBuffer&) = delete;
+  ChunkReorderBuffer& operator=(const ChunkReorderBuffer&) = delete;
+
+  // Takes in a DATA frame from |endpoint_id| and appends the frames that can
+  // be processed now to |ready|, in order. Returns false if too many chunks of
+  // the payload are held; the payload is forgotten then.
+  bool Add(const std::string& endpoint_id, PayloadTransferFrame frame,
+           std::vector<PayloadTransferFrame>* ready)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Appends the held frames of the payload that can be processed now to
+  // |ready|, in order.
+  void TakeReady(const std::string& endpoint_id, Payload::Id payload_id,
+                 std::vector<PayloadTransferFrame>* ready)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Moves the start of the next expected chunk of the payload ahead to
+  // |offset|, e.g. when the transfer resumes at a checkpoint. Chunks below it
+  // are passed on as they come.
+  void SkipTo(const std::string& endpoint_id, Payload::Id payload_id,
+              std::int64_t offset) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets the payload, e.g. once it is canceled. Its late chunks are passed
+  // on as they come.
+  void Remove(const std::string& endpoint_id, Payload::Id payload_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets all payloads from |endpoint_id|.
+  void RemoveEndpoint(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  using Key = std::pair<std::string, Payload::Id>;
+  struct PayloadState {
+    std::int64_t next_offset = 0;
+    // Chunks that arrived ahead of |next_offset|, by offset.
+    std::map<std::int64_t, PayloadTransferFrame> held;
+  };
+  using Payloads = absl::flat_hash_map<Key, PayloadState>;
+
+  // Appends the held frames that follow on from |next_offset| to |ready|.
+  void DrainLocked(Payloads::iterator item,
+                   std::vector<PayloadTransferFrame>* ready)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void FinishLocked(Payloads::iterator item)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool IsFinishedLocked(const Key& key) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable Mutex mutex_;
+  Payloads payloads_ ABSL_GUARDED_BY(mutex_);
+  std::deque<Key> finished_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_CHUNK_REORDER_BUFFER_H_
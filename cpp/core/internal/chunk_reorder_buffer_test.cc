@@ -0,0 +1,157 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/chunk_reorder_buffer.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kEndpointId[] = "ABCD";
+constexpr Payload::Id kPayloadId = 12345;
+constexpr int kChunkSize = 4;
+
+PayloadTransferFrame MakeChunk(std::int64_t offset, bool last = false,
+                               Payload::Id payload_id = kPayloadId) {
+  PayloadTransferFrame frame;
+  frame.set_packet_type(PayloadTransferFrame::DATA);
+  frame.mutable_payload_header()->set_id(payload_id);
+  auto* chunk = frame.mutable_payload_chunk();
+  chunk->set_offset(offset);
+  if (last) {
+    chunk->set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  } else {
+    chunk->set_body(std::string(kChunkSize, 'x'));
+  }
+  return frame;
+}
+
+std::vector<std::int64_t> Offsets(
+    const std::vector<PayloadTransferFrame>& frames) {
+  std::vector<std::int64_t> offsets;
+  for (const auto& frame : frames) {
+    offsets.push_back(frame.payload_chunk().offset());
+  }
+  return offsets;
+}
+
+TEST(ChunkReorderBufferTest, InOrderChunksPassThrough) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(4), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(8, /*last=*/true), &ready));
+
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({0, 4, 8}));
+}
+
+TEST(ChunkReorderBufferTest, OutOfOrderChunksAreReordered) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(12, /*last=*/true), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(8), &ready));
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({0}));
+
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(4), &ready));
+
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({0, 4, 8, 12}));
+}
+
+TEST(ChunkReorderBufferTest, PayloadsAreKeptApart) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(8), &ready));
+  EXPECT_TRUE(buffer.Add("WXYZ", MakeChunk(0), &ready));
+  EXPECT_TRUE(buffer.Add("WXYZ", MakeChunk(4), &ready));
+  EXPECT_TRUE(
+      buffer.Add(kEndpointId, MakeChunk(0, false, kPayloadId + 1), &ready));
+
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({0, 0, 4, 0}));
+}
+
+TEST(ChunkReorderBufferTest, SkipToReleasesHeldChunks) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(104), &ready));
+  ready.clear();
+
+  buffer.SkipTo(kEndpointId, kPayloadId, 100);
+  buffer.TakeReady(kEndpointId, kPayloadId, &ready);
+  EXPECT_TRUE(ready.empty());
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(4), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(100), &ready));
+
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({4, 100, 104}));
+}
+
+TEST(ChunkReorderBufferTest, ChunkAcrossSkipOffsetReleasesHeldChunks) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  buffer.SkipTo(kEndpointId, kPayloadId, 10);
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(12), &ready));
+  ready.clear();
+
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(8), &ready));
+
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({8, 12}));
+}
+
+TEST(ChunkReorderBufferTest, GivesUpWhenTooManyChunksAreHeld) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+
+  for (int i = 0; i < ChunkReorderBuffer::kMaxHeldChunksPerPayload; i++) {
+    EXPECT_TRUE(
+        buffer.Add(kEndpointId, MakeChunk((i + 2) * kChunkSize), &ready));
+  }
+  EXPECT_FALSE(buffer.Add(kEndpointId, MakeChunk(1000), &ready));
+
+  // Late chunks of a payload given up on are passed on.
+  ready.clear();
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(4), &ready));
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({4}));
+}
+
+TEST(ChunkReorderBufferTest, RemoveEndpointForgetsHeldChunks) {
+  ChunkReorderBuffer buffer;
+  std::vector<PayloadTransferFrame> ready;
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(8), &ready));
+  ready.clear();
+
+  buffer.RemoveEndpoint(kEndpointId);
+  EXPECT_TRUE(buffer.Add(kEndpointId, MakeChunk(0), &ready));
+  buffer.TakeReady(kEndpointId, kPayloadId, &ready);
+
+  EXPECT_EQ(Offsets(ready), std::vector<std::int64_t>({0}));
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
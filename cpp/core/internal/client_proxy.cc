@@ -212,55 +212,69 @@ void ClientProxy::OnEndpointFound(const std::string& service_id,
                                   const std::string& endpoint_id,
                                   const ByteArray& endpoint_info,
                                   proto::connections::Medium medium) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
 
-  NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Found]: [enter] id="
-                    << endpoint_id << "; service=" << service_id << "; info="
-                    << absl::BytesToHexString(endpoint_info.data());
-  if (!IsDiscoveringServiceId(service_id)) {
-    NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Found]: Ignoring event for id="
-                      << endpoint_id
-                      << " because this client is not discovering.";
-    return;
-  }
+    NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Found]: [enter] id="
+                      << endpoint_id << "; service=" << service_id << "; info="
+                      << absl::BytesToHexString(endpoint_info.data());
+    if (!IsDiscoveringServiceId(service_id)) {
+      NEARBY_LOGS(INFO)
+          << "ClientProxy [Endpoint Found]: Ignoring event for id="
+          << endpoint_id << " because this client is not discovering.";
+      return;
+    }
 
-  if (discovered_endpoint_ids_.count(endpoint_id)) {
-    NEARBY_LOGS(WARNING)
-        << "ClientProxy [Endpoint Found]: Ignoring event for id=" << endpoint_id
-        << " because this client has already reported this endpoint as found.";
-    return;
-  }
+    if (discovered_endpoint_ids_.count(endpoint_id)) {
+      NEARBY_LOGS(WARNING)
+          << "ClientProxy [Endpoint Found]: Ignoring event for id="
+          << endpoint_id
+          << " because this client has already reported this endpoint as "
+             "found.";
+      return;
+    }
 
-  discovered_endpoint_ids_.insert(endpoint_id);
-  discovery_info_.listener.endpoint_found_cb(endpoint_id, endpoint_info,
-                                             service_id);
-  analytics_recorder_->OnEndpointFound(medium);
+    discovered_endpoint_ids_.insert(endpoint_id);
+    QueueCallback(endpoint_id,
+                  [callback = discovery_info_.listener.endpoint_found_cb,
+                   endpoint_id, endpoint_info, service_id]() {
+                    callback(endpoint_id, endpoint_info, service_id);
+                  });
+    analytics_recorder_->OnEndpointFound(medium);
+  }
+  RunCallbacks(endpoint_id);
 }
 
 void ClientProxy::OnEndpointLost(const std::string& service_id,
                                  const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
+
+    NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Lost]: [enter] id="
+                      << endpoint_id << "; service=" << service_id;
+    if (!IsDiscoveringServiceId(service_id)) {
+      NEARBY_LOG(INFO,
+                 "ClientProxy [Endpoint Lost]: Ignoring event for id=%s "
+                 "because this client is not discovering",
+                 endpoint_id.c_str());
+      return;
+    }
 
-  NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Lost]: [enter] id=" << endpoint_id
-                    << "; service=" << service_id;
-  if (!IsDiscoveringServiceId(service_id)) {
-    NEARBY_LOG(INFO,
-               "ClientProxy [Endpoint Lost]: Ignoring event for id=%s because "
-               "this client is not discovering",
-               endpoint_id.c_str());
-    return;
-  }
+    const auto it = discovered_endpoint_ids_.find(endpoint_id);
+    if (it == discovered_endpoint_ids_.end()) {
+      NEARBY_LOGS(WARNING)
+          << "ClientProxy [Endpoint Lost]: Ignoring event for id="
+          << endpoint_id
+          << " because this client has not yet reported this endpoint as found";
+      return;
+    }
 
-  const auto it = discovered_endpoint_ids_.find(endpoint_id);
-  if (it == discovered_endpoint_ids_.end()) {
-    NEARBY_LOGS(WARNING)
-        << "ClientProxy [Endpoint Lost]: Ignoring event for id=" << endpoint_id
-        << " because this client has not yet reported this endpoint as found";
-    return;
+    discovered_endpoint_ids_.erase(it);
+    QueueCallback(endpoint_id,
+                  [callback = discovery_info_.listener.endpoint_lost_cb,
+                   endpoint_id]() { callback(endpoint_id); });
   }
-
-  discovered_endpoint_ids_.erase(it);
-  discovery_info_.listener.endpoint_lost_cb(endpoint_id);
+  RunCallbacks(endpoint_id);
 }
 
 void ClientProxy::OnConnectionInitiated(const std::string& endpoint_id,
@@ -268,8 +282,18 @@ void ClientProxy::OnConnectionInitiated(const std::string& endpoint_id,
                                         const ConnectionOptions& options,
                                         const ConnectionListener& listener,
                                         const std::string& connection_token) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
+    OnConnectionInitiatedLocked(endpoint_id, info, options, listener,
+                                connection_token);
+  }
+  RunCallbacks(endpoint_id);
+}
 
+void ClientProxy::OnConnectionInitiatedLocked(
+    const std::string& endpoint_id, const ConnectionResponseInfo& info,
+    const ConnectionOptions& options, const ConnectionListener& listener,
+    const std::string& connection_token) {
   // Whether this is incoming or outgoing, the local and remote endpoints both
   // still need to accept this connection, so set its establishment status to
   // PENDING.
@@ -294,7 +318,9 @@ void ClientProxy::OnConnectionInitiated(const std::string& endpoint_id,
   //
   // Note: we allow devices to connect to an advertiser even after it stops
   // advertising, so no need to check IsAdvertising() here.
-  item.connection_listener.initiated_cb(endpoint_id, info);
+  QueueCallback(endpoint_id,
+                [callback = item.connection_listener.initiated_cb, endpoint_id,
+                 info]() { callback(endpoint_id, info); });
 
   if (info.is_incoming_connection) {
     // Add CancellationFlag for advertisers once encryption succeeds.
@@ -306,61 +332,87 @@ void ClientProxy::OnConnectionInitiated(const std::string& endpoint_id,
 }
 
 void ClientProxy::OnConnectionAccepted(const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
-
-  if (!HasPendingConnectionToEndpoint(endpoint_id)) {
-    NEARBY_LOGS(INFO) << "ClientProxy [Connection Accepted]: no pending "
-                         "connection; endpoint_id="
-                      << endpoint_id;
-    return;
-  }
+  {
+    MutexLock lock(&mutex_);
+
+    if (!HasPendingConnectionToEndpoint(endpoint_id)) {
+      NEARBY_LOGS(INFO) << "ClientProxy [Connection Accepted]: no pending "
+                           "connection; endpoint_id="
+                        << endpoint_id;
+      return;
+    }
 
-  // Notify the client.
-  Connection* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->connection_listener.accepted_cb(endpoint_id);
-    item->status = Connection::kConnected;
+    // Notify the client.
+    Connection* item = LookupConnection(endpoint_id);
+    if (item != nullptr) {
+      QueueCallback(endpoint_id,
+                    [callback = item->connection_listener.accepted_cb,
+                     endpoint_id]() { callback(endpoint_id); });
+      item->status = Connection::kConnected;
+    }
   }
+  RunCallbacks(endpoint_id);
 }
 
 void ClientProxy::OnConnectionRejected(const std::string& endpoint_id,
                                        const Status& status) {
-  MutexLock lock(&mutex_);
-
-  if (!HasPendingConnectionToEndpoint(endpoint_id)) {
-    NEARBY_LOGS(INFO) << "ClientProxy [Connection Rejected]: no pending "
-                         "connection; endpoint_id="
-                      << endpoint_id;
-    return;
-  }
+  {
+    MutexLock lock(&mutex_);
+
+    if (!HasPendingConnectionToEndpoint(endpoint_id)) {
+      NEARBY_LOGS(INFO) << "ClientProxy [Connection Rejected]: no pending "
+                           "connection; endpoint_id="
+                        << endpoint_id;
+      return;
+    }
 
-  // Notify the client.
-  const Connection* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->connection_listener.rejected_cb(endpoint_id, status);
-    OnDisconnected(endpoint_id, false /* notify */);
+    // Notify the client.
+    const Connection* item = LookupConnection(endpoint_id);
+    if (item != nullptr) {
+      QueueCallback(endpoint_id,
+                    [callback = item->connection_listener.rejected_cb,
+                     endpoint_id, status]() { callback(endpoint_id, status); });
+      OnDisconnectedLocked(endpoint_id, false /* notify */);
+    }
   }
+  RunCallbacks(endpoint_id);
 }
 
 void ClientProxy::OnBandwidthChanged(const std::string& endpoint_id,
                                      Medium new_medium) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
 
-  const Connection* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->connection_listener.bandwidth_changed_cb(endpoint_id, new_medium);
-    NEARBY_LOGS(INFO) << "ClientProxy [reporting onBandwidthChanged]: client="
-                      << GetClientId() << "; endpoint_id=" << endpoint_id;
+    const Connection* item = LookupConnection(endpoint_id);
+    if (item != nullptr) {
+      QueueCallback(endpoint_id,
+                    [callback = item->connection_listener.bandwidth_changed_cb,
+                     endpoint_id, new_medium]() {
+                      callback(endpoint_id, new_medium);
+                    });
+      NEARBY_LOGS(INFO) << "ClientProxy [reporting onBandwidthChanged]: client="
+                        << GetClientId() << "; endpoint_id=" << endpoint_id;
+    }
   }
+  RunCallbacks(endpoint_id);
 }
 
 void ClientProxy::OnDisconnected(const std::string& endpoint_id, bool notify) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
+    OnDisconnectedLocked(endpoint_id, notify);
+  }
+  RunCallbacks(endpoint_id);
+}
 
+void ClientProxy::OnDisconnectedLocked(const std::string& endpoint_id,
+                                       bool notify) {
   const Connection* item = LookupConnection(endpoint_id);
   if (item != nullptr) {
     if (notify) {
-      item->connection_listener.disconnected_cb({endpoint_id});
+      QueueCallback(endpoint_id,
+                    [callback = item->connection_listener.disconnected_cb,
+                     endpoint_id]() { callback(endpoint_id); });
     }
     connections_.erase(endpoint_id);
     ResetLocalEndpointIdIfNeeded();
@@ -604,17 +656,25 @@ void ClientProxy::CancelAllEndpoints() {
 }
 
 void ClientProxy::OnPayload(const std::string& endpoint_id, Payload payload) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
 
-  if (IsConnectedToEndpoint(endpoint_id)) {
-    const Connection* item = LookupConnection(endpoint_id);
-    if (item != nullptr) {
-      NEARBY_LOGS(INFO) << "ClientProxy [reporting onPayloadReceived]: client="
-                        << GetClientId() << "; endpoint_id=" << endpoint_id
-                        << " ; payload_id=" << payload.GetId();
-      item->payload_listener.payload_cb(endpoint_id, std::move(payload));
+    if (IsConnectedToEndpoint(endpoint_id)) {
+      const Connection* item = LookupConnection(endpoint_id);
+      if (item != nullptr) {
+        NEARBY_LOGS(INFO)
+            << "ClientProxy [reporting onPayloadReceived]: client="
+            << GetClientId() << "; endpoint_id=" << endpoint_id
+            << " ; payload_id=" << payload.GetId();
+        QueueCallback(endpoint_id,
+                      [callback = item->payload_listener.payload_cb,
+                       endpoint_id, payload = std::move(payload)]() mutable {
+                        callback(endpoint_id, std::move(payload));
+                      });
+      }
     }
   }
+  RunCallbacks(endpoint_id);
 }
 
 const ClientProxy::Connection* ClientProxy::LookupConnection(
@@ -631,27 +691,61 @@ ClientProxy::Connection* ClientProxy::LookupConnection(
 
 void ClientProxy::OnPayloadProgress(const std::string& endpoint_id,
                                     const PayloadProgressInfo& info) {
-  MutexLock lock(&mutex_);
+  {
+    MutexLock lock(&mutex_);
+
+    if (IsConnectedToEndpoint(endpoint_id)) {
+      Connection* item = LookupConnection(endpoint_id);
+      if (item != nullptr) {
+        QueueCallback(endpoint_id,
+                      [callback = item->payload_listener.payload_progress_cb,
+                       endpoint_id, info]() { callback(endpoint_id, info); });
+
+        if (info.status == PayloadProgressInfo::Status::kInProgress) {
+          NEARBY_LOGS(VERBOSE)
+              << "ClientProxy [reporting onPayloadProgress]: client="
+              << GetClientId() << "; endpoint_id=" << endpoint_id
+              << "; payload_id=" << info.payload_id
+              << ", payload_status=" << ToString(info.status);
+        } else {
+          NEARBY_LOGS(INFO)
+              << "ClientProxy [reporting onPayloadProgress]: client="
+              << GetClientId() << "; endpoint_id=" << endpoint_id
+              << "; payload_id=" << info.payload_id
+              << ", payload_status=" << ToString(info.status);
+        }
+      }
+    }
+  }
+  RunCallbacks(endpoint_id);
+}
 
-  if (IsConnectedToEndpoint(endpoint_id)) {
-    Connection* item = LookupConnection(endpoint_id);
-    if (item != nullptr) {
-      item->payload_listener.payload_progress_cb(endpoint_id, info);
+void ClientProxy::QueueCallback(const std::string& endpoint_id,
+                                Task callback) {
+  MutexLock lock(&callbacks_mutex_);
+  callbacks_[endpoint_id].callbacks.push_back(std::move(callback));
+}
 
-      if (info.status == PayloadProgressInfo::Status::kInProgress) {
-        NEARBY_LOGS(VERBOSE)
-            << "ClientProxy [reporting onPayloadProgress]: client="
-            << GetClientId() << "; endpoint_id=" << endpoint_id
-            << "; payload_id=" << info.payload_id
-            << ", payload_status=" << ToString(info.status);
-      } else {
-        NEARBY_LOGS(INFO)
-            << "ClientProxy [reporting onPayloadProgress]: client="
-            << GetClientId() << "; endpoint_id=" << endpoint_id
-            << "; payload_id=" << info.payload_id
-            << ", payload_status=" << ToString(info.status);
+void ClientProxy::RunCallbacks(const std::string& endpoint_id) {
+  {
+    MutexLock lock(&callbacks_mutex_);
+    auto item = callbacks_.find(endpoint_id);
+    if (item == callbacks_.end() || item->second.running) return;
+    item->second.running = true;
+  }
+  while (true) {
+    Task callback;
+    {
+      MutexLock lock(&callbacks_mutex_);
+      PendingCallbacks& pending = callbacks_[endpoint_id];
+      if (pending.callbacks.empty()) {
+        callbacks_.erase(endpoint_id);
+        return;
       }
+      callback = std::move(pending.callbacks.front());
+      pending.callbacks.pop_front();
     }
+    callback();
   }
 }
 
@@ -16,6 +16,7 @@
 #define CORE_INTERNAL_CLIENT_PROXY_H_
 
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <string>
 #include <vector>
@@ -29,6 +30,7 @@
 #include "platform/base/cancellation_flag.h"
 #include "platform/base/error_code_recorder.h"
 #include "platform/base/prng.h"
+#include "platform/base/task.h"
 #include "platform/public/cancelable_alarm.h"
 #include "platform/public/mutex.h"
 // Prefer using absl:: versions of a set and a map; they tend to be more
@@ -43,6 +45,12 @@ namespace connections {
 
 // ClientProxy is tracking state of client's connection, and serves as
 // a proxy for notifications sent to this client.
+//
+// Notifications are never delivered while the client state is locked: they are
+// queued per endpoint while the state is updated, and run once the lock is
+// released, in the order they were queued. A slow client callback only delays
+// later callbacks of the same endpoint, and callbacks may call back into
+// ClientProxy.
 class ClientProxy final {
  public:
   static constexpr int kEndpointIdLength = 4;
@@ -232,8 +240,30 @@ class ClientProxy final {
     bool IsEmpty() const { return service_id.empty(); }
   };
 
+  // Callbacks queued for an endpoint, and whether some thread is running them.
+  struct PendingCallbacks {
+    std::deque<Task> callbacks;
+    bool running = false;
+  };
+
   void RemoveAllEndpoints();
   void ResetLocalEndpointIdIfNeeded();
+  // OnConnectionInitiated() minus running the callbacks it queues.
+  void OnConnectionInitiatedLocked(const std::string& endpoint_id,
+                                   const ConnectionResponseInfo& info,
+                                   const ConnectionOptions& options,
+                                   const ConnectionListener& listener,
+                                   const std::string& connection_token);
+  // Removes the endpoint, and queues disconnected_cb() if notify is true.
+  // Caller must hold mutex_.
+  void OnDisconnectedLocked(const std::string& endpoint_id, bool notify);
+  // Queues a client callback for endpoint_id. Called with mutex_ held, so that
+  // callbacks are queued in the same order as the state changes they report.
+  void QueueCallback(const std::string& endpoint_id, Task callback);
+  // Runs the callbacks queued for endpoint_id, unless another thread is
+  // already running them; that thread will then pick up the new ones too.
+  // Must be called without holding mutex_.
+  void RunCallbacks(const std::string& endpoint_id);
   bool ConnectionStatusesContains(const std::string& endpoint_id,
                                   Connection::Status status_to_match) const;
   void AppendConnectionStatus(const std::string& endpoint_id,
@@ -253,6 +283,9 @@ class ClientProxy final {
   std::string ToString(PayloadProgressInfo::Status status) const;
 
   mutable RecursiveMutex mutex_;
+  // Guards callbacks_; never held while a callback runs.
+  Mutex callbacks_mutex_;
+  absl::flat_hash_map<std::string, PendingCallbacks> callbacks_;
   Prng prng_;
   std::int64_t client_id_;
   std::string local_endpoint_id_;
@@ -270,7 +303,7 @@ class ClientProxy final {
   // endpoint id cached here in previous high visibility mode advertisement
   // expires.
   std::string local_high_vis_mode_cache_endpoint_id_;
-  ScheduledExecutor single_thread_executor_;
+  ScheduledExecutor single_thread_executor_{"client-proxy"};
   CancelableAlarm clear_local_high_vis_mode_cache_endpoint_id_alarm_;
 
   // If not empty, we are currently advertising and accepting connection
@@ -15,6 +15,8 @@
 #include "core/internal/client_proxy.h"
 
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -28,6 +30,7 @@
 #include "platform/base/byte_array.h"
 #include "platform/base/feature_flags.h"
 #include "platform/base/medium_environment.h"
+#include "platform/public/count_down_latch.h"
 
 namespace location {
 namespace nearby {
@@ -616,6 +619,67 @@ TEST_F(ClientProxyTest, EndpointIdRotateWhenLowVizAdvertisementWithLowPower) {
   EXPECT_NE(advertising_endpoint_1.id, advertising_endpoint_2.id);
 }
 
+TEST_F(ClientProxyTest, CallbacksRunWithoutHoldingTheLock) {
+  Endpoint advertising_endpoint =
+      StartAdvertising(&client1_, advertising_connection_listener_);
+  bool discovering = false;
+  DiscoveryListener discovery_listener{
+      .endpoint_found_cb =
+          [this, &discovering](const std::string& endpoint_id,
+                               const ByteArray& endpoint_info,
+                               const std::string& service_id) {
+            // Would deadlock if client2_ was locked during the callback.
+            std::thread reader(
+                [this, &discovering]() {
+                  discovering = client2_.IsDiscovering();
+                });
+            reader.join();
+          },
+  };
+  StartDiscovery(&client2_, discovery_listener);
+
+  client2_.OnEndpointFound(service_id_, advertising_endpoint.id,
+                           advertising_endpoint.info, medium_);
+
+  EXPECT_TRUE(discovering);
+}
+
+TEST_F(ClientProxyTest, CallbacksOfEndpointRunInOrderWithoutBlocking) {
+  Endpoint advertising_endpoint =
+      StartAdvertising(&client1_, advertising_connection_listener_);
+  StartDiscovery(&client2_, discovery_listener_);
+  OnDiscoveryEndpointFound(&client2_, advertising_endpoint);
+  OnDiscoveryConnectionInitiated(&client2_, advertising_endpoint);
+  CountDownLatch first_started(1);
+  CountDownLatch second_reported(1);
+  std::vector<std::int64_t> reported_ids;
+  payload_listener_.payload_progress_cb =
+      [&](const std::string& endpoint_id, const PayloadProgressInfo& info) {
+        if (info.payload_id == 1) {
+          first_started.CountDown();
+          second_reported.Await();
+        }
+        reported_ids.push_back(info.payload_id);
+      };
+  OnDiscoveryConnectionLocalAccepted(&client2_, advertising_endpoint);
+  OnDiscoveryConnectionRemoteAccepted(&client2_, advertising_endpoint);
+  OnDiscoveryConnectionAccepted(&client2_, advertising_endpoint);
+
+  std::thread first([&]() {
+    client2_.OnPayloadProgress(advertising_endpoint.id, {.payload_id = 1});
+  });
+  first_started.Await();
+  // Returns while the first callback is still running; the thread running it
+  // delivers this update afterwards.
+  client2_.OnPayloadProgress(advertising_endpoint.id, {.payload_id = 2});
+  EXPECT_TRUE(reported_ids.empty());
+  EXPECT_TRUE(client2_.IsConnectedToEndpoint(advertising_endpoint.id));
+  second_reported.CountDown();
+  first.join();
+
+  EXPECT_EQ(reported_ids, (std::vector<std::int64_t>{1, 2}));
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
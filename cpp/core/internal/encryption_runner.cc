@@ -14,19 +14,34 @@
 
 #include "core/internal/encryption_runner.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "securegcm/d2d_connection_context_v1.h"
 #include "securegcm/ukey2_handshake.h"
+#include "securemessage/crypto_ops.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "core/internal/mediums/utils.h"
 #include "platform/base/base64_utils.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
+#include "platform/base/feature_flags.h"
 #include "platform/public/cancelable_alarm.h"
 #include "platform/public/logging.h"
+#include "platform/public/metrics.h"
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
 
 namespace location {
 namespace nearby {
@@ -39,6 +54,41 @@ constexpr std::int32_t kTokenLength = 5;
 constexpr securegcm::UKey2Handshake::HandshakeCipher kCipher =
     securegcm::UKey2Handshake::HandshakeCipher::P256_SHA512;
 
+// A client that holds a SessionTicketCache ticket for the endpoint sends a
+// resumption request in place of UKEY2 Message 1:
+//
+//   kResumptionMagic | kResumptionRequest | ticket id | nonce | proof
+//
+// and the server answers it in place of UKEY2 Message 2 with either
+//
+//   kResumptionMagic | kResumptionAccepted | nonce | proof
+//
+// after which both sides derive the keys of the session from the ticket secret
+// and the two nonces, or with
+//
+//   kResumptionMagic | kResumptionRejected
+//
+// after which the client runs UKEY2 as usual. Every field is
+// kResumptionFieldLength long. No UKEY2 message starts with kResumptionMagic,
+// since 0xff isn't a valid protobuf tag.
+constexpr absl::string_view kResumptionMagic = "\xffRESUME";
+constexpr char kResumptionRequest = 1;
+constexpr char kResumptionAccepted = 2;
+constexpr char kResumptionRejected = 3;
+constexpr std::size_t kResumptionFieldLength = 32;
+
+using TimingsCallback =
+    std::function<void(absl::Duration queue_time, absl::Duration crypto_time)>;
+
+// Runs |fn|, and adds the time it took to |total|.
+template <typename F>
+auto Timed(absl::Duration* total, F fn) -> decltype(fn()) {
+  absl::Time start = SystemClock::ElapsedRealtime();
+  auto result = fn();
+  *total += SystemClock::ElapsedRealtime() - start;
+  return result;
+}
+
 // Transforms a raw UKEY2 token (which is a random ByteArray that's
 // kMaxUkey2VerificationStringLength long) into a kTokenLength string that only
 // uses [A-Z], [0-9], '_', '-' for each character.
@@ -48,6 +98,98 @@ std::string ToHumanReadableString(const ByteArray& token) {
   return result;
 }
 
+bool IsResumptionMessage(const ByteArray& message) {
+  return absl::StartsWith(absl::string_view(message.data(), message.size()),
+                          kResumptionMagic);
+}
+
+ByteArray ForResumptionMessage(char type,
+                               std::initializer_list<ByteArray> fields) {
+  std::string message = absl::StrCat(kResumptionMagic, std::string(1, type));
+  for (const ByteArray& field : fields) {
+    absl::StrAppend(&message, std::string(field));
+  }
+  return ByteArray(std::move(message));
+}
+
+// Returns false if the message is not a resumption message of the given type
+// with the given number of fields.
+bool ParseResumptionMessage(const ByteArray& message, char type,
+                            int field_count, std::vector<ByteArray>* fields) {
+  std::string data(message);
+  std::size_t header_length = kResumptionMagic.size() + 1;
+  if (!IsResumptionMessage(message) ||
+      data.size() != header_length + field_count * kResumptionFieldLength ||
+      data[kResumptionMagic.size()] != type) {
+    return false;
+  }
+  fields->clear();
+  for (int i = 0; i < field_count; ++i) {
+    fields->emplace_back(
+        data.substr(header_length + i * kResumptionFieldLength,
+                    kResumptionFieldLength));
+  }
+  return true;
+}
+
+// Derives kResumptionFieldLength bytes for the given purpose from a secret
+// with HKDF. Returns an empty ByteArray on error.
+ByteArray DeriveFromSecret(const ByteArray& secret, absl::string_view label,
+                           const ByteArray& salt = ByteArray()) {
+  std::unique_ptr<std::string> derived = securemessage::CryptoOps::Hkdf(
+      std::string(secret), std::string(salt), std::string(label));
+  if (derived == nullptr || derived->size() != kResumptionFieldLength) {
+    return {};
+  }
+  return ByteArray(std::move(*derived));
+}
+
+// Returns true if |proof| is the one derived from |secret| for |label| and
+// |salt|. The comparison takes the same time wherever the proofs differ.
+bool VerifyProof(const ByteArray& proof, const ByteArray& secret,
+                 absl::string_view label, const ByteArray& salt) {
+  ByteArray expected = DeriveFromSecret(secret, label, salt);
+  if (expected.Empty() || proof.size() != expected.size()) return false;
+  unsigned char difference = 0;
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    difference |= static_cast<unsigned char>(proof.data()[i]) ^
+                  static_cast<unsigned char>(expected.data()[i]);
+  }
+  return difference == 0;
+}
+
+std::unique_ptr<EndpointChannel::EncryptionContext> ForResumedSession(
+    const ByteArray& secret, const ByteArray& salt, bool is_client) {
+  ByteArray client_key = DeriveFromSecret(secret, "client key", salt);
+  ByteArray server_key = DeriveFromSecret(secret, "server key", salt);
+  if (client_key.Empty() || server_key.Empty()) return nullptr;
+  securemessage::CryptoOps::SecretKey encode_key(
+      std::string(is_client ? client_key : server_key),
+      securemessage::CryptoOps::AES_256_KEY);
+  securemessage::CryptoOps::SecretKey decode_key(
+      std::string(is_client ? server_key : client_key),
+      securemessage::CryptoOps::AES_256_KEY);
+  return std::make_unique<securegcm::D2DConnectionContextV1>(
+      encode_key, decode_key, /*encode_sequence_number=*/0,
+      /*decode_sequence_number=*/0);
+}
+
+// Returns false if the keys of the session could not be derived.
+bool HandleResumptionSuccess(const std::string& endpoint_id,
+                             const ByteArray& secret, const ByteArray& salt,
+                             bool is_client,
+                             const EncryptionRunner::ResultListener& listener) {
+  ByteArray raw_authentication_token =
+      DeriveFromSecret(secret, "auth token", salt);
+  std::unique_ptr<EndpointChannel::EncryptionContext> context =
+      ForResumedSession(secret, salt, is_client);
+  if (raw_authentication_token.Empty() || context == nullptr) return false;
+  listener.on_resumed_cb(endpoint_id, std::move(context),
+                         ToHumanReadableString(raw_authentication_token),
+                         raw_authentication_token);
+  return true;
+}
+
 bool HandleEncryptionSuccess(const std::string& endpoint_id,
                              std::unique_ptr<securegcm::UKey2Handshake> ukey2,
                              const EncryptionRunner::ResultListener& listener) {
@@ -79,22 +221,29 @@ void CancelableAlarmRunnable(ClientProxy* client,
 class ServerRunnable final {
  public:
   ServerRunnable(ClientProxy* client, ScheduledExecutor* alarm_executor,
-                 const std::string& endpoint_id, EndpointChannel* channel,
-                 EncryptionRunner::ResultListener&& listener)
+                 SessionTicketCache* tickets, const std::string& endpoint_id,
+                 EndpointChannel* channel,
+                 EncryptionRunner::ResultListener&& listener,
+                 TimingsCallback timings_cb)
       : client_(client),
         alarm_executor_(alarm_executor),
+        tickets_(tickets),
         endpoint_id_(endpoint_id),
         channel_(channel),
-        listener_(std::move(listener)) {}
+        listener_(std::move(listener)),
+        timings_cb_(std::move(timings_cb)),
+        enqueue_time_(SystemClock::ElapsedRealtime()) {}
 
   void operator()() const {
+    queue_time_ = SystemClock::ElapsedRealtime() - enqueue_time_;
     CancelableAlarm timeout_alarm(
         "EncryptionRunner.StartServer() timeout",
         [this]() { CancelableAlarmRunnable(client_, endpoint_id_, channel_); },
         kTimeout, alarm_executor_);
 
     std::unique_ptr<securegcm::UKey2Handshake> server =
-        securegcm::UKey2Handshake::ForResponder(kCipher);
+        Timed(&crypto_time_,
+              [] { return securegcm::UKey2Handshake::ForResponder(kCipher); });
     if (server == nullptr) {
       LogException();
       HandleHandshakeOrIoException(&timeout_alarm);
@@ -109,8 +258,23 @@ class ServerRunnable final {
       return;
     }
 
+    if (IsResumptionMessage(client_init.result())) {
+      if (Resume(client_init.result(), &timeout_alarm)) return;
+
+      // The client goes on with Message 1 once we've turned it down.
+      client_init = channel_->Read();
+      if (!client_init.ok()) {
+        LogException();
+        HandleHandshakeOrIoException(&timeout_alarm);
+        return;
+      }
+    }
+
     securegcm::UKey2Handshake::ParseResult parse_result =
-        server->ParseHandshakeMessage(std::string(client_init.result()));
+        Timed(&crypto_time_, [&] {
+          return server->ParseHandshakeMessage(
+              std::string(client_init.result()));
+        });
 
     // Java code throws a HandshakeException / AlertException.
     if (!parse_result.success) {
@@ -127,8 +291,8 @@ class ServerRunnable final {
         << endpoint_id_ << ").";
 
     // Message 2 (Server Init)
-    std::unique_ptr<std::string> server_init =
-        server->GetNextHandshakeMessage();
+    std::unique_ptr<std::string> server_init = Timed(
+        &crypto_time_, [&] { return server->GetNextHandshakeMessage(); });
 
     // Java code throws a HandshakeException.
     if (server_init == nullptr) {
@@ -158,8 +322,9 @@ class ServerRunnable final {
       return;
     }
 
-    parse_result =
-        server->ParseHandshakeMessage(std::string(client_finish.result()));
+    parse_result = Timed(&crypto_time_, [&] {
+      return server->ParseHandshakeMessage(std::string(client_finish.result()));
+    });
 
     // Java code throws an AlertException or a HandshakeException.
     if (!parse_result.success) {
@@ -176,6 +341,7 @@ class ServerRunnable final {
         << endpoint_id_ << ").";
 
     timeout_alarm.Cancel();
+    ReportTimings();
 
     if (!HandleEncryptionSuccess(endpoint_id_, std::move(server), listener_)) {
       LogException();
@@ -185,13 +351,81 @@ class ServerRunnable final {
   }
 
  private:
+  // Answers a resumption request. Returns true if that concluded the
+  // handshake, one way or another, and false if the client goes on with UKEY2.
+  bool Resume(const ByteArray& request, CancelableAlarm* timeout_alarm) const {
+    std::vector<ByteArray> fields;
+    SessionTicketCache::Ticket ticket;
+    if (!ParseResumptionMessage(request, kResumptionRequest, 3, &fields) ||
+        !tickets_->TakeById(fields[0], &ticket) ||
+        !Timed(&crypto_time_, [&] {
+          return VerifyProof(fields[2], ticket.secret, "client proof",
+                             fields[1]);
+        })) {
+      NEARBY_LOGS(INFO) << "In StartServer(), turning down session resumption "
+                        << "with endpoint(id=" << endpoint_id_ << ").";
+      if (!channel_->Write(ForResumptionMessage(kResumptionRejected, {}))
+               .Ok()) {
+        LogException();
+        HandleHandshakeOrIoException(timeout_alarm);
+        return true;
+      }
+      return false;
+    }
+
+    const ByteArray& client_nonce = fields[1];
+    ByteArray server_nonce =
+        Utils::GenerateRandomBytes(kResumptionFieldLength);
+    ByteArray salt{absl::StrCat(std::string(client_nonce),
+                                std::string(server_nonce))};
+    ByteArray server_proof = Timed(&crypto_time_, [&] {
+      return DeriveFromSecret(ticket.secret, "server proof", salt);
+    });
+    if (server_proof.Empty()) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+      return true;
+    }
+    if (!channel_
+             ->Write(ForResumptionMessage(kResumptionAccepted,
+                                          {server_nonce, server_proof}))
+             .Ok()) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+      return true;
+    }
+
+    NEARBY_LOGS(INFO) << "In StartServer(), resumed session with endpoint(id="
+                      << endpoint_id_ << ").";
+    timeout_alarm->Cancel();
+    ReportTimings();
+    if (!HandleResumptionSuccess(endpoint_id_, ticket.secret, salt,
+                                 /*is_client=*/false, listener_)) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+    }
+    return true;
+  }
+
   void LogException() const {
     NEARBY_LOGS(ERROR) << "In StartServer(), UKEY2 failed with endpoint(id="
                        << endpoint_id_ << ").";
   }
 
+  void ReportTimings() const {
+    if (timings_reported_) return;
+    timings_reported_ = true;
+    NEARBY_LOGS(INFO) << "In StartServer(), UKEY2 with endpoint(id="
+                      << endpoint_id_ << ") waited "
+                      << absl::FormatDuration(queue_time_) << " to start and "
+                      << "spent " << absl::FormatDuration(crypto_time_)
+                      << " on crypto.";
+    timings_cb_(queue_time_, crypto_time_);
+  }
+
   void HandleHandshakeOrIoException(CancelableAlarm* timeout_alarm) const {
     timeout_alarm->Cancel();
+    ReportTimings();
     listener_.on_failure_cb(endpoint_id_, channel_);
   }
 
@@ -209,30 +443,45 @@ class ServerRunnable final {
 
   ClientProxy* client_;
   ScheduledExecutor* alarm_executor_;
+  SessionTicketCache* tickets_;
   const std::string endpoint_id_;
   EndpointChannel* channel_;
   EncryptionRunner::ResultListener listener_;
+  TimingsCallback timings_cb_;
+  absl::Time enqueue_time_;
+  mutable absl::Duration queue_time_ = absl::ZeroDuration();
+  mutable absl::Duration crypto_time_ = absl::ZeroDuration();
+  mutable bool timings_reported_ = false;
 };
 
 class ClientRunnable final {
  public:
   ClientRunnable(ClientProxy* client, ScheduledExecutor* alarm_executor,
-                 const std::string& endpoint_id, EndpointChannel* channel,
-                 EncryptionRunner::ResultListener&& listener)
+                 SessionTicketCache* tickets, const std::string& endpoint_id,
+                 EndpointChannel* channel,
+                 EncryptionRunner::ResultListener&& listener,
+                 TimingsCallback timings_cb)
       : client_(client),
         alarm_executor_(alarm_executor),
+        tickets_(tickets),
         endpoint_id_(endpoint_id),
         channel_(channel),
-        listener_(std::move(listener)) {}
+        listener_(std::move(listener)),
+        timings_cb_(std::move(timings_cb)),
+        enqueue_time_(SystemClock::ElapsedRealtime()) {}
 
   void operator()() const {
+    queue_time_ = SystemClock::ElapsedRealtime() - enqueue_time_;
     CancelableAlarm timeout_alarm(
         "EncryptionRunner.StartClient() timeout",
         [this]() { CancelableAlarmRunnable(client_, endpoint_id_, channel_); },
         kTimeout, alarm_executor_);
 
+    if (Resume(&timeout_alarm)) return;
+
     std::unique_ptr<securegcm::UKey2Handshake> crypto =
-        securegcm::UKey2Handshake::ForInitiator(kCipher);
+        Timed(&crypto_time_,
+              [] { return securegcm::UKey2Handshake::ForInitiator(kCipher); });
 
     // Java code throws a HandshakeException.
     if (crypto == nullptr) {
@@ -242,8 +491,8 @@ class ClientRunnable final {
     }
 
     // Message 1 (Client Init)
-    std::unique_ptr<std::string> client_init =
-        crypto->GetNextHandshakeMessage();
+    std::unique_ptr<std::string> client_init = Timed(
+        &crypto_time_, [&] { return crypto->GetNextHandshakeMessage(); });
 
     // Java code throws a HandshakeException.
     if (client_init == nullptr) {
@@ -273,7 +522,10 @@ class ClientRunnable final {
     }
 
     securegcm::UKey2Handshake::ParseResult parse_result =
-        crypto->ParseHandshakeMessage(std::string(server_init.result()));
+        Timed(&crypto_time_, [&] {
+          return crypto->ParseHandshakeMessage(
+              std::string(server_init.result()));
+        });
 
     // Java code throws an AlertException or a HandshakeException.
     if (!parse_result.success) {
@@ -290,8 +542,8 @@ class ClientRunnable final {
         << endpoint_id_ << ").";
 
     // Message 3 (Client Finish)
-    std::unique_ptr<std::string> client_finish =
-        crypto->GetNextHandshakeMessage();
+    std::unique_ptr<std::string> client_finish = Timed(
+        &crypto_time_, [&] { return crypto->GetNextHandshakeMessage(); });
 
     // Java code throws a HandshakeException.
     if (client_finish == nullptr) {
@@ -313,6 +565,7 @@ class ClientRunnable final {
         << endpoint_id_ << ").";
 
     timeout_alarm.Cancel();
+    ReportTimings();
 
     if (!HandleEncryptionSuccess(endpoint_id_, std::move(crypto), listener_)) {
       LogException();
@@ -322,13 +575,95 @@ class ClientRunnable final {
   }
 
  private:
+  // Resumes the last session with the endpoint, if we have a ticket for it.
+  // Returns true if that concluded the handshake, one way or another, and
+  // false if we should go on with UKEY2.
+  bool Resume(CancelableAlarm* timeout_alarm) const {
+    SessionTicketCache::Ticket ticket;
+    if (!FeatureFlags::GetInstance()
+             .GetFlags()
+             .enable_ukey2_session_resumption ||
+        !tickets_->TakeForEndpoint(endpoint_id_, &ticket)) {
+      return false;
+    }
+
+    ByteArray client_nonce =
+        Utils::GenerateRandomBytes(kResumptionFieldLength);
+    ByteArray client_proof = Timed(&crypto_time_, [&] {
+      return DeriveFromSecret(ticket.secret, "client proof", client_nonce);
+    });
+    if (client_proof.Empty()) return false;
+    if (!channel_
+             ->Write(ForResumptionMessage(kResumptionRequest,
+                                          {ticket.id, client_nonce,
+                                           client_proof}))
+             .Ok()) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+      return true;
+    }
+
+    ExceptionOr<ByteArray> response = channel_->Read();
+    if (!response.ok()) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+      return true;
+    }
+    std::vector<ByteArray> fields;
+    if (ParseResumptionMessage(response.result(), kResumptionRejected, 0,
+                               &fields)) {
+      NEARBY_LOGS(INFO) << "In StartClient(), endpoint(id=" << endpoint_id_
+                        << ") turned down session resumption, running UKEY2.";
+      return false;
+    }
+    if (!ParseResumptionMessage(response.result(), kResumptionAccepted, 2,
+                                &fields)) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+      return true;
+    }
+    const ByteArray& server_nonce = fields[0];
+    ByteArray salt{absl::StrCat(std::string(client_nonce),
+                                std::string(server_nonce))};
+    if (!Timed(&crypto_time_, [&] {
+          return VerifyProof(fields[1], ticket.secret, "server proof", salt);
+        })) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+      return true;
+    }
+
+    NEARBY_LOGS(INFO) << "In StartClient(), resumed session with endpoint(id="
+                      << endpoint_id_ << ").";
+    timeout_alarm->Cancel();
+    ReportTimings();
+    if (!HandleResumptionSuccess(endpoint_id_, ticket.secret, salt,
+                                 /*is_client=*/true, listener_)) {
+      LogException();
+      HandleHandshakeOrIoException(timeout_alarm);
+    }
+    return true;
+  }
+
   void LogException() const {
     NEARBY_LOGS(ERROR) << "In StartClient(), UKEY2 failed with endpoint(id="
                        << endpoint_id_ << ").";
   }
 
+  void ReportTimings() const {
+    if (timings_reported_) return;
+    timings_reported_ = true;
+    NEARBY_LOGS(INFO) << "In StartClient(), UKEY2 with endpoint(id="
+                      << endpoint_id_ << ") waited "
+                      << absl::FormatDuration(queue_time_) << " to start and "
+                      << "spent " << absl::FormatDuration(crypto_time_)
+                      << " on crypto.";
+    timings_cb_(queue_time_, crypto_time_);
+  }
+
   void HandleHandshakeOrIoException(CancelableAlarm* timeout_alarm) const {
     timeout_alarm->Cancel();
+    ReportTimings();
     listener_.on_failure_cb(endpoint_id_, channel_);
   }
 
@@ -346,17 +681,26 @@ class ClientRunnable final {
 
   ClientProxy* client_;
   ScheduledExecutor* alarm_executor_;
+  SessionTicketCache* tickets_;
   const std::string endpoint_id_;
   EndpointChannel* channel_;
   EncryptionRunner::ResultListener listener_;
+  TimingsCallback timings_cb_;
+  absl::Time enqueue_time_;
+  mutable absl::Duration queue_time_ = absl::ZeroDuration();
+  mutable absl::Duration crypto_time_ = absl::ZeroDuration();
+  mutable bool timings_reported_ = false;
 };
 
 }  // namespace
 
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr int EncryptionRunner::kMaxConcurrentHandshakes;
+
 EncryptionRunner::~EncryptionRunner() {
   // Stop all the ongoing Runnables (as gracefully as possible).
-  client_executor_.Shutdown();
-  server_executor_.Shutdown();
+  handshake_executor_.Shutdown();
   alarm_executor_.Shutdown();
 }
 
@@ -364,24 +708,79 @@ void EncryptionRunner::StartServer(
     ClientProxy* client, const std::string& endpoint_id,
     EndpointChannel* endpoint_channel,
     EncryptionRunner::ResultListener&& listener) {
-  server_executor_.Execute(
+  handshake_executor_.Execute(
       "encryption-server",
-      [runnable{ServerRunnable(client, &alarm_executor_, endpoint_id,
-                               endpoint_channel, std::move(listener))}]() {
-        runnable();
-      });
+      [runnable{ServerRunnable(client, &alarm_executor_, &tickets_,
+                               endpoint_id, endpoint_channel,
+                               std::move(listener),
+                               [this](absl::Duration queue_time,
+                                      absl::Duration crypto_time) {
+                                 RecordHandshake(queue_time, crypto_time);
+                               })}]() { runnable(); });
 }
 
 void EncryptionRunner::StartClient(
     ClientProxy* client, const std::string& endpoint_id,
     EndpointChannel* endpoint_channel,
     EncryptionRunner::ResultListener&& listener) {
-  client_executor_.Execute(
+  handshake_executor_.Execute(
       "encryption-client",
-      [runnable{ClientRunnable(client, &alarm_executor_, endpoint_id,
-                               endpoint_channel, std::move(listener))}]() {
-        runnable();
-      });
+      [runnable{ClientRunnable(client, &alarm_executor_, &tickets_,
+                               endpoint_id, endpoint_channel,
+                               std::move(listener),
+                               [this](absl::Duration queue_time,
+                                      absl::Duration crypto_time) {
+                                 RecordHandshake(queue_time, crypto_time);
+                               })}]() { runnable(); });
+}
+
+void EncryptionRunner::IssueResumptionTicket(
+    const std::string& endpoint_id,
+    EndpointChannel::EncryptionContext* context) {
+  if (!FeatureFlags::GetInstance().GetFlags().enable_ukey2_session_resumption) {
+    return;
+  }
+  std::unique_ptr<std::string> session_unique = context->GetSessionUnique();
+  if (session_unique == nullptr) return;
+  ByteArray unique(std::move(*session_unique));
+  ByteArray id = DeriveFromSecret(unique, "ticket id");
+  ByteArray secret = DeriveFromSecret(unique, "ticket secret");
+  if (id.Empty() || secret.Empty()) return;
+  tickets_.Add(endpoint_id, id, secret);
+}
+
+void EncryptionRunner::InvalidateResumptionTicket(
+    const std::string& endpoint_id) {
+  tickets_.Invalidate(endpoint_id);
+}
+
+void EncryptionRunner::InvalidateAllResumptionTickets() {
+  tickets_.InvalidateAll();
+}
+
+EncryptionRunner::HandshakeStats EncryptionRunner::GetHandshakeStats() const {
+  MutexLock lock(&stats_mutex_);
+  return stats_;
+}
+
+void EncryptionRunner::RecordHandshake(absl::Duration queue_time,
+                                       absl::Duration crypto_time) {
+  static Histogram* queue_time_histogram =
+      MetricsRegistry::GetInstance().GetHistogram(
+          "nearby_ukey2_handshake_queue_micros",
+          "Time a UKEY2 handshake waited for a thread, in microseconds.");
+  static Histogram* crypto_time_histogram =
+      MetricsRegistry::GetInstance().GetHistogram(
+          "nearby_ukey2_handshake_crypto_micros",
+          "Time spent on UKEY2 handshake crypto, in microseconds.");
+  queue_time_histogram->Record(queue_time);
+  crypto_time_histogram->Record(crypto_time);
+
+  MutexLock lock(&stats_mutex_);
+  stats_.handshakes++;
+  stats_.total_queue_time += queue_time;
+  stats_.max_queue_time = std::max(stats_.max_queue_time, queue_time);
+  stats_.total_crypto_time += crypto_time;
 }
 
 }  // namespace connections
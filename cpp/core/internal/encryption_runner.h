@@ -15,15 +15,20 @@
 #ifndef CORE_INTERNAL_ENCRYPTION_RUNNER_H_
 #define CORE_INTERNAL_ENCRYPTION_RUNNER_H_
 
+#include <cstdint>
 #include <string>
 
 #include "securegcm/ukey2_handshake.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
 #include "core/internal/client_proxy.h"
 #include "core/internal/endpoint_channel.h"
+#include "core/internal/session_ticket_cache.h"
 #include "core/listeners.h"
 #include "platform/base/byte_array.h"
+#include "platform/public/multi_thread_executor.h"
+#include "platform/public/mutex.h"
 #include "platform/public/scheduled_executor.h"
-#include "platform/public/single_thread_executor.h"
 
 namespace location {
 namespace nearby {
@@ -34,8 +39,32 @@ namespace connections {
 // NOTE: Stalled EndpointChannels will be disconnected after kTimeout.
 // This is to prevent unverified endpoints from maintaining an
 // indefinite connection to us.
+//
+// Up to kMaxConcurrentHandshakes handshakes run at once, so that a burst of
+// incoming connections doesn't line up behind one another's round trips. The
+// kTimeout of a handshake only starts once it gets a thread of its own.
+//
+// If enable_ukey2_session_resumption is set, the secret of each accepted
+// session with an endpoint that can resume it too is kept as a
+// SessionTicketCache ticket, and the next StartClient() with the same endpoint
+// derives new keys from it in one round trip instead of running UKEY2. A
+// server that doesn't hold the ticket turns resumption down, and the client
+// falls back to UKEY2 on the same channel. Keys and proofs are derived from
+// the ticket secret with HKDF.
 class EncryptionRunner {
  public:
+  static constexpr int kMaxConcurrentHandshakes = 16;
+
+  // Where the time of finished handshakes went. Queue time is spent waiting
+  // for a thread, crypto time is spent in UKEY2 itself; the rest of a
+  // handshake is spent waiting on the remote endpoint.
+  struct HandshakeStats {
+    std::int64_t handshakes = 0;
+    absl::Duration total_queue_time = absl::ZeroDuration();
+    absl::Duration max_queue_time = absl::ZeroDuration();
+    absl::Duration total_crypto_time = absl::ZeroDuration();
+  };
+
   EncryptionRunner() = default;
   ~EncryptionRunner();
 
@@ -62,6 +91,19 @@ class EncryptionRunner {
     std::function<void(const std::string& endpoint_id,
                        EndpointChannel* channel)>
         on_failure_cb = DefaultCallback<const std::string&, EndpointChannel*>();
+
+    // A previous session was resumed instead of running UKEY2; |context| is
+    // ready to use.
+    //
+    // @EncryptionRunnerThread
+    std::function<void(
+        const std::string& endpoint_id,
+        std::unique_ptr<EndpointChannel::EncryptionContext> context,
+        const std::string& auth_token, const ByteArray& raw_auth_token)>
+        on_resumed_cb = DefaultCallback<
+            const std::string&,
+            std::unique_ptr<EndpointChannel::EncryptionContext>,
+            const std::string&, const ByteArray&>();
   };
 
   // @AnyThread
@@ -73,10 +115,32 @@ class EncryptionRunner {
                    EndpointChannel* endpoint_channel,
                    ResultListener&& result_listener);
 
+  // Remembers the secret of an accepted session, so that the next connection
+  // with the endpoint can resume it. Only to be called once both devices told
+  // each other they can resume sessions, since the client of the next
+  // connection asks to resume it before the server has said anything.
+  // @AnyThread
+  void IssueResumptionTicket(const std::string& endpoint_id,
+                             EndpointChannel::EncryptionContext* context);
+  // Makes the next connection with the endpoint run UKEY2.
+  // @AnyThread
+  void InvalidateResumptionTicket(const std::string& endpoint_id);
+  // @AnyThread
+  void InvalidateAllResumptionTickets();
+
+  // @AnyThread
+  HandshakeStats GetHandshakeStats() const ABSL_LOCKS_EXCLUDED(stats_mutex_);
+
  private:
-  ScheduledExecutor alarm_executor_;
-  SingleThreadExecutor server_executor_;
-  SingleThreadExecutor client_executor_;
+  void RecordHandshake(absl::Duration queue_time, absl::Duration crypto_time)
+      ABSL_LOCKS_EXCLUDED(stats_mutex_);
+
+  ScheduledExecutor alarm_executor_{"encryption-alarms"};
+  MultiThreadExecutor handshake_executor_{"encryption-handshakes",
+                                          kMaxConcurrentHandshakes};
+  SessionTicketCache tickets_;
+  mutable Mutex stats_mutex_;
+  HandshakeStats stats_ ABSL_GUARDED_BY(stats_mutex_);
 };
 
 }  // namespace connections
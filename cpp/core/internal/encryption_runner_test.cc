@@ -20,6 +20,8 @@
 #include "core/internal/client_proxy.h"
 #include "core/internal/endpoint_channel.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/feature_flags.h"
+#include "platform/base/medium_environment.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/pipe.h"
 #include "platform/public/system_clock.h"
@@ -45,6 +47,7 @@ class FakeEndpointChannel : public EndpointChannel {
     write_timestamp_ = SystemClock::ElapsedRealtime();
     return out_ ? out_->Write(data) : Exception{Exception::kIo};
   }
+  Exception WriteLast(const ByteArray& data) override { return Write(data); }
   void Close() override {
     if (in_) in_->Close();
     if (out_) out_->Close();
@@ -71,6 +74,10 @@ class FakeEndpointChannel : public EndpointChannel {
   int GetMaxTransmitPacketSize() const override { return 512; }
   void EnableEncryption(std::shared_ptr<EncryptionContext> context) override {}
   void DisableEncryption() override {}
+  void EnableWriteEncryption(
+      std::shared_ptr<EncryptionContext> context) override {}
+  void EnableReadEncryption(
+      std::shared_ptr<EncryptionContext> context) override {}
   bool IsPaused() const override { return false; }
   void Pause() override {}
   void Resume() override {}
@@ -107,6 +114,129 @@ struct Response {
   Status client_status = Status::kUnknown;
 };
 
+// Outcome of one side of a handshake.
+struct Side {
+  // Set if the handshake ran UKEY2.
+  bool ran_ukey2 = false;
+  std::unique_ptr<EndpointChannel::EncryptionContext> context;
+  std::string auth_token;
+};
+
+EncryptionRunner::ResultListener ListenerFor(Side* side,
+                                             CountDownLatch* latch) {
+  return {
+      .on_success_cb =
+          [side, latch](const std::string& endpoint_id,
+                        std::unique_ptr<securegcm::UKey2Handshake> ukey2,
+                        const std::string& auth_token,
+                        const ByteArray& raw_auth_token) {
+            side->ran_ukey2 = true;
+            if (ukey2->VerifyHandshake()) {
+              side->context = ukey2->ToConnectionContext();
+            }
+            side->auth_token = auth_token;
+            latch->CountDown();
+          },
+      .on_failure_cb =
+          [latch](const std::string& endpoint_id, EndpointChannel* channel) {
+            latch->CountDown();
+          },
+      .on_resumed_cb =
+          [side, latch](
+              const std::string& endpoint_id,
+              std::unique_ptr<EndpointChannel::EncryptionContext> context,
+              const std::string& auth_token, const ByteArray& raw_auth_token) {
+            side->context = std::move(context);
+            side->auth_token = auth_token;
+            latch->CountDown();
+          },
+  };
+}
+
+// Runs a handshake between user_a as the server and user_b as the client.
+void RunHandshake(User* user_a, User* user_b, Side* server, Side* client) {
+  CountDownLatch latch(2);
+  user_a->crypto.StartServer(&user_a->client, "endpoint_b", &user_a->channel,
+                             ListenerFor(server, &latch));
+  user_b->crypto.StartClient(&user_b->client, "endpoint_a", &user_b->channel,
+                             ListenerFor(client, &latch));
+  EXPECT_TRUE(latch.Await(absl::Milliseconds(5000)).result());
+}
+
+// Checks that the two contexts talk to each other.
+void ExpectMatchingContexts(Side* server, Side* client) {
+  ASSERT_NE(server->context, nullptr);
+  ASSERT_NE(client->context, nullptr);
+  EXPECT_EQ(server->auth_token, client->auth_token);
+  std::unique_ptr<std::string> encoded =
+      client->context->EncodeMessageToPeer("hello");
+  ASSERT_NE(encoded, nullptr);
+  std::unique_ptr<std::string> decoded =
+      server->context->DecodeMessageFromPeer(*encoded);
+  ASSERT_NE(decoded, nullptr);
+  EXPECT_EQ(*decoded, "hello");
+}
+
+class EncryptionRunnerResumptionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FeatureFlags::Flags flags = FeatureFlags::GetInstance().GetFlags();
+    flags.enable_ukey2_session_resumption = true;
+    MediumEnvironment::Instance().SetFeatureFlags(flags);
+  }
+  void TearDown() override {
+    MediumEnvironment::Instance().SetFeatureFlags(FeatureFlags::Flags());
+  }
+
+  Pipe from_a_to_b_;
+  Pipe from_b_to_a_;
+  User user_a_{/*reader=*/&from_b_to_a_, /*writer=*/&from_a_to_b_};
+  User user_b_{/*reader=*/&from_a_to_b_, /*writer=*/&from_b_to_a_};
+};
+
+TEST_F(EncryptionRunnerResumptionTest, ResumesAcceptedSession) {
+  Side first_server;
+  Side first_client;
+  RunHandshake(&user_a_, &user_b_, &first_server, &first_client);
+  ASSERT_TRUE(first_server.ran_ukey2);
+  ASSERT_TRUE(first_client.ran_ukey2);
+  ExpectMatchingContexts(&first_server, &first_client);
+  user_a_.crypto.IssueResumptionTicket("endpoint_b",
+                                       first_server.context.get());
+  user_b_.crypto.IssueResumptionTicket("endpoint_a",
+                                       first_client.context.get());
+
+  Side server;
+  Side client;
+  RunHandshake(&user_a_, &user_b_, &server, &client);
+
+  EXPECT_FALSE(server.ran_ukey2);
+  EXPECT_FALSE(client.ran_ukey2);
+  ExpectMatchingContexts(&server, &client);
+  EXPECT_NE(server.auth_token, first_server.auth_token);
+}
+
+TEST_F(EncryptionRunnerResumptionTest, FallsBackToUkey2WithoutServerTicket) {
+  Side first_server;
+  Side first_client;
+  RunHandshake(&user_a_, &user_b_, &first_server, &first_client);
+  ASSERT_TRUE(first_server.ran_ukey2);
+  ASSERT_TRUE(first_client.ran_ukey2);
+  user_a_.crypto.IssueResumptionTicket("endpoint_b",
+                                       first_server.context.get());
+  user_b_.crypto.IssueResumptionTicket("endpoint_a",
+                                       first_client.context.get());
+  user_a_.crypto.InvalidateAllResumptionTickets();
+
+  Side server;
+  Side client;
+  RunHandshake(&user_a_, &user_b_, &server, &client);
+
+  EXPECT_TRUE(server.ran_ukey2);
+  EXPECT_TRUE(client.ran_ukey2);
+  ExpectMatchingContexts(&server, &client);
+}
+
 TEST(EncryptionRunnerTest, ConstructorDestructorWorks) { EncryptionRunner enc; }
 
 TEST(EncryptionRunnerTest, ReadWrite) {
@@ -157,6 +287,77 @@ TEST(EncryptionRunnerTest, ReadWrite) {
   EXPECT_EQ(response.client_status, Response::Status::kDone);
 }
 
+TEST(EncryptionRunnerTest, StalledHandshakeDoesNotHoldBackOthers) {
+  Pipe stalled_pipe;
+  Pipe unused_pipe;
+  Pipe from_a_to_b;
+  Pipe from_b_to_a;
+  User user_a(/*reader=*/&from_b_to_a, /*writer=*/&from_a_to_b);
+  User user_b(/*reader=*/&from_a_to_b, /*writer=*/&from_b_to_a);
+  // Nothing is ever written to this channel, so its handshake waits for
+  // kTimeout.
+  FakeEndpointChannel stalled_channel(&stalled_pipe.GetInputStream(),
+                                      &unused_pipe.GetOutputStream());
+  CountDownLatch stalled_latch(1);
+  Response response;
+
+  user_a.crypto.StartServer(
+      &user_a.client, "stalled_endpoint_id", &stalled_channel,
+      {
+          .on_failure_cb =
+              [&stalled_latch](const std::string& endpoint_id,
+                               EndpointChannel* channel) {
+                stalled_latch.CountDown();
+              },
+      });
+  user_a.crypto.StartServer(
+      &user_a.client, "endpoint_id", &user_a.channel,
+      {
+          .on_success_cb =
+              [&response](const std::string& endpoint_id,
+                          std::unique_ptr<securegcm::UKey2Handshake> ukey2,
+                          const std::string& auth_token,
+                          const ByteArray& raw_auth_token) {
+                response.server_status = Response::Status::kDone;
+                response.latch.CountDown();
+              },
+          .on_failure_cb =
+              [&response](const std::string& endpoint_id,
+                          EndpointChannel* channel) {
+                response.server_status = Response::Status::kFailed;
+                response.latch.CountDown();
+              },
+      });
+  user_b.crypto.StartClient(
+      &user_b.client, "endpoint_id", &user_b.channel,
+      {
+          .on_success_cb =
+              [&response](const std::string& endpoint_id,
+                          std::unique_ptr<securegcm::UKey2Handshake> ukey2,
+                          const std::string& auth_token,
+                          const ByteArray& raw_auth_token) {
+                response.client_status = Response::Status::kDone;
+                response.latch.CountDown();
+              },
+          .on_failure_cb =
+              [&response](const std::string& endpoint_id,
+                          EndpointChannel* channel) {
+                response.client_status = Response::Status::kFailed;
+                response.latch.CountDown();
+              },
+      });
+  EXPECT_TRUE(response.latch.Await(absl::Milliseconds(5000)).result());
+  EXPECT_EQ(response.server_status, Response::Status::kDone);
+  EXPECT_EQ(response.client_status, Response::Status::kDone);
+  EncryptionRunner::HandshakeStats stats = user_a.crypto.GetHandshakeStats();
+  EXPECT_EQ(stats.handshakes, 1);
+  EXPECT_GT(stats.total_crypto_time, absl::ZeroDuration());
+
+  stalled_channel.Close();
+  EXPECT_TRUE(stalled_latch.Await(absl::Milliseconds(5000)).result());
+  EXPECT_EQ(user_a.crypto.GetHandshakeStats().handshakes, 2);
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
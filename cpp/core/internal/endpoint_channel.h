@@ -41,6 +41,10 @@ class EndpointChannel {
 
   virtual Exception Write(const ByteArray& data) = 0;  // throws Exception::IO
 
+  // Writes |data| as the last frame with the current write keys: later writes
+  // throw Exception::IO until other write keys are enabled.
+  virtual Exception WriteLast(const ByteArray& data) = 0;
+
   // Closes this EndpointChannel, without tracking the closure in analytics.
   virtual void Close() = 0;
 
@@ -79,6 +83,14 @@ class EndpointChannel {
   // Disables encryption on the EndpointChannel.
   virtual void DisableEncryption() = 0;
 
+  // Switches only the writes, or only the reads, of the EndpointChannel to
+  // encryption with |context|. This lets each side move a channel over to new
+  // keys at the point of its own stream where that is safe.
+  virtual void EnableWriteEncryption(
+      std::shared_ptr<EncryptionContext> context) = 0;
+  virtual void EnableReadEncryption(
+      std::shared_ptr<EncryptionContext> context) = 0;
+
   // True if the EndpointChannel is currently pausing all writes.
   virtual bool IsPaused() const = 0;
 
@@ -26,6 +26,8 @@
 #include "platform/public/mutex_lock.h"
 #include "platform/public/system_clock.h"
 #include "proto/connections/offline_wire_formats.pb.h"
+#include "securegcm/d2d_connection_context_v1.h"
+#include "securemessage/crypto_ops.h"
 
 namespace location {
 namespace nearby {
@@ -33,12 +35,17 @@ namespace connections {
 
 namespace {
 const absl::Duration kDataTransferDelay = absl::Milliseconds(500);
-}
+
+// HKDF info of the stripe key used for messages from each side of the upgrade.
+constexpr char kStripeInitiatorKeyLabel[] = "stripe initiator key";
+constexpr char kStripeResponderKeyLabel[] = "stripe responder key";
+}  // namespace
 
 EndpointChannelManager::~EndpointChannelManager() {
   NEARBY_LOG(INFO, "Initiating shutdown of EndpointChannelManager.");
   MutexLock lock(&mutex_);
   channel_state_.DestroyAll();
+  BumpGenerationLocked();
   NEARBY_LOG(INFO, "EndpointChannelManager has shut down.");
 }
 
@@ -93,6 +100,36 @@ std::shared_ptr<EndpointChannel> EndpointChannelManager::GetChannelForEndpoint(
   return endpoint->channel;
 }
 
+EndpointChannelManager::ChannelHandle EndpointChannelManager::GetChannelHandle(
+    const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+
+  ChannelHandle handle;
+  handle.endpoint_id = endpoint_id;
+  ResolveChannelHandleLocked(handle);
+  return handle;
+}
+
+bool EndpointChannelManager::RefreshChannelHandle(ChannelHandle& handle) {
+  if (handle.generation != generation_.load(std::memory_order_acquire)) {
+    MutexLock lock(&mutex_);
+    ResolveChannelHandleLocked(handle);
+  }
+  return handle.channel != nullptr;
+}
+
+void EndpointChannelManager::ResolveChannelHandleLocked(ChannelHandle& handle) {
+  handle.generation = generation_.load(std::memory_order_relaxed);
+  auto* endpoint = channel_state_.LookupEndpointData(handle.endpoint_id);
+  if (endpoint == nullptr) {
+    handle.channel = nullptr;
+    handle.stripes = nullptr;
+    return;
+  }
+  handle.channel = endpoint->channel;
+  handle.stripes = endpoint->stripes;
+}
+
 void EndpointChannelManager::SetActiveEndpointChannel(
     ClientProxy* client, const std::string& endpoint_id,
     std::unique_ptr<EndpointChannel> channel) {
@@ -103,6 +140,8 @@ void EndpointChannelManager::SetActiveEndpointChannel(
 
   auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
   if (endpoint->IsEncrypted()) channel_state_.EncryptChannel(endpoint);
+  BumpGenerationLocked();
+  channel_changed_.Notify();
 }
 
 int EndpointChannelManager::GetConnectedEndpointsCount() const {
@@ -110,6 +149,155 @@ int EndpointChannelManager::GetConnectedEndpointsCount() const {
   return channel_state_.GetConnectedEndpointsCount();
 }
 
+bool EndpointChannelManager::WaitForChannelReplacement(
+    const std::string& endpoint_id, const EndpointChannel* channel,
+    absl::Duration timeout) {
+  MutexLock lock(&mutex_);
+
+  absl::Time deadline = SystemClock::ElapsedRealtime() + timeout;
+  while (true) {
+    auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+    if (endpoint == nullptr) return false;
+    if (endpoint->channel.get() != channel) return true;
+    absl::Duration remaining = deadline - SystemClock::ElapsedRealtime();
+    if (remaining <= absl::ZeroDuration()) return false;
+    if (!channel_changed_.Wait(remaining).Ok()) return false;
+  }
+}
+
+bool EndpointChannelManager::RetainChannelAsStripe(
+    const std::string& endpoint_id, const ByteArray& salt, bool is_initiator) {
+  MutexLock lock(&mutex_);
+
+  auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+  if (endpoint == nullptr || endpoint->channel == nullptr ||
+      !endpoint->IsEncrypted() || endpoint->stripe_channel != nullptr) {
+    return false;
+  }
+  std::shared_ptr<EncryptionContext> context =
+      DeriveStripeContext(*endpoint->context, salt, is_initiator);
+  if (context == nullptr) {
+    NEARBY_LOGS(INFO) << "Failed to derive stripe keys for endpoint "
+                      << endpoint_id;
+    return false;
+  }
+
+  endpoint->stripe_channel = endpoint->channel;
+  endpoint->stripe_context = std::move(context);
+  endpoint->stripe_writes_started = false;
+  endpoint->stripe_reads_started = false;
+  NEARBY_LOGS(INFO) << "EndpointChannelManager retained channel of type "
+                    << endpoint->stripe_channel->GetType()
+                    << " as a stripe for endpoint " << endpoint_id;
+  return true;
+}
+
+void EndpointChannelManager::StartStripeWrites(const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+
+  auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+  if (endpoint == nullptr || endpoint->stripe_channel == nullptr) return;
+  endpoint->stripe_channel->EnableWriteEncryption(endpoint->stripe_context);
+  endpoint->stripe_writes_started = true;
+}
+
+std::shared_ptr<EndpointChannel> EndpointChannelManager::StartStripeReads(
+    const std::string& endpoint_id, const EndpointChannel* channel) {
+  MutexLock lock(&mutex_);
+
+  auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+  if (endpoint == nullptr || endpoint->stripe_channel == nullptr ||
+      endpoint->stripe_channel.get() != channel ||
+      endpoint->stripe_reads_started) {
+    return {};
+  }
+  endpoint->stripe_channel->EnableReadEncryption(endpoint->stripe_context);
+  endpoint->stripe_reads_started = true;
+  return endpoint->stripe_channel;
+}
+
+bool EndpointChannelManager::ActivateStripe(const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+
+  auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+  if (endpoint == nullptr || endpoint->stripe_channel == nullptr ||
+      !endpoint->stripe_writes_started) {
+    return false;
+  }
+  endpoint->stripes =
+      std::make_shared<ChannelStripes>(endpoint->stripe_channel);
+  BumpGenerationLocked();
+  NEARBY_LOGS(INFO) << "EndpointChannelManager activated stripe of type "
+                    << endpoint->stripe_channel->GetType() << " for endpoint "
+                    << endpoint_id;
+  return true;
+}
+
+std::shared_ptr<ChannelStripes> EndpointChannelManager::GetStripesForEndpoint(
+    const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+
+  auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+  if (endpoint == nullptr) return {};
+  return endpoint->stripes;
+}
+
+bool EndpointChannelManager::HasStripeForEndpoint(
+    const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+
+  auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+  return endpoint != nullptr && endpoint->stripe_channel != nullptr;
+}
+
+void EndpointChannelManager::RemoveStripeForEndpoint(
+    const std::string& endpoint_id, const EndpointChannel* channel) {
+  std::shared_ptr<EndpointChannel> stripe_channel;
+  {
+    MutexLock lock(&mutex_);
+
+    auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
+    if (endpoint == nullptr || endpoint->stripe_channel == nullptr ||
+        endpoint->stripe_channel.get() != channel) {
+      return;
+    }
+    stripe_channel = std::move(endpoint->stripe_channel);
+    endpoint->stripe_channel = nullptr;
+    endpoint->stripe_context = nullptr;
+    // |stripes| stays, to write the frames that could not make it over the
+    // stripe over the current EndpointChannel instead.
+  }
+  NEARBY_LOGS(INFO) << "EndpointChannelManager removed stripe of type "
+                    << stripe_channel->GetType() << " for endpoint "
+                    << endpoint_id;
+  // Closing may block on the medium, so it is done outside of the lock.
+  stripe_channel->Close(proto::connections::DisconnectionReason::UPGRADED);
+}
+
+std::unique_ptr<EndpointChannelManager::EncryptionContext>
+EndpointChannelManager::DeriveStripeContext(EncryptionContext& context,
+                                            const ByteArray& salt,
+                                            bool is_initiator) {
+  std::unique_ptr<std::string> session_unique = context.GetSessionUnique();
+  if (session_unique == nullptr) return {};
+
+  std::unique_ptr<std::string> initiator_key = securemessage::CryptoOps::Hkdf(
+      *session_unique, std::string(salt), kStripeInitiatorKeyLabel);
+  std::unique_ptr<std::string> responder_key = securemessage::CryptoOps::Hkdf(
+      *session_unique, std::string(salt), kStripeResponderKeyLabel);
+  if (initiator_key == nullptr || responder_key == nullptr) return {};
+
+  securemessage::CryptoOps::SecretKey own_key(
+      is_initiator ? *initiator_key : *responder_key,
+      securemessage::CryptoOps::AES_256_KEY);
+  securemessage::CryptoOps::SecretKey peer_key(
+      is_initiator ? *responder_key : *initiator_key,
+      securemessage::CryptoOps::AES_256_KEY);
+  return std::make_unique<securegcm::D2DConnectionContextV1>(
+      own_key, peer_key, /*encode_sequence_number=*/0,
+      /*decode_sequence_number=*/0);
+}
+
 ///////////////////////////////// ChannelState /////////////////////////////////
 
 // endpoint - channel endpoint to encrypt
@@ -174,6 +362,9 @@ bool EndpointChannelManager::UnregisterChannelForEndpoint(
           proto::connections::DisconnectionReason::LOCAL_DISCONNECTION)) {
     return false;
   }
+  BumpGenerationLocked();
+  channel_changed_.Notify();
+  medium_quality_tracker_.ForgetEndpoint(endpoint_id);
 
   NEARBY_LOGS(INFO)
       << "EndpointChannelManager unregistered channel for endpoint "
@@ -15,13 +15,20 @@
 #ifndef CORE_INTERNAL_ENDPOINT_CHANNEL_MANAGER_H_
 #define CORE_INTERNAL_ENDPOINT_CHANNEL_MANAGER_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "securegcm/d2d_connection_context_v1.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "core/internal/channel_stripes.h"
 #include "core/internal/client_proxy.h"
 #include "core/internal/endpoint_channel.h"
+#include "core/internal/medium_quality_tracker.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/condition_variable.h"
 #include "platform/public/logging.h"
 #include "platform/public/mutex.h"
 
@@ -47,6 +54,18 @@ class EndpointChannelManager final {
  public:
   using EncryptionContext = EndpointChannel::EncryptionContext;
 
+  // The EndpointChannel and stripes of an endpoint, as resolved at some
+  // generation of the channel table. Paths that write to an endpoint over and
+  // over, like sending the chunks of a payload, keep one of these around and
+  // revalidate it with RefreshChannelHandle() instead of looking the channel
+  // up every time.
+  struct ChannelHandle {
+    std::string endpoint_id;
+    std::shared_ptr<EndpointChannel> channel;
+    std::shared_ptr<ChannelStripes> stripes;
+    std::uint64_t generation = 0;
+  };
+
   ~EndpointChannelManager();
 
   // Registers the initial EndpointChannel to be associated with an endpoint;
@@ -89,6 +108,17 @@ class EndpointChannelManager final {
   std::shared_ptr<EndpointChannel> GetChannelForEndpoint(
       const std::string& endpoint_id) ABSL_LOCKS_EXCLUDED(mutex_);
 
+  // Returns a handle to the current EndpointChannel and stripes of the
+  // endpoint. Its channel is nullptr if the endpoint has none.
+  ChannelHandle GetChannelHandle(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Brings |handle| up to date with the channel table. This is a single atomic
+  // load while no channel has been registered, replaced or unregistered, and
+  // no stripe activated, since the handle was resolved; otherwise the handle is
+  // resolved again. Returns true if the handle has a channel.
+  bool RefreshChannelHandle(ChannelHandle& handle) ABSL_LOCKS_EXCLUDED(mutex_);
+
   // Returns true if 'endpoint_id' actually had a registered EndpointChannel.
   // IOW, a return of false signifies a no-op.
   bool UnregisterChannelForEndpoint(const std::string& endpoint_id)
@@ -96,6 +126,79 @@ class EndpointChannelManager final {
 
   int GetConnectedEndpointsCount() const ABSL_LOCKS_EXCLUDED(mutex_);
 
+  // Blocks until |channel| is no longer the EndpointChannel of the endpoint,
+  // for at most |timeout|. Returns true if it got replaced, or false if the
+  // endpoint went away or the time ran out.
+  bool WaitForChannelReplacement(const std::string& endpoint_id,
+                                 const EndpointChannel* channel,
+                                 absl::Duration timeout)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Striping: after a bandwidth upgrade, the prior EndpointChannel of an
+  // endpoint may be kept open as a stripe that carries payload chunks next to
+  // the new one. The stripe gets keys of its own, derived from the endpoint's
+  // session and a salt both sides agreed on, so that its messages can be
+  // decoded in whatever order they arrive relative to those of the new
+  // channel.
+  //
+  // The stripe moves over to its keys one direction at a time, each at the
+  // point of the stream after which the old keys are no longer used for it:
+  //   1. RetainChannelAsStripe(), before the channel is replaced.
+  //   2. StartStripeWrites(), after the last write with the old keys.
+  //   3. StartStripeReads(), after the last read with the old keys.
+  //   4. ActivateStripe(), to start spreading payload chunks over it.
+
+  // Keeps the current EndpointChannel of the endpoint open once it gets
+  // replaced. |is_initiator| tells which side of the bandwidth upgrade this
+  // device is on. Returns false if the channel can't become a stripe, i.e. it
+  // isn't encrypted, or the endpoint already has a stripe.
+  bool RetainChannelAsStripe(const std::string& endpoint_id,
+                             const ByteArray& salt, bool is_initiator)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Moves the writes of the retained channel over to its new keys.
+  void StartStripeWrites(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Moves the reads of |channel| over to its new keys, if it is the retained
+  // channel of the endpoint. Returns the channel, or nullptr if it is not.
+  std::shared_ptr<EndpointChannel> StartStripeReads(
+      const std::string& endpoint_id, const EndpointChannel* channel)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Starts spreading payload chunks over the retained channel. Returns false
+  // if there is no retained channel that is ready for it.
+  bool ActivateStripe(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the stripes of the endpoint, or nullptr if it never had an active
+  // stripe. Once the stripe fails, its frames go over the current
+  // EndpointChannel.
+  std::shared_ptr<ChannelStripes> GetStripesForEndpoint(
+      const std::string& endpoint_id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns true if the endpoint has a stripe, active or not.
+  bool HasStripeForEndpoint(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Closes and forgets the stripe |channel| of the endpoint, if it has one.
+  void RemoveStripeForEndpoint(const std::string& endpoint_id,
+                               const EndpointChannel* channel)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Derives the encryption context of a stripe from the endpoint's |context|:
+  // one key per direction, derived with HKDF from the session unique of
+  // |context| and |salt|, and sequence numbers that start over. The initiator
+  // and the responder of the upgrade derive matching contexts.
+  static std::unique_ptr<EncryptionContext> DeriveStripeContext(
+      EncryptionContext& context, const ByteArray& salt, bool is_initiator);
+
+  // Returns how well each medium has been doing lately, over the channels of
+  // all endpoints.
+  MediumQualityTracker& GetMediumQualityTracker() {
+    return medium_quality_tracker_;
+  }
+
  private:
   // Tracks channel state for all endpoints. This includes what EndpointChannel
   // the endpoint is currently using and whether or not the EndpointChannel has
@@ -110,6 +213,9 @@ class EndpointChannelManager final {
         if (channel != nullptr) {
           channel->Close(disconnect_reason);
         }
+        if (stripe_channel != nullptr) {
+          stripe_channel->Close(disconnect_reason);
+        }
       }
 
       // True if we have a 'context' for the endpoint.
@@ -117,6 +223,13 @@ class EndpointChannelManager final {
 
       std::shared_ptr<EndpointChannel> channel;
       std::shared_ptr<EncryptionContext> context;
+      // The channel kept open as a stripe, and its own encryption context.
+      std::shared_ptr<EndpointChannel> stripe_channel;
+      std::shared_ptr<EncryptionContext> stripe_context;
+      bool stripe_writes_started = false;
+      bool stripe_reads_started = false;
+      // Set once the stripe is active; outlives the stripe channel.
+      std::shared_ptr<ChannelStripes> stripes;
       proto::connections::DisconnectionReason disconnect_reason =
           proto::connections::DisconnectionReason::UNKNOWN_DISCONNECTION_REASON;
     };
@@ -161,8 +274,24 @@ class EndpointChannelManager final {
                                 std::unique_ptr<EndpointChannel> channel)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Resolves |handle| again, at the current generation.
+  void ResolveChannelHandleLocked(ChannelHandle& handle)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Marks every ChannelHandle out there as stale.
+  void BumpGenerationLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
   mutable Mutex mutex_;
   ChannelState channel_state_ ABSL_GUARDED_BY(mutex_);
+  // Notified whenever the EndpointChannel of an endpoint changes or goes away.
+  ConditionVariable channel_changed_{&mutex_};
+  // Changes whenever the channels or stripes of any endpoint change; only
+  // written with |mutex_| held, so that a handle resolved under it is never
+  // newer than its generation.
+  std::atomic<std::uint64_t> generation_{1};
+  MediumQualityTracker medium_quality_tracker_;
 };
 
 }  // namespace connections
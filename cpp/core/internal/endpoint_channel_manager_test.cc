@@ -14,18 +14,112 @@
 
 #include "core/internal/endpoint_channel_manager.h"
 
+#include <memory>
+#include <string>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "core/internal/client_proxy.h"
 
 namespace location {
 namespace nearby {
 namespace connections {
+namespace {
+
+using ::testing::NiceMock;
+
+class MockEndpointChannel : public EndpointChannel {
+ public:
+  MOCK_METHOD(ExceptionOr<ByteArray>, Read, (), (override));
+  MOCK_METHOD(Exception, Write, (const ByteArray& data), (override));
+  MOCK_METHOD(Exception, WriteLast, (const ByteArray& data), (override));
+  MOCK_METHOD(void, Close, (), (override));
+  MOCK_METHOD(void, Close, (proto::connections::DisconnectionReason reason),
+              (override));
+  MOCK_METHOD(proto::connections::ConnectionTechnology, GetTechnology, (),
+              (const override));
+  MOCK_METHOD(proto::connections::ConnectionBand, GetBand, (),
+              (const override));
+  MOCK_METHOD(int, GetFrequency, (), (const override));
+  MOCK_METHOD(int, GetTryCount, (), (const override));
+  MOCK_METHOD(std::string, GetType, (), (const override));
+  MOCK_METHOD(std::string, GetName, (), (const override));
+  MOCK_METHOD(Medium, GetMedium, (), (const override));
+  MOCK_METHOD(int, GetMaxTransmitPacketSize, (), (const override));
+  MOCK_METHOD(void, EnableEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(void, DisableEncryption, (), (override));
+  MOCK_METHOD(void, EnableWriteEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(void, EnableReadEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(bool, IsPaused, (), (const override));
+  MOCK_METHOD(void, Pause, (), (override));
+  MOCK_METHOD(void, Resume, (), (override));
+  MOCK_METHOD(absl::Time, GetLastReadTimestamp, (), (const override));
+  MOCK_METHOD(absl::Time, GetLastWriteTimestamp, (), (const override));
+  MOCK_METHOD(void, SetAnalyticsRecorder,
+              (analytics::AnalyticsRecorder*, const std::string&), (override));
+};
 
 TEST(EndpointChannelManagerTest, ConstructorDestructorWorks) {
   EndpointChannelManager mgr;
   SUCCEED();
 }
 
+TEST(EndpointChannelManagerTest, UnknownEndpointHasNoStripe) {
+  EndpointChannelManager mgr;
+
+  EXPECT_FALSE(mgr.RetainChannelAsStripe("ABCD", ByteArray(std::string("salt")),
+                                         /*is_initiator=*/true));
+  EXPECT_FALSE(mgr.HasStripeForEndpoint("ABCD"));
+  EXPECT_FALSE(mgr.ActivateStripe("ABCD"));
+  EXPECT_EQ(mgr.GetStripesForEndpoint("ABCD"), nullptr);
+}
+
+TEST(EndpointChannelManagerTest, UnknownEndpointIsNotWaitedFor) {
+  EndpointChannelManager mgr;
+
+  EXPECT_FALSE(
+      mgr.WaitForChannelReplacement("ABCD", nullptr, absl::Seconds(10)));
+}
+
+TEST(EndpointChannelManagerTest, UnknownEndpointHasEmptyChannelHandle) {
+  EndpointChannelManager mgr;
+
+  EndpointChannelManager::ChannelHandle handle = mgr.GetChannelHandle("ABCD");
+  EXPECT_EQ(handle.endpoint_id, "ABCD");
+  EXPECT_EQ(handle.channel, nullptr);
+  EXPECT_FALSE(mgr.RefreshChannelHandle(handle));
+}
+
+TEST(EndpointChannelManagerTest, ChannelHandleFollowsReplacedChannel) {
+  ClientProxy client;
+  EndpointChannelManager mgr;
+  auto first = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto second = std::make_unique<NiceMock<MockEndpointChannel>>();
+  EndpointChannel* first_channel = first.get();
+  EndpointChannel* second_channel = second.get();
+
+  mgr.RegisterChannelForEndpoint(&client, "ABCD", std::move(first));
+  EndpointChannelManager::ChannelHandle handle = mgr.GetChannelHandle("ABCD");
+  EXPECT_EQ(handle.channel.get(), first_channel);
+  std::uint64_t generation = handle.generation;
+  EXPECT_TRUE(mgr.RefreshChannelHandle(handle));
+  EXPECT_EQ(handle.generation, generation);
+  EXPECT_EQ(handle.channel.get(), first_channel);
+
+  mgr.ReplaceChannelForEndpoint(&client, "ABCD", std::move(second));
+  EXPECT_TRUE(mgr.RefreshChannelHandle(handle));
+  EXPECT_NE(handle.generation, generation);
+  EXPECT_EQ(handle.channel.get(), second_channel);
+
+  EXPECT_TRUE(mgr.UnregisterChannelForEndpoint("ABCD"));
+  EXPECT_FALSE(mgr.RefreshChannelHandle(handle));
+}
+
+}  // namespace
+
 }  // namespace connections
 }  // namespace nearby
 }  // namespace location
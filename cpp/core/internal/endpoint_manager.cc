@@ -17,12 +17,15 @@
 #include <memory>
 #include <utility>
 
+#include "core/internal/channel_stripes.h"
 #include "core/internal/endpoint_channel.h"
 #include "core/internal/offline_frames.h"
+#include "platform/base/buffer_pool.h"
 #include "platform/base/exception.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/logging.h"
 #include "platform/public/mutex_lock.h"
+#include "platform/public/trace.h"
 #include "proto/connections/offline_wire_formats.pb.h"
 
 namespace location {
@@ -32,6 +35,8 @@ namespace connections {
 using ::location::nearby::proto::connections::Medium;
 
 constexpr absl::Duration EndpointManager::kProcessEndpointDisconnectionTimeout;
+constexpr int EndpointManager::kMaxPendingIncomingFrames;
+constexpr absl::Duration EndpointManager::kChannelReplacementTimeout;
 constexpr absl::Time EndpointManager::kInvalidTimestamp;
 
 class EndpointManager::LockedFrameProcessor {
@@ -158,7 +163,7 @@ void EndpointManager::EndpointChannelLoopRunnable(
 
 ExceptionOr<bool> EndpointManager::HandleData(
     const std::string& endpoint_id, ClientProxy* client,
-    EndpointChannel* endpoint_channel) {
+    EndpointChannel* endpoint_channel, IncomingFrameQueue* frame_queue) {
   // Read as much as we can from the healthy EndpointChannel - when it is no
   // longer in good shape (i.e. our read from it throws an Exception), our
   // super class will loop back around and try our luck in case there's been
@@ -169,9 +174,29 @@ ExceptionOr<bool> EndpointManager::HandleData(
     if (!bytes.ok()) {
       NEARBY_LOG(INFO, "Stop reading on read-time exception: %d",
                  bytes.exception());
+      // Let the frames we have already read be processed before our super
+      // class decides what to do next (e.g. discard the endpoint).
+      frame_queue->WaitUntilDispatched();
       return ExceptionOr<bool>(bytes.exception());
     }
-    ExceptionOr<OfflineFrame> wrapped_frame = parser::FromBytes(bytes.result());
+    ExceptionOr<OfflineFrame> wrapped_frame;
+    {
+      NEARBY_TRACE_SPAN(decode_span, "DecodeFrame", endpoint_id);
+      wrapped_frame = parser::FromBytes(bytes.result());
+      NEARBY_TRACE_SET_PAYLOAD(
+          decode_span,
+          wrapped_frame.ok() &&
+                  wrapped_frame.result().v1().has_payload_transfer()
+              ? wrapped_frame.result().v1().payload_transfer()
+                    .payload_header().id()
+              : -1,
+          wrapped_frame.ok() &&
+                  wrapped_frame.result().v1().has_payload_transfer()
+              ? wrapped_frame.result().v1().payload_transfer()
+                    .payload_chunk().offset()
+              : -1);
+    }
+    BufferPool::GetInstance().Release(std::move(bytes.result()));
     if (!wrapped_frame.ok()) {
       if (wrapped_frame.GetException().Raised(
               Exception::kInvalidProtocolBuffer)) {
@@ -181,35 +206,130 @@ ExceptionOr<bool> EndpointManager::HandleData(
       } else {
         NEARBY_LOG(INFO, "Stop reading on parse-time exception: %d",
                    wrapped_frame.exception());
+        frame_queue->WaitUntilDispatched();
         return ExceptionOr<bool>(wrapped_frame.exception());
       }
     }
     OfflineFrame& frame = wrapped_frame.result();
 
-    // Route the incoming offlineFrame to its registered processor.
+    // KEEP_ALIVE and DISCONNECTION have no explicit handlers; deal with them
+    // here, so they don't wait behind the data frames queued for dispatch.
     V1Frame::FrameType frame_type = parser::GetFrameType(frame);
-    LockedFrameProcessor frame_processor = GetFrameProcessor(frame_type);
-    if (!frame_processor) {
-      // report messages without handlers, except KEEP_ALIVE, which has
-      // no explicit handler.
-      if (frame_type == V1Frame::KEEP_ALIVE) {
-        NEARBY_LOG(INFO, "KeepAlive message for endpoint %s",
-                   endpoint_id.c_str());
-      } else if (frame_type == V1Frame::DISCONNECTION) {
-        NEARBY_LOG(INFO, "Disconnect message for endpoint %s",
-                   endpoint_id.c_str());
-        endpoint_channel->Close();
+    if (frame_type == V1Frame::KEEP_ALIVE) {
+      NEARBY_LOG(INFO, "KeepAlive message for endpoint %s",
+                 endpoint_id.c_str());
+      continue;
+    }
+    if (frame_type == V1Frame::DISCONNECTION) {
+      NEARBY_LOG(INFO, "Disconnect message for endpoint %s",
+                 endpoint_id.c_str());
+      // Everything the remote endpoint sent before disconnecting must be
+      // processed before the channel goes away.
+      frame_queue->WaitUntilDispatched();
+      endpoint_channel->Close();
+      continue;
+    }
+
+    // After a bandwidth upgrade, SAFE_TO_CLOSE_PRIOR_CHANNEL is the last frame
+    // read over the prior channel with the keys it shares with the new one. If
+    // the prior channel stays on as a stripe, what follows is encrypted with
+    // keys of its own and read by a reader of its own, while we move on to the
+    // new channel.
+    //
+    // With a make-before-break upgrade, that frame is LAST_WRITE instead, and
+    // what follows it goes over the new channel right away; so we move on as
+    // soon as there is a new channel to move on to.
+    std::shared_ptr<EndpointChannel> stripe_channel;
+    bool switch_channels = false;
+    if (frame_type == V1Frame::BANDWIDTH_UPGRADE_NEGOTIATION) {
+      const auto& bwu_frame = frame.v1().bandwidth_upgrade_negotiation();
+      if (bwu_frame.event_type() ==
+          BandwidthUpgradeNegotiationFrame::SAFE_TO_CLOSE_PRIOR_CHANNEL) {
+        stripe_channel =
+            channel_manager_->StartStripeReads(endpoint_id, endpoint_channel);
+        switch_channels = stripe_channel != nullptr;
+      } else if (bwu_frame.event_type() == BandwidthUpgradeNegotiationFrame::
+                                               LAST_WRITE_TO_PRIOR_CHANNEL &&
+                 bwu_frame.last_write_to_prior_channel().make_before_break()) {
+        if (!channel_manager_->WaitForChannelReplacement(
+                endpoint_id, endpoint_channel, kChannelReplacementTimeout)) {
+          NEARBY_LOGS(WARNING)
+              << "No new channel after a make-before-break LAST_WRITE; "
+                 "endpoint_id="
+              << endpoint_id;
+        }
+        stripe_channel =
+            channel_manager_->StartStripeReads(endpoint_id, endpoint_channel);
+        switch_channels = true;
+      }
+    }
+
+    // Hand the frame over to the dispatch stage; this blocks if the dispatch
+    // stage is too far behind.
+    if (!frame_queue->Push({std::move(frame), endpoint_channel->GetMedium()})) {
+      NEARBY_LOG(INFO, "Stop reading; frame queue is closed for endpoint %s",
+                 endpoint_id.c_str());
+      return ExceptionOr<bool>(Exception::kInterrupted);
+    }
+
+    if (stripe_channel != nullptr) {
+      StartStripeReader(endpoint_id, client, std::move(stripe_channel));
+    }
+    if (switch_channels) {
+      return ExceptionOr<bool>(true);
+    }
+  }
+}
+
+void EndpointManager::StartStripeReader(
+    const std::string& endpoint_id, ClientProxy* client,
+    std::shared_ptr<EndpointChannel> stripe_channel) {
+  RunOnEndpointManagerThread("start-stripe-reader", [this, client, endpoint_id,
+                                                     stripe_channel]() {
+    auto item = endpoints_.find(endpoint_id);
+    if (item == endpoints_.end()) {
+      channel_manager_->RemoveStripeForEndpoint(endpoint_id,
+                                                stripe_channel.get());
+      return;
+    }
+    item->second.StartStripeReader(
+        [this, client, endpoint_id,
+         stripe_channel](IncomingFrameQueue* frame_queue) {
+          NEARBY_LOGS(INFO) << "Started stripe reader; endpoint_id="
+                            << endpoint_id
+                            << "; channel=" << stripe_channel->GetType();
+          HandleData(endpoint_id, client, stripe_channel.get(), frame_queue);
+          // The endpoint carries on over its current channel; only the stripe
+          // is lost.
+          channel_manager_->RemoveStripeForEndpoint(endpoint_id,
+                                                    stripe_channel.get());
+          NEARBY_LOGS(INFO) << "Stripe reader done; endpoint_id="
+                            << endpoint_id;
+        });
+  });
+}
+
+void EndpointManager::DispatchIncomingFrames(const std::string& endpoint_id,
+                                             ClientProxy* client,
+                                             IncomingFrameQueue* frame_queue) {
+  IncomingFrameQueue::Item item;
+  while (frame_queue->Pop(&item)) {
+    {
+      // Route the incoming offlineFrame to its registered processor.
+      V1Frame::FrameType frame_type = parser::GetFrameType(item.frame);
+      LockedFrameProcessor frame_processor = GetFrameProcessor(frame_type);
+      if (frame_processor) {
+        frame_processor->OnIncomingFrame(item.frame, endpoint_id, client,
+                                         item.medium);
       } else {
         NEARBY_LOGS(ERROR) << "Unhandled message: endpoint_id=" << endpoint_id
                            << ", frame type="
                            << V1Frame::FrameType_Name(frame_type);
       }
-      continue;
     }
-
-    frame_processor->OnIncomingFrame(frame, endpoint_id, client,
-                                     endpoint_channel->GetMedium());
+    frame_queue->MarkDispatched();
   }
+  NEARBY_LOGS(INFO) << "Dispatcher done; endpoint_id=" << endpoint_id;
 }
 
 ExceptionOr<bool> EndpointManager::HandleKeepAlive(
@@ -414,18 +534,28 @@ void EndpointManager::RegisterEndpoint(ClientProxy* client,
     NEARBY_LOGS(INFO) << "Starting workers: endpoint " << endpoint_id;
     // For every endpoint, there's normally only one Read handler instance
     // running on a dedicated thread. This instance reads data from the
-    // endpoint and delegates incoming frames to various FrameProcessors.
-    // Once the frame has been properly handled, it starts reading again for
-    // the next frame. If the handler fails its read and no other
+    // endpoint and queues incoming frames for delivery to various
+    // FrameProcessors, then immediately starts reading again for the next
+    // frame. If the handler fails its read and no other
     // EndpointChannels are available for this endpoint, a disconnection
     // will be initiated.
-    endpoint_state.StartEndpointReader([this, client, endpoint_id]() {
-      EndpointChannelLoopRunnable(
-          "Read", client, endpoint_id,
-          [this, client, endpoint_id](EndpointChannel* channel) {
-            return HandleData(endpoint_id, client, channel);
-          });
-    });
+    endpoint_state.StartEndpointReader(
+        [this, client, endpoint_id](IncomingFrameQueue* frame_queue) {
+          EndpointChannelLoopRunnable(
+              "Read", client, endpoint_id,
+              [this, client, endpoint_id,
+               frame_queue](EndpointChannel* channel) {
+                return HandleData(endpoint_id, client, channel, frame_queue);
+              });
+        });
+    // The reader hands every frame over to a dispatcher running on its own
+    // thread, which delivers the frames to their FrameProcessors in order.
+    // This way the reader keeps draining the socket while frames are being
+    // processed, up to kMaxPendingIncomingFrames frames ahead.
+    endpoint_state.StartEndpointDispatcher(
+        [this, client, endpoint_id](IncomingFrameQueue* frame_queue) {
+          DispatchIncomingFrames(endpoint_id, client, frame_queue);
+        });
 
     // For every endpoint, there's only one KeepAliveManager instance running on
     // a dedicated thread. This instance will periodically send out a ping* to
@@ -479,28 +609,46 @@ void EndpointManager::UnregisterEndpoint(ClientProxy* client,
   latch.Await();
 }
 
-int EndpointManager::GetMaxTransmitPacketSize(const std::string& endpoint_id) {
-  std::shared_ptr<EndpointChannel> channel =
-      channel_manager_->GetChannelForEndpoint(endpoint_id);
-  if (channel == nullptr) {
+int EndpointManager::GetMaxTransmitPacketSize(const ChannelHandle& handle) {
+  if (handle.channel == nullptr) {
     return 0;
   }
 
-  return channel->GetMaxTransmitPacketSize();
+  return handle.channel->GetMaxTransmitPacketSize();
+}
+
+EndpointManager::ChannelHandle EndpointManager::GetChannelHandle(
+    const std::string& endpoint_id) {
+  return channel_manager_->GetChannelHandle(endpoint_id);
+}
+
+bool EndpointManager::RefreshChannelHandle(ChannelHandle& handle) {
+  return channel_manager_->RefreshChannelHandle(handle);
 }
 
 std::vector<std::string> EndpointManager::SendPayloadChunk(
     const PayloadTransferFrame::PayloadHeader& payload_header,
     const PayloadTransferFrame::PayloadChunk& payload_chunk,
-    const std::vector<std::string>& endpoint_ids) {
-  ByteArray bytes =
-      parser::ForDataPayloadTransfer(payload_header, payload_chunk);
+    std::vector<ChannelHandle>& channel_handles) {
+  ByteArray bytes;
+  {
+    NEARBY_TRACE_SPAN(encode_span, "EncodeFrame");
+    bytes = parser::ForDataPayloadTransfer(payload_header, payload_chunk);
+  }
 
-  return SendTransferFrameBytes(
-      endpoint_ids, bytes, payload_header.id(),
+  // Payload chunks may be spread over the stripes of an endpoint; the last one
+  // follows all the others, so none of them is left behind on a stripe that
+  // fails afterwards.
+  bool last_chunk = (payload_chunk.flags() &
+                     PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
+  std::vector<std::string> failed_endpoint_ids = SendTransferFrameBytes(
+      channel_handles, bytes, payload_header.id(),
       /*offset=*/payload_chunk.offset(),
       /*packet_type=*/
-      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::DATA));
+      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::DATA),
+      last_chunk ? StripePolicy::kAfterStripes : StripePolicy::kAnyChannel);
+  BufferPool::GetInstance().Release(std::move(bytes));
+  return failed_endpoint_ids;
 }
 
 // Designed to run asynchronously. It is called from IO thread pools, and
@@ -604,13 +752,27 @@ CountDownLatch EndpointManager::NotifyFrameProcessorsOnEndpointDisconnect(
 std::vector<std::string> EndpointManager::SendTransferFrameBytes(
     const std::vector<std::string>& endpoint_ids, const ByteArray& bytes,
     std::int64_t payload_id, std::int64_t offset,
-    const std::string& packet_type) {
-  std::vector<std::string> failed_endpoint_ids;
+    const std::string& packet_type, StripePolicy stripe_policy) {
+  std::vector<ChannelHandle> channel_handles;
+  channel_handles.reserve(endpoint_ids.size());
   for (const std::string& endpoint_id : endpoint_ids) {
-    std::shared_ptr<EndpointChannel> channel =
-        channel_manager_->GetChannelForEndpoint(endpoint_id);
+    channel_handles.push_back(channel_manager_->GetChannelHandle(endpoint_id));
+  }
+  return SendTransferFrameBytes(channel_handles, bytes, payload_id, offset,
+                                packet_type, stripe_policy);
+}
 
-    if (channel == nullptr) {
+std::vector<std::string> EndpointManager::SendTransferFrameBytes(
+    std::vector<ChannelHandle>& channel_handles, const ByteArray& bytes,
+    std::int64_t payload_id, std::int64_t offset,
+    const std::string& packet_type, StripePolicy stripe_policy) {
+  std::vector<std::string> failed_endpoint_ids;
+  for (ChannelHandle& handle : channel_handles) {
+    const std::string& endpoint_id = handle.endpoint_id;
+    NEARBY_TRACE_SPAN(write_span, "WriteToEndpoint", endpoint_id, payload_id,
+                      offset);
+
+    if (handle.channel == nullptr) {
       // We no longer know about this endpoint (it was either explicitly
       // unregistered, or a read/write error made us unregister it internally).
       NEARBY_LOGS(ERROR) << "EndpointManager failed to find EndpointChannel "
@@ -623,7 +785,36 @@ std::vector<std::string> EndpointManager::SendTransferFrameBytes(
       continue;
     }
 
-    Exception write_exception = channel->Write(bytes);
+    Exception write_exception{Exception::kSuccess};
+    // A make-before-break bandwidth upgrade may seal the channel for writes
+    // right under our feet; the write then goes over the channel that
+    // replaced it.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      EndpointChannel& channel = *handle.channel;
+      ChannelStripes* stripes = stripe_policy != StripePolicy::kPrimaryOnly
+                                    ? handle.stripes.get()
+                                    : nullptr;
+      if (stripes == nullptr) {
+        absl::Time write_start_time = SystemClock::ElapsedRealtime();
+        write_exception = channel.Write(bytes);
+        if (write_exception.Ok()) {
+          channel_manager_->GetMediumQualityTracker().RecordWrite(
+              endpoint_id, channel.GetMedium(), bytes.size(), write_start_time,
+              SystemClock::ElapsedRealtime());
+        }
+      } else if (stripe_policy == StripePolicy::kAnyChannel) {
+        write_exception = stripes->Write(channel, bytes);
+      } else {
+        write_exception = stripes->Flush(channel);
+        if (write_exception.Ok()) write_exception = channel.Write(bytes);
+      }
+      if (write_exception.Ok()) break;
+      std::shared_ptr<EndpointChannel> failed_channel = handle.channel;
+      if (!channel_manager_->RefreshChannelHandle(handle) ||
+          handle.channel == failed_channel) {
+        break;
+      }
+    }
     if (!write_exception.Ok()) {
       failed_endpoint_ids.push_back(endpoint_id);
       NEARBY_LOGS(INFO) << "Failed to send packet; endpoint_id=" << endpoint_id;
@@ -644,6 +835,11 @@ EndpointManager::EndpointState::~EndpointState() {
     channel_manager_->UnregisterChannelForEndpoint(endpoint_id_);
   }
 
+  // Make sure neither the reader nor the dispatcher is blocking shutdown.
+  if (frame_queue_) {
+    frame_queue_->Close();
+  }
+
   // Make sure the KeepAlive thread isn't blocking shutdown.
   if (keep_alive_waiter_mutex_ && keep_alive_waiter_) {
     MutexLock lock(keep_alive_waiter_mutex_.get());
@@ -651,8 +847,28 @@ EndpointManager::EndpointState::~EndpointState() {
   }
 }
 
-void EndpointManager::EndpointState::StartEndpointReader(Runnable&& runnable) {
-  reader_thread_.Execute("reader", std::move(runnable));
+void EndpointManager::EndpointState::StartEndpointReader(
+    std::function<void(IncomingFrameQueue*)> runnable) {
+  reader_thread_.Execute(
+      "reader", [runnable, frame_queue = frame_queue_.get()]() {
+        runnable(frame_queue);
+      });
+}
+
+void EndpointManager::EndpointState::StartEndpointDispatcher(
+    std::function<void(IncomingFrameQueue*)> runnable) {
+  dispatch_thread_.Execute(
+      "dispatcher", [runnable, frame_queue = frame_queue_.get()]() {
+        runnable(frame_queue);
+      });
+}
+
+void EndpointManager::EndpointState::StartStripeReader(
+    std::function<void(IncomingFrameQueue*)> runnable) {
+  stripe_reader_thread_.Execute(
+      "stripe-reader", [runnable, frame_queue = frame_queue_.get()]() {
+        runnable(frame_queue);
+      });
 }
 
 void EndpointManager::EndpointState::StartEndpointKeepAliveManager(
@@ -665,6 +881,52 @@ void EndpointManager::EndpointState::StartEndpointKeepAliveManager(
       });
 }
 
+bool EndpointManager::IncomingFrameQueue::Push(Item item) {
+  MutexLock lock(&mutex_);
+  while (!closed_ && items_.size() >= capacity_) {
+    cond_.Wait();
+  }
+  if (closed_) return false;
+  items_.push_back(std::move(item));
+  undispatched_++;
+  cond_.Notify();
+  return true;
+}
+
+bool EndpointManager::IncomingFrameQueue::Pop(Item* item) {
+  MutexLock lock(&mutex_);
+  while (!closed_ && items_.empty()) {
+    cond_.Wait();
+  }
+  if (closed_) return false;
+  *item = std::move(items_.front());
+  items_.pop_front();
+  // Wake up the reader, if it is waiting for room in the queue.
+  cond_.Notify();
+  return true;
+}
+
+void EndpointManager::IncomingFrameQueue::MarkDispatched() {
+  MutexLock lock(&mutex_);
+  if (undispatched_ > 0) undispatched_--;
+  if (undispatched_ == 0) cond_.Notify();
+}
+
+void EndpointManager::IncomingFrameQueue::WaitUntilDispatched() {
+  MutexLock lock(&mutex_);
+  while (!closed_ && undispatched_ > 0) {
+    cond_.Wait();
+  }
+}
+
+void EndpointManager::IncomingFrameQueue::Close() {
+  MutexLock lock(&mutex_);
+  closed_ = true;
+  items_.clear();
+  undispatched_ = 0;
+  cond_.Notify();
+}
+
 void EndpointManager::RunOnEndpointManagerThread(const std::string& name,
                                                  Runnable runnable) {
   serial_executor_.Execute(name, std::move(runnable));
@@ -16,6 +16,7 @@
 #define CORE_INTERNAL_ENDPOINT_MANAGER_H_
 
 #include <cstdint>
+#include <deque>
 #include <memory>
 
 #include "absl/base/thread_annotations.h"
@@ -31,6 +32,7 @@
 #include "platform/public/condition_variable.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/multi_thread_executor.h"
+#include "platform/public/mutex.h"
 #include "platform/public/single_thread_executor.h"
 #include "platform/public/system_clock.h"
 
@@ -50,11 +52,13 @@ namespace connections {
 // dedicated writer threads belonging to the PayloadManager. The writer thread
 // that is used depends on the Payload::Type.
 //
-// The EndpointManager has one dedicated reader thread for each registered
-// endpoint, and the receiving of every incoming payload (and its subsequent
-// chunks) originates on one of those threads before control is transferred over
-// to PayloadManager::ProcessFrame() (still running on that
-// same dedicated reader thread).
+// The EndpointManager has two dedicated threads for each registered endpoint,
+// which form a two-stage receive pipeline. The reader thread keeps reading,
+// decrypting and parsing incoming frames and hands them over to the dispatch
+// thread through a bounded queue. The dispatch thread routes every frame to
+// its registered FrameProcessor, e.g. PayloadManager::OnIncomingFrame(), so a
+// slow frame processor does not stop the socket from being drained. Frames are
+// dispatched in the order in which they were read.
 
 class EndpointManager {
  public:
@@ -62,7 +66,7 @@ class EndpointManager {
    public:
     virtual ~FrameProcessor() = default;
 
-    // @EndpointManagerReaderThread
+    // @EndpointManagerDispatchThread
     // Called for every incoming frame of registered type.
     // NOTE(OfflineFrame& frame):
     // For large payload in data phase, resources may be saved if data is moved,
@@ -110,17 +114,29 @@ class EndpointManager {
   // this case, we do not notify the client of onDisconnected().
   void UnregisterEndpoint(ClientProxy* client, const std::string& endpoint_id);
 
+  using ChannelHandle = EndpointChannelManager::ChannelHandle;
+
+  // Returns a handle to the EndpointChannel of the endpoint, to send it a run
+  // of frames without looking the channel up for each of them.
+  ChannelHandle GetChannelHandle(const std::string& endpoint_id);
+
+  // Brings |handle| up to date; cheap unless some channel has changed since it
+  // was resolved. Returns true if the handle has a channel.
+  bool RefreshChannelHandle(ChannelHandle& handle);
+
   // Returns the maximum supported transmit packet size(MTU) for the underlying
   // transport.
-  int GetMaxTransmitPacketSize(const std::string& endpoint_id);
+  static int GetMaxTransmitPacketSize(const ChannelHandle& handle);
 
   // Returns the list of endpoints to which sending this chunk failed.
   //
-  // Invoked from the PayloadManager's sendPayload() method.
+  // Invoked from the PayloadManager's sendPayload() method, with the handles
+  // it refreshed for this chunk. A handle is updated if its channel got
+  // replaced while the chunk was being written.
   std::vector<std::string> SendPayloadChunk(
       const PayloadTransferFrame::PayloadHeader& payload_header,
       const PayloadTransferFrame::PayloadChunk& payload_chunk,
-      const std::vector<std::string>& endpoint_ids);
+      std::vector<ChannelHandle>& channel_handles);
   std::vector<std::string> SendControlMessage(
       const PayloadTransferFrame::PayloadHeader& payload_header,
       const PayloadTransferFrame::ControlMessage& control_message,
@@ -142,15 +158,66 @@ class EndpointManager {
   void DiscardEndpoint(ClientProxy* client, const std::string& endpoint_id);
 
  private:
+  // Bounded FIFO of parsed incoming frames of a single endpoint. It connects
+  // the reader stage (socket read, decryption and parsing) with the dispatch
+  // stage (FrameProcessor::OnIncomingFrame()).
+  class IncomingFrameQueue {
+   public:
+    struct Item {
+      OfflineFrame frame;
+      // Medium of the channel the frame was read from.
+      proto::connections::Medium medium = proto::connections::UNKNOWN_MEDIUM;
+    };
+
+    explicit IncomingFrameQueue(size_t capacity) : capacity_(capacity) {}
+    IncomingFrameQueue(const IncomingFrameQueue&) = delete;
+    IncomingFrameQueue& operator=(const IncomingFrameQueue&) = delete;
+
+    // Blocks while the queue is full.
+    // Returns false if the queue was closed, in which case item is dropped.
+    bool Push(Item item) ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Blocks while the queue is empty.
+    // Returns false if the queue was closed; item is left untouched then.
+    bool Pop(Item* item) ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Must be called by the dispatch stage once an item returned by Pop() has
+    // been fully processed.
+    void MarkDispatched() ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Blocks until every pushed item has been dispatched, or the queue is
+    // closed.
+    void WaitUntilDispatched() ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Drops all pending items and unblocks all waiters. Every subsequent call
+    // to Push() or Pop() fails.
+    void Close() ABSL_LOCKS_EXCLUDED(mutex_);
+
+   private:
+    const size_t capacity_;
+    Mutex mutex_;
+    ConditionVariable cond_{&mutex_};
+    std::deque<Item> items_ ABSL_GUARDED_BY(mutex_);
+    // Number of items that were pushed but are not yet dispatched.
+    int undispatched_ ABSL_GUARDED_BY(mutex_) = 0;
+    bool closed_ ABSL_GUARDED_BY(mutex_) = false;
+  };
+
   class EndpointState {
    public:
     EndpointState(const std::string& endpoint_id,
                   EndpointChannelManager* channel_manager)
         : endpoint_id_{endpoint_id},
           channel_manager_{channel_manager},
+          frame_queue_{std::make_unique<IncomingFrameQueue>(
+              kMaxPendingIncomingFrames)},
+          reader_thread_{"endpoint-reader " + endpoint_id},
+          dispatch_thread_{"endpoint-dispatcher " + endpoint_id},
+          stripe_reader_thread_{"endpoint-stripe-reader " + endpoint_id},
           keep_alive_waiter_mutex_{std::make_unique<Mutex>()},
           keep_alive_waiter_{std::make_unique<ConditionVariable>(
-              keep_alive_waiter_mutex_.get())} {}
+              keep_alive_waiter_mutex_.get())},
+          keep_alive_thread_{"endpoint-keep-alive " + endpoint_id} {}
 
     EndpointState(const EndpointState&) = delete;
     // The default move constructor would not reset |channel_manager_|, for
@@ -159,7 +226,10 @@ class EndpointManager {
     EndpointState(EndpointState&& other)
         : endpoint_id_{std::move(other.endpoint_id_)},
           channel_manager_{std::exchange(other.channel_manager_, nullptr)},
+          frame_queue_{std::move(other.frame_queue_)},
           reader_thread_{std::move(other.reader_thread_)},
+          dispatch_thread_{std::move(other.dispatch_thread_)},
+          stripe_reader_thread_{std::move(other.stripe_reader_thread_)},
           keep_alive_waiter_mutex_{
               std::exchange(other.keep_alive_waiter_mutex_, nullptr)},
           keep_alive_waiter_{std::exchange(other.keep_alive_waiter_, nullptr)},
@@ -168,14 +238,25 @@ class EndpointManager {
     EndpointState&& operator=(EndpointState&&) = delete;
     ~EndpointState();
 
-    void StartEndpointReader(Runnable&& runnable);
+    void StartEndpointReader(
+        std::function<void(IncomingFrameQueue*)> runnable);
+    void StartEndpointDispatcher(
+        std::function<void(IncomingFrameQueue*)> runnable);
+    void StartStripeReader(std::function<void(IncomingFrameQueue*)> runnable);
     void StartEndpointKeepAliveManager(
         std::function<void(Mutex*, ConditionVariable*)> runnable);
 
    private:
     const std::string endpoint_id_;
     EndpointChannelManager* channel_manager_;
+    // Created on the heap so raw pointers sent to the reader and dispatcher
+    // aren't invalidated during std::move operations. Declared before the
+    // threads using it, so it outlives them.
+    std::unique_ptr<IncomingFrameQueue> frame_queue_;
     SingleThreadExecutor reader_thread_;
+    SingleThreadExecutor dispatch_thread_;
+    // Reads the stripe of the endpoint, if it has one, into |frame_queue_|.
+    SingleThreadExecutor stripe_reader_thread_;
 
     // Use a condition variable so we can wait on the thread but still be able
     // to wake it up before shutting down. We don't want to just sleep and risk
@@ -205,9 +286,24 @@ class EndpointManager {
 
   LockedFrameProcessor GetFrameProcessor(V1Frame::FrameType frame_type);
 
+  // Reader stage: reads, decrypts and parses frames from endpoint_channel and
+  // enqueues them to frame_queue. Hands endpoint_channel over to a stripe
+  // reader if it stays on as a stripe after a bandwidth upgrade.
   ExceptionOr<bool> HandleData(const std::string& endpoint_id,
                                ClientProxy* client_proxy,
-                               EndpointChannel* endpoint_channel);
+                               EndpointChannel* endpoint_channel,
+                               IncomingFrameQueue* frame_queue);
+
+  // Dispatch stage: routes frames from frame_queue to their registered
+  // FrameProcessor, until the queue is closed.
+  void DispatchIncomingFrames(const std::string& endpoint_id,
+                              ClientProxy* client_proxy,
+                              IncomingFrameQueue* frame_queue);
+
+  // Starts reading the stripe of an endpoint, until it fails.
+  void StartStripeReader(const std::string& endpoint_id,
+                         ClientProxy* client_proxy,
+                         std::shared_ptr<EndpointChannel> stripe_channel);
 
   ExceptionOr<bool> HandleKeepAlive(EndpointChannel* endpoint_channel,
                                     absl::Duration keep_alive_interval,
@@ -234,6 +330,13 @@ class EndpointManager {
 
   static constexpr absl::Duration kProcessEndpointDisconnectionTimeout =
       absl::Milliseconds(2000);
+  // Maximum number of frames read ahead of the dispatch stage, per endpoint.
+  // Once reached, the reader stage stops reading until frames are dispatched.
+  static constexpr int kMaxPendingIncomingFrames = 32;
+  // How long the reader waits for the new channel of a make-before-break
+  // bandwidth upgrade, once the remote device stopped writing to the old one.
+  static constexpr absl::Duration kChannelReplacementTimeout =
+      absl::Seconds(10);
   static constexpr absl::Time kInvalidTimestamp = absl::InfinitePast();
 
   // It should be noted that this method may be called multiple times (because
@@ -251,10 +354,26 @@ class EndpointManager {
   CountDownLatch NotifyFrameProcessorsOnEndpointDisconnect(
       ClientProxy* client, const std::string& endpoint_id);
 
+  // How a frame is written to an endpoint that has a stripe.
+  enum class StripePolicy {
+    // Over the current EndpointChannel only.
+    kPrimaryOnly,
+    // Over whichever channel gets to it first.
+    kAnyChannel,
+    // Over the current EndpointChannel, once the frames before it are out.
+    kAfterStripes,
+  };
+
   std::vector<std::string> SendTransferFrameBytes(
       const std::vector<std::string>& endpoint_ids,
       const ByteArray& payload_transfer_frame_bytes, std::int64_t payload_id,
-      std::int64_t offset, const std::string& packet_type);
+      std::int64_t offset, const std::string& packet_type,
+      StripePolicy stripe_policy = StripePolicy::kPrimaryOnly);
+  std::vector<std::string> SendTransferFrameBytes(
+      std::vector<ChannelHandle>& channel_handles,
+      const ByteArray& payload_transfer_frame_bytes, std::int64_t payload_id,
+      std::int64_t offset, const std::string& packet_type,
+      StripePolicy stripe_policy);
 
   // Executes all jobs sequentially, on a serial_executor_.
   void RunOnEndpointManagerThread(const std::string& name, Runnable runnable);
@@ -268,7 +387,7 @@ class EndpointManager {
   // We keep track of all registered channel endpoints here.
   absl::flat_hash_map<std::string, EndpointState> endpoints_;
 
-  SingleThreadExecutor serial_executor_;
+  SingleThreadExecutor serial_executor_{"endpoint-manager"};
 };
 
 // Operator overloads when comparing FrameProcessor*.
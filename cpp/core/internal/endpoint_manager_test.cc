@@ -30,9 +30,14 @@
 #include "core/options.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
+#include "platform/base/virtual_clock.h"
+#include "platform/public/condition_variable.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/logging.h"
+#include "platform/public/mutex.h"
+#include "platform/public/mutex_lock.h"
 #include "platform/public/pipe.h"
+#include "platform/public/system_clock.h"
 #include "proto/connections_enums.pb.h"
 
 namespace location {
@@ -51,6 +56,7 @@ class MockEndpointChannel : public EndpointChannel {
  public:
   MOCK_METHOD(ExceptionOr<ByteArray>, Read, (), (override));
   MOCK_METHOD(Exception, Write, (const ByteArray& data), (override));
+  MOCK_METHOD(Exception, WriteLast, (const ByteArray& data), (override));
   MOCK_METHOD(void, Close, (), (override));
   MOCK_METHOD(void, Close, (DisconnectionReason reason), (override));
   // TODO(jfcarroll): This needs to be fixed properly
@@ -70,6 +76,10 @@ class MockEndpointChannel : public EndpointChannel {
   MOCK_METHOD(void, EnableEncryption,
               (std::shared_ptr<EncryptionContext> context), (override));
   MOCK_METHOD(void, DisableEncryption, (), (override));
+  MOCK_METHOD(void, EnableWriteEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
+  MOCK_METHOD(void, EnableReadEncryption,
+              (std::shared_ptr<EncryptionContext> context), (override));
   MOCK_METHOD(bool, IsPaused, (), (const override));
   MOCK_METHOD(void, Pause, (), (override));
   MOCK_METHOD(void, Resume, (), (override));
@@ -199,7 +209,8 @@ TEST_F(EndpointManagerTest, RegisterFrameProcessorWorks) {
   ByteArray endpoint_info{"endpoint_name"};
   auto read_data =
       parser::ForConnectionRequest("endpoint_id", endpoint_info, 1234, false,
-                                   "", std::vector{Medium::BLE}, 0, 0);
+                                   "", std::vector{Medium::BLE}, 0, 0,
+                                   /*supports_session_resumption=*/false);
   EXPECT_CALL(*connect_request, OnIncomingFrame);
   EXPECT_CALL(*connect_request, OnEndpointDisconnect);
   EXPECT_CALL(*endpoint_channel, Read())
@@ -216,6 +227,54 @@ TEST_F(EndpointManagerTest, RegisterFrameProcessorWorks) {
   RegisterEndpoint(std::move(endpoint_channel));
 }
 
+TEST_F(EndpointManagerTest, ReaderKeepsReadingWhileFrameIsProcessed) {
+  constexpr int kFrameCount = 3;
+  auto endpoint_channel = std::make_unique<MockEndpointChannel>();
+  auto connect_request = std::make_unique<MockFrameProcessor>();
+  ByteArray endpoint_info{"endpoint_name"};
+  auto read_data =
+      parser::ForConnectionRequest("endpoint_id", endpoint_info, 1234, false,
+                                   "", std::vector{Medium::BLE}, 0, 0,
+                                   /*supports_session_resumption=*/false);
+  auto read_count = std::make_shared<std::atomic_int>(0);
+  CountDownLatch all_frames_read(1);
+  CountDownLatch processor_released(1);
+  CountDownLatch disconnected(1);
+  EXPECT_CALL(*endpoint_channel, Read())
+      .WillRepeatedly([read_count, read_data, all_frames_read]() mutable {
+        if ((*read_count)++ < kFrameCount) {
+          return ExceptionOr<ByteArray>(read_data);
+        }
+        all_frames_read.CountDown();
+        return ExceptionOr<ByteArray>(Exception::kIo);
+      });
+  EXPECT_CALL(*endpoint_channel, Write(_))
+      .WillRepeatedly(Return(Exception{Exception::kSuccess}));
+  // The first frame blocks the dispatcher until all frames have been read.
+  EXPECT_CALL(*connect_request, OnIncomingFrame)
+      .Times(kFrameCount)
+      .WillOnce([processor_released](OfflineFrame&, const std::string&,
+                                     ClientProxy*, Medium) mutable {
+        processor_released.Await();
+      })
+      .WillRepeatedly(Return());
+  EXPECT_CALL(*connect_request, OnEndpointDisconnect)
+      .WillOnce([disconnected](ClientProxy*, const std::string&,
+                               CountDownLatch barrier) mutable {
+        barrier.CountDown();
+        disconnected.CountDown();
+      });
+  em_.RegisterFrameProcessor(V1Frame::CONNECTION_REQUEST,
+                             connect_request.get());
+  processors_.emplace_back(std::move(connect_request));
+  RegisterEndpoint(std::move(endpoint_channel), false);
+
+  EXPECT_TRUE(all_frames_read.Await(absl::Milliseconds(1000)).result());
+  processor_released.CountDown();
+  // Frames read before the failure are all dispatched before disconnection.
+  EXPECT_TRUE(disconnected.Await(absl::Milliseconds(1000)).result());
+}
+
 TEST_F(EndpointManagerTest, UnregisterFrameProcessorWorks) {
   auto endpoint_channel = std::make_unique<MockEndpointChannel>();
   EXPECT_CALL(*endpoint_channel, Read())
@@ -286,6 +345,62 @@ TEST_F(EndpointManagerTest, SingleReadOnInvalidPayload) {
   RegisterEndpoint(std::move(endpoint_channel));
 }
 
+// Runs on virtual time, so the 30 s keep-alive timeout takes no wall time.
+TEST(EndpointManagerKeepAliveTest, SilentEndpointIsDroppedAfterTimeout) {
+  VirtualClock::Instance().Start();
+  {
+    // The channel outlives the endpoint manager, whose reader waits on it.
+    Mutex mutex;
+    ConditionVariable closed_cond(&mutex);
+    bool closed = false;
+    absl::Time closed_at;
+    CountDownLatch done(1);
+    absl::Time last_read = SystemClock::ElapsedRealtime();
+    ClientProxy client;
+    EndpointChannelManager ecm;
+    EndpointManager em(&ecm);
+    ConnectionOptions options{
+        .keep_alive_interval_millis = 5000,
+        .keep_alive_timeout_millis = 30000,
+    };
+    auto endpoint_channel = std::make_unique<MockEndpointChannel>();
+    EXPECT_CALL(*endpoint_channel, GetMedium())
+        .WillRepeatedly(Return(Medium::BLE));
+    EXPECT_CALL(*endpoint_channel, GetLastReadTimestamp())
+        .WillRepeatedly(Return(last_read));
+    EXPECT_CALL(*endpoint_channel, GetLastWriteTimestamp())
+        .WillRepeatedly(Return(last_read));
+    EXPECT_CALL(*endpoint_channel, Write(_))
+        .WillRepeatedly(Return(Exception{Exception::kSuccess}));
+    // Nothing is ever read; the reader waits for the channel to close, which
+    // does not keep the clock from moving.
+    EXPECT_CALL(*endpoint_channel, Read()).WillRepeatedly([&]() {
+      MutexLock lock(&mutex);
+      while (!closed) closed_cond.Wait();
+      return ExceptionOr<ByteArray>(Exception::kIo);
+    });
+    EXPECT_CALL(*endpoint_channel, Close(_))
+        .WillRepeatedly([&](DisconnectionReason reason) {
+          MutexLock lock(&mutex);
+          if (!closed) closed_at = SystemClock::ElapsedRealtime();
+          closed = true;
+          closed_cond.Notify();
+          done.CountDown();
+        });
+
+    em.RegisterEndpoint(&client, "endpoint_id", ConnectionResponseInfo{},
+                        options, std::move(endpoint_channel),
+                        ConnectionListener{}, "conntokn");
+
+    // CountDownLatch waits in real time.
+    EXPECT_TRUE(done.Await(absl::Seconds(5)).result());
+    MutexLock lock(&mutex);
+    EXPECT_GE(closed_at - last_read, absl::Seconds(30));
+    EXPECT_LT(closed_at - last_read, absl::Seconds(35));
+  }
+  VirtualClock::Instance().Stop();
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
@@ -14,6 +14,10 @@
 
 #include "core/internal/internal_payload.h"
 
+#include <memory>
+
+#include "absl/strings/string_view.h"
+
 namespace location {
 namespace nearby {
 namespace connections {
@@ -28,6 +32,25 @@ Payload InternalPayload::ReleasePayload() { return std::move(payload_); }
 
 Payload::Id InternalPayload::GetId() const { return payload_id_; }
 
+void InternalPayload::EnableChecksum() {
+  checksum_ = std::make_unique<Crypto::Sha256Stream>();
+}
+
+ByteArray InternalPayload::FinishChecksum() {
+  if (!checksum_) return {};
+  ByteArray checksum = checksum_->Finish();
+  checksum_.reset();
+  return checksum;
+}
+
+void InternalPayload::UpdateChecksum(const ByteArray& chunk) {
+  if (checksum_) {
+    checksum_->Update(absl::string_view(chunk.data(), chunk.size()));
+  }
+}
+
+void InternalPayload::DropChecksum() { checksum_.reset(); }
+
 }  // namespace connections
 }  // namespace nearby
 }  // namespace location
@@ -16,10 +16,12 @@
 #define CORE_INTERNAL_INTERNAL_PAYLOAD_H_
 
 #include <cstdint>
+#include <memory>
 
 #include "core/payload.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
+#include "platform/public/crypto.h"
 
 namespace location {
 namespace nearby {
@@ -76,8 +78,10 @@ class InternalPayload {
   //
   // @param chunk The next chunk; this being null signals that this is the last
   // chunk, which will typically be used as a trigger to perform whatever state
-  // cleanup may be required by the concrete implementation.
-  virtual Exception AttachNextChunk(const ByteArray& chunk) = 0;
+  // cleanup may be required by the concrete implementation. The payload takes
+  // the chunk over: implementations that don't keep it give its buffer back to
+  // BufferPool.
+  virtual Exception AttachNextChunk(ByteArray&& chunk) = 0;
 
   // Skips current stream pointer to the offset.
   //
@@ -87,16 +91,44 @@ class InternalPayload {
   // @return the offset really skipped
   virtual ExceptionOr<size_t> SkipToOffset(size_t offset) = 0;
 
+  // Returns how many bytes of an incoming payload, counted from its start,
+  // are known to be synced to storage. A transfer interrupted after that
+  // point can be resumed from this offset.
+  virtual std::int64_t GetCommittedOffset() const { return 0; }
+
+  // Returns how many bytes of an incoming payload, counted from its start,
+  // have been attached so far. Only kept by payloads that can be resumed, i.e.
+  // those with a committed offset.
+  virtual std::int64_t GetWrittenOffset() const { return 0; }
+
   // Cleans up any resources used by this Payload. Called when we're stopping
   // early, e.g. after being cancelled or having no more recipients left.
   virtual void Close() {}
 
+  // Starts computing a checksum of the chunks detached from or attached to
+  // this payload. Must be called before the first chunk.
+  void EnableChecksum();
+
+  // Returns the SHA256 checksum of all chunks, from the start of the payload,
+  // and stops computing it. Returns an empty ByteArray if there is no such
+  // checksum, e.g. because it was never enabled, or the payload skipped ahead.
+  ByteArray FinishChecksum();
+
  protected:
+  // Called by implementations with each chunk that is detached or attached.
+  void UpdateChecksum(const ByteArray& chunk);
+  // Called by implementations that skip ahead; the checksum then no longer
+  // covers the whole payload.
+  void DropChecksum();
+
   Payload payload_;
   // We're caching the payload ID here because the backing payload will be
   // released to another owner during the lifetime of an incoming
   // InternalPayload.
   Payload::Id payload_id_;
+
+ private:
+  std::unique_ptr<Crypto::Sha256Stream> checksum_;
 };
 
 }  // namespace connections
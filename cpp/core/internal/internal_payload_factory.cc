@@ -19,13 +19,15 @@
 
 #include "absl/memory/memory.h"
 #include "core/payload.h"
+#include "core/payload_source.h"
+#include "platform/base/buffer_pool.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
+#include "platform/base/feature_flags.h"
 #include "platform/public/condition_variable.h"
 #include "platform/public/file.h"
 #include "platform/public/logging.h"
 #include "platform/public/mutex.h"
-#include "platform/public/pipe.h"
 
 namespace location {
 namespace nearby {
@@ -33,6 +35,11 @@ namespace connections {
 
 namespace {
 
+// Gives the buffer of a chunk that a payload does not keep back to BufferPool.
+void RecycleChunk(ByteArray&& chunk) {
+  if (!chunk.Empty()) BufferPool::GetInstance().Release(std::move(chunk));
+}
+
 class BytesInternalPayload : public InternalPayload {
  public:
   explicit BytesInternalPayload(Payload payload)
@@ -57,8 +64,9 @@ class BytesInternalPayload : public InternalPayload {
     return std::move(payload_).AsBytes();
   }
 
-  // Does nothing.
-  Exception AttachNextChunk(const ByteArray& chunk) override {
+  // Does nothing but recycle the chunk.
+  Exception AttachNextChunk(ByteArray&& chunk) override {
+    RecycleChunk(std::move(chunk));
     return {Exception::kSuccess};
   }
 
@@ -87,6 +95,9 @@ class OutgoingStreamInternalPayload : public InternalPayload {
   std::int64_t GetTotalSize() const override { return -1; }
 
   ByteArray DetachNextChunk(int chunk_size) override {
+    PayloadSource* source = payload_.AsSource();
+    if (source) return DetachNextSourceChunk(*source, chunk_size);
+
     InputStream* input_stream = payload_.AsStream();
     if (!input_stream) return {};
 
@@ -106,10 +117,12 @@ class OutgoingStreamInternalPayload : public InternalPayload {
       return {};
     }
 
+    UpdateChecksum(scoped_bytes_read);
     return scoped_bytes_read;
   }
 
-  Exception AttachNextChunk(const ByteArray& chunk) override {
+  Exception AttachNextChunk(ByteArray&& chunk) override {
+    RecycleChunk(std::move(chunk));
     return {Exception::kIo};
   }
 
@@ -117,6 +130,7 @@ class OutgoingStreamInternalPayload : public InternalPayload {
     InputStream* stream = payload_.AsStream();
     if (stream == nullptr) return {Exception::kIo};
 
+    DropChecksum();
     ExceptionOr<size_t> real_offset = stream->Skip(offset);
     if (real_offset.ok() && real_offset.GetResult() == offset) {
       return real_offset;
@@ -138,12 +152,30 @@ class OutgoingStreamInternalPayload : public InternalPayload {
     InputStream* stream = payload_.AsStream();
     if (stream) stream->Close();
   }
+
+ private:
+  // Hands over the buffers the producer wrote, without copying the ones that
+  // fit in a chunk.
+  ByteArray DetachNextSourceChunk(PayloadSource& source, int chunk_size) {
+    ExceptionOr<ByteArray> buffer = source.Read(chunk_size);
+    if (!buffer.ok() || buffer.result().Empty()) {
+      NEARBY_LOGS(INFO) << "No more data for outgoing payload " << this
+                        << ", closing PayloadSource.";
+      source.Cancel();
+      return {};
+    }
+
+    ByteArray chunk = std::move(buffer.result());
+    UpdateChecksum(chunk);
+    return chunk;
+  }
 };
 
 class IncomingStreamInternalPayload : public InternalPayload {
  public:
-  IncomingStreamInternalPayload(Payload payload, OutputStream& output_stream)
-      : InternalPayload(std::move(payload)), output_stream_(&output_stream) {}
+  IncomingStreamInternalPayload(Payload payload,
+                                std::shared_ptr<PayloadSource> source)
+      : InternalPayload(std::move(payload)), source_(std::move(source)) {}
 
   PayloadTransferFrame::PayloadHeader::PayloadType GetType() const override {
     return PayloadTransferFrame::PayloadHeader::STREAM;
@@ -153,15 +185,16 @@ class IncomingStreamInternalPayload : public InternalPayload {
 
   ByteArray DetachNextChunk(int chunk_size) override { return {}; }
 
-  Exception AttachNextChunk(const ByteArray& chunk) override {
+  Exception AttachNextChunk(ByteArray&& chunk) override {
     if (chunk.Empty()) {
       NEARBY_LOGS(INFO) << "Received null last chunk for incoming payload "
-                        << this << ", closing OutputStream.";
-      output_stream_->Close();
+                        << this << ", closing PayloadSource.";
+      source_->Close();
       return {Exception::kSuccess};
     }
 
-    return output_stream_->Write(chunk);
+    UpdateChecksum(chunk);
+    return source_->Write(std::move(chunk));
   }
 
   ExceptionOr<size_t> SkipToOffset(size_t offset) override {
@@ -170,10 +203,10 @@ class IncomingStreamInternalPayload : public InternalPayload {
     return {Exception::kIo};
   }
 
-  void Close() override { output_stream_->Close(); }
+  void Close() override { source_->Close(); }
 
  private:
-  OutputStream* output_stream_;
+  std::shared_ptr<PayloadSource> source_;
 };
 
 class OutgoingFileInternalPayload : public InternalPayload {
@@ -206,10 +239,12 @@ class OutgoingFileInternalPayload : public InternalPayload {
       return {};
     }
 
+    UpdateChecksum(bytes);
     return bytes;
   }
 
-  Exception AttachNextChunk(const ByteArray& chunk) override {
+  Exception AttachNextChunk(ByteArray&& chunk) override {
+    RecycleChunk(std::move(chunk));
     return {Exception::kIo};
   }
 
@@ -220,6 +255,7 @@ class OutgoingFileInternalPayload : public InternalPayload {
       return {Exception::kIo};
     }
 
+    DropChecksum();
     ExceptionOr<size_t> real_offset = file->Skip(offset);
     if (real_offset.ok() && real_offset.GetResult() == offset) {
       return real_offset;
@@ -246,11 +282,19 @@ class OutgoingFileInternalPayload : public InternalPayload {
 
 class IncomingFileInternalPayload : public InternalPayload {
  public:
+  // Bytes written between two syncs of the output file. Each sync advances
+  // the committed offset, which is what an interrupted transfer resumes from.
+  static constexpr std::int64_t kCommitIntervalBytes = 1024 * 1024;
+
+  // |offset| is the number of bytes already held by output_file, when
+  // resuming an interrupted transfer.
   IncomingFileInternalPayload(Payload payload, OutputFile output_file,
-                              std::int64_t total_size)
+                              std::int64_t total_size, std::int64_t offset)
       : InternalPayload(std::move(payload)),
         output_file_(std::move(output_file)),
-        total_size_(total_size) {}
+        total_size_(total_size),
+        written_offset_(offset),
+        committed_offset_(offset) {}
 
   PayloadTransferFrame::PayloadHeader::PayloadType GetType() const override {
     return PayloadTransferFrame::PayloadHeader::FILE;
@@ -260,14 +304,24 @@ class IncomingFileInternalPayload : public InternalPayload {
 
   ByteArray DetachNextChunk(int chunk_size) override { return {}; }
 
-  Exception AttachNextChunk(const ByteArray& chunk) override {
+  Exception AttachNextChunk(ByteArray&& chunk) override {
     if (chunk.Empty()) {
       // Received null last chunk for incoming payload.
       output_file_.Close();
       return {Exception::kSuccess};
     }
 
-    return output_file_.Write(chunk);
+    Exception write_exception = output_file_.Write(chunk);
+    if (write_exception.Ok()) {
+      UpdateChecksum(chunk);
+      written_offset_ += chunk.size();
+      if (written_offset_ - committed_offset_ >= kCommitIntervalBytes &&
+          output_file_.Sync().Ok()) {
+        committed_offset_ = written_offset_;
+      }
+    }
+    RecycleChunk(std::move(chunk));
+    return write_exception;
   }
 
   ExceptionOr<size_t> SkipToOffset(size_t offset) override {
@@ -276,13 +330,29 @@ class IncomingFileInternalPayload : public InternalPayload {
     return {Exception::kIo};
   }
 
+  std::int64_t GetCommittedOffset() const override { return committed_offset_; }
+
+  std::int64_t GetWrittenOffset() const override { return written_offset_; }
+
   void Close() override { output_file_.Close(); }
 
  private:
   OutputFile output_file_;
   const std::int64_t total_size_;
+  std::int64_t written_offset_;
+  std::int64_t committed_offset_;
 };
 
+// Checksums only cover payloads transferred from their start; a resumed
+// incoming file doesn't get one.
+std::unique_ptr<InternalPayload> WithChecksum(
+    std::unique_ptr<InternalPayload> payload) {
+  if (FeatureFlags::GetInstance().GetFlags().enable_payload_checksums) {
+    payload->EnableChecksum();
+  }
+  return payload;
+}
+
 }  // namespace
 
 std::unique_ptr<InternalPayload> CreateOutgoingInternalPayload(
@@ -296,12 +366,13 @@ std::unique_ptr<InternalPayload> CreateOutgoingInternalPayload(
       const PayloadId file_payload_id = file ? file->GetPayloadId() : 0;
       const PayloadId payload_id = payload.GetId();
       CHECK(payload_id == file_payload_id);
-      return absl::make_unique<OutgoingFileInternalPayload>(std::move(payload));
+      return WithChecksum(
+          absl::make_unique<OutgoingFileInternalPayload>(std::move(payload)));
     }
 
     case Payload::Type::kStream:
-      return absl::make_unique<OutgoingStreamInternalPayload>(
-          std::move(payload));
+      return WithChecksum(
+          absl::make_unique<OutgoingStreamInternalPayload>(std::move(payload)));
 
     default:
       DCHECK(false);  // This should never happen.
@@ -310,7 +381,7 @@ std::unique_ptr<InternalPayload> CreateOutgoingInternalPayload(
 }
 
 std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
-    const PayloadTransferFrame& frame) {
+    const PayloadTransferFrame& frame, std::int64_t resume_offset) {
   if (frame.packet_type() != PayloadTransferFrame::DATA) {
     return {};
   }
@@ -323,21 +394,31 @@ std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
     }
 
     case PayloadTransferFrame::PayloadHeader::STREAM: {
-      auto pipe = std::make_shared<Pipe>();
-
-      return absl::make_unique<IncomingStreamInternalPayload>(
-          Payload(payload_id,
-                  [pipe]() -> InputStream& {
-                    return pipe->GetInputStream();  // NOLINT
-                  }),
-          pipe->GetOutputStream());
+      // Unbounded, so that a slow reader doesn't stall the endpoint's other
+      // payloads; chunks are handed over as they arrive.
+      auto source = std::make_shared<PayloadSource>(PayloadSource::kUnbounded);
+
+      return WithChecksum(absl::make_unique<IncomingStreamInternalPayload>(
+          Payload(payload_id, source), source));
     }
 
     case PayloadTransferFrame::PayloadHeader::FILE: {
       std::int64_t total_size = frame.payload_header().total_size();
-      return absl::make_unique<IncomingFileInternalPayload>(
+      if (resume_offset > 0) {
+        OutputFile output_file(payload_id, resume_offset);
+        if (output_file.IsValid()) {
+          return absl::make_unique<IncomingFileInternalPayload>(
+              Payload(payload_id, InputFile(payload_id, total_size)),
+              std::move(output_file), total_size, resume_offset);
+        }
+        // The app may have deleted or truncated the partial file since.
+        NEARBY_LOGS(WARNING) << "File of payload " << payload_id
+                             << " no longer holds " << resume_offset
+                             << " bytes; receiving it from the start.";
+      }
+      return WithChecksum(absl::make_unique<IncomingFileInternalPayload>(
           Payload(payload_id, InputFile(payload_id, total_size)),
-          OutputFile(payload_id), total_size);
+          OutputFile(payload_id), total_size, /*offset=*/0));
     }
     default:
       DCHECK(false);  // This should never happen.
@@ -27,8 +27,12 @@ std::unique_ptr<InternalPayload> CreateOutgoingInternalPayload(Payload payload);
 
 // Creates an InternalPayload representing an incoming Payload from a remote
 // endpoint.
+// For a FILE payload, a positive |resume_offset| means the output file already
+// holds that many bytes from an interrupted transfer; they are kept, and the
+// file is appended to from there on. If the file doesn't hold them anymore,
+// the payload starts from 0; GetCommittedOffset() tells which one it was.
 std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
-    const PayloadTransferFrame& frame);
+    const PayloadTransferFrame& frame, std::int64_t resume_offset = 0);
 
 }  // namespace connections
 }  // namespace nearby
@@ -20,7 +20,12 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "core/internal/offline_frames.h"
+#include "core/payload_source.h"
+#include "platform/base/buffer_pool.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/feature_flags.h"
+#include "platform/base/medium_environment.h"
+#include "platform/public/crypto.h"
 #include "platform/public/pipe.h"
 #include "proto/connections/offline_wire_formats.pb.h"
 
@@ -176,6 +181,139 @@ TEST(InternalPayloadFActoryTest,
   EXPECT_EQ(contents_after_skip, ByteArray("6789"));
 }
 
+TEST(InternalPayloadFActoryTest, SourcePayloadDetachesWrittenBuffers) {
+  auto source = std::make_shared<PayloadSource>();
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateOutgoingInternalPayload(Payload{source});
+  EXPECT_EQ(internal_payload->GetType(),
+            PayloadTransferFrame::PayloadHeader::STREAM);
+  std::string data(512, 'x');
+  const char* buffer_data = data.data();
+  EXPECT_TRUE(source->Write(ByteArray(std::move(data))).Ok());
+  EXPECT_TRUE(source->Write(ByteArray("0123456789")).Ok());
+  source->Close();
+
+  ByteArray first = internal_payload->DetachNextChunk(512);
+  EXPECT_EQ(first.size(), 512);
+  EXPECT_EQ(first.data(), buffer_data);
+  EXPECT_EQ(internal_payload->DetachNextChunk(6), ByteArray("012345"));
+  EXPECT_EQ(internal_payload->DetachNextChunk(6), ByteArray("6789"));
+  EXPECT_TRUE(internal_payload->DetachNextChunk(6).Empty());
+}
+
+TEST(InternalPayloadFActoryTest, StreamMessageAttachesChunksToSource) {
+  PayloadTransferFrame frame;
+  frame.set_packet_type(PayloadTransferFrame::DATA);
+  auto& header = *frame.mutable_payload_header();
+  header.set_type(PayloadTransferFrame::PayloadHeader::STREAM);
+  header.set_id(12345);
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateIncomingInternalPayload(frame);
+  Payload payload = internal_payload->ReleasePayload();
+  PayloadSource* source = payload.AsSource();
+  ASSERT_NE(source, nullptr);
+
+  EXPECT_TRUE(internal_payload->AttachNextChunk(ByteArray(kText)).Ok());
+  EXPECT_TRUE(internal_payload->AttachNextChunk(ByteArray()).Ok());
+
+  ExceptionOr<ByteArray> chunk = source->Read(512);
+  ASSERT_TRUE(chunk.ok());
+  EXPECT_EQ(chunk.result(), ByteArray(kText));
+  chunk = source->Read(512);
+  ASSERT_TRUE(chunk.ok());
+  EXPECT_TRUE(chunk.result().Empty());
+}
+
+TEST(InternalPayloadFActoryTest, FileMessageRecyclesAttachedChunks) {
+  PayloadTransferFrame frame;
+  frame.set_packet_type(PayloadTransferFrame::DATA);
+  auto& header = *frame.mutable_payload_header();
+  header.set_type(PayloadTransferFrame::PayloadHeader::FILE);
+  header.set_id(Payload::GenerateId());
+  header.set_total_size(BufferPool::kMinBufferSize);
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateIncomingInternalPayload(frame);
+  BufferPool& pool = BufferPool::GetInstance();
+  std::int64_t released = pool.GetStats().released;
+
+  ByteArray chunk = pool.Acquire(BufferPool::kMinBufferSize);
+  EXPECT_TRUE(internal_payload->AttachNextChunk(std::move(chunk)).Ok());
+  EXPECT_TRUE(internal_payload->AttachNextChunk(ByteArray()).Ok());
+
+  EXPECT_EQ(pool.GetStats().released, released + 1);
+}
+
+class InternalPayloadChecksumTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FeatureFlags::Flags flags = FeatureFlags::GetInstance().GetFlags();
+    flags.enable_payload_checksums = true;
+    MediumEnvironment::Instance().SetFeatureFlags(flags);
+  }
+  void TearDown() override {
+    MediumEnvironment::Instance().SetFeatureFlags(FeatureFlags::Flags());
+  }
+
+  std::unique_ptr<InternalPayload> CreateOutgoingStream(
+      std::shared_ptr<Pipe> pipe) {
+    pipe->GetOutputStream().Write(ByteArray(std::string(kText)));
+    pipe->GetOutputStream().Close();
+    return CreateOutgoingInternalPayload(Payload{[pipe]() -> InputStream& {
+      return pipe->GetInputStream();  // NOLINT
+    }});
+  }
+};
+
+TEST_F(InternalPayloadChecksumTest, OutgoingStreamChecksumCoversAllChunks) {
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateOutgoingStream(std::make_shared<Pipe>());
+
+  while (!internal_payload->DetachNextChunk(4).Empty()) {
+  }
+
+  EXPECT_EQ(internal_payload->FinishChecksum(), Crypto::Sha256(kText));
+  EXPECT_TRUE(internal_payload->FinishChecksum().Empty());
+}
+
+TEST_F(InternalPayloadChecksumTest, OutgoingStreamHasNoChecksumAfterSkip) {
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateOutgoingStream(std::make_shared<Pipe>());
+
+  EXPECT_TRUE(internal_payload->SkipToOffset(4).ok());
+  while (!internal_payload->DetachNextChunk(4).Empty()) {
+  }
+
+  EXPECT_TRUE(internal_payload->FinishChecksum().Empty());
+}
+
+TEST_F(InternalPayloadChecksumTest, IncomingStreamChecksumCoversAllChunks) {
+  PayloadTransferFrame frame;
+  frame.set_packet_type(PayloadTransferFrame::DATA);
+  auto& header = *frame.mutable_payload_header();
+  header.set_type(PayloadTransferFrame::PayloadHeader::STREAM);
+  header.set_id(12345);
+  header.set_total_size(0);
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateIncomingInternalPayload(frame);
+  std::string text(kText);
+
+  EXPECT_TRUE(
+      internal_payload->AttachNextChunk(ByteArray(text.substr(0, 4))).Ok());
+  EXPECT_TRUE(
+      internal_payload->AttachNextChunk(ByteArray(text.substr(4))).Ok());
+
+  EXPECT_EQ(internal_payload->FinishChecksum(), Crypto::Sha256(kText));
+}
+
+TEST(InternalPayloadFActoryTest, HasNoChecksumByDefault) {
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateOutgoingInternalPayload(Payload{ByteArray(kText)});
+
+  internal_payload->DetachNextChunk(4);
+
+  EXPECT_TRUE(internal_payload->FinishChecksum().Empty());
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
@@ -0,0 +1,168 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/medium_quality_tracker.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+using ::location::nearby::proto::connections::Medium;
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr absl::Duration ThroughputSampler::kSampleWindow;
+constexpr absl::Duration ThroughputSampler::kMaxIdleTime;
+constexpr double MediumQualityTracker::kSmoothingFactor;
+constexpr absl::Duration MediumQualityTracker::kSampleWindow;
+
+double ThroughputSampler::RecordWrite(std::int64_t size, absl::Time start_time,
+                                      absl::Time end_time) {
+  if (start_time - last_write_end_ > kMaxIdleTime) {
+    window_start_ = start_time;
+    window_bytes_ = 0;
+  }
+  window_bytes_ += size;
+  last_write_end_ = std::max(last_write_end_, end_time);
+
+  absl::Duration window = last_write_end_ - window_start_;
+  if (window < kSampleWindow) return 0;
+  double sample = window_bytes_ / absl::ToDoubleSeconds(window);
+  window_start_ = last_write_end_;
+  window_bytes_ = 0;
+  return sample;
+}
+
+void MediumQualityTracker::RecordWrite(const std::string& endpoint_id,
+                                       Medium medium, std::int64_t size,
+                                       absl::Time start_time,
+                                       absl::Time end_time) {
+  MutexLock lock(&mutex_);
+  Link& link = links_[LinkKey(endpoint_id, medium)];
+  double sample = link.sampler.RecordWrite(size, start_time, end_time);
+  if (sample <= 0) return;
+  AddSample(sample, link.throughput);
+  AddSample(sample, stats_[medium].throughput);
+}
+
+void MediumQualityTracker::ForgetEndpoint(const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+  for (auto item = links_.begin(); item != links_.end();) {
+    if (item->first.first == endpoint_id) {
+      links_.erase(item++);
+    } else {
+      ++item;
+    }
+  }
+}
+
+void MediumQualityTracker::RecordUpgradeResult(Medium medium, bool success) {
+  MutexLock lock(&mutex_);
+  Stats& stats = stats_[medium];
+  stats.link_quality +=
+      kSmoothingFactor * ((success ? 1.0 : 0.0) - stats.link_quality);
+}
+
+double MediumQualityTracker::GetThroughput(Medium medium) const {
+  MutexLock lock(&mutex_);
+  return GetThroughputLocked(medium);
+}
+
+double MediumQualityTracker::GetThroughput(const std::string& endpoint_id,
+                                           Medium medium) const {
+  MutexLock lock(&mutex_);
+  return GetThroughputLocked(endpoint_id, medium);
+}
+
+double MediumQualityTracker::GetLinkQuality(Medium medium) const {
+  MutexLock lock(&mutex_);
+  return GetLinkQualityLocked(medium);
+}
+
+Medium MediumQualityTracker::ChooseBest(
+    const std::string& endpoint_id, const std::vector<Medium>& mediums) const {
+  MutexLock lock(&mutex_);
+  Medium best_medium = Medium::UNKNOWN_MEDIUM;
+  double best_score = -1;
+  for (Medium medium : mediums) {
+    double score = GetThroughputLocked(endpoint_id, medium) *
+                   GetLinkQualityLocked(medium);
+    if (score > best_score) {
+      best_medium = medium;
+      best_score = score;
+    }
+  }
+  return best_medium;
+}
+
+double MediumQualityTracker::GetNominalThroughput(Medium medium) {
+  // Rough figures, in bytes per second; they only need to get the order of
+  // the mediums right.
+  switch (medium) {
+    case Medium::WIFI_LAN:
+      return 6e6;
+    case Medium::WIFI_HOTSPOT:
+    case Medium::WIFI_DIRECT:
+    case Medium::WIFI_AWARE:
+      return 4e6;
+    case Medium::WEB_RTC:
+      return 1e6;
+    case Medium::BLUETOOTH:
+      return 1e5;
+    case Medium::BLE:
+      return 1e4;
+    default:
+      return 0;
+  }
+}
+
+void MediumQualityTracker::AddSample(double sample, double& estimate) {
+  if (estimate <= 0) {
+    estimate = sample;
+  } else {
+    estimate += kSmoothingFactor * (sample - estimate);
+  }
+}
+
+double MediumQualityTracker::GetThroughputLocked(Medium medium) const {
+  auto item = stats_.find(medium);
+  if (item == stats_.end() || item->second.throughput <= 0) {
+    return GetNominalThroughput(medium);
+  }
+  return item->second.throughput;
+}
+
+double MediumQualityTracker::GetThroughputLocked(
+    const std::string& endpoint_id, Medium medium) const {
+  auto item = links_.find(LinkKey(endpoint_id, medium));
+  if (item == links_.end() || item->second.throughput <= 0) {
+    return GetThroughputLocked(medium);
+  }
+  return item->second.throughput;
+}
+
+double MediumQualityTracker::GetLinkQualityLocked(Medium medium) const {
+  auto item = stats_.find(medium);
+  return item == stats_.end() ? 1.0 : item->second.link_quality;
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
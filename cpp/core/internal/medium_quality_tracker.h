@@ -0,0 +1,147 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_MEDIUM_QUALITY_TRACKER_H_
+#define CORE_INTERNAL_MEDIUM_QUALITY_TRACKER_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "platform/public/mutex.h"
+#include "proto/connections_enums.pb.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Turns the writes to a link into throughput samples, each taken over a
+// window of back-to-back writes that lasts at least kSampleWindow, so that a
+// single write, which may only have filled a socket buffer, is never taken for
+// the throughput of the link. Not thread-safe.
+class ThroughputSampler {
+ public:
+  // Shortest span of writes a throughput sample is taken over.
+  static constexpr absl::Duration kSampleWindow = absl::Seconds(1);
+  // A link that goes without writes for longer than this was idle rather than
+  // busy, so the window in progress starts over.
+  static constexpr absl::Duration kMaxIdleTime = absl::Milliseconds(250);
+
+  // Records that writing |size| bytes started at |start_time| and completed
+  // at |end_time|. Returns the throughput over the window in bytes per second
+  // once the window has lasted kSampleWindow, and 0 while it is in progress.
+  double RecordWrite(std::int64_t size, absl::Time start_time,
+                     absl::Time end_time);
+
+ private:
+  // The window of writes in progress.
+  absl::Time window_start_ = absl::InfinitePast();
+  absl::Time last_write_end_ = absl::InfinitePast();
+  std::int64_t window_bytes_ = 0;
+};
+
+// Keeps track of how well each medium has been doing lately, to pick the
+// medium to upgrade an endpoint to.
+//
+// A medium is scored by its throughput times its link quality, i.e. how often
+// upgrades to it have succeeded. Throughput is the rate at which payload
+// chunks got delivered over a link (an endpoint on a medium), sampled over
+// windows of back-to-back writes that last at least kSampleWindow; that of
+// the link to the endpoint being upgraded wins over that of the medium as a
+// whole. Until a medium has been sampled, it is assumed to perform at a
+// nominal throughput typical of that medium. Thread-safe.
+class MediumQualityTracker {
+ public:
+  // Weight of the newest sample in the estimates of a medium.
+  static constexpr double kSmoothingFactor = 0.25;
+  // Shortest span of writes a throughput sample is taken over.
+  static constexpr absl::Duration kSampleWindow =
+      ThroughputSampler::kSampleWindow;
+
+  // Records that writing |size| bytes to |endpoint_id| over |medium| started
+  // at |start_time| and completed at |end_time|.
+  void RecordWrite(const std::string& endpoint_id,
+                   proto::connections::Medium medium, std::int64_t size,
+                   absl::Time start_time, absl::Time end_time)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Drops what was measured over the links to |endpoint_id|.
+  void ForgetEndpoint(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Records whether an upgrade to |medium| succeeded.
+  void RecordUpgradeResult(proto::connections::Medium medium, bool success)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the estimated throughput of |medium| in bytes per second.
+  double GetThroughput(proto::connections::Medium medium) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the estimated throughput of the link to |endpoint_id| over
+  // |medium| in bytes per second, or that of |medium| if the link hasn't been
+  // sampled.
+  double GetThroughput(const std::string& endpoint_id,
+                       proto::connections::Medium medium) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the link quality of |medium|, between 0 and 1.
+  double GetLinkQuality(proto::connections::Medium medium) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the medium of |mediums| with the best score for |endpoint_id|, or
+  // UNKNOWN_MEDIUM if |mediums| is empty. Of mediums that score the same, the
+  // earlier one wins.
+  proto::connections::Medium ChooseBest(
+      const std::string& endpoint_id,
+      const std::vector<proto::connections::Medium>& mediums) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Stats {
+    // Bytes per second; 0 until sampled.
+    double throughput = 0;
+    double link_quality = 1.0;
+  };
+  struct Link {
+    // Bytes per second; 0 until sampled.
+    double throughput = 0;
+    ThroughputSampler sampler;
+  };
+  using LinkKey = std::pair<std::string, proto::connections::Medium>;
+
+  static double GetNominalThroughput(proto::connections::Medium medium);
+  static void AddSample(double sample, double& estimate);
+  double GetThroughputLocked(proto::connections::Medium medium) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  double GetThroughputLocked(const std::string& endpoint_id,
+                             proto::connections::Medium medium) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  double GetLinkQualityLocked(proto::connections::Medium medium) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable Mutex mutex_;
+  absl::flat_hash_map<proto::connections::Medium, Stats> stats_
+      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<LinkKey, Link> links_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_MEDIUM_QUALITY_TRACKER_H_
@@ -0,0 +1,154 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/medium_quality_tracker.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "proto/connections_enums.pb.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+using ::location::nearby::proto::connections::Medium;
+
+constexpr char kEndpointId[] = "ABCD";
+constexpr char kOtherEndpointId[] = "WXYZ";
+
+// Writes |bytes_per_second| to |endpoint_id| over |medium| for a sample
+// window, in back-to-back writes of a tenth of a second each.
+void WriteForSampleWindow(MediumQualityTracker& tracker,
+                          const std::string& endpoint_id, Medium medium,
+                          std::int64_t bytes_per_second,
+                          absl::Time start = absl::UnixEpoch()) {
+  absl::Duration write_time = absl::Milliseconds(100);
+  int writes = MediumQualityTracker::kSampleWindow / write_time;
+  for (int i = 0; i < writes; ++i) {
+    tracker.RecordWrite(endpoint_id, medium, bytes_per_second / 10,
+                        start + i * write_time, start + (i + 1) * write_time);
+  }
+}
+
+TEST(MediumQualityTrackerTest, UnmeasuredMediumsKeepTheirUsualOrder) {
+  MediumQualityTracker tracker;
+
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::BLUETOOTH, Medium::WEB_RTC,
+                                             Medium::WIFI_LAN}),
+            Medium::WIFI_LAN);
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::BLUETOOTH,
+                                             Medium::WEB_RTC}),
+            Medium::WEB_RTC);
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {}), Medium::UNKNOWN_MEDIUM);
+}
+
+TEST(MediumQualityTrackerTest, PrefersMeasuredThroughput) {
+  MediumQualityTracker tracker;
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 1000);
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WEB_RTC, 4000);
+
+  EXPECT_DOUBLE_EQ(tracker.GetThroughput(Medium::WIFI_LAN), 1000);
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::WIFI_LAN,
+                                             Medium::WEB_RTC}),
+            Medium::WEB_RTC);
+}
+
+TEST(MediumQualityTrackerTest, FastWritesAreNotASample) {
+  MediumQualityTracker tracker;
+  tracker.RecordWrite(kEndpointId, Medium::WIFI_LAN, 1 << 20,
+                      absl::UnixEpoch(),
+                      absl::UnixEpoch() + absl::Microseconds(10));
+
+  EXPECT_EQ(tracker.GetThroughput(Medium::WIFI_LAN),
+            tracker.GetThroughput(kOtherEndpointId, Medium::WIFI_LAN));
+  EXPECT_LT(tracker.GetThroughput(Medium::WIFI_LAN), 1e7);
+}
+
+TEST(MediumQualityTrackerTest, IdleTimeIsNotSampled) {
+  MediumQualityTracker tracker;
+  tracker.RecordWrite(kEndpointId, Medium::WIFI_LAN, 1000, absl::UnixEpoch(),
+                      absl::UnixEpoch() + absl::Milliseconds(500));
+  absl::Time after_idle_time = absl::UnixEpoch() + absl::Seconds(10);
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 2000,
+                       after_idle_time);
+
+  EXPECT_DOUBLE_EQ(tracker.GetThroughput(Medium::WIFI_LAN), 2000);
+}
+
+TEST(MediumQualityTrackerTest, ThroughputIsSmoothed) {
+  MediumQualityTracker tracker;
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 100);
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 200,
+                       absl::UnixEpoch() + MediumQualityTracker::kSampleWindow);
+
+  EXPECT_DOUBLE_EQ(tracker.GetThroughput(Medium::WIFI_LAN),
+                   MediumQualityTracker::kSmoothingFactor * 200 +
+                       (1 - MediumQualityTracker::kSmoothingFactor) * 100);
+}
+
+TEST(MediumQualityTrackerTest, PrefersThroughputOfTheEndpoint) {
+  MediumQualityTracker tracker;
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 1000);
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WEB_RTC, 2000);
+  WriteForSampleWindow(tracker, kOtherEndpointId, Medium::WIFI_LAN, 100000);
+
+  EXPECT_DOUBLE_EQ(tracker.GetThroughput(kEndpointId, Medium::WIFI_LAN),
+                   1000);
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::WIFI_LAN,
+                                             Medium::WEB_RTC}),
+            Medium::WEB_RTC);
+
+  tracker.ForgetEndpoint(kEndpointId);
+  EXPECT_EQ(tracker.GetThroughput(kEndpointId, Medium::WIFI_LAN),
+            tracker.GetThroughput(Medium::WIFI_LAN));
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::WIFI_LAN,
+                                             Medium::WEB_RTC}),
+            Medium::WIFI_LAN);
+}
+
+TEST(MediumQualityTrackerTest, FailedUpgradesLowerTheScore) {
+  MediumQualityTracker tracker;
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 2000);
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WEB_RTC, 1500);
+  for (int i = 0; i < 3; i++) {
+    tracker.RecordUpgradeResult(Medium::WIFI_LAN, /*success=*/false);
+  }
+
+  EXPECT_LT(tracker.GetLinkQuality(Medium::WIFI_LAN), 0.5);
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::WIFI_LAN,
+                                             Medium::WEB_RTC}),
+            Medium::WEB_RTC);
+
+  tracker.RecordUpgradeResult(Medium::WIFI_LAN, /*success=*/true);
+  EXPECT_GT(tracker.GetLinkQuality(Medium::WIFI_LAN), 0.5);
+}
+
+TEST(MediumQualityTrackerTest, TiesGoToTheEarlierMedium) {
+  MediumQualityTracker tracker;
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WIFI_LAN, 1000);
+  WriteForSampleWindow(tracker, kEndpointId, Medium::WEB_RTC, 1000);
+
+  EXPECT_EQ(tracker.ChooseBest(kEndpointId, {Medium::WEB_RTC,
+                                             Medium::WIFI_LAN}),
+            Medium::WEB_RTC);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -193,7 +193,8 @@ class BluetoothClassic {
 
   // A thread pool dedicated to running all the accept loops from
   // StartAcceptingConnections().
-  MultiThreadExecutor accept_loops_runner_{kMaxConcurrentAcceptLoops};
+  MultiThreadExecutor accept_loops_runner_{"bluetooth-accept-loops",
+                                          kMaxConcurrentAcceptLoops};
 
   // A map of service Name -> ServerSocket. If map is non-empty, we
   // are currently listening for incoming connections.
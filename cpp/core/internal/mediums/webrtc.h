@@ -238,7 +238,8 @@ class WebRtc {
   WebRtcMedium medium_;
 
   // The single thread we throw the potentially blocking work on to.
-  ScheduledExecutor single_thread_executor_;
+  ScheduledExecutor single_thread_executor_{
+      "webrtc", ScheduledExecutor::TaskType::kBlocking};
 
   // A map of ServiceID -> State for all services that are listening for
   // incoming connections.
@@ -112,7 +112,7 @@ class WebRtcSocket : public Socket, public webrtc::DataChannelObserver {
 
   // This should be destroyed first to ensure any remaining tasks flushed on
   // shutdown get run while the other members are still alive.
-  SingleThreadExecutor single_thread_executor_;
+  SingleThreadExecutor single_thread_executor_{"webrtc-socket"};
 };
 
 }  // namespace mediums
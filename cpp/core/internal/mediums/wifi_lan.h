@@ -177,7 +177,8 @@ class WifiLan {
 
   // A thread pool dedicated to running all the accept loops from
   // StartAcceptingConnections().
-  MultiThreadExecutor accept_loops_runner_{kMaxConcurrentAcceptLoops};
+  MultiThreadExecutor accept_loops_runner_{"wifi-lan-accept-loops",
+                                          kMaxConcurrentAcceptLoops};
 
   // A map of service_id -> ServerSocket. If map is non-empty, we
   // are currently listening for incoming connections.
@@ -20,6 +20,7 @@
 #include "core/internal/message_lite.h"
 #include "core/internal/offline_frames_validator.h"
 #include "core/status.h"
+#include "platform/base/buffer_pool.h"
 #include "platform/base/byte_array.h"
 
 namespace location {
@@ -32,7 +33,7 @@ using ExceptionOrOfflineFrame = ExceptionOr<OfflineFrame>;
 using MessageLite = ::google::protobuf::MessageLite;
 
 ByteArray ToBytes(OfflineFrame&& frame) {
-  ByteArray bytes(frame.ByteSizeLong());
+  ByteArray bytes = BufferPool::GetInstance().Acquire(frame.ByteSizeLong());
   frame.set_version(OfflineFrame::V1);
   frame.SerializeToArray(bytes.data(), bytes.size());
   return bytes;
@@ -68,7 +69,8 @@ ByteArray ForConnectionRequest(const std::string& endpoint_id,
                                const std::string& bssid,
                                const std::vector<Medium>& mediums,
                                std::int32_t keep_alive_interval_millis,
-                               std::int32_t keep_alive_timeout_millis) {
+                               std::int32_t keep_alive_timeout_millis,
+                               bool supports_session_resumption) {
   OfflineFrame frame;
 
   frame.set_version(OfflineFrame::V1);
@@ -97,11 +99,15 @@ ByteArray ForConnectionRequest(const std::string& endpoint_id,
     connection_request->set_keep_alive_timeout_millis(
         keep_alive_timeout_millis);
   }
+  if (supports_session_resumption) {
+    connection_request->set_supports_session_resumption(true);
+  }
 
   return ToBytes(std::move(frame));
 }
 
-ByteArray ForConnectionResponse(std::int32_t status) {
+ByteArray ForConnectionResponse(std::int32_t status,
+                                bool supports_session_resumption) {
   OfflineFrame frame;
 
   frame.set_version(OfflineFrame::V1);
@@ -116,6 +122,9 @@ ByteArray ForConnectionResponse(std::int32_t status) {
   sub_frame->set_response(status == Status::kSuccess
                               ? ConnectionResponseFrame::ACCEPT
                               : ConnectionResponseFrame::REJECT);
+  if (supports_session_resumption) {
+    sub_frame->set_supports_session_resumption(true);
+  }
 
   return ToBytes(std::move(frame));
 }
@@ -296,7 +305,7 @@ ByteArray ForBwuWebrtcPathAvailable(const std::string& peer_id,
   return ToBytes(std::move(frame));
 }
 
-ByteArray ForBwuLastWrite() {
+ByteArray ForBwuLastWrite(bool make_before_break) {
   OfflineFrame frame;
 
   frame.set_version(OfflineFrame::V1);
@@ -305,6 +314,10 @@ ByteArray ForBwuLastWrite() {
   auto* sub_frame = v1_frame->mutable_bandwidth_upgrade_negotiation();
   sub_frame->set_event_type(
       BandwidthUpgradeNegotiationFrame::LAST_WRITE_TO_PRIOR_CHANNEL);
+  if (make_before_break) {
+    sub_frame->mutable_last_write_to_prior_channel()->set_make_before_break(
+        true);
+  }
 
   return ToBytes(std::move(frame));
 }
@@ -322,7 +335,9 @@ ByteArray ForBwuSafeToClose() {
   return ToBytes(std::move(frame));
 }
 
-ByteArray ForBwuIntroduction(const std::string& endpoint_id) {
+ByteArray ForBwuIntroduction(const std::string& endpoint_id,
+                             bool supports_striping,
+                             bool supports_make_before_break) {
   OfflineFrame frame;
 
   frame.set_version(OfflineFrame::V1);
@@ -333,11 +348,18 @@ ByteArray ForBwuIntroduction(const std::string& endpoint_id) {
       BandwidthUpgradeNegotiationFrame::CLIENT_INTRODUCTION);
   auto* client_introduction = sub_frame->mutable_client_introduction();
   client_introduction->set_endpoint_id(endpoint_id);
+  if (supports_striping) {
+    client_introduction->set_supports_striping(true);
+  }
+  if (supports_make_before_break) {
+    client_introduction->set_supports_make_before_break(true);
+  }
 
   return ToBytes(std::move(frame));
 }
 
-ByteArray ForBwuIntroductionAck() {
+ByteArray ForBwuIntroductionAck(const ByteArray& stripe_salt,
+                                bool make_before_break) {
   OfflineFrame frame;
 
   frame.set_version(OfflineFrame::V1);
@@ -346,6 +368,13 @@ ByteArray ForBwuIntroductionAck() {
   auto* sub_frame = v1_frame->mutable_bandwidth_upgrade_negotiation();
   sub_frame->set_event_type(
       BandwidthUpgradeNegotiationFrame::CLIENT_INTRODUCTION_ACK);
+  auto* client_introduction_ack = sub_frame->mutable_client_introduction_ack();
+  if (!stripe_salt.Empty()) {
+    client_introduction_ack->set_stripe_salt(std::string(stripe_salt));
+  }
+  if (make_before_break) {
+    client_introduction_ack->set_make_before_break(true);
+  }
 
   return ToBytes(std::move(frame));
 }
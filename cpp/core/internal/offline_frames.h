@@ -48,8 +48,10 @@ ByteArray ForConnectionRequest(const std::string& endpoint_id,
                                const std::string& bssid,
                                const std::vector<Medium>& mediums,
                                std::int32_t keep_alive_interval_millis,
-                               std::int32_t keep_alive_timeout_millis);
-ByteArray ForConnectionResponse(std::int32_t status);
+                               std::int32_t keep_alive_timeout_millis,
+                               bool supports_session_resumption);
+ByteArray ForConnectionResponse(std::int32_t status,
+                                bool supports_session_resumption);
 
 // Builds Payload transfer messages.
 ByteArray ForDataPayloadTransfer(
@@ -60,8 +62,12 @@ ByteArray ForControlPayloadTransfer(
     const PayloadTransferFrame::ControlMessage& control);
 
 // Builds Bandwidth Upgrade [BWU] messages.
-ByteArray ForBwuIntroduction(const std::string& endpoint_id);
-ByteArray ForBwuIntroductionAck();
+ByteArray ForBwuIntroduction(const std::string& endpoint_id,
+                             bool supports_striping,
+                             bool supports_make_before_break);
+// A non-empty |stripe_salt| agrees to keep the prior channel as a stripe.
+ByteArray ForBwuIntroductionAck(const ByteArray& stripe_salt,
+                                bool make_before_break);
 ByteArray ForBwuWifiHotspotPathAvailable(const std::string& ssid,
                                          const std::string& password,
                                          std::int32_t port,
@@ -83,7 +89,7 @@ ByteArray ForBwuBluetoothPathAvailable(const std::string& service_id,
 ByteArray ForBwuWebrtcPathAvailable(const std::string& peer_id,
                                     const LocationHint& location_hint_a);
 ByteArray ForBwuFailure(const UpgradePathInfo& info);
-ByteArray ForBwuLastWrite();
+ByteArray ForBwuLastWrite(bool make_before_break);
 ByteArray ForBwuSafeToClose();
 
 ByteArray ForKeepAlive();
@@ -106,13 +106,14 @@ TEST(OfflineFramesTest, CanGenerateConnectionRequest) {
         mediums: WEB_RTC
         keep_alive_interval_millis: 1000
         keep_alive_timeout_millis: 5000
+        supports_session_resumption: true
       >
     >)pb";
   ByteArray bytes = ForConnectionRequest(
       std::string(kEndpointId), ByteArray{std::string(kEndpointName)}, kNonce,
       kSupports5ghz, std::string(kBssid),
       std::vector(kMediums.begin(), kMediums.end()), kKeepAliveIntervalMillis,
-      kKeepAliveTimeoutMillis);
+      kKeepAliveTimeoutMillis, /*supports_session_resumption=*/true);
   auto response = FromBytes(bytes);
   ASSERT_TRUE(response.ok());
   OfflineFrame message = FromBytes(bytes).result();
@@ -127,7 +128,8 @@ TEST(OfflineFramesTest, CanGenerateConnectionResponse) {
       type: CONNECTION_RESPONSE
       connection_response: < status: 1 response: REJECT >
     >)pb";
-  ByteArray bytes = ForConnectionResponse(1);
+  ByteArray bytes =
+      ForConnectionResponse(1, /*supports_session_resumption=*/false);
   auto response = FromBytes(bytes);
   ASSERT_TRUE(response.ok());
   OfflineFrame message = FromBytes(bytes).result();
@@ -331,7 +333,25 @@ TEST(OfflineFramesTest, CanGenerateBwuLastWrite) {
       type: BANDWIDTH_UPGRADE_NEGOTIATION
       bandwidth_upgrade_negotiation: < event_type: LAST_WRITE_TO_PRIOR_CHANNEL >
     >)pb";
-  ByteArray bytes = ForBwuLastWrite();
+  ByteArray bytes = ForBwuLastWrite(/*make_before_break=*/false);
+  auto response = FromBytes(bytes);
+  ASSERT_TRUE(response.ok());
+  OfflineFrame message = FromBytes(bytes).result();
+  EXPECT_THAT(message, EqualsProto(kExpected));
+}
+
+TEST(OfflineFramesTest, CanGenerateBwuLastWriteMakeBeforeBreak) {
+  constexpr char kExpected[] =
+      R"pb(
+    version: V1
+    v1: <
+      type: BANDWIDTH_UPGRADE_NEGOTIATION
+      bandwidth_upgrade_negotiation: <
+        event_type: LAST_WRITE_TO_PRIOR_CHANNEL
+        last_write_to_prior_channel: < make_before_break: true >
+      >
+    >)pb";
+  ByteArray bytes = ForBwuLastWrite(/*make_before_break=*/true);
   auto response = FromBytes(bytes);
   ASSERT_TRUE(response.ok());
   OfflineFrame message = FromBytes(bytes).result();
@@ -364,7 +384,52 @@ TEST(OfflineFramesTest, CanGenerateBwuIntroduction) {
         client_introduction: < endpoint_id: "ABC" >
       >
     >)pb";
-  ByteArray bytes = ForBwuIntroduction(std::string(kEndpointId));
+  ByteArray bytes = ForBwuIntroduction(std::string(kEndpointId),
+                                       /*supports_striping=*/false,
+                                       /*supports_make_before_break=*/false);
+  auto response = FromBytes(bytes);
+  ASSERT_TRUE(response.ok());
+  OfflineFrame message = FromBytes(bytes).result();
+  EXPECT_THAT(message, EqualsProto(kExpected));
+}
+
+TEST(OfflineFramesTest, CanGenerateBwuIntroductionWithOptions) {
+  constexpr char kExpected[] =
+      R"pb(
+    version: V1
+    v1: <
+      type: BANDWIDTH_UPGRADE_NEGOTIATION
+      bandwidth_upgrade_negotiation: <
+        event_type: CLIENT_INTRODUCTION
+        client_introduction: <
+          endpoint_id: "ABC"
+          supports_striping: true
+          supports_make_before_break: true
+        >
+      >
+    >)pb";
+  ByteArray bytes = ForBwuIntroduction(std::string(kEndpointId),
+                                       /*supports_striping=*/true,
+                                       /*supports_make_before_break=*/true);
+  auto response = FromBytes(bytes);
+  ASSERT_TRUE(response.ok());
+  OfflineFrame message = FromBytes(bytes).result();
+  EXPECT_THAT(message, EqualsProto(kExpected));
+}
+
+TEST(OfflineFramesTest, CanGenerateBwuIntroductionAckWithOptions) {
+  constexpr char kExpected[] =
+      R"pb(
+    version: V1
+    v1: <
+      type: BANDWIDTH_UPGRADE_NEGOTIATION
+      bandwidth_upgrade_negotiation: <
+        event_type: CLIENT_INTRODUCTION_ACK
+        client_introduction_ack: < stripe_salt: "salt" make_before_break: true >
+      >
+    >)pb";
+  ByteArray bytes = ForBwuIntroductionAck(ByteArray(std::string("salt")),
+                                          /*make_before_break=*/true);
   auto response = FromBytes(bytes);
   ASSERT_TRUE(response.ok());
   OfflineFrame message = FromBytes(bytes).result();
@@ -58,7 +58,7 @@ TEST(OfflineFramesValidatorTest, ValidatesAsOkWithValidConnectionRequestFrame) {
       std::string(kEndpointId), ByteArray{std::string(kEndpointName)}, kNonce,
       kSupports5ghz, std::string(kBssid),
       std::vector(kMediums.begin(), kMediums.end()), kKeepAliveIntervalMillis,
-      kKeepAliveTimeoutMillis);
+      kKeepAliveTimeoutMillis, /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
@@ -74,7 +74,7 @@ TEST(OfflineFramesValidatorTest,
       std::string(kEndpointId), ByteArray{std::string(kEndpointName)}, kNonce,
       kSupports5ghz, std::string(kBssid),
       std::vector(kMediums.begin(), kMediums.end()), kKeepAliveIntervalMillis,
-      kKeepAliveTimeoutMillis);
+      kKeepAliveTimeoutMillis, /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
   auto* v1_frame = offline_frame.mutable_v1();
 
@@ -94,7 +94,7 @@ TEST(OfflineFramesValidatorTest,
       empty_enpoint_id, ByteArray{std::string(kEndpointName)}, kNonce,
       kSupports5ghz, std::string(kBssid),
       std::vector(kMediums.begin(), kMediums.end()), kKeepAliveIntervalMillis,
-      kKeepAliveTimeoutMillis);
+      kKeepAliveTimeoutMillis, /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
@@ -110,7 +110,8 @@ TEST(OfflineFramesValidatorTest,
   ByteArray bytes = ForConnectionRequest(
       std::string(kEndpointId), empty_endpoint_info, kNonce, kSupports5ghz,
       std::string(kBssid), std::vector(kMediums.begin(), kMediums.end()),
-      kKeepAliveIntervalMillis, kKeepAliveTimeoutMillis);
+      kKeepAliveIntervalMillis, kKeepAliveTimeoutMillis,
+      /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
@@ -126,7 +127,8 @@ TEST(OfflineFramesValidatorTest,
   ByteArray bytes = ForConnectionRequest(
       std::string(kEndpointId), ByteArray{std::string(kEndpointName)}, kNonce,
       kSupports5ghz, empty_bssid, std::vector(kMediums.begin(), kMediums.end()),
-      kKeepAliveIntervalMillis, kKeepAliveTimeoutMillis);
+      kKeepAliveIntervalMillis, kKeepAliveTimeoutMillis,
+      /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
@@ -142,7 +144,8 @@ TEST(OfflineFramesValidatorTest,
   ByteArray bytes = ForConnectionRequest(
       std::string(kEndpointId), ByteArray{std::string(kEndpointName)}, kNonce,
       kSupports5ghz, std::string(kBssid), empty_mediums,
-      kKeepAliveIntervalMillis, kKeepAliveTimeoutMillis);
+      kKeepAliveIntervalMillis, kKeepAliveTimeoutMillis,
+      /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
@@ -154,7 +157,8 @@ TEST(OfflineFramesValidatorTest,
      ValidatesAsOkWithValidConnectionResponseFrame) {
   OfflineFrame offline_frame;
 
-  ByteArray bytes = ForConnectionResponse(kStatusAccepted);
+  ByteArray bytes = ForConnectionResponse(
+      kStatusAccepted, /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
@@ -166,7 +170,8 @@ TEST(OfflineFramesValidatorTest,
      ValidatesAsFailWithNullConnectionResponseFrame) {
   OfflineFrame offline_frame;
 
-  ByteArray bytes = ForConnectionResponse(kStatusAccepted);
+  ByteArray bytes = ForConnectionResponse(
+      kStatusAccepted, /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
   auto* v1_frame = offline_frame.mutable_v1();
 
@@ -181,7 +186,8 @@ TEST(OfflineFramesValidatorTest,
      ValidatesAsFailWithUnexpectedStatusInConnectionResponseFrame) {
   OfflineFrame offline_frame;
 
-  ByteArray bytes = ForConnectionResponse(-1);
+  ByteArray bytes = ForConnectionResponse(
+      -1, /*supports_session_resumption=*/false);
   offline_frame.ParseFromString(std::string(bytes));
 
   auto ret_value = EnsureValidOfflineFrame(offline_frame);
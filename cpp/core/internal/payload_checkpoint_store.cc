@@ -0,0 +1,73 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_checkpoint_store.h"
+
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr int PayloadCheckpointStore::kMaxCheckpoints;
+
+void PayloadCheckpointStore::Save(const std::string& endpoint_id,
+                                  Payload::Id payload_id,
+                                  std::int64_t total_size,
+                                  std::int64_t offset) {
+  MutexLock lock(&mutex_);
+  Key key{endpoint_id, payload_id};
+  if (!checkpoints_.contains(key) &&
+      static_cast<int>(checkpoints_.size()) >= kMaxCheckpoints) {
+    EvictOldestLocked();
+  }
+  checkpoints_[key] = {total_size, offset, SystemClock::ElapsedRealtime()};
+}
+
+std::int64_t PayloadCheckpointStore::Get(const std::string& endpoint_id,
+                                         Payload::Id payload_id,
+                                         std::int64_t total_size) const {
+  MutexLock lock(&mutex_);
+  auto it = checkpoints_.find(Key{endpoint_id, payload_id});
+  if (it == checkpoints_.end() || it->second.total_size != total_size) {
+    return 0;
+  }
+  return it->second.offset;
+}
+
+void PayloadCheckpointStore::Remove(const std::string& endpoint_id,
+                                    Payload::Id payload_id) {
+  MutexLock lock(&mutex_);
+  checkpoints_.erase(Key{endpoint_id, payload_id});
+}
+
+int PayloadCheckpointStore::Size() const {
+  MutexLock lock(&mutex_);
+  return static_cast<int>(checkpoints_.size());
+}
+
+void PayloadCheckpointStore::EvictOldestLocked() {
+  auto oldest = checkpoints_.begin();
+  for (auto it = checkpoints_.begin(); it != checkpoints_.end(); ++it) {
+    if (it->second.updated_at < oldest->second.updated_at) oldest = it;
+  }
+  if (oldest != checkpoints_.end()) checkpoints_.erase(oldest);
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
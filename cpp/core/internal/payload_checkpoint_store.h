@@ -0,0 +1,82 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_PAYLOAD_CHECKPOINT_STORE_H_
+#define CORE_INTERNAL_PAYLOAD_CHECKPOINT_STORE_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "core/payload.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Remembers how much of an incoming file payload has been committed to
+// storage, so that a transfer interrupted by a disconnect can be resumed
+// instead of restarted.
+//
+// Checkpoints are keyed by endpoint id and payload id, and are only returned
+// for a payload of the same total size. The store is bounded; when it is full,
+// the least recently updated checkpoint is evicted.
+class PayloadCheckpointStore {
+ public:
+  static constexpr int kMaxCheckpoints = 64;
+
+  PayloadCheckpointStore() = default;
+  PayloadCheckpointStore(const PayloadCheckpointStore&) = delete;
+  PayloadCheckpointStore& operator=(const PayloadCheckpointStore&) = delete;
+
+  // Records that the first |offset| bytes of the payload are committed.
+  void Save(const std::string& endpoint_id, Payload::Id payload_id,
+            std::int64_t total_size, std::int64_t offset)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the committed offset of the payload, or 0 if there is no usable
+  // checkpoint for it.
+  std::int64_t Get(const std::string& endpoint_id, Payload::Id payload_id,
+                   std::int64_t total_size) const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets the checkpoint of the payload, e.g. once it is fully received or
+  // canceled.
+  void Remove(const std::string& endpoint_id, Payload::Id payload_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of checkpoints currently held.
+  int Size() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  using Key = std::pair<std::string, Payload::Id>;
+  struct Checkpoint {
+    std::int64_t total_size;
+    std::int64_t offset;
+    absl::Time updated_at;
+  };
+
+  void EvictOldestLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable Mutex mutex_;
+  absl::flat_hash_map<Key, Checkpoint> checkpoints_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_PAYLOAD_CHECKPOINT_STORE_H_
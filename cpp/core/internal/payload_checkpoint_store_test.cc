@@ -0,0 +1,80 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_checkpoint_store.h"
+
+#include "gtest/gtest.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kEndpointId[] = "ABCD";
+constexpr Payload::Id kPayloadId = 12345;
+constexpr std::int64_t kTotalSize = 4 * 1024 * 1024;
+
+TEST(PayloadCheckpointStoreTest, GetReturnsZeroWithoutCheckpoint) {
+  PayloadCheckpointStore store;
+
+  EXPECT_EQ(store.Get(kEndpointId, kPayloadId, kTotalSize), 0);
+}
+
+TEST(PayloadCheckpointStoreTest, GetReturnsSavedOffset) {
+  PayloadCheckpointStore store;
+
+  store.Save(kEndpointId, kPayloadId, kTotalSize, 1024);
+  store.Save(kEndpointId, kPayloadId, kTotalSize, 2048);
+
+  EXPECT_EQ(store.Get(kEndpointId, kPayloadId, kTotalSize), 2048);
+  EXPECT_EQ(store.Get("WXYZ", kPayloadId, kTotalSize), 0);
+  EXPECT_EQ(store.Get(kEndpointId, kPayloadId + 1, kTotalSize), 0);
+}
+
+TEST(PayloadCheckpointStoreTest, GetIgnoresCheckpointOfDifferentSize) {
+  PayloadCheckpointStore store;
+
+  store.Save(kEndpointId, kPayloadId, kTotalSize, 1024);
+
+  EXPECT_EQ(store.Get(kEndpointId, kPayloadId, kTotalSize + 1), 0);
+}
+
+TEST(PayloadCheckpointStoreTest, RemoveForgetsCheckpoint) {
+  PayloadCheckpointStore store;
+  store.Save(kEndpointId, kPayloadId, kTotalSize, 1024);
+
+  store.Remove(kEndpointId, kPayloadId);
+
+  EXPECT_EQ(store.Get(kEndpointId, kPayloadId, kTotalSize), 0);
+  EXPECT_EQ(store.Size(), 0);
+}
+
+TEST(PayloadCheckpointStoreTest, StoreIsBounded) {
+  PayloadCheckpointStore store;
+
+  for (int i = 0; i <= PayloadCheckpointStore::kMaxCheckpoints; i++) {
+    store.Save(kEndpointId, kPayloadId + i, kTotalSize, 1024);
+  }
+
+  EXPECT_EQ(store.Size(), PayloadCheckpointStore::kMaxCheckpoints);
+  EXPECT_EQ(store.Get(kEndpointId,
+                      kPayloadId + PayloadCheckpointStore::kMaxCheckpoints,
+                      kTotalSize),
+            1024);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
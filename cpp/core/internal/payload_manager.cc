@@ -19,20 +19,53 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
 #include "core/internal/internal_payload_factory.h"
+#include "platform/base/feature_flags.h"
 #include "platform/public/count_down_latch.h"
+#include "platform/public/metrics.h"
 #include "platform/public/mutex_lock.h"
 #include "platform/public/single_thread_executor.h"
 #include "platform/public/system_clock.h"
+#include "platform/public/trace.h"
 
 namespace location {
 namespace nearby {
 namespace connections {
 
+namespace {
+
+struct SendMetrics {
+  Gauge* payloads_in_flight;
+  Counter* chunks_sent;
+  Counter* bytes_sent;
+  Histogram* chunk_send_latency;
+};
+
+const SendMetrics& GetSendMetrics() {
+  static const SendMetrics* metrics = [] {
+    MetricsRegistry& registry = MetricsRegistry::GetInstance();
+    return new SendMetrics{
+        registry.GetGauge("nearby_outgoing_payloads_in_flight",
+                          "Outgoing payloads being sent."),
+        registry.GetCounter("nearby_payload_chunks_sent_total",
+                            "Payload chunks sent, counted once per chunk."),
+        registry.GetCounter("nearby_payload_bytes_sent_total",
+                            "Payload body bytes sent, counted once per chunk."),
+        registry.GetHistogram("nearby_payload_chunk_send_latency_micros",
+                              "Time to send a payload chunk to all its "
+                              "endpoints, in microseconds."),
+    };
+  }();
+  return *metrics;
+}
+
+}  // namespace
+
 // C++14 requires to declare this.
 // TODO(apolyudov): remove when migration to c++17 is possible.
 constexpr const absl::Duration PayloadManager::kWaitCloseTimeout;
@@ -40,7 +73,8 @@ constexpr const absl::Duration PayloadManager::kWaitCloseTimeout;
 bool PayloadManager::SendPayloadLoop(
     ClientProxy* client, PendingPayload& pending_payload,
     PayloadTransferFrame::PayloadHeader& payload_header,
-    std::int64_t& next_chunk_offset, size_t resume_offset) {
+    std::int64_t& next_chunk_offset, size_t resume_offset,
+    ChannelHandles& channel_handles) {
   // in lieu of structured binding:
   auto pair = GetAvailableAndUnavailableEndpoints(pending_payload);
   const EndpointIds& available_endpoint_ids =
@@ -99,15 +133,33 @@ bool PayloadManager::SendPayloadLoop(
                          << pending_payload.GetInternalPayload()->GetId();
     next_chunk_offset = real_offset.GetResult();
   }
+  // With a single recipient, skip whatever it already holds from an earlier,
+  // interrupted attempt at this transfer.
+  if (available_endpoint_ids.size() == 1 &&
+      !SkipToResumeOffset(pending_payload, next_chunk_offset, resume_offset)) {
+    HandleFinishedOutgoingPayload(
+        client, available_endpoint_ids, payload_header, next_chunk_offset,
+        proto::connections::PayloadStatus::LOCAL_ERROR);
+    return false;
+  }
   for (const auto& endpoint_id : available_endpoint_ids) {
     pending_payload.SetOffsetForEndpoint(endpoint_id, next_chunk_offset);
   }
+  // Channels are looked up once per payload; from then on a replaced channel,
+  // e.g. after a bandwidth upgrade, is picked up here at the next chunk.
+  UpdateChannelHandles(available_endpoint_ids, channel_handles);
 
+  NEARBY_TRACE_SPAN(chunk_span, "SendChunk", {}, payload_header.id(),
+                    next_chunk_offset);
   // This will block if there is no data to transfer.
   // It will resume when new data arrives, or if Close() is called.
-  int chunk_size = GetOptimalChunkSize(available_endpoint_ids);
-  ByteArray next_chunk =
-      pending_payload.GetInternalPayload()->DetachNextChunk(chunk_size);
+  int chunk_size = GetOptimalChunkSize(channel_handles);
+  ByteArray next_chunk;
+  {
+    NEARBY_TRACE_SPAN(detach_span, "DetachNextChunk");
+    next_chunk =
+        pending_payload.GetInternalPayload()->DetachNextChunk(chunk_size);
+  }
   if (shutdown_.Get()) return false;
   // Save chunk size. We'll need it after we move next_chunk.
   auto next_chunk_size = next_chunk.size();
@@ -129,8 +181,21 @@ bool PayloadManager::SendPayloadLoop(
   // happened.
   PayloadTransferFrame::PayloadChunk payload_chunk(CreatePayloadChunk(
       next_chunk_offset - resume_offset, std::move(next_chunk)));
+  if (!next_chunk_size) {
+    ByteArray checksum =
+        pending_payload.GetInternalPayload()->FinishChecksum();
+    if (!checksum.Empty()) {
+      payload_chunk.set_checksum(std::string(std::move(checksum)));
+    }
+  }
+  const SendMetrics& metrics = GetSendMetrics();
+  absl::Time send_start_time = SystemClock::ElapsedRealtime();
   const EndpointIds& failed_endpoint_ids = endpoint_manager_->SendPayloadChunk(
-      payload_header, payload_chunk, available_endpoint_ids);
+      payload_header, payload_chunk, channel_handles);
+  metrics.chunk_send_latency->Record(SystemClock::ElapsedRealtime() -
+                                     send_start_time);
+  metrics.chunks_sent->Increment();
+  metrics.bytes_sent->Increment(next_chunk_size);
   // Check whether at least one endpoint failed.
   if (!failed_endpoint_ids.empty()) {
     NEARBY_LOGS(INFO) << "Payload xfer: endpoints failed: payload_id="
@@ -170,6 +235,46 @@ bool PayloadManager::SendPayloadLoop(
   return true;
 }
 
+bool PayloadManager::SkipToResumeOffset(PendingPayload& pending_payload,
+                                        std::int64_t& next_chunk_offset,
+                                        size_t resume_offset) {
+  // Chunk offsets on the wire are relative to |resume_offset|, and so is the
+  // offset reported by the receiver.
+  std::int64_t sent_offset = next_chunk_offset - resume_offset;
+  std::int64_t receiver_offset = pending_payload.GetResumeOffset();
+  if (receiver_offset <= sent_offset) return true;
+
+  ExceptionOr<size_t> skipped =
+      pending_payload.GetInternalPayload()->SkipToOffset(receiver_offset -
+                                                         sent_offset);
+  if (!skipped.ok()) {
+    NEARBY_LOGS(WARNING) << "PayloadManager failed to skip to offset "
+                         << receiver_offset << " requested by receiver of "
+                         << "payload_id=" << pending_payload.GetId();
+    return false;
+  }
+  NEARBY_LOGS(INFO) << "PayloadManager resumed payload_id="
+                    << pending_payload.GetId() << " at offset "
+                    << receiver_offset << " requested by receiver";
+  next_chunk_offset += skipped.GetResult();
+  return true;
+}
+
+void PayloadManager::UpdateCheckpoint(
+    PendingPayload& pending_payload, const std::string& endpoint_id,
+    const PayloadTransferFrame::PayloadHeader& header) {
+  if (header.type() != PayloadTransferFrame::PayloadHeader::FILE ||
+      !FeatureFlags::GetInstance().GetFlags().enable_payload_checkpoints) {
+    return;
+  }
+  std::int64_t committed_offset =
+      pending_payload.GetInternalPayload()->GetCommittedOffset();
+  if (committed_offset > 0) {
+    checkpoint_store_.Save(endpoint_id, header.id(), header.total_size(),
+                           committed_offset);
+  }
+}
+
 std::pair<PayloadManager::Endpoints, PayloadManager::Endpoints>
 PayloadManager::GetAvailableAndUnavailableEndpoints(
     const PendingPayload& pending_payload) {
@@ -413,19 +518,27 @@ void PayloadManager::SendPayload(ClientProxy* client,
         auto* internal_payload = pending_payload->GetInternalPayload();
         if (!internal_payload) return;
 
-        RecordPayloadStartedAnalytics(client, endpoint_ids, payload_id,
-                                      payload_type, resume_offset,
-                                      internal_payload->GetTotalSize());
+        std::vector<analytics::AnalyticsRecorder::ChunkCounter>
+            chunk_counters = RecordPayloadStartedAnalytics(
+                client, endpoint_ids, payload_id, payload_type, resume_offset,
+                internal_payload->GetTotalSize());
+        for (std::size_t i = 0; i < endpoint_ids.size(); ++i) {
+          pending_payload->SetChunkCounterForEndpoint(
+              endpoint_ids[i], std::move(chunk_counters[i]));
+        }
 
         PayloadTransferFrame::PayloadHeader payload_header{
             CreatePayloadHeader(*internal_payload, resume_offset)};
         bool should_continue = true;
         std::int64_t next_chunk_offset = 0;
+        ChannelHandles channel_handles;
+        GetSendMetrics().payloads_in_flight->Add(1);
         while (should_continue && !shutdown_.Get()) {
-          should_continue =
-              SendPayloadLoop(client, *pending_payload, payload_header,
-                              next_chunk_offset, resume_offset);
+          should_continue = SendPayloadLoop(
+              client, *pending_payload, payload_header, next_chunk_offset,
+              resume_offset, channel_handles);
         }
+        GetSendMetrics().payloads_in_flight->Add(-1);
         RunOnStatusUpdateThread("destroy-payload",
                                 [this, payload_id]()
                                     RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
@@ -478,7 +591,11 @@ void PayloadManager::OnIncomingFrame(
       ProcessControlPacket(to_client, from_endpoint_id, frame);
       break;
     case PayloadTransferFrame::DATA:
-      ProcessDataPacket(to_client, from_endpoint_id, frame);
+      if (FeatureFlags::GetInstance().GetFlags().enable_multipath_striping) {
+        ProcessStripedDataPacket(to_client, from_endpoint_id, frame);
+      } else {
+        ProcessDataPacket(to_client, from_endpoint_id, frame);
+      }
       break;
     default:
       NEARBY_LOGS(WARNING)
@@ -499,6 +616,7 @@ void PayloadManager::OnEndpointDisconnect(ClientProxy* client,
       "payload-manager-on-disconnect",
       [this, client, endpoint_id, barrier]()
           RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() mutable {
+            chunk_reorder_buffer_.RemoveEndpoint(endpoint_id);
             // Iterate through all our payloads and look for payloads associated
             // with this endpoint.
             MutexLock lock(&mutex_);
@@ -600,11 +718,37 @@ SingleThreadExecutor* PayloadManager::GetOutgoingPayloadExecutor(
   }
 }
 
-int PayloadManager::GetOptimalChunkSize(EndpointIds endpoint_ids) {
+void PayloadManager::UpdateChannelHandles(const EndpointIds& endpoint_ids,
+                                          ChannelHandles& channel_handles) {
+  bool unchanged = channel_handles.size() == endpoint_ids.size();
+  for (size_t i = 0; unchanged && i < endpoint_ids.size(); ++i) {
+    unchanged = channel_handles[i].endpoint_id == endpoint_ids[i];
+  }
+  if (!unchanged) {
+    // Some recipients dropped out; keep the handles of the others.
+    ChannelHandles handles;
+    handles.reserve(endpoint_ids.size());
+    for (const auto& endpoint_id : endpoint_ids) {
+      auto it = std::find_if(channel_handles.begin(), channel_handles.end(),
+                             [&endpoint_id](const auto& handle) {
+                               return handle.endpoint_id == endpoint_id;
+                             });
+      handles.push_back(it != channel_handles.end()
+                            ? std::move(*it)
+                            : endpoint_manager_->GetChannelHandle(endpoint_id));
+    }
+    channel_handles = std::move(handles);
+  }
+  for (auto& handle : channel_handles) {
+    endpoint_manager_->RefreshChannelHandle(handle);
+  }
+}
+
+int PayloadManager::GetOptimalChunkSize(const ChannelHandles& channel_handles) {
   int minChunkSize = std::numeric_limits<int>::max();
-  for (const auto& endpoint_id : endpoint_ids) {
-    minChunkSize = std::min(
-        minChunkSize, endpoint_manager_->GetMaxTransmitPacketSize(endpoint_id));
+  for (const auto& handle : channel_handles) {
+    minChunkSize = std::min(minChunkSize,
+                            EndpointManager::GetMaxTransmitPacketSize(handle));
   }
   return minChunkSize;
 }
@@ -641,19 +785,27 @@ PayloadTransferFrame::PayloadChunk PayloadManager::CreatePayloadChunk(
 }
 
 PayloadManager::PendingPayload* PayloadManager::CreateIncomingPayload(
-    const PayloadTransferFrame& frame, const std::string& endpoint_id) {
-  auto internal_payload = CreateIncomingInternalPayload(frame);
+    const PayloadTransferFrame& frame, const std::string& endpoint_id,
+    std::int64_t resume_offset) {
+  auto internal_payload = CreateIncomingInternalPayload(frame, resume_offset);
   if (!internal_payload) {
     return nullptr;
   }
 
   Payload::Id payload_id = internal_payload->GetId();
-  NEARBY_LOGS(INFO) << "CreateIncomingPayload: payload_id=" << payload_id;
+  if (internal_payload->GetCommittedOffset() < resume_offset) {
+    // The partial file is gone; the payload is received from the start.
+    checkpoint_store_.Remove(endpoint_id, payload_id);
+    resume_offset = 0;
+  }
+  NEARBY_LOGS(INFO) << "CreateIncomingPayload: payload_id=" << payload_id
+                    << "; resume_offset=" << resume_offset;
+  auto pending_payload = absl::make_unique<PendingPayload>(
+      std::move(internal_payload), EndpointIds{endpoint_id}, true);
+  pending_payload->SetResumeOffset(resume_offset);
   MutexLock lock(&mutex_);
-  pending_payloads_.StartTrackingPayload(
-      payload_id,
-      absl::make_unique<PendingPayload>(std::move(internal_payload),
-                                        EndpointIds{endpoint_id}, true));
+  pending_payloads_.StartTrackingPayload(payload_id,
+                                         std::move(pending_payload));
 
   return pending_payloads_.GetPayload(payload_id);
 }
@@ -794,11 +946,15 @@ void PayloadManager::HandleFinishedIncomingPayload(
     ClientProxy* client, const std::string& endpoint_id,
     const PayloadTransferFrame::PayloadHeader& payload_header,
     std::int64_t offset_bytes, proto::connections::PayloadStatus status) {
+  // The transfer is over for good; it won't be resumed.
+  checkpoint_store_.Remove(endpoint_id, payload_header.id());
+  chunk_reorder_buffer_.Remove(endpoint_id, payload_header.id());
   SendClientCallbacksForFinishedIncomingPayload(
       client, endpoint_id, payload_header, offset_bytes, status);
 
   switch (status) {
     case proto::connections::PayloadStatus::LOCAL_ERROR:
+    case proto::connections::PayloadStatus::CHECKSUM_MISMATCH:
       SendControlMessage({endpoint_id}, payload_header, offset_bytes,
                          PayloadTransferFrame::ControlMessage::PAYLOAD_ERROR);
       break;
@@ -828,7 +984,10 @@ void PayloadManager::HandleSuccessfulOutgoingChunk(
         // Make sure we're still tracking this payload and its associated
         // endpoint.
         PendingPayload* pending_payload = GetPayload(payload_header.id());
-        if (!pending_payload || !pending_payload->GetEndpoint(endpoint_id)) {
+        EndpointInfo* endpoint_info =
+            pending_payload ? pending_payload->GetEndpoint(endpoint_id)
+                            : nullptr;
+        if (!endpoint_info) {
           NEARBY_LOGS(INFO)
               << "HandleSuccessfulOutgoingChunk: endpoint not found: "
                  "endpoint_id="
@@ -862,8 +1021,7 @@ void PayloadManager::HandleSuccessfulOutgoingChunk(
             pending_payload->Close();
           }
         } else {
-          client->GetAnalyticsRecorder().OnPayloadChunkSent(
-              endpoint_id, payload_header.id(), payload_chunk_body_size);
+          endpoint_info->chunk_counter.Count(payload_chunk_body_size);
         }
       });
 }
@@ -920,9 +1078,9 @@ void PayloadManager::HandleSuccessfulIncomingChunk(
         if (is_last_chunk) {
           client->GetAnalyticsRecorder().OnIncomingPayloadDone(
               endpoint_id, payload_header.id(), proto::connections::SUCCESS);
-        } else {
-          client->GetAnalyticsRecorder().OnPayloadChunkReceived(
-              endpoint_id, payload_header.id(), payload_chunk_body_size);
+        } else if (EndpointInfo* endpoint_info =
+                       pending_payload->GetEndpoint(endpoint_id)) {
+          endpoint_info->chunk_counter.Count(payload_chunk_body_size);
         }
       });
 }
@@ -942,19 +1100,23 @@ void PayloadManager::ProcessDataPacket(
 
   PendingPayload* pending_payload;
   if (payload_chunk.offset() == 0) {
-    RunOnStatusUpdateThread(
-        "process-data-packet", [to_client, from_endpoint_id, payload_header,
-                                this]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
-          // This is the first chunk of a new incoming
-          // payload. Start the analysis.
-          to_client->GetAnalyticsRecorder().OnIncomingPayloadStarted(
-              from_endpoint_id, payload_header.id(),
-              FramePayloadTypeToPayloadType(payload_header.type()),
-              payload_header.total_size());
-        });
-
-    pending_payload =
-        CreateIncomingPayload(payload_transfer_frame, from_endpoint_id);
+    // This is the first chunk of a new incoming payload. Start the analysis.
+    analytics::AnalyticsRecorder::ChunkCounter chunk_counter =
+        to_client->GetAnalyticsRecorder().OnIncomingPayloadStarted(
+            from_endpoint_id, payload_header.id(),
+            FramePayloadTypeToPayloadType(payload_header.type()),
+            payload_header.total_size());
+
+    // Pick up where an interrupted transfer of this payload left off.
+    std::int64_t resume_offset = 0;
+    if (payload_header.type() == PayloadTransferFrame::PayloadHeader::FILE &&
+        FeatureFlags::GetInstance().GetFlags().enable_payload_checkpoints) {
+      resume_offset = checkpoint_store_.Get(
+          from_endpoint_id, payload_header.id(), payload_header.total_size());
+    }
+
+    pending_payload = CreateIncomingPayload(payload_transfer_frame,
+                                            from_endpoint_id, resume_offset);
     if (!pending_payload) {
       NEARBY_LOGS(WARNING)
           << "PayloadManager failed to create InternalPayload from "
@@ -967,6 +1129,20 @@ void PayloadManager::ProcessDataPacket(
                          PayloadTransferFrame::ControlMessage::PAYLOAD_ERROR);
       return;
     }
+    pending_payload->SetChunkCounterForEndpoint(from_endpoint_id,
+                                                std::move(chunk_counter));
+
+    // Let the sender skip the bytes we already have.
+    resume_offset = pending_payload->GetResumeOffset();
+    if (resume_offset > 0) {
+      NEARBY_LOGS(INFO) << "PayloadManager resuming payload_id="
+                        << payload_header.id() << " from endpoint_id="
+                        << from_endpoint_id << " at offset " << resume_offset;
+      chunk_reorder_buffer_.SkipTo(from_endpoint_id, payload_header.id(),
+                                   resume_offset);
+      SendControlMessage({from_endpoint_id}, payload_header, resume_offset,
+                         PayloadTransferFrame::ControlMessage::PAYLOAD_RESUME);
+    }
 
     // Also, let the client know of this new incoming payload.
     RunOnStatusUpdateThread(
@@ -1003,6 +1179,39 @@ void PayloadManager::ProcessDataPacket(
     return;
   }
 
+  // A resumed transfer has to pick up right where the file ends. Chunks below
+  // that were already received in an interrupted transfer; they keep coming
+  // until the sender has processed PAYLOAD_RESUME, and need not be cut at the
+  // same offsets as the first time.
+  bool is_last_chunk = (payload_chunk.flags() &
+                        PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
+  if (pending_payload->GetResumeOffset() > 0) {
+    std::int64_t written_offset =
+        pending_payload->GetInternalPayload()->GetWrittenOffset();
+    std::int64_t overlap = written_offset - payload_chunk.offset();
+    if (overlap < 0 || (is_last_chunk && overlap > 0)) {
+      NEARBY_LOGS(ERROR) << "ProcessDataPacket: [resume: offset mismatch] "
+                         << "endpoint_id=" << from_endpoint_id
+                         << "; payload_id=" << pending_payload->GetId()
+                         << "; offset=" << payload_chunk.offset()
+                         << "; written_offset=" << written_offset;
+      HandleFinishedIncomingPayload(
+          to_client, from_endpoint_id, payload_header, payload_chunk.offset(),
+          proto::connections::PayloadStatus::LOCAL_ERROR);
+      return;
+    }
+    // The file already holds the whole chunk.
+    if (overlap >= static_cast<std::int64_t>(payload_chunk.body().size()) &&
+        !is_last_chunk) {
+      return;
+    }
+    // The chunk straddles the end of the file; keep the part past it.
+    if (overlap > 0) {
+      payload_chunk.mutable_body()->erase(0, overlap);
+      payload_chunk.set_offset(written_offset);
+    }
+  }
+
   // Update the offset for this payload. An endpoint disconnection might occur
   // from another thread and we would need to know the current offset to report
   // back to the client. For the sake of accuracy, we update the pending payload
@@ -1011,11 +1220,34 @@ void PayloadManager::ProcessDataPacket(
   pending_payload->SetOffsetForEndpoint(from_endpoint_id,
                                         payload_chunk.offset());
 
+  // Check the payload against the checksum of the sender before the last
+  // chunk lets the client read it to the end.
+  if (is_last_chunk && payload_chunk.has_checksum()) {
+    ByteArray checksum =
+        pending_payload->GetInternalPayload()->FinishChecksum();
+    if (!checksum.Empty() &&
+        std::string(checksum) != payload_chunk.checksum()) {
+      NEARBY_LOGS(ERROR) << "ProcessDataPacket: [checksum: mismatch] "
+                         << "endpoint_id=" << from_endpoint_id
+                         << "; payload_id=" << pending_payload->GetId();
+      HandleFinishedIncomingPayload(
+          to_client, from_endpoint_id, payload_header, payload_chunk.offset(),
+          proto::connections::PayloadStatus::CHECKSUM_MISMATCH);
+      return;
+    }
+  }
+
   // Save size of packet before we move it.
   std::int64_t payload_body_size = payload_chunk.body().size();
-  if (pending_payload->GetInternalPayload()
-          ->AttachNextChunk(ByteArray(std::move(*payload_chunk.mutable_body())))
-          .Raised()) {
+  Exception attach_exception;
+  {
+    NEARBY_TRACE_SPAN(attach_span, "AttachNextChunk", from_endpoint_id,
+                      payload_header.id(), payload_chunk.offset());
+    attach_exception =
+        pending_payload->GetInternalPayload()->AttachNextChunk(
+            ByteArray(std::move(*payload_chunk.mutable_body())));
+  }
+  if (attach_exception.Raised()) {
     NEARBY_LOGS(ERROR) << "ProcessDataPacket: [data: error] endpoint_id="
                        << from_endpoint_id
                        << "; payload_id=" << pending_payload->GetId();
@@ -1025,11 +1257,52 @@ void PayloadManager::ProcessDataPacket(
     return;
   }
 
+  if (is_last_chunk) {
+    checkpoint_store_.Remove(from_endpoint_id, payload_header.id());
+  } else {
+    UpdateCheckpoint(*pending_payload, from_endpoint_id, payload_header);
+  }
+
   HandleSuccessfulIncomingChunk(to_client, from_endpoint_id, payload_header,
                                 payload_chunk.flags(), payload_chunk.offset(),
                                 payload_body_size);
 }
 
+// @EndpointManagerDataPool
+void PayloadManager::ProcessStripedDataPacket(
+    ClientProxy* to_client, const std::string& from_endpoint_id,
+    PayloadTransferFrame& payload_transfer_frame) {
+  PayloadTransferFrame::PayloadHeader payload_header =
+      payload_transfer_frame.payload_header();
+  std::int64_t offset = payload_transfer_frame.payload_chunk().offset();
+  std::vector<PayloadTransferFrame> ready;
+  if (!chunk_reorder_buffer_.Add(from_endpoint_id,
+                                 std::move(payload_transfer_frame), &ready)) {
+    // A chunk got lost along with the stripe that carried it; the payload
+    // can't be completed.
+    NEARBY_LOGS(ERROR) << "ProcessStripedDataPacket: [missing chunk] "
+                          "endpoint_id="
+                       << from_endpoint_id
+                       << "; payload_id=" << payload_header.id();
+    if (GetPayload(payload_header.id()) != nullptr) {
+      HandleFinishedIncomingPayload(
+          to_client, from_endpoint_id, payload_header, offset,
+          proto::connections::PayloadStatus::LOCAL_ERROR);
+    }
+    return;
+  }
+
+  // Processing a chunk may let more held chunks through (e.g. on resumption).
+  while (!ready.empty()) {
+    for (PayloadTransferFrame& frame : ready) {
+      ProcessDataPacket(to_client, from_endpoint_id, frame);
+    }
+    ready.clear();
+    chunk_reorder_buffer_.TakeReady(from_endpoint_id, payload_header.id(),
+                                    &ready);
+  }
+}
+
 // @EndpointManagerDataPool
 void PayloadManager::ProcessControlPacket(
     ClientProxy* to_client, const std::string& from_endpoint_id,
@@ -1082,6 +1355,17 @@ void PayloadManager::ProcessControlPacket(
                                                              control_message);
       }
       break;
+    case PayloadTransferFrame::ControlMessage::PAYLOAD_RESUME:
+      // Only file payloads are checkpointed by the receiver.
+      if (!pending_payload->IsIncoming() &&
+          pending_payload->GetInternalPayload()->GetType() ==
+              PayloadTransferFrame::PayloadHeader::FILE) {
+        NEARBY_LOGS(INFO) << "Outgoing PAYLOAD_RESUME: from endpoint_id="
+                          << from_endpoint_id
+                          << "; offset=" << control_message.offset();
+        pending_payload->SetResumeOffset(control_message.offset());
+      }
+      break;
     default:
       NEARBY_LOGS(INFO) << "Unhandled control message "
                         << control_message.event() << " for payload_id="
@@ -1097,11 +1381,12 @@ void PayloadManager::NotifyClientOfIncomingPayloadProgressInfo(
   client->OnPayloadProgress(endpoint_id, payload_transfer_update);
 }
 
-void PayloadManager::RecordPayloadStartedAnalytics(
+std::vector<analytics::AnalyticsRecorder::ChunkCounter>
+PayloadManager::RecordPayloadStartedAnalytics(
     ClientProxy* client, const EndpointIds& endpoint_ids,
     std::int64_t payload_id, Payload::Type payload_type, std::int64_t offset,
     std::int64_t total_size) {
-  client->GetAnalyticsRecorder().OnOutgoingPayloadStarted(
+  return client->GetAnalyticsRecorder().OnOutgoingPayloadStarted(
       endpoint_ids, payload_id, payload_type,
       total_size == -1 ? -1 : total_size - offset);
 }
@@ -1250,6 +1535,27 @@ void PayloadManager::PendingPayload::SetOffsetForEndpoint(
   }
 }
 
+void PayloadManager::PendingPayload::SetChunkCounterForEndpoint(
+    const std::string& endpoint_id,
+    analytics::AnalyticsRecorder::ChunkCounter chunk_counter) {
+  MutexLock lock(&mutex_);
+
+  auto item = endpoints_.find(endpoint_id);
+  if (item != endpoints_.end()) {
+    item->second.chunk_counter = std::move(chunk_counter);
+  }
+}
+
+void PayloadManager::PendingPayload::SetResumeOffset(std::int64_t offset) {
+  MutexLock lock(&mutex_);
+  resume_offset_ = offset;
+}
+
+std::int64_t PayloadManager::PendingPayload::GetResumeOffset() const {
+  MutexLock lock(&mutex_);
+  return resume_offset_;
+}
+
 void PayloadManager::PendingPayload::Close() {
   if (internal_payload_) internal_payload_->Close();
   close_event_.CountDown();
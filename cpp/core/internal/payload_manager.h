@@ -21,9 +21,12 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "analytics/analytics_recorder.h"
+#include "core/internal/chunk_reorder_buffer.h"
 #include "core/internal/client_proxy.h"
 #include "core/internal/endpoint_manager.h"
 #include "core/internal/internal_payload.h"
+#include "core/internal/payload_checkpoint_store.h"
 #include "core/listeners.h"
 #include "core/payload.h"
 #include "core/status.h"
@@ -55,7 +58,7 @@ class PayloadManager : public EndpointManager::FrameProcessor {
                    Payload payload);
   Status CancelPayload(ClientProxy* client, Payload::Id payload_id);
 
-  // @EndpointManagerReaderThread
+  // @EndpointManagerDispatchThread
   void OnIncomingFrame(OfflineFrame& offline_frame,
                        const std::string& from_endpoint_id,
                        ClientProxy* to_client,
@@ -87,6 +90,9 @@ class PayloadManager : public EndpointManager::FrameProcessor {
     std::string id;
     AtomicReference<Status> status{Status::kUnknown};
     std::int64_t offset = 0;
+    // Counts the chunks transferred to or from the endpoint for analytics.
+    // Set when the payload starts, before any of its chunks is counted.
+    analytics::AnalyticsRecorder::ChunkCounter chunk_counter;
   };
 
   // Tracks state for an InternalPayload and the endpoints associated with it.
@@ -130,6 +136,21 @@ class PayloadManager : public EndpointManager::FrameProcessor {
     void SetOffsetForEndpoint(const std::string& endpoint_id,
                               std::int64_t offset) ABSL_LOCKS_EXCLUDED(mutex_);
 
+    // Sets the analytics chunk counter for a particular endpoint.
+    void SetChunkCounterForEndpoint(
+        const std::string& endpoint_id,
+        analytics::AnalyticsRecorder::ChunkCounter chunk_counter)
+        ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Outgoing payloads: records that the receiver already holds the first
+    // |offset| bytes, as reported via a PAYLOAD_RESUME ControlMessage.
+    // Incoming payloads: records that the first |offset| bytes were restored
+    // from a checkpoint, so chunks below it are to be ignored.
+    void SetResumeOffset(std::int64_t offset) ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Returns the offset set by SetResumeOffset(), or 0 if none was set.
+    std::int64_t GetResumeOffset() const ABSL_LOCKS_EXCLUDED(mutex_);
+
     // Closes internal_payload_ and triggers close_event_.
     // Close is called when a pending peyload does not have associated
     // endpoints.
@@ -148,6 +169,7 @@ class PayloadManager : public EndpointManager::FrameProcessor {
     std::unique_ptr<InternalPayload> internal_payload_;
     absl::flat_hash_map<std::string, EndpointInfo> endpoints_
         ABSL_GUARDED_BY(mutex_);
+    std::int64_t resume_offset_ ABSL_GUARDED_BY(mutex_) = 0;
   };
 
   // Tracks and manages PendingPayload objects in a synchronized manner.
@@ -187,9 +209,18 @@ class PayloadManager : public EndpointManager::FrameProcessor {
   // Returns list of endpoint ids.
   static EndpointIds EndpointsToEndpointIds(const Endpoints& endpoints);
 
+  using ChannelHandles = std::vector<EndpointManager::ChannelHandle>;
+
+  // Sends the next chunk of the payload. |channel_handles| carries the
+  // channels of its recipients from one chunk to the next.
   bool SendPayloadLoop(ClientProxy* client, PendingPayload& pending_payload,
                        PayloadTransferFrame::PayloadHeader& payload_header,
-                       std::int64_t& next_chunk_offset, size_t resume_offset);
+                       std::int64_t& next_chunk_offset, size_t resume_offset,
+                       ChannelHandles& channel_handles);
+  // Makes |channel_handles| match |endpoint_ids| and refreshes them, resolving
+  // only those of endpoints it has no handle for yet.
+  void UpdateChannelHandles(const EndpointIds& endpoint_ids,
+                            ChannelHandles& channel_handles);
   void SendClientCallbacksForFinishedIncomingPayloadRunnable(
       ClientProxy* client, const std::string& endpoint_id,
       const PayloadTransferFrame::PayloadHeader& payload_header,
@@ -208,7 +239,7 @@ class PayloadManager : public EndpointManager::FrameProcessor {
   static PayloadProgressInfo::Status PayloadStatusToTransferUpdateStatus(
       proto::connections::PayloadStatus status);
 
-  int GetOptimalChunkSize(EndpointIds endpoint_ids);
+  static int GetOptimalChunkSize(const ChannelHandles& channel_handles);
 
   PayloadTransferFrame::PayloadHeader CreatePayloadHeader(
       const InternalPayload& payload, size_t offset);
@@ -216,9 +247,22 @@ class PayloadManager : public EndpointManager::FrameProcessor {
                                                         ByteArray body);
 
   PendingPayload* CreateIncomingPayload(const PayloadTransferFrame& frame,
-                                        const std::string& endpoint_id)
+                                        const std::string& endpoint_id,
+                                        std::int64_t resume_offset)
       ABSL_LOCKS_EXCLUDED(mutex_);
 
+  // Skips the outgoing payload ahead to the offset its only receiver asked to
+  // resume from, if any. Returns false if skipping failed.
+  bool SkipToResumeOffset(PendingPayload& pending_payload,
+                          std::int64_t& next_chunk_offset,
+                          size_t resume_offset);
+
+  // Updates the checkpoint of an incoming file payload after a chunk has been
+  // attached.
+  void UpdateCheckpoint(PendingPayload& pending_payload,
+                        const std::string& endpoint_id,
+                        const PayloadTransferFrame::PayloadHeader& header);
+
   Payload::Id CreateOutgoingPayload(Payload payload,
                                     const EndpointIds& endpoint_ids)
       ABSL_LOCKS_EXCLUDED(mutex_);
@@ -266,6 +310,11 @@ class PayloadManager : public EndpointManager::FrameProcessor {
   void ProcessDataPacket(ClientProxy* to_client,
                          const std::string& from_endpoint_id,
                          PayloadTransferFrame& payload_transfer_frame);
+  // Puts DATA frames that may arrive out of order over the stripes of an
+  // endpoint back in order, and processes the ones that are next in line.
+  void ProcessStripedDataPacket(ClientProxy* to_client,
+                                const std::string& from_endpoint_id,
+                                PayloadTransferFrame& payload_transfer_frame);
   void ProcessControlPacket(ClientProxy* to_client,
                             const std::string& from_endpoint_id,
                             PayloadTransferFrame& payload_transfer_frame);
@@ -286,12 +335,13 @@ class PayloadManager : public EndpointManager::FrameProcessor {
       ABSL_LOCKS_EXCLUDED(mutex_);
   void CancelAllPayloads() ABSL_LOCKS_EXCLUDED(mutex_);
 
-  void RecordPayloadStartedAnalytics(ClientProxy* client,
-                                     const EndpointIds& endpoint_ids,
-                                     std::int64_t payload_id,
-                                     Payload::Type payload_type,
-                                     std::int64_t offset,
-                                     std::int64_t total_size);
+  // Returns the chunk counter of the payload for each of |endpoint_ids|.
+  std::vector<analytics::AnalyticsRecorder::ChunkCounter>
+  RecordPayloadStartedAnalytics(ClientProxy* client,
+                                const EndpointIds& endpoint_ids,
+                                std::int64_t payload_id,
+                                Payload::Type payload_type,
+                                std::int64_t offset, std::int64_t total_size);
   void RecordInvalidPayloadAnalytics(ClientProxy* client,
                                      const EndpointIds& endpoint_ids,
                                      std::int64_t payload_id,
@@ -307,10 +357,12 @@ class PayloadManager : public EndpointManager::FrameProcessor {
   std::unique_ptr<CountDownLatch> shutdown_barrier_;
   int send_payload_count_ = 0;
   PendingPayloads pending_payloads_ ABSL_GUARDED_BY(mutex_);
-  SingleThreadExecutor bytes_payload_executor_;
-  SingleThreadExecutor file_payload_executor_;
-  SingleThreadExecutor stream_payload_executor_;
-  SingleThreadExecutor payload_status_update_executor_;
+  SingleThreadExecutor bytes_payload_executor_{"payload-bytes"};
+  SingleThreadExecutor file_payload_executor_{"payload-file"};
+  SingleThreadExecutor stream_payload_executor_{"payload-stream"};
+  SingleThreadExecutor payload_status_update_executor_{"payload-status"};
+  PayloadCheckpointStore checkpoint_store_;
+  ChunkReorderBuffer chunk_reorder_buffer_;
 
   EndpointManager* endpoint_manager_;
 };
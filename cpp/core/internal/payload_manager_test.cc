@@ -14,11 +14,16 @@
 
 #include "core/internal/payload_manager.h"
 
+#include <algorithm>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/strings/string_view.h"
+#include "core/internal/offline_frames.h"
 #include "core/internal/simulation_user.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/feature_flags.h"
+#include "platform/public/file.h"
 #include "platform/public/pipe.h"
 #include "platform/public/system_clock.h"
 
@@ -367,6 +372,134 @@ TEST_P(PayloadManagerTest, SendPayloadWithSkip_StreamPayload) {
 INSTANTIATE_TEST_SUITE_P(ParametrisedPayloadManagerTest, PayloadManagerTest,
                          ::testing::ValuesIn(kTestCases));
 
+// Receives file payloads straight from crafted frames; a sender in the same
+// process would share the payload's file.
+class PayloadManagerResumeTest : public ::testing::Test {
+ protected:
+  static constexpr std::int64_t kChunkSize = 512 * 1024;
+  static constexpr int kNumChunks = 3;
+  static constexpr std::int64_t kTotalSize = kNumChunks * kChunkSize;
+  static constexpr absl::string_view kEndpointId = "ABCD";
+
+  void SetUp() override {
+    FeatureFlags::Flags flags = FeatureFlags::GetInstance().GetFlags();
+    flags.enable_payload_checkpoints = true;
+    env_.SetFeatureFlags(flags);
+    env_.Start();
+  }
+  void TearDown() override {
+    pm_.DisconnectFromEndpointManager();
+    env_.Stop();
+    env_.SetFeatureFlags(FeatureFlags::Flags());
+  }
+
+  static ByteArray GetChunk(int index) {
+    return ByteArray(std::string(kChunkSize, static_cast<char>('a' + index)));
+  }
+
+  void ReceiveChunk(int index) {
+    ReceiveFrame(index * kChunkSize, GetChunk(index), /*last=*/false);
+  }
+  // Receives |size| bytes of the payload from |offset| in a single chunk.
+  void ReceiveBytes(std::int64_t offset, std::int64_t size) {
+    ReceiveFrame(offset, ByteArray(GetContents().substr(offset, size)),
+                 /*last=*/false);
+  }
+  void ReceiveLastChunk() {
+    ReceiveFrame(kTotalSize, ByteArray(), /*last=*/true);
+  }
+
+  // Drops the connection in the middle of the transfer.
+  void Disconnect() {
+    CountDownLatch barrier(1);
+    pm_.OnEndpointDisconnect(&client_, std::string(kEndpointId), barrier);
+    EXPECT_TRUE(barrier.Await(kDefaultTimeout).result());
+  }
+
+  std::string ReadFile() {
+    InputFile file(payload_id_, kTotalSize);
+    ExceptionOr<ByteArray> bytes = file.Read(2 * kTotalSize);
+    file.Close();
+    return bytes.ok() ? std::string(bytes.result()) : std::string();
+  }
+
+  std::string GetContents() {
+    std::string contents;
+    for (int i = 0; i < kNumChunks; i++) contents += std::string(GetChunk(i));
+    return contents;
+  }
+
+  MediumEnvironment& env_{MediumEnvironment::Instance()};
+  const Payload::Id payload_id_ = Payload::GenerateId();
+  ClientProxy client_;
+  EndpointChannelManager ecm_;
+  EndpointManager em_{&ecm_};
+  PayloadManager pm_{em_};
+
+ private:
+  void ReceiveFrame(std::int64_t offset, const ByteArray& body, bool last) {
+    PayloadTransferFrame::PayloadHeader header;
+    header.set_id(payload_id_);
+    header.set_type(PayloadTransferFrame::PayloadHeader::FILE);
+    header.set_total_size(kTotalSize);
+    PayloadTransferFrame::PayloadChunk chunk;
+    chunk.set_offset(offset);
+    chunk.set_flags(last ? PayloadTransferFrame::PayloadChunk::LAST_CHUNK : 0);
+    chunk.set_body(std::string(body));
+    ExceptionOr<OfflineFrame> frame =
+        parser::FromBytes(parser::ForDataPayloadTransfer(header, chunk));
+    ASSERT_TRUE(frame.ok());
+    pm_.OnIncomingFrame(frame.result(), std::string(kEndpointId), &client_,
+                        proto::connections::Medium::BLUETOOTH);
+  }
+};
+
+TEST_F(PayloadManagerResumeTest, ResumesFromCheckpoint) {
+  ReceiveChunk(0);
+  ReceiveChunk(1);
+  Disconnect();
+
+  // The sender starts over; the chunks the receiver has are ignored, until
+  // the sender skips to where it resumed.
+  ReceiveChunk(0);
+  ReceiveChunk(2);
+  ReceiveLastChunk();
+
+  EXPECT_EQ(ReadFile(), GetContents());
+}
+
+TEST_F(PayloadManagerResumeTest, ResumesWithOtherChunkSizes) {
+  ReceiveChunk(0);
+  ReceiveChunk(1);
+  Disconnect();
+
+  // The sender starts over with smaller chunks, one of which straddles the
+  // offset the receiver resumes from.
+  constexpr std::int64_t kOtherChunkSize = kChunkSize * 3 / 4;
+  for (std::int64_t offset = 0; offset < kTotalSize;
+       offset += kOtherChunkSize) {
+    ReceiveBytes(offset, std::min(kOtherChunkSize, kTotalSize - offset));
+  }
+  ReceiveLastChunk();
+
+  EXPECT_EQ(ReadFile(), GetContents());
+}
+
+TEST_F(PayloadManagerResumeTest, StartsOverIfFileIsTruncated) {
+  ReceiveChunk(0);
+  ReceiveChunk(1);
+  Disconnect();
+  // The app drops the partial file.
+  OutputFile(payload_id_).Close();
+
+  ReceiveChunk(0);
+  ReceiveChunk(1);
+  ReceiveChunk(2);
+  ReceiveLastChunk();
+
+  EXPECT_EQ(ReadFile(), GetContents());
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
@@ -27,6 +27,7 @@
 #include "core/params.h"
 #include "core/payload.h"
 #include "platform/public/logging.h"
+#include "platform/public/mutex_lock.h"
 
 namespace location {
 namespace nearby {
@@ -63,11 +64,17 @@ ServiceControllerRouter::ServiceControllerRouter() {
 ServiceControllerRouter::~ServiceControllerRouter() {
   NEARBY_LOGS(INFO) << "ServiceControllerRouter going down.";
 
-  if (service_controller_) {
-    service_controller_->Stop();
+  {
+    MutexLock lock(&service_controller_mutex_);
+    if (service_controller_) {
+      service_controller_->Stop();
+    }
   }
-  // And make sure that cleanup is the last thing we do.
+  // And make sure that cleanup is the last thing we do. Activities of the
+  // topology lane may still hand activities over to the payload lane, so it
+  // goes down first.
   serializer_.Shutdown();
+  payload_executor_.Shutdown();
 }
 
 void ServiceControllerRouter::StartAdvertising(
@@ -75,7 +82,7 @@ void ServiceControllerRouter::StartAdvertising(
     const ConnectionOptions& options, const ConnectionRequestInfo& info,
     const ResultCallback& callback) {
   RouteToServiceController(
-      "scr-start-advertising",
+      "scr-start-advertising", client, Lane::kTopology,
       [this, client, service_id = std::string(service_id), options, info,
        callback]() {
         if (client->IsAdvertising()) {
@@ -90,12 +97,13 @@ void ServiceControllerRouter::StartAdvertising(
 
 void ServiceControllerRouter::StopAdvertising(ClientProxy* client,
                                               const ResultCallback& callback) {
-  RouteToServiceController("scr-stop-advertising", [this, client, callback]() {
-    if (client->IsAdvertising()) {
-      GetServiceController()->StopAdvertising(client);
-    }
-    callback.result_cb({Status::kSuccess});
-  });
+  RouteToServiceController("scr-stop-advertising", client, Lane::kTopology,
+                           [this, client, callback]() {
+                             if (client->IsAdvertising()) {
+                               GetServiceController()->StopAdvertising(client);
+                             }
+                             callback.result_cb({Status::kSuccess});
+                           });
 }
 
 void ServiceControllerRouter::StartDiscovery(ClientProxy* client,
@@ -104,7 +112,7 @@ void ServiceControllerRouter::StartDiscovery(ClientProxy* client,
                                              const DiscoveryListener& listener,
                                              const ResultCallback& callback) {
   RouteToServiceController(
-      "scr-start-discovery",
+      "scr-start-discovery", client, Lane::kTopology,
       [this, client, service_id = std::string(service_id), options, listener,
        callback]() {
         if (client->IsDiscovering()) {
@@ -119,12 +127,13 @@ void ServiceControllerRouter::StartDiscovery(ClientProxy* client,
 
 void ServiceControllerRouter::StopDiscovery(ClientProxy* client,
                                             const ResultCallback& callback) {
-  RouteToServiceController("scr-stop-discovery", [this, client, callback]() {
-    if (client->IsDiscovering()) {
-      GetServiceController()->StopDiscovery(client);
-    }
-    callback.result_cb({Status::kSuccess});
-  });
+  RouteToServiceController("scr-stop-discovery", client, Lane::kTopology,
+                           [this, client, callback]() {
+                             if (client->IsDiscovering()) {
+                               GetServiceController()->StopDiscovery(client);
+                             }
+                             callback.result_cb({Status::kSuccess});
+                           });
 }
 
 void ServiceControllerRouter::InjectEndpoint(
@@ -132,7 +141,7 @@ void ServiceControllerRouter::InjectEndpoint(
     const OutOfBandConnectionMetadata& metadata,
     const ResultCallback& callback) {
   RouteToServiceController(
-      "scr-inject-endpoint",
+      "scr-inject-endpoint", client, Lane::kTopology,
       [this, client, service_id = std::string(service_id), metadata,
        callback]() {
         // Currently, Bluetooth is the only supported medium for endpoint
@@ -173,7 +182,7 @@ void ServiceControllerRouter::RequestConnection(
   client->AddCancellationFlag(std::string(endpoint_id));
 
   RouteToServiceController(
-      "scr-request-connection",
+      "scr-request-connection", client, Lane::kTopology,
       [this, client, endpoint_id = std::string(endpoint_id), info, options,
        callback]() {
         if (client->HasPendingConnectionToEndpoint(endpoint_id) ||
@@ -196,7 +205,7 @@ void ServiceControllerRouter::AcceptConnection(ClientProxy* client,
                                                const PayloadListener& listener,
                                                const ResultCallback& callback) {
   RouteToServiceController(
-      "scr-accept-connection",
+      "scr-accept-connection", client, Lane::kTopology,
       [this, client, endpoint_id = std::string(endpoint_id), listener,
        callback]() {
         if (client->IsConnectedToEndpoint(endpoint_id)) {
@@ -225,7 +234,7 @@ void ServiceControllerRouter::RejectConnection(ClientProxy* client,
   client->CancelEndpoint(std::string(endpoint_id));
 
   RouteToServiceController(
-      "scr-reject-connection",
+      "scr-reject-connection", client, Lane::kTopology,
       [this, client, endpoint_id = std::string(endpoint_id), callback]() {
         if (client->IsConnectedToEndpoint(endpoint_id)) {
           callback.result_cb({Status::kAlreadyConnectedToEndpoint});
@@ -251,7 +260,7 @@ void ServiceControllerRouter::InitiateBandwidthUpgrade(
     ClientProxy* client, absl::string_view endpoint_id,
     const ResultCallback& callback) {
   RouteToServiceController(
-      "scr-init-bwu",
+      "scr-init-bwu", client, Lane::kTopology,
       [this, client, endpoint_id = std::string(endpoint_id), callback]() {
         if (!client->IsConnectedToEndpoint(endpoint_id)) {
           callback.result_cb({Status::kOutOfOrderApiCall});
@@ -279,29 +288,31 @@ void ServiceControllerRouter::SendPayload(
   const std::vector<std::string> endpoints =
       std::vector<std::string>(endpoint_ids.begin(), endpoint_ids.end());
 
-  RouteToServiceController("scr-send-payload", [this, client, shared_payload,
-                                                endpoints, callback]() {
-    if (!ClientHasConnectionToAtLeastOneEndpoint(client, endpoints)) {
-      callback.result_cb({Status::kEndpointUnknown});
-      return;
-    }
+  RouteToServiceController(
+      "scr-send-payload", client, Lane::kPayload,
+      [this, client, shared_payload, endpoints, callback]() {
+        if (!ClientHasConnectionToAtLeastOneEndpoint(client, endpoints)) {
+          callback.result_cb({Status::kEndpointUnknown});
+          return;
+        }
 
-    GetServiceController()->SendPayload(client, endpoints,
-                                        std::move(*shared_payload));
+        GetServiceController()->SendPayload(client, endpoints,
+                                            std::move(*shared_payload));
 
-    // At this point, we've queued up the send Payload request with the
-    // ServiceController; any further failures (e.g. one of the endpoints is
-    // unknown, goes away, or otherwise fails) will be returned to the
-    // client as a PayloadTransferUpdate.
-    callback.result_cb({Status::kSuccess});
-  });
+        // At this point, we've queued up the send Payload request with the
+        // ServiceController; any further failures (e.g. one of the endpoints
+        // is unknown, goes away, or otherwise fails) will be returned to the
+        // client as a PayloadTransferUpdate.
+        callback.result_cb({Status::kSuccess});
+      });
 }
 
 void ServiceControllerRouter::CancelPayload(ClientProxy* client,
                                             std::uint64_t payload_id,
                                             const ResultCallback& callback) {
   RouteToServiceController(
-      "scr-cancel-payload", [this, client, payload_id, callback]() {
+      "scr-cancel-payload", client, Lane::kPayload,
+      [this, client, payload_id, callback]() {
         callback.result_cb(
             GetServiceController()->CancelPayload(client, payload_id));
       });
@@ -315,7 +326,7 @@ void ServiceControllerRouter::DisconnectFromEndpoint(
   client->CancelEndpoint(std::string(endpoint_id));
 
   RouteToServiceController(
-      "scr-disconnect-endpoint",
+      "scr-disconnect-endpoint", client, Lane::kTopology,
       [this, client, endpoint_id = std::string(endpoint_id), callback]() {
         if (!client->IsConnectedToEndpoint(endpoint_id) &&
             !client->HasPendingConnectionToEndpoint(endpoint_id)) {
@@ -335,7 +346,8 @@ void ServiceControllerRouter::StopAllEndpoints(ClientProxy* client,
   client->CancelAllEndpoints();
 
   RouteToServiceController(
-      "scr-stop-all-endpoints", [this, client, callback]() {
+      "scr-stop-all-endpoints", client, Lane::kTopology,
+      [this, client, callback]() {
         NEARBY_LOGS(INFO) << "Client " << client->GetClientId()
                           << " has requested us to stop all endpoints. We will "
                              "now reset the client.";
@@ -346,10 +358,12 @@ void ServiceControllerRouter::StopAllEndpoints(ClientProxy* client,
 
 void ServiceControllerRouter::SetServiceControllerForTesting(
     std::unique_ptr<ServiceController> service_controller) {
+  MutexLock lock(&service_controller_mutex_);
   service_controller_ = std::move(service_controller);
 }
 
 ServiceController* ServiceControllerRouter::GetServiceController() {
+  MutexLock lock(&service_controller_mutex_);
   if (!service_controller_) {
     service_controller_ = std::make_unique<OfflineServiceController>();
   }
@@ -375,8 +389,48 @@ void ServiceControllerRouter::FinishClientSession(ClientProxy* client) {
 }
 
 void ServiceControllerRouter::RouteToServiceController(const std::string& name,
+                                                       ClientProxy* client,
+                                                       Lane lane,
                                                        Runnable runnable) {
-  serializer_.Execute(name, std::move(runnable));
+  {
+    MutexLock lock(&mutex_);
+    auto item = clients_.find(client);
+    if (item != clients_.end()) {
+      // Wait for the activity the client has in progress.
+      item->second.push_back({name, lane, std::move(runnable)});
+      return;
+    }
+    clients_.emplace(client, std::deque<Activity>());
+  }
+  RunActivity(client, {name, lane, std::move(runnable)});
+}
+
+void ServiceControllerRouter::RunActivity(ClientProxy* client,
+                                          Activity activity) {
+  SubmittableExecutor& executor =
+      activity.lane == Lane::kTopology
+          ? static_cast<SubmittableExecutor&>(serializer_)
+          : static_cast<SubmittableExecutor&>(payload_executor_);
+  executor.Execute(activity.name,
+                   [this, client, runnable = std::move(activity.runnable)]() {
+                     runnable();
+                     RunNextActivity(client);
+                   });
+}
+
+void ServiceControllerRouter::RunNextActivity(ClientProxy* client) {
+  Activity activity;
+  {
+    MutexLock lock(&mutex_);
+    auto item = clients_.find(client);
+    if (item->second.empty()) {
+      clients_.erase(item);
+      return;
+    }
+    activity = std::move(item->second.front());
+    item->second.pop_front();
+  }
+  RunActivity(client, std::move(activity));
 }
 
 }  // namespace connections
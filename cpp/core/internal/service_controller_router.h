@@ -15,10 +15,13 @@
 #ifndef CORE_INTERNAL_SERVICE_CONTROLLER_ROUTER_H_
 #define CORE_INTERNAL_SERVICE_CONTROLLER_ROUTER_H_
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
@@ -27,6 +30,8 @@
 #include "core/options.h"
 #include "core/params.h"
 #include "platform/base/runnable.h"
+#include "platform/public/multi_thread_executor.h"
+#include "platform/public/mutex.h"
 #include "platform/public/single_thread_executor.h"
 
 namespace location {
@@ -47,8 +52,16 @@ namespace connections {
 //
 // Every activity is handled the same way:
 // 1) all the arguments to the call are captured by value;
-// 2) the actual processing is scheduled on a private single-threaded executor,
-//    which makes locking unnecessary, when internal data is being manipulated.
+// 2) the actual processing is scheduled on one of two lanes:
+//    - the topology lane, a private single-threaded executor, takes the
+//      activities that change what clients advertise, discover or are
+//      connected to. They are serialized across all clients, which makes
+//      locking unnecessary when internal data is being manipulated;
+//    - the payload lane takes SendPayload() and CancelPayload(), so a slow
+//      topology activity of one client, such as turning radios on, does not
+//      hold up the payloads of another.
+//    Either way, the activities of a client run one at a time, in the order
+//    the client asked for them.
 // 3) activity handlers are delegating much of their work to an implementation
 //    of a ServiceController interface, which does the actual job.
 class ServiceControllerRouter {
@@ -113,14 +126,40 @@ class ServiceControllerRouter {
       std::unique_ptr<ServiceController> service_controller);
 
  private:
-  // Lazily create ServiceController.
-  ServiceController* GetServiceController();
+  enum class Lane { kTopology, kPayload };
+
+  struct Activity {
+    std::string name;
+    Lane lane = Lane::kTopology;
+    Runnable runnable;
+  };
 
-  void RouteToServiceController(const std::string& name, Runnable runnable);
+  // Threads of the payload lane; payload activities only queue work for
+  // PayloadManager, so a few threads serve many clients.
+  static constexpr int kPayloadLaneThreads = 4;
+
+  // Lazily create ServiceController.
+  ServiceController* GetServiceController()
+      ABSL_LOCKS_EXCLUDED(service_controller_mutex_);
+
+  void RouteToServiceController(const std::string& name, ClientProxy* client,
+                                Lane lane, Runnable runnable)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void RunActivity(ClientProxy* client, Activity activity);
+  // Runs the next activity |client| has waiting, if any.
+  void RunNextActivity(ClientProxy* client) ABSL_LOCKS_EXCLUDED(mutex_);
   void FinishClientSession(ClientProxy* client);
 
-  std::unique_ptr<ServiceController> service_controller_;
-  SingleThreadExecutor serializer_;
+  Mutex service_controller_mutex_;
+  std::unique_ptr<ServiceController> service_controller_
+      ABSL_GUARDED_BY(service_controller_mutex_);
+  Mutex mutex_;
+  // Clients with an activity in progress, and the activities they have
+  // waiting for it.
+  absl::flat_hash_map<ClientProxy*, std::deque<Activity>> clients_
+      ABSL_GUARDED_BY(mutex_);
+  SingleThreadExecutor serializer_{"router"};
+  MultiThreadExecutor payload_executor_{"router-payload", kPayloadLaneThreads};
 };
 
 }  // namespace connections
@@ -19,6 +19,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -33,6 +34,7 @@
 #include "core/params.h"
 #include "platform/base/byte_array.h"
 #include "platform/public/condition_variable.h"
+#include "platform/public/count_down_latch.h"
 #include "platform/public/mutex.h"
 #include "platform/public/mutex_lock.h"
 
@@ -41,6 +43,8 @@ namespace nearby {
 namespace connections {
 
 namespace {
+using ::testing::ElementsAre;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
 constexpr std::array<char, 6> kFakeMacAddress = {'a', 'b', 'c', 'd', 'e', 'f'};
 constexpr std::array<char, 6> kFakeInjectedEndpointInfo = {'g', 'h', 'i'};
@@ -415,6 +419,68 @@ TEST_F(ServiceControllerRouterTest, DisconnectFromEndpointCalled) {
   DisconnectFromEndpoint(&client_, kRemoteEndpointId, kCallback);
 }
 
+TEST_F(ServiceControllerRouterTest, PayloadCallsDoNotWaitForOtherClients) {
+  ClientProxy other_client;
+  CountDownLatch advertising_started(1);
+  CountDownLatch release_advertising(1);
+  CountDownLatch advertising_done(1);
+  CountDownLatch cancel_done(1);
+  EXPECT_CALL(*mock_, StartAdvertising)
+      .WillOnce(InvokeWithoutArgs([&]() {
+        advertising_started.CountDown();
+        release_advertising.Await();
+        return Status{Status::kSuccess};
+      }));
+  EXPECT_CALL(*mock_, CancelPayload).WillOnce(Return(Status{Status::kSuccess}));
+
+  router_.StartAdvertising(
+      &other_client, kServiceId, kConnectionOptions, kConnectionRequestInfo,
+      {.result_cb = [&](Status) { advertising_done.CountDown(); }});
+  advertising_started.Await();
+  // While the other client is still busy with its radios, payload calls of
+  // this one go through.
+  router_.CancelPayload(
+      &client_, kPayloadId,
+      {.result_cb = [&](Status) { cancel_done.CountDown(); }});
+  EXPECT_TRUE(cancel_done.Await(absl::Seconds(1)).result());
+
+  release_advertising.CountDown();
+  advertising_done.Await();
+}
+
+TEST_F(ServiceControllerRouterTest, CallsOfClientRunInOrder) {
+  CountDownLatch release_advertising(1);
+  CountDownLatch cancel_done(1);
+  Mutex calls_mutex;
+  std::vector<std::string> calls;
+  EXPECT_CALL(*mock_, StartAdvertising)
+      .WillOnce(InvokeWithoutArgs([&]() {
+        release_advertising.Await();
+        MutexLock lock(&calls_mutex);
+        calls.push_back("StartAdvertising");
+        return Status{Status::kSuccess};
+      }));
+  EXPECT_CALL(*mock_, CancelPayload).WillOnce(InvokeWithoutArgs([&]() {
+    MutexLock lock(&calls_mutex);
+    calls.push_back("CancelPayload");
+    return Status{Status::kSuccess};
+  }));
+
+  router_.StartAdvertising(&client_, kServiceId, kConnectionOptions,
+                           kConnectionRequestInfo, {});
+  router_.CancelPayload(
+      &client_, kPayloadId,
+      {.result_cb = [&](Status) { cancel_done.CountDown(); }});
+  // The payload lane is free, but the payload call waits for the client's
+  // previous call anyway.
+  EXPECT_FALSE(cancel_done.Await(absl::Milliseconds(100)).result());
+
+  release_advertising.CountDown();
+  cancel_done.Await();
+  MutexLock lock(&calls_mutex);
+  EXPECT_THAT(calls, ElementsAre("StartAdvertising", "CancelPayload"));
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
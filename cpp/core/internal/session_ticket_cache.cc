@@ -0,0 +1,89 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/session_ticket_cache.h"
+
+#include <utility>
+
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr absl::Duration SessionTicketCache::kTicketLifetime;
+constexpr int SessionTicketCache::kMaxTickets;
+
+void SessionTicketCache::Add(const std::string& endpoint_id,
+                             const ByteArray& id, const ByteArray& secret) {
+  MutexLock lock(&mutex_);
+  if (!tickets_.contains(endpoint_id) &&
+      static_cast<int>(tickets_.size()) >= kMaxTickets) {
+    EvictFirstToExpireLocked();
+  }
+  tickets_[endpoint_id] = {id, secret,
+                           SystemClock::ElapsedRealtime() + lifetime_};
+}
+
+bool SessionTicketCache::TakeForEndpoint(const std::string& endpoint_id,
+                                         Ticket* ticket) {
+  MutexLock lock(&mutex_);
+  return TakeLocked(tickets_.find(endpoint_id), ticket);
+}
+
+bool SessionTicketCache::TakeById(const ByteArray& id, Ticket* ticket) {
+  MutexLock lock(&mutex_);
+  auto it = tickets_.begin();
+  while (it != tickets_.end() && it->second.id != id) ++it;
+  return TakeLocked(it, ticket);
+}
+
+void SessionTicketCache::Invalidate(const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+  tickets_.erase(endpoint_id);
+}
+
+void SessionTicketCache::InvalidateAll() {
+  MutexLock lock(&mutex_);
+  tickets_.clear();
+}
+
+int SessionTicketCache::Size() const {
+  MutexLock lock(&mutex_);
+  return static_cast<int>(tickets_.size());
+}
+
+bool SessionTicketCache::TakeLocked(
+    absl::flat_hash_map<std::string, Ticket>::iterator it, Ticket* ticket) {
+  if (it == tickets_.end()) return false;
+  bool valid = it->second.expiration > SystemClock::ElapsedRealtime();
+  if (valid) *ticket = std::move(it->second);
+  tickets_.erase(it);
+  return valid;
+}
+
+void SessionTicketCache::EvictFirstToExpireLocked() {
+  auto first = tickets_.begin();
+  for (auto it = tickets_.begin(); it != tickets_.end(); ++it) {
+    if (it->second.expiration < first->second.expiration) first = it;
+  }
+  if (first != tickets_.end()) tickets_.erase(first);
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,92 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_SESSION_TICKET_CACHE_H_
+#define CORE_INTERNAL_SESSION_TICKET_CACHE_H_
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Remembers a secret of each authenticated UKEY2 session, so that the next
+// connection with the same endpoint can derive its keys from it in a single
+// round trip instead of running UKEY2 again (see EncryptionRunner).
+//
+// A ticket is handed out at most once, and is useless after its lifetime. The
+// cache is bounded; when it is full, the ticket that expires first is evicted.
+class SessionTicketCache {
+ public:
+  static constexpr absl::Duration kTicketLifetime = absl::Minutes(30);
+  static constexpr int kMaxTickets = 64;
+
+  struct Ticket {
+    // Names the ticket on the wire; both sides of the session derive it.
+    ByteArray id;
+    // Never leaves the device.
+    ByteArray secret;
+    absl::Time expiration;
+  };
+
+  explicit SessionTicketCache(absl::Duration lifetime = kTicketLifetime)
+      : lifetime_(lifetime) {}
+  SessionTicketCache(const SessionTicketCache&) = delete;
+  SessionTicketCache& operator=(const SessionTicketCache&) = delete;
+
+  // Remembers the ticket of the latest session with the endpoint, replacing
+  // the previous one.
+  void Add(const std::string& endpoint_id, const ByteArray& id,
+           const ByteArray& secret) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Hands out, and forgets, the ticket of the endpoint. Returns false if there
+  // is no ticket that is still valid.
+  bool TakeForEndpoint(const std::string& endpoint_id, Ticket* ticket)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Hands out, and forgets, the ticket with the given id. Returns false if
+  // there is no ticket that is still valid.
+  bool TakeById(const ByteArray& id, Ticket* ticket)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets the ticket of the endpoint, so that the next connection with it
+  // runs UKEY2.
+  void Invalidate(const std::string& endpoint_id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets all tickets.
+  void InvalidateAll() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of tickets currently held.
+  int Size() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  bool TakeLocked(absl::flat_hash_map<std::string, Ticket>::iterator it,
+                  Ticket* ticket) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EvictFirstToExpireLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const absl::Duration lifetime_;
+  mutable Mutex mutex_;
+  absl::flat_hash_map<std::string, Ticket> tickets_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_SESSION_TICKET_CACHE_H_
@@ -0,0 +1,109 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/session_ticket_cache.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kEndpointId[] = "ABCD";
+
+TEST(SessionTicketCacheTest, TakeForEndpointHandsOutTicketOnce) {
+  SessionTicketCache cache;
+  ByteArray id{std::string("ticket id")};
+  ByteArray secret{std::string("ticket secret")};
+  cache.Add(kEndpointId, id, secret);
+  SessionTicketCache::Ticket ticket;
+
+  EXPECT_FALSE(cache.TakeForEndpoint("WXYZ", &ticket));
+  ASSERT_TRUE(cache.TakeForEndpoint(kEndpointId, &ticket));
+  EXPECT_EQ(ticket.id, id);
+  EXPECT_EQ(ticket.secret, secret);
+  EXPECT_FALSE(cache.TakeForEndpoint(kEndpointId, &ticket));
+}
+
+TEST(SessionTicketCacheTest, TakeByIdHandsOutTicketOnce) {
+  SessionTicketCache cache;
+  ByteArray id{std::string("ticket id")};
+  ByteArray secret{std::string("ticket secret")};
+  cache.Add(kEndpointId, id, secret);
+  SessionTicketCache::Ticket ticket;
+
+  EXPECT_FALSE(cache.TakeById(ByteArray{std::string("other id")}, &ticket));
+  ASSERT_TRUE(cache.TakeById(id, &ticket));
+  EXPECT_EQ(ticket.secret, secret);
+  EXPECT_FALSE(cache.TakeById(id, &ticket));
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST(SessionTicketCacheTest, AddReplacesTicketOfEndpoint) {
+  SessionTicketCache cache;
+  ByteArray old_id{std::string("old id")};
+  ByteArray new_id{std::string("new id")};
+  cache.Add(kEndpointId, old_id, ByteArray{std::string("old secret")});
+  cache.Add(kEndpointId, new_id, ByteArray{std::string("new secret")});
+  SessionTicketCache::Ticket ticket;
+
+  EXPECT_FALSE(cache.TakeById(old_id, &ticket));
+  EXPECT_TRUE(cache.TakeById(new_id, &ticket));
+}
+
+TEST(SessionTicketCacheTest, ExpiredTicketIsNotHandedOut) {
+  SessionTicketCache cache(/*lifetime=*/absl::ZeroDuration());
+  cache.Add(kEndpointId, ByteArray{std::string("ticket id")},
+            ByteArray{std::string("ticket secret")});
+  SessionTicketCache::Ticket ticket;
+
+  EXPECT_FALSE(cache.TakeForEndpoint(kEndpointId, &ticket));
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST(SessionTicketCacheTest, InvalidateForgetsTickets) {
+  SessionTicketCache cache;
+  cache.Add(kEndpointId, ByteArray{std::string("id 1")},
+            ByteArray{std::string("secret 1")});
+  cache.Add("WXYZ", ByteArray{std::string("id 2")},
+            ByteArray{std::string("secret 2")});
+  SessionTicketCache::Ticket ticket;
+
+  cache.Invalidate(kEndpointId);
+
+  EXPECT_FALSE(cache.TakeForEndpoint(kEndpointId, &ticket));
+  EXPECT_EQ(cache.Size(), 1);
+
+  cache.InvalidateAll();
+
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+TEST(SessionTicketCacheTest, SizeIsBounded) {
+  SessionTicketCache cache;
+  for (int i = 0; i < SessionTicketCache::kMaxTickets + 10; ++i) {
+    std::string n = std::to_string(i);
+    cache.Add(n, ByteArray{"id " + n}, ByteArray{"secret " + n});
+  }
+
+  EXPECT_EQ(cache.Size(), SessionTicketCache::kMaxTickets);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
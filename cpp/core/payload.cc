@@ -42,6 +42,9 @@ Payload::Payload(std::function<InputStream&()> stream)
     : content_(std::move(stream)) {}
 
 // Constructors for incoming payloads.
+Payload::Payload(std::shared_ptr<PayloadSource> source)
+    : content_(std::move(source)) {}
+
 Payload::Payload(Id id, ByteArray&& bytes)
     : content_(std::move(bytes)), id_(id) {}
 
@@ -53,6 +56,9 @@ Payload::Payload(Id id, InputFile file) : content_(std::move(file)), id_(id) {}
 Payload::Payload(Id id, std::function<InputStream&()> stream)
     : content_(std::move(stream)), id_(id) {}
 
+Payload::Payload(Id id, std::shared_ptr<PayloadSource> source)
+    : content_(std::move(source)), id_(id) {}
+
 // Returns ByteArray payload, if it has been defined, or empty ByteArray.
 const ByteArray& Payload::AsBytes() const& {
   static const ByteArray empty;  // NOLINT: function-level static is OK.
@@ -65,9 +71,15 @@ ByteArray&& Payload::AsBytes() && {
 }
 // Returns InputStream* payload, if it has been defined, or nullptr.
 InputStream* Payload::AsStream() {
+  PayloadSource* source = AsSource();
+  if (source) return &source->GetInputStream();
   auto* result = absl::get_if<std::function<InputStream&()>>(&content_);
   return result ? &(*result)() : nullptr;
 }
+PayloadSource* Payload::AsSource() {
+  auto* result = absl::get_if<std::shared_ptr<PayloadSource>>(&content_);
+  return result ? result->get() : nullptr;
+}
 // Returns InputFile* payload, if it has been defined, or nullptr.
 InputFile* Payload::AsFile() { return absl::get_if<InputFile>(&content_); }
 
@@ -93,6 +105,9 @@ size_t Payload::GetOffset() { return offset_; }
 Payload::Id Payload::GenerateId() { return Prng().NextInt64(); }
 
 Payload::Type Payload::FindType() const {
+  if (absl::holds_alternative<std::shared_ptr<PayloadSource>>(content_)) {
+    return Type::kStream;
+  }
   return static_cast<Type>(content_.index());
 }
 
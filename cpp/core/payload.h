@@ -21,6 +21,7 @@
 #include <utility>
 
 #include "absl/types/variant.h"
+#include "core/payload_source.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/input_stream.h"
 #include "platform/base/payload_id.h"
@@ -35,14 +36,16 @@ namespace connections {
 
 // Payload is default-constructible, and moveable, but not copyable container
 // that holds at most one instance of one of:
-// ByteArray, InputStream, or InputFile.
+// ByteArray, InputStream, InputFile, or PayloadSource.
 class Payload {
  public:
   using Id = PayloadId;
   // Order of types in variant, and values in Type enum is important.
-  // Enum values must match respective variant types.
-  using Content = absl::variant<absl::monostate, ByteArray,
-                                std::function<InputStream&()>, InputFile>;
+  // Enum values must match respective variant types; a PayloadSource, that
+  // comes last, is a kStream too.
+  using Content =
+      absl::variant<absl::monostate, ByteArray, std::function<InputStream&()>,
+                    InputFile, std::shared_ptr<PayloadSource>>;
   enum class Type { kUnknown = 0, kBytes = 1, kStream = 2, kFile = 3 };
 
   Payload(Payload&& other) noexcept;
@@ -58,19 +61,25 @@ class Payload {
   explicit Payload(const ByteArray& bytes);
   explicit Payload(InputFile file);
   explicit Payload(std::function<InputStream&()> stream);
+  // The caller keeps a reference to |source| to write the stream to it.
+  explicit Payload(std::shared_ptr<PayloadSource> source);
 
   // Constructors for incoming payloads.
   Payload(Id id, ByteArray&& bytes);
   Payload(Id id, const ByteArray& bytes);
   Payload(Id id, InputFile file);
   Payload(Id id, std::function<InputStream&()> stream);
+  Payload(Id id, std::shared_ptr<PayloadSource> source);
 
 
   // Returns ByteArray payload, if it has been defined, or empty ByteArray.
   const ByteArray& AsBytes() const&;
   ByteArray&& AsBytes() &&;
   // Returns InputStream* payload, if it has been defined, or nullptr.
+  // A PayloadSource payload is read through PayloadSource::GetInputStream().
   InputStream* AsStream();
+  // Returns PayloadSource* payload, if it has been defined, or nullptr.
+  PayloadSource* AsSource();
   // Returns InputFile* payload, if it has been defined, or nullptr.
   InputFile* AsFile();
 
@@ -0,0 +1,185 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/payload_source.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+PayloadSource::PayloadSource(std::size_t max_buffered_bytes)
+    : max_buffered_bytes_(max_buffered_bytes) {}
+
+Exception PayloadSource::Write(ByteArray buffer) {
+  // An empty buffer would read as the end of the stream.
+  if (buffer.Empty()) return {Exception::kSuccess};
+  {
+    MutexLock lock(&mutex_);
+    while (!closed_ && !canceled_ && !has_sink_ && !IsWritableLocked()) {
+      cond_.Wait();
+    }
+    if (closed_ || canceled_) return {Exception::kIo};
+    if (!has_sink_) {
+      buffered_bytes_ += buffer.size();
+      buffers_.push_back(std::move(buffer));
+      cond_.Notify();
+      return {Exception::kSuccess};
+    }
+  }
+  MutexLock sink_lock(&sink_mutex_);
+  return Deliver(std::move(buffer));
+}
+
+bool PayloadSource::IsWritable() const {
+  MutexLock lock(&mutex_);
+  return closed_ || canceled_ || has_sink_ || IsWritableLocked();
+}
+
+void PayloadSource::SetWritableCallback(std::function<void()> callback) {
+  MutexLock lock(&mutex_);
+  writable_cb_ = std::move(callback);
+}
+
+void PayloadSource::Close() {
+  MutexLock sink_lock(&sink_mutex_);
+  {
+    MutexLock lock(&mutex_);
+    if (closed_ || canceled_) return;
+    closed_ = true;
+    cond_.Notify();
+    if (!has_sink_) return;
+  }
+  DeliverClose();
+}
+
+ExceptionOr<ByteArray> PayloadSource::Read(std::size_t max_size) {
+  ByteArray result;
+  std::function<void()> writable_cb;
+  {
+    MutexLock lock(&mutex_);
+    while (!canceled_ && !has_sink_ && !closed_ && buffers_.empty()) {
+      cond_.Wait();
+    }
+    if (canceled_ || has_sink_) {
+      return ExceptionOr<ByteArray>{Exception::kIo};
+    }
+    if (buffers_.empty()) return ExceptionOr<ByteArray>{ByteArray{}};
+
+    bool was_writable = IsWritableLocked();
+    ByteArray& front = buffers_.front();
+    std::size_t remaining = front.size() - front_offset_;
+    if (front_offset_ == 0 && remaining <= max_size) {
+      // The whole buffer goes to the reader as is.
+      result = std::move(front);
+      buffers_.pop_front();
+    } else {
+      std::size_t size = std::min(remaining, max_size);
+      result = ByteArray(front.data() + front_offset_, size);
+      front_offset_ += size;
+      if (front_offset_ == front.size()) {
+        buffers_.pop_front();
+        front_offset_ = 0;
+      }
+    }
+    buffered_bytes_ -= result.size();
+    if (!was_writable && IsWritableLocked()) writable_cb = writable_cb_;
+    cond_.Notify();
+  }
+  if (writable_cb) writable_cb();
+  return ExceptionOr<ByteArray>{std::move(result)};
+}
+
+void PayloadSource::SetSink(PayloadSink sink) {
+  std::deque<ByteArray> buffers;
+  std::function<void()> writable_cb;
+  {
+    MutexLock sink_lock(&sink_mutex_);
+    bool ended;
+    {
+      MutexLock lock(&mutex_);
+      if (has_sink_) return;
+      has_sink_ = true;
+      if (!IsWritableLocked()) writable_cb = writable_cb_;
+      buffers.swap(buffers_);
+      if (front_offset_ > 0) {
+        ByteArray& front = buffers.front();
+        front = ByteArray(front.data() + front_offset_,
+                          front.size() - front_offset_);
+        front_offset_ = 0;
+      }
+      buffered_bytes_ = 0;
+      ended = closed_ || canceled_;
+      // Blocked writers and readers have to take note of the sink.
+      cond_.Notify();
+    }
+    sink_ = std::move(sink);
+    for (ByteArray& buffer : buffers) {
+      if (!Deliver(std::move(buffer)).Ok()) break;
+    }
+    if (ended) DeliverClose();
+  }
+  if (writable_cb) writable_cb();
+}
+
+void PayloadSource::Cancel() {
+  std::function<void()> writable_cb;
+  {
+    MutexLock sink_lock(&sink_mutex_);
+    bool has_sink;
+    {
+      MutexLock lock(&mutex_);
+      if (canceled_) return;
+      canceled_ = true;
+      buffers_.clear();
+      buffered_bytes_ = 0;
+      front_offset_ = 0;
+      has_sink = has_sink_;
+      writable_cb = writable_cb_;
+      cond_.Notify();
+    }
+    if (has_sink) DeliverClose();
+  }
+  if (writable_cb) writable_cb();
+}
+
+bool PayloadSource::IsWritableLocked() const {
+  return buffered_bytes_ < max_buffered_bytes_;
+}
+
+Exception PayloadSource::Deliver(ByteArray buffer) {
+  if (sink_closed_) return {Exception::kIo};
+  if (sink_.buffer_cb(std::move(buffer)).Ok()) return {Exception::kSuccess};
+  {
+    MutexLock lock(&mutex_);
+    canceled_ = true;
+    cond_.Notify();
+  }
+  DeliverClose();
+  return {Exception::kIo};
+}
+
+void PayloadSource::DeliverClose() {
+  if (sink_closed_) return;
+  sink_closed_ = true;
+  sink_.close_cb();
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
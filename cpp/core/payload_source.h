@@ -0,0 +1,153 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_PAYLOAD_SOURCE_H_
+#define CORE_PAYLOAD_SOURCE_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+#include "platform/base/input_stream.h"
+#include "platform/base/listeners.h"
+#include "platform/public/condition_variable.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// PayloadSink receives an incoming STREAM payload buffer by buffer, as it
+// arrives; see PayloadSource::SetSink().
+struct PayloadSink {
+  // Takes over the next buffer of the stream. Returning anything but
+  // Exception::kSuccess cancels the stream. The connection does not move on
+  // before this returns, so a slow sink holds back its sender.
+  std::function<Exception(ByteArray buffer)> buffer_cb =
+      [](ByteArray) -> Exception { return {Exception::kSuccess}; };
+  // Called once, after the last buffer or when the stream is canceled.
+  std::function<void()> close_cb = DefaultCallback<>();
+};
+
+// PayloadSource is a STREAM payload made of the buffers its writer hands
+// over. The reader takes each buffer as it was written: nothing is copied in
+// between, unless the reader asks for less than a whole buffer.
+//
+// Outgoing, the application makes a source, sends Payload(source), and then
+// writes its data (e.g. camera frames, sensor batches) to the source; chunks
+// are sent as soon as they are written. Buffers no larger than the chunk size
+// of the medium go out without a copy.
+// Incoming, a STREAM payload is backed by a source too. The application reads
+// whole buffers from it with Read(), or attaches a PayloadSink. Reading it
+// through Payload::AsStream() still works.
+//
+// Flow control: the source holds at most |max_buffered_bytes| that the reader
+// has not taken yet. Write() blocks past that. A writer that must not block
+// checks IsWritable() and waits for the writable callback instead.
+class PayloadSource {
+ public:
+  static constexpr std::size_t kDefaultMaxBufferedBytes = 1024 * 1024;
+  static constexpr std::size_t kUnbounded =
+      std::numeric_limits<std::size_t>::max();
+
+  explicit PayloadSource(
+      std::size_t max_buffered_bytes = kDefaultMaxBufferedBytes);
+  PayloadSource(const PayloadSource&) = delete;
+  PayloadSource& operator=(const PayloadSource&) = delete;
+
+  // Writer side.
+
+  // Hands |buffer| over to the reader. Blocks while the source is full.
+  // Returns Exception::kIo once the source is closed or canceled.
+  Exception Write(ByteArray buffer) ABSL_LOCKS_EXCLUDED(mutex_, sink_mutex_);
+  // Returns whether Write() would go through without blocking.
+  bool IsWritable() const ABSL_LOCKS_EXCLUDED(mutex_);
+  // |callback| is called whenever the source goes from full to writable, and
+  // once if it is canceled. It is called on the reader's thread, with no lock
+  // held.
+  void SetWritableCallback(std::function<void()> callback)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Ends the stream. The buffers written so far are still delivered.
+  void Close() ABSL_LOCKS_EXCLUDED(mutex_, sink_mutex_);
+
+  // Reader side.
+
+  // Returns the next buffer, or its next |max_size| bytes if it is larger.
+  // Blocks until there is one. Returns an empty ByteArray at the end of the
+  // stream, and Exception::kIo once canceled or when a sink is attached.
+  ExceptionOr<ByteArray> Read(std::size_t max_size) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Delivers the buffers to |sink| from now on, starting with those not read
+  // yet. Buffers are delivered on the writer's thread. The source takes no
+  // more than one sink. The sink must not call back into the source; it
+  // returns an error from |buffer_cb| to cancel it.
+  void SetSink(PayloadSink sink) ABSL_LOCKS_EXCLUDED(mutex_, sink_mutex_);
+  // Drops the buffers not read yet, and fails further writes.
+  void Cancel() ABSL_LOCKS_EXCLUDED(mutex_, sink_mutex_);
+
+  // Returns an InputStream that reads from this source. Closing the stream
+  // cancels the source.
+  InputStream& GetInputStream() { return input_stream_; }
+
+ private:
+  class SourceInputStream : public InputStream {
+   public:
+    explicit SourceInputStream(PayloadSource* source) : source_(source) {}
+    ~SourceInputStream() override = default;
+
+    ExceptionOr<ByteArray> Read(std::int64_t size) override {
+      return source_->Read(static_cast<std::size_t>(size));
+    }
+    Exception Close() override {
+      source_->Cancel();
+      return {Exception::kSuccess};
+    }
+
+   private:
+    PayloadSource* source_;
+  };
+
+  bool IsWritableLocked() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Hands |buffer| to the sink; cancels the source if the sink refuses it.
+  Exception Deliver(ByteArray buffer) ABSL_EXCLUSIVE_LOCKS_REQUIRED(sink_mutex_)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void DeliverClose() ABSL_EXCLUSIVE_LOCKS_REQUIRED(sink_mutex_);
+
+  const std::size_t max_buffered_bytes_;
+  mutable Mutex mutex_;
+  ConditionVariable cond_{&mutex_};
+  std::deque<ByteArray> buffers_ ABSL_GUARDED_BY(mutex_);
+  // Bytes of buffers_.front() already read.
+  std::size_t front_offset_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::size_t buffered_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool closed_ ABSL_GUARDED_BY(mutex_) = false;
+  bool canceled_ ABSL_GUARDED_BY(mutex_) = false;
+  bool has_sink_ ABSL_GUARDED_BY(mutex_) = false;
+  std::function<void()> writable_cb_ ABSL_GUARDED_BY(mutex_);
+  // Keeps the buffers in order on their way to the sink.
+  Mutex sink_mutex_ ABSL_ACQUIRED_BEFORE(mutex_);
+  PayloadSink sink_ ABSL_GUARDED_BY(sink_mutex_);
+  bool sink_closed_ ABSL_GUARDED_BY(sink_mutex_) = false;
+  SourceInputStream input_stream_{this};
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_PAYLOAD_SOURCE_H_
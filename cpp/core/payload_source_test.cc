@@ -0,0 +1,165 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/payload_source.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kData[] = "0123456789";
+
+TEST(PayloadSourceTest, ReadReturnsWrittenBufferWithoutCopy) {
+  PayloadSource source;
+  std::string data(1024, 'x');
+  const char* buffer_data = data.data();
+
+  EXPECT_TRUE(source.Write(ByteArray(std::move(data))).Ok());
+  ExceptionOr<ByteArray> buffer = source.Read(1024);
+
+  ASSERT_TRUE(buffer.ok());
+  EXPECT_EQ(buffer.result().size(), 1024);
+  EXPECT_EQ(buffer.result().data(), buffer_data);
+}
+
+TEST(PayloadSourceTest, ReadSplitsLargerBuffer) {
+  PayloadSource source;
+
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+
+  EXPECT_EQ(source.Read(4).result(), ByteArray("0123"));
+  EXPECT_EQ(source.Read(4).result(), ByteArray("4567"));
+  EXPECT_EQ(source.Read(4).result(), ByteArray("89"));
+}
+
+TEST(PayloadSourceTest, ReadReturnsEmptyBufferAfterClose) {
+  PayloadSource source;
+
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+  source.Close();
+
+  EXPECT_EQ(source.Read(1024).result(), ByteArray(kData));
+  ExceptionOr<ByteArray> end = source.Read(1024);
+  ASSERT_TRUE(end.ok());
+  EXPECT_TRUE(end.result().Empty());
+  EXPECT_FALSE(source.Write(ByteArray(kData)).Ok());
+}
+
+TEST(PayloadSourceTest, CancelFailsReadsAndWrites) {
+  PayloadSource source;
+
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+  source.Cancel();
+
+  EXPECT_FALSE(source.Read(1024).ok());
+  EXPECT_FALSE(source.Write(ByteArray(kData)).Ok());
+}
+
+TEST(PayloadSourceTest, InputStreamReadsFromSource) {
+  PayloadSource source;
+  InputStream& stream = source.GetInputStream();
+
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+  source.Close();
+
+  EXPECT_EQ(stream.Read(1024).result(), ByteArray(kData));
+  EXPECT_TRUE(stream.Read(1024).result().Empty());
+}
+
+TEST(PayloadSourceTest, FullSourceIsNotWritableUntilRead) {
+  PayloadSource source(/*max_buffered_bytes=*/4);
+  int writable_calls = 0;
+  source.SetWritableCallback([&writable_calls]() { writable_calls++; });
+
+  EXPECT_TRUE(source.IsWritable());
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+  EXPECT_FALSE(source.IsWritable());
+
+  EXPECT_EQ(source.Read(4).result(), ByteArray("0123"));
+  EXPECT_FALSE(source.IsWritable());
+  EXPECT_EQ(writable_calls, 0);
+  EXPECT_EQ(source.Read(4).result(), ByteArray("4567"));
+  EXPECT_TRUE(source.IsWritable());
+  EXPECT_EQ(writable_calls, 1);
+}
+
+TEST(PayloadSourceTest, WriteBlocksWhileFull) {
+  PayloadSource source(/*max_buffered_bytes=*/4);
+  CountDownLatch written(1);
+  SingleThreadExecutor writer;
+
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+  writer.Execute([&source, &written]() {
+    EXPECT_TRUE(source.Write(ByteArray("abc")).Ok());
+    written.CountDown();
+  });
+
+  EXPECT_FALSE(written.Await(absl::Milliseconds(100)).result());
+  EXPECT_EQ(source.Read(1024).result(), ByteArray(kData));
+  EXPECT_TRUE(written.Await(absl::Seconds(1)).result());
+  EXPECT_EQ(source.Read(1024).result(), ByteArray("abc"));
+}
+
+TEST(PayloadSourceTest, SinkReceivesPendingAndNewBuffers) {
+  PayloadSource source;
+  std::vector<ByteArray> received;
+  bool closed = false;
+
+  EXPECT_TRUE(source.Write(ByteArray(kData)).Ok());
+  source.SetSink({
+      .buffer_cb =
+          [&received](ByteArray buffer) {
+            received.push_back(std::move(buffer));
+            return Exception{Exception::kSuccess};
+          },
+      .close_cb = [&closed]() { closed = true; },
+  });
+  EXPECT_TRUE(source.Write(ByteArray("abc")).Ok());
+  source.Close();
+
+  EXPECT_THAT(received,
+              testing::ElementsAre(ByteArray(kData), ByteArray("abc")));
+  EXPECT_TRUE(closed);
+  EXPECT_FALSE(source.Read(1024).ok());
+}
+
+TEST(PayloadSourceTest, SinkErrorCancelsSource) {
+  PayloadSource source;
+  bool closed = false;
+  source.SetSink({
+      .buffer_cb = [](ByteArray) { return Exception{Exception::kIo}; },
+      .close_cb = [&closed]() { closed = true; },
+  });
+
+  EXPECT_FALSE(source.Write(ByteArray(kData)).Ok());
+  EXPECT_TRUE(closed);
+  EXPECT_FALSE(source.Write(ByteArray(kData)).Ok());
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
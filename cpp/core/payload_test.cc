@@ -19,6 +19,7 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "core/payload_source.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/input_stream.h"
 #include "platform/public/file.h"
@@ -78,6 +79,18 @@ TEST(PayloadTest, SupportsStreamType) {
   EXPECT_EQ(payload.GetOffset(), kOffset);
 }
 
+TEST(PayloadTest, SupportsSourceAsStreamType) {
+  auto source = std::make_shared<PayloadSource>();
+
+  Payload payload(source);
+
+  EXPECT_EQ(payload.GetType(), Payload::Type::kStream);
+  EXPECT_EQ(payload.AsSource(), source.get());
+  EXPECT_EQ(payload.AsStream(), &source->GetInputStream());
+  EXPECT_EQ(payload.AsFile(), nullptr);
+  EXPECT_EQ(payload.AsBytes(), ByteArray{});
+}
+
 TEST(PayloadTest, PayloadIsMoveable) {
   Payload payload1;
   Payload payload2(ByteArray("bytes"));
@@ -15,6 +15,8 @@
 #ifndef PLATFORM_API_CRYPTO_H_
 #define PLATFORM_API_CRYPTO_H_
 
+#include <memory>
+
 #include "absl/strings/string_view.h"
 #include "platform/base/byte_array.h"
 
@@ -30,6 +32,27 @@ class Crypto {
   static ByteArray Md5(absl::string_view input);
   // Return SHA256 hash of input.
   static ByteArray Sha256(absl::string_view input);
+
+  // Computes the SHA256 hash of input that arrives in pieces, such as the
+  // chunks of a payload, without holding on to it. Implementations are
+  // expected to use the hardware support of the CPU where there is any.
+  class Sha256Stream {
+   public:
+    Sha256Stream();
+    ~Sha256Stream();
+    Sha256Stream(const Sha256Stream&) = delete;
+    Sha256Stream& operator=(const Sha256Stream&) = delete;
+
+    // Adds the next piece of input.
+    void Update(absl::string_view input);
+    // Returns the SHA256 hash of all input so far, and starts over.
+    ByteArray Finish();
+
+   private:
+    // Defined by each implementation.
+    struct State;
+    std::unique_ptr<State> state_;
+  };
 };
 
 }  // namespace nearby
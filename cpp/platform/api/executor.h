@@ -15,7 +15,7 @@
 #ifndef PLATFORM_API_EXECUTOR_H_
 #define PLATFORM_API_EXECUTOR_H_
 
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 
 namespace location {
 namespace nearby {
@@ -31,7 +31,7 @@ class Executor {
   // jobs to finish.
   virtual ~Executor() = default;
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-  virtual void Execute(Runnable&& runnable) = 0;
+  virtual void Execute(Task&& runnable) = 0;
 
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/ExecutorService.html#shutdown--
   virtual void Shutdown() = 0;
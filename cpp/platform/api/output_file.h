@@ -27,6 +27,11 @@ namespace api {
 class OutputFile : public OutputStream {
  public:
   ~OutputFile() override = default;
+
+  // Writes the data of previous Write() calls through to the storage device,
+  // so that it survives a crash or a power loss.
+  // Returns Exception::kIo on error, or if the platform can't do that.
+  virtual Exception Sync() { return {Exception::kIo}; }
 };
 
 }  // namespace api
@@ -84,6 +84,11 @@ class ImplementationPlatform {
   static std::unique_ptr<InputFile> CreateInputFile(PayloadId payload_id,
                                                     std::int64_t total_size);
   static std::unique_ptr<OutputFile> CreateOutputFile(PayloadId payload_id);
+  // Reopens the output file of a partially received payload; writes continue
+  // at offset. Returns nullptr if the file is gone, or holds less than offset
+  // bytes.
+  static std::unique_ptr<OutputFile> CreateOutputFile(PayloadId payload_id,
+                                                      std::int64_t offset);
   static std::unique_ptr<LogMessage> CreateLogMessage(
       const char* file, int line, LogMessage::Severity severity);
 
@@ -22,7 +22,7 @@
 #include "absl/time/time.h"
 #include "platform/api/cancelable.h"
 #include "platform/api/executor.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 
 namespace location {
 namespace nearby {
@@ -39,7 +39,7 @@ class ScheduledExecutor : public Executor {
   // We want Cancelable to live until both caller and executor are done with it.
   // Exclusive ownership model does not work for this case;
   // using std:shared_ptr<> instead if std::unique_ptr<>.
-  virtual std::shared_ptr<Cancelable> Schedule(Runnable&& runnable,
+  virtual std::shared_ptr<Cancelable> Schedule(Task&& runnable,
                                                absl::Duration duration) = 0;
 };
 
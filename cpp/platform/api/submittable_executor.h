@@ -20,7 +20,7 @@
 
 #include "platform/api/executor.h"
 #include "platform/api/future.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 
 namespace location {
 namespace nearby {
@@ -37,7 +37,7 @@ class SubmittableExecutor : public Executor {
   // Submit a callable (with no delay).
   // Returns true, if callable was submitted, false otherwise.
   // Callable is not submitted if shutdown is in progress.
-  virtual bool DoSubmit(Runnable&& wrapped_callable) = 0;
+  virtual bool DoSubmit(Task&& wrapped_callable) = 0;
 };
 
 }  // namespace api
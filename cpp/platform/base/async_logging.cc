@@ -0,0 +1,279 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/async_logging.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "absl/time/clock.h"
+#include "platform/api/platform.h"
+#include "platform/api/system_clock.h"
+
+namespace location {
+namespace nearby {
+
+namespace {
+
+// Messages suppressed by the last log site that opened a new rate limiting
+// window on this thread; reported by the next message of this thread.
+thread_local int pending_suppressed = 0;
+
+void AppendSuppressed(std::ostream& stream, int suppressed) {
+  if (suppressed > 0) {
+    stream << "[" << suppressed << " similar messages suppressed] ";
+  }
+}
+
+}  // namespace
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr int AsyncLogging::kRecordsPerThread;
+
+struct AsyncLogging::Record {
+  // Orders the records of all threads.
+  std::int64_t sequence = 0;
+  const char* file = nullptr;
+  int line = 0;
+  api::LogMessage::Severity severity = api::LogMessage::Severity::kInfo;
+  std::string text;
+};
+
+// A ring buffer with a single producer, the thread that owns it, and a single
+// consumer, whoever holds drain_mutex_.
+class AsyncLogging::Ring {
+ public:
+  bool Push(Record&& record) {
+    std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kRecordsPerThread) {
+      return false;
+    }
+    slots_[tail % kRecordsPerThread] = std::move(record);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(Record* record) {
+    std::uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    *record = std::move(slots_[head % kRecordsPerThread]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // Set once the owning thread is gone; the ring is dropped once drained.
+  std::atomic<bool> retired{false};
+
+ private:
+  std::vector<Record> slots_{kRecordsPerThread};
+  std::atomic<std::uint64_t> head_{0};
+  std::atomic<std::uint64_t> tail_{0};
+};
+
+class AsyncLogging::AsyncLogMessage : public api::LogMessage {
+ public:
+  AsyncLogMessage(AsyncLogging* logging, const char* file, int line,
+                  Severity severity)
+      : logging_(logging), file_(file), line_(line), severity_(severity) {}
+
+  ~AsyncLogMessage() override {
+    Record record;
+    record.file = file_;
+    record.line = line_;
+    record.severity = severity_;
+    record.text = stream_.str();
+    logging_->Enqueue(std::move(record));
+    // Logging may have stopped since this message was created; don't leave
+    // it behind.
+    if (!logging_->IsRunning()) logging_->Flush();
+  }
+
+  void Print(const char* format, ...) override {
+    va_list ap;
+    va_start(ap, format);
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int size = std::vsnprintf(nullptr, 0, format, ap_copy);
+    va_end(ap_copy);
+    if (size > 0) {
+      std::string text(size + 1, '\0');
+      std::vsnprintf(&text[0], text.size(), format, ap);
+      text.resize(size);
+      stream_ << text;
+    }
+    va_end(ap);
+  }
+
+  std::ostream& Stream() override { return stream_; }
+
+ private:
+  AsyncLogging* logging_;
+  const char* file_;
+  int line_;
+  Severity severity_;
+  std::ostringstream stream_;
+};
+
+bool LogSite::Allow() {
+  AsyncLogging& logging = AsyncLogging::GetInstance();
+  int limit =
+      logging.max_messages_per_site_per_second_.load(std::memory_order_relaxed);
+  if (limit <= 0) return true;
+
+  std::int64_t now = absl::ToUnixSeconds(absl::Now());
+  std::int64_t window = window_.load(std::memory_order_relaxed);
+  if (window != now && window_.compare_exchange_strong(
+                           window, now, std::memory_order_relaxed)) {
+    logged_.store(0, std::memory_order_relaxed);
+    pending_suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+  }
+  if (logged_.fetch_add(1, std::memory_order_relaxed) < limit) return true;
+  suppressed_.fetch_add(1, std::memory_order_relaxed);
+  logging.suppressed_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+std::unique_ptr<api::LogMessage> CreateLogMessage(
+    const char* file, int line, api::LogMessage::Severity severity) {
+  return AsyncLogging::GetInstance().CreateLogMessage(file, line, severity);
+}
+
+AsyncLogging& AsyncLogging::GetInstance() {
+  static AsyncLogging* instance = new AsyncLogging();
+  return *instance;
+}
+
+void AsyncLogging::Start(const Options& options) {
+  absl::MutexLock lock(&mutex_);
+  if (drain_executor_ != nullptr) return;
+  max_messages_per_site_per_second_.store(
+      options.max_messages_per_site_per_second, std::memory_order_relaxed);
+  running_.store(true, std::memory_order_release);
+  drain_executor_ = api::ImplementationPlatform::CreateSingleThreadExecutor();
+  absl::Duration drain_interval = options.drain_interval;
+  drain_executor_->Execute(
+      [this, drain_interval]() { DrainLoop(drain_interval); });
+}
+
+void AsyncLogging::Stop() {
+  absl::MutexLock lock(&mutex_);
+  if (drain_executor_ == nullptr) return;
+  running_.store(false, std::memory_order_release);
+  max_messages_per_site_per_second_.store(0, std::memory_order_relaxed);
+  drain_executor_->Shutdown();
+  drain_executor_.reset();
+  Flush();
+}
+
+void AsyncLogging::Flush() {
+  absl::MutexLock lock(&drain_mutex_);
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    absl::MutexLock rings_lock(&rings_mutex_);
+    // Rings of threads that are gone were drained by an earlier flush.
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                [](const std::shared_ptr<Ring>& ring) {
+                                  return ring->retired && ring->Empty();
+                                }),
+                 rings_.end());
+    rings = rings_;
+  }
+
+  std::vector<Record> records;
+  Record record;
+  for (const auto& ring : rings) {
+    while (ring->Pop(&record)) records.push_back(std::move(record));
+  }
+  std::sort(records.begin(), records.end(),
+            [](const Record& a, const Record& b) {
+              return a.sequence < b.sequence;
+            });
+  for (const auto& record : records) {
+    api::ImplementationPlatform::CreateLogMessage(record.file, record.line,
+                                                  record.severity)
+            ->Stream()
+        << record.text;
+  }
+  written_.fetch_add(records.size(), std::memory_order_relaxed);
+}
+
+void AsyncLogging::DrainLoop(absl::Duration drain_interval) {
+  while (IsRunning()) {
+    Flush();
+    SystemClock::Sleep(drain_interval);
+  }
+}
+
+AsyncLogging::Stats AsyncLogging::GetStats() const {
+  Stats stats;
+  stats.written = written_.load(std::memory_order_relaxed);
+  stats.dropped = dropped_.load(std::memory_order_relaxed);
+  stats.suppressed = suppressed_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::unique_ptr<api::LogMessage> AsyncLogging::CreateLogMessage(
+    const char* file, int line, api::LogMessage::Severity severity) {
+  int suppressed = std::exchange(pending_suppressed, 0);
+  std::unique_ptr<api::LogMessage> message;
+  if (!IsRunning() || severity == api::LogMessage::Severity::kFatal) {
+    // Whatever was logged before a FATAL message goes out before it.
+    if (IsRunning()) Flush();
+    message =
+        api::ImplementationPlatform::CreateLogMessage(file, line, severity);
+  } else {
+    message = std::make_unique<AsyncLogMessage>(this, file, line, severity);
+  }
+  AppendSuppressed(message->Stream(), suppressed);
+  return message;
+}
+
+void AsyncLogging::Enqueue(Record record) {
+  record.sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+  if (!GetThreadRing().Push(std::move(record))) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+AsyncLogging::Ring& AsyncLogging::GetThreadRing() {
+  // Retires the ring of a thread when the thread goes away.
+  struct Holder {
+    ~Holder() {
+      if (ring != nullptr) ring->retired = true;
+    }
+    std::shared_ptr<Ring> ring;
+  };
+  thread_local Holder holder;
+  if (holder.ring == nullptr) holder.ring = AddRing();
+  return *holder.ring;
+}
+
+std::shared_ptr<AsyncLogging::Ring> AsyncLogging::AddRing() {
+  absl::MutexLock lock(&rings_mutex_);
+  rings_.push_back(std::make_shared<Ring>());
+  return rings_.back();
+}
+
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,151 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_ASYNC_LOGGING_H_
+#define PLATFORM_BASE_ASYNC_LOGGING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "platform/api/log_message.h"
+#include "platform/api/submittable_executor.h"
+
+namespace location {
+namespace nearby {
+
+// The state of a single NEARBY_LOGS or NEARBY_LOG statement, which
+// rate-limits it when AsyncLogging is running.
+//
+// LogSite has a constexpr constructor, so the static instance each log
+// statement has is initialized at compile time and costs no guard check.
+class LogSite {
+ public:
+  constexpr LogSite() = default;
+  LogSite(const LogSite&) = delete;
+  LogSite& operator=(const LogSite&) = delete;
+
+  // Returns whether the statement may log now. Checked after the severity,
+  // and before any of the arguments are evaluated. Lock-free.
+  bool Allow();
+
+ private:
+  // The second the current rate limiting window started in.
+  std::atomic<std::int64_t> window_{0};
+  // Messages logged and suppressed in the current window.
+  std::atomic<int> logged_{0};
+  std::atomic<int> suppressed_{0};
+};
+
+// Creates the log message that NEARBY_LOGS and NEARBY_LOG write to: an
+// asynchronous one if AsyncLogging is running, or a platform one otherwise.
+std::unique_ptr<api::LogMessage> CreateLogMessage(
+    const char* file, int line, api::LogMessage::Severity severity);
+
+// A logging backend that takes the writing of log messages off the threads
+// that log them.
+//
+// A message is still rendered on the calling thread, but is then only moved
+// into a ring buffer of that thread. A background thread takes messages from
+// all rings, in the order they were logged, and writes them to the platform
+// log. Rings are single-producer, single-consumer and lock-free; a thread
+// only takes a lock once, to register its ring. When a ring is full, messages
+// are dropped and counted rather than blocking the caller.
+//
+// FATAL messages are written synchronously, after everything logged before
+// them.
+class AsyncLogging {
+ public:
+  struct Options {
+    // How many messages each log statement may log per second; the rest are
+    // suppressed and counted in the next message the statement logs. 0 means
+    // unlimited.
+    int max_messages_per_site_per_second = 20;
+    // How often the background thread writes out what has been logged.
+    absl::Duration drain_interval = absl::Milliseconds(20);
+  };
+
+  struct Stats {
+    std::int64_t written = 0;
+    // Messages dropped because the ring of their thread was full.
+    std::int64_t dropped = 0;
+    // Messages not logged because of rate limiting.
+    std::int64_t suppressed = 0;
+  };
+
+  // Messages each thread can have waiting to be written.
+  static constexpr int kRecordsPerThread = 1024;
+
+  static AsyncLogging& GetInstance();
+
+  AsyncLogging(const AsyncLogging&) = delete;
+  AsyncLogging& operator=(const AsyncLogging&) = delete;
+
+  // Routes all log statements through the background thread, until Stop().
+  void Start(const Options& options) ABSL_LOCKS_EXCLUDED(mutex_);
+  void Start() { Start(Options()); }
+  // Writes out whatever is still pending, and goes back to synchronous
+  // logging.
+  void Stop() ABSL_LOCKS_EXCLUDED(mutex_);
+  bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+  // Writes out all messages logged so far, on the calling thread.
+  void Flush() ABSL_LOCKS_EXCLUDED(drain_mutex_);
+
+  Stats GetStats() const;
+
+  // See ::location::nearby::CreateLogMessage().
+  std::unique_ptr<api::LogMessage> CreateLogMessage(
+      const char* file, int line, api::LogMessage::Severity severity);
+
+ private:
+  friend class LogSite;
+  class AsyncLogMessage;
+  class Ring;
+  struct Record;
+
+  AsyncLogging() = default;
+
+  void Enqueue(Record record);
+  Ring& GetThreadRing();
+  std::shared_ptr<Ring> AddRing() ABSL_LOCKS_EXCLUDED(rings_mutex_);
+  // Run by the background thread: writes out what has been logged every
+  // |drain_interval|, until Stop().
+  void DrainLoop(absl::Duration drain_interval);
+
+  std::atomic<bool> running_{false};
+  std::atomic<int> max_messages_per_site_per_second_{0};
+  std::atomic<std::int64_t> next_sequence_{0};
+  std::atomic<std::int64_t> written_{0};
+  std::atomic<std::int64_t> dropped_{0};
+  std::atomic<std::int64_t> suppressed_{0};
+
+  // Serializes Start() and Stop().
+  absl::Mutex mutex_;
+  std::unique_ptr<api::SubmittableExecutor> drain_executor_
+      ABSL_GUARDED_BY(mutex_);
+  // Serializes writing out messages; rings have a single consumer.
+  absl::Mutex drain_mutex_;
+  absl::Mutex rings_mutex_;
+  std::vector<std::shared_ptr<Ring>> rings_ ABSL_GUARDED_BY(rings_mutex_);
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_ASYNC_LOGGING_H_
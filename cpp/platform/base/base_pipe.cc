@@ -14,6 +14,10 @@
 
 #include "platform/base/base_pipe.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "platform/api/system_clock.h"
 #include "platform/base/base_mutex_lock.h"
 #include "platform/base/input_stream.h"
 #include "platform/base/output_stream.h"
@@ -31,8 +35,19 @@ ExceptionOr<ByteArray> BasePipe::Read(size_t size) {
     return ExceptionOr<ByteArray>{ByteArray{}};
   }
 
-  while (buffer_.empty() && !input_stream_closed_) {
-    Exception wait_exception = cond_->Wait();
+  while (!input_stream_closed_) {
+    Exception wait_exception{Exception::kSuccess};
+    if (buffer_.empty()) {
+      wait_exception = cond_->Wait();
+    } else if (buffer_.front().deliver_at == absl::InfinitePast()) {
+      break;
+    } else {
+      // Shaped chunk; wait until the link delivers it.
+      absl::Duration remaining =
+          buffer_.front().deliver_at - SystemClock::ElapsedRealtime();
+      if (remaining <= absl::ZeroDuration()) break;
+      wait_exception = cond_->Wait(remaining);
+    }
 
     if (wait_exception.Raised()) {
       return ExceptionOr<ByteArray>{wait_exception};
@@ -43,29 +58,31 @@ ExceptionOr<ByteArray> BasePipe::Read(size_t size) {
     return ExceptionOr<ByteArray>{Exception::kIo};
   }
 
-  ByteArray first_chunk{buffer_.front()};
+  Chunk first_chunk{buffer_.front()};
   buffer_.pop_front();
 
   // If we received our sentinel chunk, mark the fact that there cannot
   // possibly be any more chunks to read here on in, and return an empty chunk
   // to serve as an EOF indication to callers.
-  if (first_chunk.Empty()) {
+  if (first_chunk.data.Empty()) {
     read_all_chunks_ = true;
     return ExceptionOr<ByteArray>{ByteArray{}};
   }
 
   // If first_chunk is small enough to not overshoot the requested 'size', just
   // return that.
-  if (first_chunk.size() <= size) {
-    return ExceptionOr<ByteArray>{first_chunk};
+  if (first_chunk.data.size() <= size) {
+    return ExceptionOr<ByteArray>{first_chunk.data};
   } else {
     // Break first_chunk into 2 parts -- the first one of which (next_chunk)
     // will be 'size' bytes long, and will be returned, and the second one of
     // which (overflow_chunk) will be re-inserted into buffer_, at the head of
     // the queue, to be served up in the next call to read().
-    ByteArray next_chunk(first_chunk.data(), size);
+    ByteArray next_chunk(first_chunk.data.data(), size);
     buffer_.push_front(
-        ByteArray(first_chunk.data() + size, first_chunk.size() - size));
+        Chunk{ByteArray(first_chunk.data.data() + size,
+                        first_chunk.data.size() - size),
+              first_chunk.deliver_at});
     return ExceptionOr<ByteArray>{next_chunk};
   }
 }
@@ -73,7 +90,31 @@ ExceptionOr<ByteArray> BasePipe::Read(size_t size) {
 Exception BasePipe::Write(const ByteArray& data) {
   BaseMutexLock lock(mutex_.get());
 
-  return WriteLocked(data);
+  Exception write_exception = WriteLocked(data);
+  if (write_exception.Raised() || !link_profile_.IsShaped()) {
+    return write_exception;
+  }
+
+  // Like a socket with a full send buffer, hold the writer until the link has
+  // transmitted what it was given.
+  while (!input_stream_closed_) {
+    absl::Duration remaining = link_idle_at_ - SystemClock::ElapsedRealtime();
+    if (remaining <= absl::ZeroDuration()) break;
+    Exception wait_exception = cond_->Wait(remaining);
+    if (wait_exception.Raised()) return wait_exception;
+  }
+  return write_exception;
+}
+
+void BasePipe::SetLinkProfile(const LinkProfile& profile) {
+  BaseMutexLock lock(mutex_.get());
+
+  link_profile_ = profile;
+  if (!prng_ && (profile.jitter > absl::ZeroDuration() ||
+                 profile.stall_probability > 0 ||
+                 profile.disconnect_probability > 0)) {
+    prng_ = std::make_unique<Prng>();
+  }
 }
 
 void BasePipe::MarkInputStreamClosed() {
@@ -98,12 +139,62 @@ Exception BasePipe::WriteLocked(const ByteArray& data) {
     return {Exception::kIo};
   }
 
-  buffer_.push_back(data);
+  absl::Time deliver_at = absl::InfinitePast();
+  if (link_profile_.IsShaped()) {
+    deliver_at = ShapeLocked(data.size());
+    if (deliver_at == absl::InfiniteFuture()) {
+      // The link broke; fail the reader too, as a dropped connection would.
+      input_stream_closed_ = true;
+      cond_->Notify();
+      return {Exception::kIo};
+    }
+  }
+
+  buffer_.push_back(Chunk{data, deliver_at});
   // Trigger cond_ to unblock a potentially-blocked call to read(), now that
   // there's more data for it to consume.
   cond_->Notify();
   return {Exception::kSuccess};
 }
 
+absl::Time BasePipe::ShapeLocked(size_t size) {
+  absl::Time now = SystemClock::ElapsedRealtime();
+  // The end-of-stream sentinel carries no data; it only has to stay behind the
+  // chunks written before it.
+  if (size == 0) return last_deliver_at_ = std::max(now, last_deliver_at_);
+
+  bytes_written_ += size;
+  if (RollLocked(link_profile_.disconnect_probability) ||
+      (link_profile_.disconnect_after_bytes > 0 &&
+       bytes_written_ > link_profile_.disconnect_after_bytes)) {
+    return absl::InfiniteFuture();
+  }
+
+  absl::Time start = std::max(now, link_idle_at_);
+  if (RollLocked(link_profile_.stall_probability)) {
+    start += link_profile_.stall_duration;
+  }
+  link_idle_at_ = start;
+  if (link_profile_.bandwidth_bytes_per_second > 0) {
+    link_idle_at_ += absl::Seconds(static_cast<double>(size) /
+                                   link_profile_.bandwidth_bytes_per_second);
+  }
+
+  absl::Time deliver_at = link_idle_at_ + link_profile_.latency;
+  if (link_profile_.jitter > absl::ZeroDuration()) {
+    deliver_at += link_profile_.jitter *
+                  (static_cast<double>(prng_->NextUint32()) /
+                   std::numeric_limits<std::uint32_t>::max());
+  }
+  return last_deliver_at_ = std::max(deliver_at, last_deliver_at_);
+}
+
+bool BasePipe::RollLocked(double probability) {
+  if (probability <= 0) return false;
+  if (probability >= 1) return true;
+  return prng_->NextUint32() <
+         probability * std::numeric_limits<std::uint32_t>::max();
+}
+
 }  // namespace nearby
 }  // namespace location
@@ -20,12 +20,15 @@
 #include <memory>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
 #include "platform/api/condition_variable.h"
 #include "platform/api/mutex.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
 #include "platform/base/input_stream.h"
+#include "platform/base/link_profile.h"
 #include "platform/base/output_stream.h"
+#include "platform/base/prng.h"
 
 namespace location {
 namespace nearby {
@@ -62,6 +65,12 @@ class BasePipe {
   InputStream& GetInputStream() { return input_stream_; }
   OutputStream& GetOutputStream() { return output_stream_; }
 
+  // Shapes the data written from now on, as if it travelled over a link with
+  // the given profile. Writes block while the link is busy transmitting, and
+  // reads only see a chunk once its delivery time has come. A link broken by
+  // the profile fails both reads and writes with Exception::kIo.
+  void SetLinkProfile(const LinkProfile& profile) ABSL_LOCKS_EXCLUDED(mutex_);
+
  protected:
   BasePipe() = default;
 
@@ -117,6 +126,19 @@ class BasePipe {
   Exception WriteLocked(const ByteArray& data)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Returns the time at which a chunk of the given size written now reaches
+  // the reader, and advances the link state accordingly. Returns
+  // absl::InfiniteFuture() if the write broke the link.
+  absl::Time ShapeLocked(size_t size) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns true with the given probability.
+  bool RollLocked(double probability) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  struct Chunk {
+    ByteArray data;
+    // Unshaped chunks are readable right away.
+    absl::Time deliver_at = absl::InfinitePast();
+  };
+
   // Order of declaration matters:
   // - mutex must be defined before condvar;
   // - input & output streams must be after both mutex and condvar.
@@ -124,7 +146,14 @@ class BasePipe {
   bool output_stream_closed_ ABSL_GUARDED_BY(mutex_) = false;
   bool read_all_chunks_ ABSL_GUARDED_BY(mutex_) = false;
 
-  std::deque<ByteArray> ABSL_GUARDED_BY(mutex_) buffer_;
+  std::deque<Chunk> ABSL_GUARDED_BY(mutex_) buffer_;
+  LinkProfile link_profile_ ABSL_GUARDED_BY(mutex_);
+  std::unique_ptr<Prng> prng_ ABSL_GUARDED_BY(mutex_);
+  // Time at which the link is done transmitting everything written so far.
+  absl::Time link_idle_at_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+  // Delivery time of the last chunk written; later chunks never overtake it.
+  absl::Time last_deliver_at_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+  std::int64_t bytes_written_ ABSL_GUARDED_BY(mutex_) = 0;
   std::unique_ptr<api::Mutex> mutex_;
   std::unique_ptr<api::ConditionVariable> cond_;
 
@@ -0,0 +1,177 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/buffer_pool.h"
+
+#include <algorithm>
+
+namespace location {
+namespace nearby {
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr std::size_t BufferPool::kMinBufferSize;
+constexpr std::size_t BufferPool::kMaxBufferSize;
+constexpr int BufferPool::kSizeClasses;
+constexpr int BufferPool::kBuffersPerThread;
+constexpr std::size_t BufferPool::kSharedBytesPerClass;
+
+// Idle buffers of one thread. They go to the shared pool when the thread
+// exits.
+struct BufferPool::ThreadCache {
+  ~ThreadCache() {
+    BufferPool& pool = GetInstance();
+    for (int size_class = 0; size_class < kSizeClasses; ++size_class) {
+      for (auto& buffer : buffers[size_class]) {
+        if (!pool.PutShared(size_class, std::move(buffer))) {
+          pool.AddPooledBytes(-static_cast<std::int64_t>(
+              SizeOfClass(size_class)));
+          pool.discarded_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+  std::array<std::vector<std::string>, kSizeClasses> buffers;
+};
+
+BufferPool& BufferPool::GetInstance() {
+  static BufferPool* instance = new BufferPool();
+  return *instance;
+}
+
+ByteArray BufferPool::Acquire(std::size_t size) {
+  int size_class = SizeClassToAcquire(size);
+  if (size_class < 0) return ByteArray(size);
+
+  acquired_.fetch_add(1, std::memory_order_relaxed);
+  std::string buffer;
+  std::vector<std::string>& cached = GetThreadCache().buffers[size_class];
+  if (!cached.empty()) {
+    buffer = std::move(cached.back());
+    cached.pop_back();
+  } else if (!TakeShared(size_class, &buffer)) {
+    buffer.reserve(SizeOfClass(size_class));
+    buffer.resize(size);
+    return ByteArray(std::move(buffer));
+  }
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  AddPooledBytes(-static_cast<std::int64_t>(SizeOfClass(size_class)));
+  buffer.resize(size);
+  return ByteArray(std::move(buffer));
+}
+
+void BufferPool::Release(std::string&& buffer) {
+  int size_class = SizeClassToRelease(buffer.capacity());
+  if (size_class < 0) {
+    discarded_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer.clear();
+  std::vector<std::string>& cached = GetThreadCache().buffers[size_class];
+  if (cached.size() < kBuffersPerThread) {
+    cached.push_back(std::move(buffer));
+  } else if (!PutShared(size_class, std::move(buffer))) {
+    discarded_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  released_.fetch_add(1, std::memory_order_relaxed);
+  AddPooledBytes(SizeOfClass(size_class));
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+  Stats stats;
+  stats.acquired = acquired_.load(std::memory_order_relaxed);
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.released = released_.load(std::memory_order_relaxed);
+  stats.discarded = discarded_.load(std::memory_order_relaxed);
+  stats.pooled_bytes = pooled_bytes_.load(std::memory_order_relaxed);
+  stats.peak_pooled_bytes = peak_pooled_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void BufferPool::Trim() {
+  std::int64_t trimmed_bytes = 0;
+  for (int size_class = 0; size_class < kSizeClasses; ++size_class) {
+    std::vector<std::string>& cached = GetThreadCache().buffers[size_class];
+    trimmed_bytes += cached.size() * SizeOfClass(size_class);
+    cached.clear();
+    cached.shrink_to_fit();
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    for (int size_class = 0; size_class < kSizeClasses; ++size_class) {
+      trimmed_bytes += shared_[size_class].size() * SizeOfClass(size_class);
+      shared_[size_class].clear();
+      shared_[size_class].shrink_to_fit();
+    }
+  }
+  AddPooledBytes(-trimmed_bytes);
+}
+
+int BufferPool::SizeClassToAcquire(std::size_t size) {
+  if (size < kMinBufferSize || size > kMaxBufferSize) return -1;
+  int size_class = 0;
+  while (SizeOfClass(size_class) < size) ++size_class;
+  return size_class;
+}
+
+int BufferPool::SizeClassToRelease(std::size_t capacity) {
+  // Buffers much larger than the largest class would waste memory.
+  if (capacity < kMinBufferSize || capacity > 2 * kMaxBufferSize) return -1;
+  int size_class = kSizeClasses - 1;
+  while (SizeOfClass(size_class) > capacity) --size_class;
+  return size_class;
+}
+
+std::size_t BufferPool::SizeOfClass(int size_class) {
+  return kMinBufferSize << size_class;
+}
+
+BufferPool::ThreadCache& BufferPool::GetThreadCache() {
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+bool BufferPool::TakeShared(int size_class, std::string* buffer) {
+  absl::MutexLock lock(&mutex_);
+  std::vector<std::string>& shared = shared_[size_class];
+  if (shared.empty()) return false;
+  *buffer = std::move(shared.back());
+  shared.pop_back();
+  return true;
+}
+
+bool BufferPool::PutShared(int size_class, std::string&& buffer) {
+  std::size_t max_buffers = std::min<std::size_t>(
+      64, std::max<std::size_t>(
+              2, kSharedBytesPerClass / SizeOfClass(size_class)));
+  absl::MutexLock lock(&mutex_);
+  std::vector<std::string>& shared = shared_[size_class];
+  if (shared.size() >= max_buffers) return false;
+  shared.push_back(std::move(buffer));
+  return true;
+}
+
+void BufferPool::AddPooledBytes(std::int64_t bytes) {
+  std::int64_t pooled =
+      pooled_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  std::int64_t peak = peak_pooled_bytes_.load(std::memory_order_relaxed);
+  while (pooled > peak && !peak_pooled_bytes_.compare_exchange_weak(
+                              peak, pooled, std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,121 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_BUFFER_POOL_H_
+#define PLATFORM_BASE_BUFFER_POOL_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "platform/base/byte_array.h"
+
+namespace location {
+namespace nearby {
+
+// A pool of reusable buffers for payload chunks and the frames that carry
+// them, which would otherwise be allocated and freed at every stage of a
+// transfer.
+//
+// Buffers come in size classes of 1 KB to 1 MB, each twice the one before.
+// Each thread keeps a few buffers of each class for itself, so most Acquire()
+// and Release() calls take no lock; the rest go to a shared, bounded pool.
+// Since ByteArray keeps its bytes in a std::string, any string can be
+// released into the pool, wherever it was allocated, and a pooled buffer
+// keeps its capacity as it moves between ByteArray and std::string.
+class BufferPool {
+ public:
+  static constexpr std::size_t kMinBufferSize = 1024;
+  static constexpr std::size_t kMaxBufferSize = 1024 * 1024;
+  static constexpr int kSizeClasses = 11;
+  // Buffers each thread keeps per size class.
+  static constexpr int kBuffersPerThread = 2;
+  // Bytes the shared pool keeps per size class; 2 to 64 buffers.
+  static constexpr std::size_t kSharedBytesPerClass = 4 * 1024 * 1024;
+
+  struct Stats {
+    // Acquire() calls for sizes the pool serves.
+    std::int64_t acquired = 0;
+    // Of those, the ones served with a pooled buffer.
+    std::int64_t hits = 0;
+    // Buffers taken back into the pool.
+    std::int64_t released = 0;
+    // Buffers not taken back, because the pool was full or they didn't fit
+    // any size class.
+    std::int64_t discarded = 0;
+    // Bytes held by idle buffers in the pool, now and at most.
+    std::int64_t pooled_bytes = 0;
+    std::int64_t peak_pooled_bytes = 0;
+  };
+
+  static BufferPool& GetInstance();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Returns a zero-filled buffer of |size| bytes. Sizes below kMinBufferSize
+  // or above kMaxBufferSize are allocated as usual.
+  ByteArray Acquire(std::size_t size);
+
+  // Takes back a buffer that is no longer needed, to be reused.
+  void Release(ByteArray&& buffer) {
+    Release(std::string(std::move(buffer)));
+  }
+  void Release(std::string&& buffer);
+
+  Stats GetStats() const;
+
+  // Frees the idle buffers of the shared pool and of the calling thread.
+  void Trim() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct ThreadCache;
+
+  BufferPool() = default;
+
+  // Returns the size class of buffers that can hold |size| bytes, or -1.
+  static int SizeClassToAcquire(std::size_t size);
+  // Returns the largest size class a buffer of |capacity| can serve, or -1.
+  static int SizeClassToRelease(std::size_t capacity);
+  static std::size_t SizeOfClass(int size_class);
+
+  static ThreadCache& GetThreadCache();
+  bool TakeShared(int size_class, std::string* buffer)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  bool PutShared(int size_class, std::string&& buffer)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void AddPooledBytes(std::int64_t bytes);
+
+  std::atomic<std::int64_t> acquired_{0};
+  std::atomic<std::int64_t> hits_{0};
+  std::atomic<std::int64_t> released_{0};
+  std::atomic<std::int64_t> discarded_{0};
+  std::atomic<std::int64_t> pooled_bytes_{0};
+  std::atomic<std::int64_t> peak_pooled_bytes_{0};
+
+  absl::Mutex mutex_;
+  std::array<std::vector<std::string>, kSizeClasses> shared_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_BUFFER_POOL_H_
@@ -0,0 +1,106 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/buffer_pool.h"
+
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "platform/base/byte_array.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+class BufferPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override { pool_.Trim(); }
+  void TearDown() override { pool_.Trim(); }
+
+  BufferPool& pool_ = BufferPool::GetInstance();
+};
+
+TEST_F(BufferPoolTest, AcquiredBufferIsZeroFilled) {
+  ByteArray buffer = pool_.Acquire(3000);
+
+  EXPECT_EQ(buffer.size(), 3000);
+  EXPECT_EQ(std::string(buffer), std::string(3000, '\0'));
+}
+
+TEST_F(BufferPoolTest, ReleasedBufferIsReused) {
+  BufferPool::Stats before = pool_.GetStats();
+  ByteArray buffer = pool_.Acquire(64 * 1024);
+  buffer.data()[0] = 'x';
+  const char* data = buffer.data();
+  pool_.Release(std::move(buffer));
+
+  ByteArray reused = pool_.Acquire(60 * 1024);
+
+  EXPECT_EQ(reused.data(), data);
+  EXPECT_EQ(reused.size(), 60 * 1024);
+  EXPECT_EQ(reused.data()[0], '\0');
+  BufferPool::Stats after = pool_.GetStats();
+  EXPECT_EQ(after.acquired - before.acquired, 2);
+  EXPECT_EQ(after.hits - before.hits, 1);
+  EXPECT_EQ(after.released - before.released, 1);
+  EXPECT_EQ(after.pooled_bytes, 0);
+  EXPECT_GE(after.peak_pooled_bytes, 64 * 1024);
+}
+
+TEST_F(BufferPoolTest, ReusesStringsAllocatedElsewhere) {
+  std::string encrypted(20000, 'e');
+  pool_.Release(std::move(encrypted));
+
+  BufferPool::Stats before = pool_.GetStats();
+  ByteArray buffer = pool_.Acquire(16 * 1024);
+
+  EXPECT_EQ(pool_.GetStats().hits - before.hits, 1);
+  EXPECT_EQ(std::string(buffer), std::string(16 * 1024, '\0'));
+}
+
+TEST_F(BufferPoolTest, DoesNotPoolOddSizes) {
+  BufferPool::Stats before = pool_.GetStats();
+
+  EXPECT_EQ(pool_.Acquire(4).size(), 4);
+  EXPECT_EQ(pool_.Acquire(BufferPool::kMaxBufferSize + 1).size(),
+            BufferPool::kMaxBufferSize + 1);
+  pool_.Release(std::string("tiny"));
+
+  BufferPool::Stats after = pool_.GetStats();
+  EXPECT_EQ(after.acquired, before.acquired);
+  EXPECT_EQ(after.discarded - before.discarded, 1);
+  EXPECT_EQ(after.pooled_bytes, 0);
+}
+
+TEST_F(BufferPoolTest, SharedPoolIsBounded) {
+  BufferPool::Stats before = pool_.GetStats();
+  for (int i = 0; i < 20; ++i) {
+    std::string buffer;
+    buffer.reserve(BufferPool::kMaxBufferSize);
+    pool_.Release(std::move(buffer));
+  }
+
+  BufferPool::Stats after = pool_.GetStats();
+  // Each size class holds at most kSharedBytesPerClass, plus what the thread
+  // keeps for itself.
+  EXPECT_EQ(after.pooled_bytes,
+            BufferPool::kSharedBytesPerClass +
+                BufferPool::kBuffersPerThread * BufferPool::kMaxBufferSize);
+  EXPECT_EQ(after.discarded - before.discarded, 20 - 6);
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -42,6 +42,37 @@ class FeatureFlags {
     absl::Duration bwu_retry_exp_backoff_maximum_delay = absl::Seconds(300);
     // Support sending file and stream payloads starting from a non-zero offset.
     bool enable_send_payload_offset = true;
+    // Checkpoint incoming file payloads, so that an interrupted transfer of
+    // the same payload from the same endpoint resumes where it left off.
+    bool enable_payload_checkpoints = false;
+    // Keep the prior channel open after a bandwidth upgrade and spread payload
+    // chunks over both channels. Only used if the remote device agrees.
+    bool enable_multipath_striping = false;
+    // Keep writing over the prior channel during a bandwidth upgrade, and
+    // switch writes over to the new channel right after LAST_WRITE, instead of
+    // pausing them until SAFE_TO_CLOSE. Only used if the remote device agrees.
+    bool enable_make_before_break_bwu = false;
+    // Pick the medium to upgrade an endpoint to by the throughput measured on
+    // it and by how often upgrades to it succeeded, instead of taking the
+    // first medium both devices support.
+    bool enable_measured_upgrade_medium_choice = false;
+    // Resume the previous UKEY2 session with an endpoint in one round trip
+    // instead of running UKEY2 again. Both devices need it.
+    bool enable_ukey2_session_resumption = false;
+    // Send a SHA256 checksum of each FILE and STREAM payload with its last
+    // chunk, and fail incoming payloads that don't match theirs.
+    bool enable_payload_checksums = false;
+    // Log analytics for finished strategy sessions, connections and
+    // connection requests once they take up analytics_flush_threshold_bytes,
+    // instead of holding all of them until the client session ends.
+    bool enable_incremental_analytics_flush = false;
+    std::int32_t analytics_flush_threshold_bytes = 64 * 1024;
+    // Sizing the analytics held in memory takes time proportional to their
+    // size, so it is only done once every so many analytics events.
+    std::int32_t analytics_flush_check_interval = 16;
+    // Run the executors created with a queue name on the worker threads of
+    // the process-wide ExecutorService, instead of on threads of their own.
+    bool enable_shared_executors = false;
   };
 
   static const FeatureFlags& GetInstance() {
@@ -0,0 +1,56 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_LINK_PROFILE_H_
+#define PLATFORM_BASE_LINK_PROFILE_H_
+
+#include <cstdint>
+
+#include "absl/time/time.h"
+
+namespace location {
+namespace nearby {
+
+// Describes how data written to one direction of a simulated link is shaped
+// on its way to the reader. A default-constructed profile leaves the link
+// unshaped: unlimited bandwidth, no latency and no injected faults.
+struct LinkProfile {
+  // Throughput cap, in bytes per second. 0 means unlimited.
+  std::int64_t bandwidth_bytes_per_second = 0;
+  // Fixed delay added to every chunk after it has been transmitted.
+  absl::Duration latency = absl::ZeroDuration();
+  // Upper bound of a uniformly distributed delay added on top of latency.
+  // Chunks are still delivered in the order they were written.
+  absl::Duration jitter = absl::ZeroDuration();
+  // Probability, from 0 to 1, that a write stalls the link for
+  // stall_duration before it is transmitted.
+  double stall_probability = 0;
+  absl::Duration stall_duration = absl::ZeroDuration();
+  // Probability, from 0 to 1, that a write breaks the link.
+  double disconnect_probability = 0;
+  // Breaks the link once more than this many bytes were written to it.
+  // 0 means never.
+  std::int64_t disconnect_after_bytes = 0;
+
+  bool IsShaped() const {
+    return bandwidth_bytes_per_second > 0 || latency > absl::ZeroDuration() ||
+           jitter > absl::ZeroDuration() || stall_probability > 0 ||
+           disconnect_probability > 0 || disconnect_after_bytes > 0;
+  }
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_LINK_PROFILE_H_
@@ -20,6 +20,7 @@
 #include "base/check.h"
 #include "platform/api/log_message.h"
 #include "platform/api/platform.h"
+#include "platform/base/async_logging.h"
 
 namespace location {
 namespace nearby {
@@ -65,20 +66,33 @@ class LogMessageVoidify {
   location::nearby::api::LogMessage::SetMinLogSeverity( \
       NEARBY_SEVERITY(severity))
 
+// Rate limiting; each log statement has a LogSite of its own.
+#define NEARBY_LOG_SITE_ALLOWS()           \
+  ([]() -> location::nearby::LogSite& {    \
+    static location::nearby::LogSite site; \
+    return site;                           \
+  }().Allow())
+
+#define NEARBY_LOG_IS_ALLOWED(severity) \
+  (NEARBY_LOG_IS_ON(severity) && NEARBY_LOG_SITE_ALLOWS())
+
 // Log message creation
-#define NEARBY_LOG_MESSAGE(severity)                               \
-  location::nearby::api::ImplementationPlatform::CreateLogMessage( \
-      __FILE__, __LINE__, NEARBY_SEVERITY(severity))
+#define NEARBY_LOG_MESSAGE(severity)                     \
+  location::nearby::CreateLogMessage(__FILE__, __LINE__, \
+                                     NEARBY_SEVERITY(severity))
 
 // Public APIs
-// The stream statement must come last or otherwise it won't compile.
-#define NEARBY_LOGS(severity)                                             \
-  !(NEARBY_LOG_IS_ON(severity)) ? (void)0                                 \
-                                : location::nearby::LogMessageVoidify() & \
-                                      NEARBY_LOG_MESSAGE(severity)->Stream()
+// The severity and the rate limit are checked before any of the arguments are
+// evaluated. The stream statement must come last or otherwise it won't
+// compile.
+#define NEARBY_LOGS(severity)                   \
+  !(NEARBY_LOG_IS_ALLOWED(severity))            \
+      ? (void)0                                 \
+      : location::nearby::LogMessageVoidify() & \
+            NEARBY_LOG_MESSAGE(severity)->Stream()
 
 #define NEARBY_LOG(severity, ...) \
-  NEARBY_LOG_IS_ON(severity)      \
+  NEARBY_LOG_IS_ALLOWED(severity) \
   ? NEARBY_LOG_MESSAGE(severity)->Print(__VA_ARGS__) : (void)0
 
 #endif  // PLATFORM_BASE_LOGGING_H_
@@ -22,6 +22,7 @@
 #include <type_traits>
 #include <utility>
 
+#include "absl/hash/hash.h"
 #include "platform/base/feature_flags.h"
 #include "platform/base/logging.h"
 #include "platform/base/prng.h"
@@ -29,6 +30,19 @@
 
 namespace location {
 namespace nearby {
+namespace {
+
+// Removes |medium| from the mediums subscribed to |key| in |index|, and drops
+// the entry once no medium is left in it.
+template <typename Index, typename Medium>
+void RemoveFromIndex(Index& index, const std::string& key, Medium* medium) {
+  auto item = index.find(key);
+  if (item == index.end()) return;
+  item->second.erase(medium);
+  if (item->second.empty()) index.erase(item);
+}
+
+}  // namespace
 
 MediumEnvironment& MediumEnvironment::Instance() {
   static std::aligned_storage_t<sizeof(MediumEnvironment),
@@ -42,6 +56,7 @@ void MediumEnvironment::Start(EnvironmentConfig config) {
   if (!enabled_.exchange(true)) {
     NEARBY_LOGS(INFO) << "MediumEnvironment::Start()";
     config_ = std::move(config);
+    SetNotificationThreads(config_.notification_threads);
     Reset();
   }
 }
@@ -59,13 +74,24 @@ void MediumEnvironment::Reset() {
     bluetooth_adapters_.clear();
     bluetooth_mediums_.clear();
     ble_mediums_.clear();
+    ble_advertisers_.clear();
+    ble_scanners_.clear();
     webrtc_signaling_message_callback_.clear();
     webrtc_signaling_complete_callback_.clear();
     wifi_lan_mediums_.clear();
+    wifi_lan_advertisers_.clear();
+    wifi_lan_discoverers_.clear();
     use_valid_peer_connection_ = true;
     peer_connection_latency_ = absl::ZeroDuration();
   });
   Sync();
+  {
+    absl::MutexLock lock(&wifi_lan_address_mutex_);
+    wifi_lan_addresses_.clear();
+  }
+  absl::MutexLock lock(&link_mutex_);
+  medium_links_.clear();
+  links_.clear();
 }
 
 void MediumEnvironment::Sync(bool enable_notifications) {
@@ -74,15 +100,25 @@ void MediumEnvironment::Sync(bool enable_notifications) {
   int count = 0;
   do {
     CountDownLatch latch(1);
-    count = job_count_ + 1;
-    // We are about to schedule one last job.
-    // When it is done, counter must be equal to count.
+    count = job_count_ + 1 + static_cast<int>(notification_threads_.size());
+    // We are about to schedule one last job on the environment thread, and
+    // then one on each notification thread.
+    // When they are done, counter must be equal to count.
     // However, if pending jobs schedule anything else,
     // it will be pending after us.
     // If we want to ensure we are completely idle, then we have to
     // repeat sync, until this becomes true.
     RunOnMediumEnvironmentThread([&latch]() { latch.CountDown(); });
     latch.Await();
+    if (!notification_threads_.empty()) {
+      CountDownLatch notification_latch(notification_threads_.size());
+      for (auto& thread : notification_threads_) {
+        job_count_++;
+        thread->Execute(
+            [&notification_latch]() { notification_latch.CountDown(); });
+      }
+      notification_latch.Await();
+    }
   } while (count < job_count_);
   NEARBY_LOGS(INFO) << "MediumEnvironment::Sync(): done [count=" << count
                     << "]";
@@ -142,8 +178,11 @@ void MediumEnvironment::OnBluetoothDeviceStateChanged(
       // Store device name, and report it as discovered.
       info.devices.emplace(&device, name);
       if (enable_notifications_) {
-        RunOnMediumEnvironmentThread(
-            [&info, &device]() { info.callback.device_discovered_cb(device); });
+        RunOnNotificationThread(info.subscriber.get(),
+                                [subscriber = info.subscriber, &device]() {
+                                  subscriber->Get().device_discovered_cb(
+                                      device);
+                                });
       }
     }
   } else {
@@ -158,16 +197,20 @@ void MediumEnvironment::OnBluetoothDeviceStateChanged(
         // Store device name, and report it as renamed.
         item->second = name;
         if (enable_notifications_) {
-          RunOnMediumEnvironmentThread([&info, &device]() {
-            info.callback.device_name_changed_cb(device);
-          });
+          RunOnNotificationThread(info.subscriber.get(),
+                                  [subscriber = info.subscriber, &device]() {
+                                    subscriber->Get().device_name_changed_cb(
+                                        device);
+                                  });
         }
       } else {
         // Device is in discovery mode, so we are reporting it anyway.
         if (enable_notifications_) {
-          RunOnMediumEnvironmentThread([&info, &device]() {
-            info.callback.device_discovered_cb(device);
-          });
+          RunOnNotificationThread(info.subscriber.get(),
+                                  [subscriber = info.subscriber, &device]() {
+                                    subscriber->Get().device_discovered_cb(
+                                        device);
+                                  });
         }
       }
     }
@@ -175,8 +218,10 @@ void MediumEnvironment::OnBluetoothDeviceStateChanged(
       // Known device is turned off.
       // Erase it from the map, and report as lost.
       if (enable_notifications_) {
-        RunOnMediumEnvironmentThread(
-            [&info, &device]() { info.callback.device_lost_cb(device); });
+        RunOnNotificationThread(
+            info.subscriber.get(), [subscriber = info.subscriber, &device]() {
+              subscriber->Get().device_lost_cb(device);
+            });
       }
       info.devices.erase(item);
     }
@@ -211,19 +256,21 @@ void MediumEnvironment::OnBlePeripheralStateChanged(
                     << "; service_id=" << service_id
                     << "; notify=" << enable_notifications_.load();
   if (!enable_notifications_) return;
-  RunOnMediumEnvironmentThread([&info, enabled, &peripheral, service_id,
-                                fast_advertisement]() {
-    NEARBY_LOGS(INFO) << "G3 [Run] OnBleServiceStateChanged [peripheral impl="
-                      << &peripheral << "]; context=" << &info
-                      << "; service_id=" << service_id
-                      << "; notify=" << enabled;
-    if (enabled) {
-      info.discovery_callback.peripheral_discovered_cb(peripheral, service_id,
-                                                       fast_advertisement);
-    } else {
-      info.discovery_callback.peripheral_lost_cb(peripheral, service_id);
-    }
-  });
+  RunOnNotificationThread(
+      info.discovery_subscriber.get(),
+      [subscriber = info.discovery_subscriber, enabled, &peripheral,
+       service_id, fast_advertisement]() {
+        NEARBY_LOGS(INFO)
+            << "G3 [Run] OnBleServiceStateChanged [peripheral impl="
+            << &peripheral << "]; subscriber=" << subscriber.get()
+            << "; service_id=" << service_id << "; notify=" << enabled;
+        if (enabled) {
+          subscriber->Get().peripheral_discovered_cb(peripheral, service_id,
+                                                     fast_advertisement);
+        } else {
+          subscriber->Get().peripheral_lost_cb(peripheral, service_id);
+        }
+      });
 }
 
 void MediumEnvironment::OnWifiLanServiceStateChanged(
@@ -231,6 +278,9 @@ void MediumEnvironment::OnWifiLanServiceStateChanged(
     bool enabled) {
   if (!enabled_) return;
   std::string service_type = service_info.GetServiceType();
+  auto subscriber = info.discovered_callbacks.find(service_type);
+  bool notify = enable_notifications_ &&
+                subscriber != info.discovered_callbacks.end();
   auto item = info.discovered_services.find(service_type);
   if (item == info.discovered_services.end()) {
     NEARBY_LOGS(INFO) << "G3 OnWifiLanServiceStateChanged; context=" << &info
@@ -242,13 +292,11 @@ void MediumEnvironment::OnWifiLanServiceStateChanged(
       // discovered.
       NsdServiceInfo discovered_service_info(service_info);
       info.discovered_services.insert({service_type, discovered_service_info});
-      if (enable_notifications_) {
-        RunOnMediumEnvironmentThread(
-            [&info, discovered_service_info, service_type]() {
-              auto item = info.discovered_callbacks.find(service_type);
-              if (item != info.discovered_callbacks.end()) {
-                item->second.service_discovered_cb(discovered_service_info);
-              }
+      if (notify) {
+        RunOnNotificationThread(
+            subscriber->second.get(),
+            [subscriber = subscriber->second, discovered_service_info]() {
+              subscriber->Get().service_discovered_cb(discovered_service_info);
             });
       }
     }
@@ -258,25 +306,21 @@ void MediumEnvironment::OnWifiLanServiceStateChanged(
         << &info << "; service_type=" << service_type << "; enabled=" << enabled
         << "; notify=" << enable_notifications_.load();
     if (enabled) {
-      if (enable_notifications_) {
-        RunOnMediumEnvironmentThread(
-            [&info, service_info = service_info, service_type]() {
-              auto item = info.discovered_callbacks.find(service_type);
-              if (item != info.discovered_callbacks.end()) {
-                item->second.service_discovered_cb(service_info);
-              }
+      if (notify) {
+        RunOnNotificationThread(
+            subscriber->second.get(),
+            [subscriber = subscriber->second, service_info = service_info]() {
+              subscriber->Get().service_discovered_cb(service_info);
             });
       }
     } else {
       // Known service is off.
       // Erase it from the map, and report as lost.
-      if (enable_notifications_) {
-        RunOnMediumEnvironmentThread(
-            [&info, service_info = service_info, service_type]() {
-              auto item = info.discovered_callbacks.find(service_type);
-              if (item != info.discovered_callbacks.end()) {
-                item->second.service_lost_cb(service_info);
-              }
+      if (notify) {
+        RunOnNotificationThread(
+            subscriber->second.get(),
+            [subscriber = subscriber->second, service_info = service_info]() {
+              subscriber->Get().service_lost_cb(service_info);
             });
       }
       info.discovered_services.erase(item);
@@ -290,6 +334,27 @@ void MediumEnvironment::RunOnMediumEnvironmentThread(
   executor_.Execute(std::move(runnable));
 }
 
+void MediumEnvironment::RunOnNotificationThread(
+    const void* subscriber, std::function<void()> runnable) {
+  if (notification_threads_.empty()) {
+    RunOnMediumEnvironmentThread(std::move(runnable));
+    return;
+  }
+  job_count_++;
+  auto index =
+      absl::Hash<const void*>()(subscriber) % notification_threads_.size();
+  notification_threads_[index]->Execute(std::move(runnable));
+}
+
+void MediumEnvironment::SetNotificationThreads(int count) {
+  if (static_cast<int>(notification_threads_.size()) == count) return;
+  // Destroying an executor waits for the notifications it has queued.
+  notification_threads_.clear();
+  for (int i = 0; i < count; ++i) {
+    notification_threads_.push_back(std::make_unique<SingleThreadExecutor>());
+  }
+}
+
 void MediumEnvironment::RegisterBluetoothMedium(
     api::BluetoothClassicMedium& medium,
     api::BluetoothAdapter& medium_adapter) {
@@ -323,7 +388,7 @@ void MediumEnvironment::UpdateBluetoothMedium(
         auto item = bluetooth_mediums_.find(&medium);
         if (item == bluetooth_mediums_.end()) return;
         auto& context = item->second;
-        context.callback = std::move(callback);
+        context.subscriber->Set(std::move(callback));
         auto* owned_adapter = context.adapter;
         NEARBY_LOGS(INFO) << "Updated: this=" << this << "; medium=" << &medium
                           << "; adapter=" << owned_adapter
@@ -347,6 +412,7 @@ void MediumEnvironment::UnregisterBluetoothMedium(
   RunOnMediumEnvironmentThread([this, &medium]() {
     auto item = bluetooth_mediums_.extract(&medium);
     if (item.empty()) return;
+    item.mapped().subscriber->Set({});
     NEARBY_LOGS(INFO) << "Unregistered Bluetooth medium:" << &medium;
   });
 }
@@ -375,17 +441,28 @@ void MediumEnvironment::UpdateBleMediumForAdvertising(
     context.ble_peripheral = &peripheral;
     context.advertising = enabled;
     context.fast_advertisement = fast_advertisement;
+    if (!context.advertising_service_id.empty()) {
+      RemoveFromIndex(ble_advertisers_, context.advertising_service_id,
+                      &medium);
+      context.advertising_service_id.clear();
+    }
+    if (enabled) {
+      ble_advertisers_[service_id].insert(&medium);
+      context.advertising_service_id = service_id;
+    }
     NEARBY_LOGS(INFO) << "Update Ble medium for advertising: this=" << this
                       << "; medium=" << &medium << "; service_id=" << service_id
                       << "; name=" << peripheral.GetName()
                       << "; fast_advertisement=" << fast_advertisement
                       << "; enabled=" << enabled;
-    for (auto& medium_info : ble_mediums_) {
-      auto& local_medium = medium_info.first;
-      auto& info = medium_info.second;
+    auto scanners = ble_scanners_.find(service_id);
+    if (scanners == ble_scanners_.end()) return;
+    for (auto* scanner : scanners->second) {
       // Do not send notification to the same medium.
-      if (local_medium == &medium) continue;
-      OnBlePeripheralStateChanged(info, peripheral, service_id,
+      if (scanner == &medium) continue;
+      auto scanner_item = ble_mediums_.find(scanner);
+      if (scanner_item == ble_mediums_.end()) continue;
+      OnBlePeripheralStateChanged(scanner_item->second, peripheral, service_id,
                                   fast_advertisement, enabled);
     }
   });
@@ -407,20 +484,27 @@ void MediumEnvironment::UpdateBleMediumForScanning(
           return;
         }
         auto& context = item->second;
-        context.discovery_callback = std::move(callback);
+        context.discovery_subscriber->Set(std::move(callback));
+        RemoveBleScanner(&medium, context);
         NEARBY_LOGS(INFO) << "Update Ble medium for scanning: this=" << this
                           << "; medium=" << &medium
                           << "; service_id=" << service_id
                           << "; fast_advertisement_service_uuid="
                           << fast_advertisement_service_uuid
                           << "; enabled=" << enabled;
-        for (auto& medium_info : ble_mediums_) {
-          auto& local_medium = medium_info.first;
-          auto& info = medium_info.second;
+        if (!enabled) return;
+        ble_scanners_[service_id].insert(&medium);
+        context.scanning_service_id = service_id;
+        auto advertisers = ble_advertisers_.find(service_id);
+        if (advertisers == ble_advertisers_.end()) return;
+        for (auto* advertiser : advertisers->second) {
           // Do not send notification to the same medium.
-          if (local_medium == &medium) continue;
-          // Search advertising mediums and send notification.
-          if (info.advertising && enabled) {
+          if (advertiser == &medium) continue;
+          // Send notification for each medium advertising this service id.
+          auto advertiser_item = ble_mediums_.find(advertiser);
+          if (advertiser_item == ble_mediums_.end()) continue;
+          auto& info = advertiser_item->second;
+          if (info.advertising) {
             OnBlePeripheralStateChanged(context, *(info.ble_peripheral),
                                         service_id, info.fast_advertisement,
                                         enabled);
@@ -452,8 +536,16 @@ void MediumEnvironment::UpdateBleMediumForAcceptedConnection(
 void MediumEnvironment::UnregisterBleMedium(api::BleMedium& medium) {
   if (!enabled_) return;
   RunOnMediumEnvironmentThread([this, &medium]() {
-    auto item = ble_mediums_.extract(&medium);
-    if (item.empty()) return;
+    auto item = ble_mediums_.find(&medium);
+    if (item == ble_mediums_.end()) return;
+    auto& context = item->second;
+    RemoveBleScanner(&medium, context);
+    if (!context.advertising_service_id.empty()) {
+      RemoveFromIndex(ble_advertisers_, context.advertising_service_id,
+                      &medium);
+    }
+    context.discovery_subscriber->Set({});
+    ble_mediums_.erase(item);
     NEARBY_LOGS(INFO) << "Unregistered Ble medium";
   });
 }
@@ -592,20 +684,32 @@ void MediumEnvironment::UpdateWifiLanMediumForAdvertising(
                       << "; service_name=" << service_info.GetServiceName()
                       << "; service_type=" << service_type
                       << ", enabled=" << enabled;
-    for (auto& medium_info : wifi_lan_mediums_) {
-      auto& local_medium = medium_info.first;
-      auto& info = medium_info.second;
+    auto item = wifi_lan_mediums_.find(&medium);
+    if (item != wifi_lan_mediums_.end()) {
       // Do not send notification to the same medium but update
       // service info map.
-      if (local_medium == &medium) {
-        if (enabled) {
-          info.advertising_services.insert({service_type, service_info});
-        } else {
-          info.advertising_services.erase(service_type);
-        }
-        continue;
+      auto& context = item->second;
+      auto address = std::make_pair(service_info.GetIPAddress(),
+                                    service_info.GetPort());
+      absl::MutexLock lock(&wifi_lan_address_mutex_);
+      if (enabled) {
+        context.advertising_services.insert({service_type, service_info});
+        wifi_lan_advertisers_[service_type].insert(&medium);
+        wifi_lan_addresses_.insert({address, &medium});
+      } else {
+        context.advertising_services.erase(service_type);
+        RemoveFromIndex(wifi_lan_advertisers_, service_type, &medium);
+        wifi_lan_addresses_.erase(address);
       }
-      OnWifiLanServiceStateChanged(info, service_info, enabled);
+    }
+    auto discoverers = wifi_lan_discoverers_.find(service_type);
+    if (discoverers == wifi_lan_discoverers_.end()) return;
+    for (auto* discoverer : discoverers->second) {
+      if (discoverer == &medium) continue;
+      auto discoverer_item = wifi_lan_mediums_.find(discoverer);
+      if (discoverer_item == wifi_lan_mediums_.end()) continue;
+      OnWifiLanServiceStateChanged(discoverer_item->second, service_info,
+                                   enabled);
     }
   });
 }
@@ -624,21 +728,30 @@ void MediumEnvironment::UpdateWifiLanMediumForDiscovery(
       return;
     }
     auto& context = item->second;
-    context.discovered_callbacks.insert({service_type, std::move(callback)});
     NEARBY_LOGS(INFO) << "Update WifiLan medium for discovery: this=" << this
                       << "; medium=" << &medium
                       << "; service_type=" << service_type
                       << "; enabled=" << enabled;
-    for (auto& medium_info : wifi_lan_mediums_) {
-      auto& local_medium = medium_info.first;
-      auto& info = medium_info.second;
+    if (!enabled) {
+      RemoveWifiLanDiscoverer(&medium, context, service_type);
+      return;
+    }
+    auto& subscriber = context.discovered_callbacks[service_type];
+    if (!subscriber) subscriber = std::make_shared<WifiLanSubscriber>();
+    subscriber->Set(std::move(callback));
+    wifi_lan_discoverers_[service_type].insert(&medium);
+    auto advertisers = wifi_lan_advertisers_.find(service_type);
+    if (advertisers == wifi_lan_advertisers_.end()) return;
+    for (auto* advertiser : advertisers->second) {
       // Do not send notification to the same medium.
-      if (local_medium == &medium) continue;
+      if (advertiser == &medium) continue;
       // Search advertising services and send notification.
-      for (auto& advertising_service : info.advertising_services) {
-        auto& service_info = advertising_service.second;
-        OnWifiLanServiceStateChanged(context, service_info, /*enabled=*/true);
-      }
+      auto advertiser_item = wifi_lan_mediums_.find(advertiser);
+      if (advertiser_item == wifi_lan_mediums_.end()) continue;
+      auto& advertising_services = advertiser_item->second.advertising_services;
+      auto service = advertising_services.find(service_type);
+      if (service == advertising_services.end()) continue;
+      OnWifiLanServiceStateChanged(context, service->second, /*enabled=*/true);
     }
   });
 }
@@ -646,31 +759,115 @@ void MediumEnvironment::UpdateWifiLanMediumForDiscovery(
 void MediumEnvironment::UnregisterWifiLanMedium(api::WifiLanMedium& medium) {
   if (!enabled_) return;
   RunOnMediumEnvironmentThread([this, &medium]() {
-    auto item = wifi_lan_mediums_.extract(&medium);
-    if (item.empty()) return;
+    auto item = wifi_lan_mediums_.find(&medium);
+    if (item == wifi_lan_mediums_.end()) return;
+    auto& context = item->second;
+    while (!context.discovered_callbacks.empty()) {
+      RemoveWifiLanDiscoverer(&medium, context,
+                              context.discovered_callbacks.begin()->first);
+    }
+    {
+      absl::MutexLock lock(&wifi_lan_address_mutex_);
+      for (auto& advertising_service : context.advertising_services) {
+        auto& service_info = advertising_service.second;
+        RemoveFromIndex(wifi_lan_advertisers_, advertising_service.first,
+                        &medium);
+        wifi_lan_addresses_.erase(std::make_pair(service_info.GetIPAddress(),
+                                                 service_info.GetPort()));
+      }
+    }
+    wifi_lan_mediums_.erase(item);
     NEARBY_LOGS(INFO) << "Unregistered WifiLan medium";
   });
 }
 
+void MediumEnvironment::RemoveWifiLanDiscoverer(
+    api::WifiLanMedium* medium, WifiLanMediumContext& context,
+    const std::string& service_type) {
+  RemoveFromIndex(wifi_lan_discoverers_, service_type, medium);
+  auto item = context.discovered_callbacks.find(service_type);
+  if (item != context.discovered_callbacks.end()) {
+    item->second->Set({});
+    context.discovered_callbacks.erase(item);
+  }
+  // Services of this type are reported afresh if discovery restarts.
+  context.discovered_services.erase(service_type);
+}
+
+void MediumEnvironment::RemoveBleScanner(api::BleMedium* medium,
+                                         BleMediumContext& context) {
+  if (context.scanning_service_id.empty()) return;
+  RemoveFromIndex(ble_scanners_, context.scanning_service_id, medium);
+  context.scanning_service_id.clear();
+}
+
 api::WifiLanMedium* MediumEnvironment::GetWifiLanMedium(
     const std::string& ip_address, int port) {
-  for (auto& medium_info : wifi_lan_mediums_) {
-    auto* medium_found = medium_info.first;
-    auto& info = medium_info.second;
-    for (auto& advertising_service : info.advertising_services) {
-      auto& service_info = advertising_service.second;
-      if (ip_address == service_info.GetIPAddress() &&
-          port == service_info.GetPort()) {
-        return medium_found;
-      }
-    }
-  }
-  return nullptr;
+  absl::MutexLock lock(&wifi_lan_address_mutex_);
+  auto item = wifi_lan_addresses_.find(std::make_pair(ip_address, port));
+  return item != wifi_lan_addresses_.end() ? item->second : nullptr;
 }
 
 void MediumEnvironment::SetFeatureFlags(const FeatureFlags::Flags& flags) {
   const_cast<FeatureFlags&>(FeatureFlags::GetInstance()).SetFlags(flags);
 }
 
+void MediumEnvironment::SetLinkProfile(proto::connections::Medium medium,
+                                       const LinkProfile& profile) {
+  absl::MutexLock lock(&link_mutex_);
+  medium_links_.insert_or_assign(medium, profile);
+}
+
+void MediumEnvironment::SetLinkProfile(api::BluetoothClassicMedium& medium_a,
+                                       api::BluetoothClassicMedium& medium_b,
+                                       const LinkProfile& profile) {
+  SetLinkProfile(MakeLinkKey(&medium_a, &medium_b), profile);
+}
+
+void MediumEnvironment::SetLinkProfile(api::BleMedium& medium_a,
+                                       api::BleMedium& medium_b,
+                                       const LinkProfile& profile) {
+  SetLinkProfile(MakeLinkKey(&medium_a, &medium_b), profile);
+}
+
+void MediumEnvironment::SetLinkProfile(api::WifiLanMedium& medium_a,
+                                       api::WifiLanMedium& medium_b,
+                                       const LinkProfile& profile) {
+  SetLinkProfile(MakeLinkKey(&medium_a, &medium_b), profile);
+}
+
+void MediumEnvironment::SetLinkProfile(LinkKey key,
+                                       const LinkProfile& profile) {
+  absl::MutexLock lock(&link_mutex_);
+  links_.insert_or_assign(key, profile);
+}
+
+LinkProfile MediumEnvironment::GetLinkProfile(
+    api::BluetoothClassicMedium& local, api::BluetoothClassicMedium& remote) {
+  return GetLinkProfile(proto::connections::BLUETOOTH,
+                        MakeLinkKey(&local, &remote));
+}
+
+LinkProfile MediumEnvironment::GetLinkProfile(api::BleMedium& local,
+                                              api::BleMedium& remote) {
+  return GetLinkProfile(proto::connections::BLE, MakeLinkKey(&local, &remote));
+}
+
+LinkProfile MediumEnvironment::GetLinkProfile(api::WifiLanMedium& local,
+                                              api::WifiLanMedium& remote) {
+  return GetLinkProfile(proto::connections::WIFI_LAN,
+                        MakeLinkKey(&local, &remote));
+}
+
+LinkProfile MediumEnvironment::GetLinkProfile(
+    proto::connections::Medium medium, LinkKey key) {
+  absl::MutexLock lock(&link_mutex_);
+  auto link = links_.find(key);
+  if (link != links_.end()) return link->second;
+  auto medium_link = medium_links_.find(medium);
+  if (medium_link != medium_links_.end()) return medium_link->second;
+  return {};
+}
+
 }  // namespace nearby
 }  // namespace location
@@ -17,9 +17,14 @@
 
 #include <atomic>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "platform/api/ble.h"
 #include "platform/api/bluetooth_adapter.h"
 #include "platform/api/bluetooth_classic.h"
@@ -27,9 +32,11 @@
 #include "platform/api/wifi_lan.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/feature_flags.h"
+#include "platform/base/link_profile.h"
 #include "platform/base/listeners.h"
 #include "platform/base/nsd_service_info.h"
 #include "platform/public/single_thread_executor.h"
+#include "proto/connections_enums.pb.h"
 
 namespace location {
 namespace nearby {
@@ -41,12 +48,18 @@ struct EnvironmentConfig {
   // This is currently set to false, due to http://b/139734036 that would lead
   // to flaky tests.
   bool webrtc_enabled = false;
+  // Number of threads that deliver discovery notifications to the simulated
+  // mediums. Notifications to one medium are delivered in order, on the same
+  // thread. 0 delivers all of them on the environment thread itself.
+  int notification_threads = 0;
 };
 
 // MediumEnvironment is a simulated environment which allows multiple instances
 // of simulated HW devices to "work" together as if they are physical.
 // For each medium type it provides necessary methods to implement
 // advertising, discovery and establishment of a data link.
+// Advertisers and discoverers are indexed by BLE service id and WifiLan
+// service type, so that an update only reaches the mediums subscribed to it.
 // NOTE: this code depends on public:types target.
 class MediumEnvironment {
  public:
@@ -231,31 +244,103 @@ class MediumEnvironment {
 
   // Returns WifiLan medium whose advertising service matching IP address and
   // port, or nullptr.
-  api::WifiLanMedium* GetWifiLanMedium(const std::string& ip_address, int port);
+  api::WifiLanMedium* GetWifiLanMedium(const std::string& ip_address, int port)
+      ABSL_LOCKS_EXCLUDED(wifi_lan_address_mutex_);
 
   void SetFeatureFlags(const FeatureFlags::Flags& flags);
 
+  // Shapes both directions of the data links established over |medium| from
+  // now on. Links already established keep the profile they had.
+  void SetLinkProfile(proto::connections::Medium medium,
+                      const LinkProfile& profile)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+
+  // Shapes the data links established between two specific mediums from now
+  // on, regardless of which of them initiates the connection. Takes
+  // precedence over the profile of the medium type.
+  void SetLinkProfile(api::BluetoothClassicMedium& medium_a,
+                      api::BluetoothClassicMedium& medium_b,
+                      const LinkProfile& profile)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+  void SetLinkProfile(api::BleMedium& medium_a, api::BleMedium& medium_b,
+                      const LinkProfile& profile)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+  void SetLinkProfile(api::WifiLanMedium& medium_a,
+                      api::WifiLanMedium& medium_b, const LinkProfile& profile)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+
+  // Returns the profile of a data link being established between two mediums.
+  LinkProfile GetLinkProfile(api::BluetoothClassicMedium& local,
+                             api::BluetoothClassicMedium& remote)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+  LinkProfile GetLinkProfile(api::BleMedium& local, api::BleMedium& remote)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+  LinkProfile GetLinkProfile(api::WifiLanMedium& local,
+                             api::WifiLanMedium& remote)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+
  private:
+  // Latest callback of one simulated medium. Notifications in flight hold on
+  // to it, so that they reach the callback current at delivery time, and a
+  // no-op one once the medium has stopped listening or is gone.
+  template <typename Callback>
+  class Subscriber {
+   public:
+    void Set(Callback callback) ABSL_LOCKS_EXCLUDED(mutex_) {
+      absl::MutexLock lock(&mutex_);
+      callback_ = std::move(callback);
+    }
+    Callback Get() const ABSL_LOCKS_EXCLUDED(mutex_) {
+      absl::MutexLock lock(&mutex_);
+      return callback_;
+    }
+
+   private:
+    mutable absl::Mutex mutex_;
+    Callback callback_ ABSL_GUARDED_BY(mutex_);
+  };
+  using BluetoothSubscriber = Subscriber<BluetoothDiscoveryCallback>;
+  using BleSubscriber = Subscriber<BleDiscoveredPeripheralCallback>;
+  using WifiLanSubscriber = Subscriber<WifiLanDiscoveredServiceCallback>;
+
+  // Unordered pair of mediums at the ends of a data link.
+  using LinkKey = std::pair<const void*, const void*>;
+
+  static LinkKey MakeLinkKey(const void* medium_a, const void* medium_b) {
+    return medium_a < medium_b ? LinkKey{medium_a, medium_b}
+                               : LinkKey{medium_b, medium_a};
+  }
+
+  void SetLinkProfile(LinkKey key, const LinkProfile& profile)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+  LinkProfile GetLinkProfile(proto::connections::Medium medium, LinkKey key)
+      ABSL_LOCKS_EXCLUDED(link_mutex_);
+
   struct BluetoothMediumContext {
-    BluetoothDiscoveryCallback callback;
+    std::shared_ptr<BluetoothSubscriber> subscriber =
+        std::make_shared<BluetoothSubscriber>();
     api::BluetoothAdapter* adapter = nullptr;
     // discovered device vs device name map.
     absl::flat_hash_map<api::BluetoothDevice*, std::string> devices;
   };
 
   struct BleMediumContext {
-    BleDiscoveredPeripheralCallback discovery_callback;
+    std::shared_ptr<BleSubscriber> discovery_subscriber =
+        std::make_shared<BleSubscriber>();
     BleAcceptedConnectionCallback accepted_connection_callback;
     api::BlePeripheral* ble_peripheral = nullptr;
     bool advertising = false;
     bool fast_advertisement = false;
+    // Service ids advertised and scanned for; empty when not doing either.
+    std::string advertising_service_id;
+    std::string scanning_service_id;
   };
 
   struct WifiLanMediumContext {
     // advertising service type vs NsdServiceInfo map.
     absl::flat_hash_map<std::string, NsdServiceInfo> advertising_services;
-    // discovered service type vs callback map.
-    absl::flat_hash_map<std::string, WifiLanDiscoveredServiceCallback>
+    // discovered service type vs subscriber map.
+    absl::flat_hash_map<std::string, std::shared_ptr<WifiLanSubscriber>>
         discovered_callbacks;
     // discovered service vs service type map.
     absl::flat_hash_map<std::string, NsdServiceInfo> discovered_services;
@@ -285,11 +370,25 @@ class MediumEnvironment {
 
   void RunOnMediumEnvironmentThread(std::function<void()> runnable);
 
+  // Delivers a notification to the subscriber identified by |subscriber|, on
+  // the notification thread that subscriber is assigned to.
+  void RunOnNotificationThread(const void* subscriber,
+                               std::function<void()> runnable);
+
+  // Replaces the notification threads; called while the environment is idle.
+  void SetNotificationThreads(int count);
+
+  void RemoveBleScanner(api::BleMedium* medium, BleMediumContext& context);
+  void RemoveWifiLanDiscoverer(api::WifiLanMedium* medium,
+                               WifiLanMediumContext& context,
+                               const std::string& service_type);
+
   std::atomic_bool enabled_ = true;
   std::atomic_int job_count_ = 0;
   std::atomic_bool enable_notifications_ = false;
   SingleThreadExecutor executor_;
   EnvironmentConfig config_;
+  std::vector<std::unique_ptr<SingleThreadExecutor>> notification_threads_;
 
   // The following data members are accessed in the context of a private
   // executor_ thread.
@@ -299,6 +398,11 @@ class MediumEnvironment {
       bluetooth_mediums_;
 
   absl::flat_hash_map<api::BleMedium*, BleMediumContext> ble_mediums_;
+  // Service id vs mediums advertising it, and vs mediums scanning for it.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<api::BleMedium*>>
+      ble_advertisers_;
+  absl::flat_hash_map<std::string, absl::flat_hash_set<api::BleMedium*>>
+      ble_scanners_;
 
   // Maps peer id to callback for receiving signaling messages.
   absl::flat_hash_map<std::string, OnSignalingMessageCallback>
@@ -310,9 +414,27 @@ class MediumEnvironment {
 
   absl::flat_hash_map<api::WifiLanMedium*, WifiLanMediumContext>
       wifi_lan_mediums_;
+  // Service type vs mediums advertising it, and vs mediums discovering it.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<api::WifiLanMedium*>>
+      wifi_lan_advertisers_;
+  absl::flat_hash_map<std::string, absl::flat_hash_set<api::WifiLanMedium*>>
+      wifi_lan_discoverers_;
+
+  // Advertised ip address and port vs WifiLan medium. Looked up by
+  // connecting threads, so it has a mutex of its own.
+  absl::Mutex wifi_lan_address_mutex_;
+  absl::flat_hash_map<std::pair<std::string, int>, api::WifiLanMedium*>
+      wifi_lan_addresses_ ABSL_GUARDED_BY(wifi_lan_address_mutex_);
 
   bool use_valid_peer_connection_ = true;
   absl::Duration peer_connection_latency_ = absl::ZeroDuration();
+
+  // Link profiles are looked up by medium threads while a connection is being
+  // established, so they are guarded by a mutex of their own.
+  absl::Mutex link_mutex_;
+  absl::flat_hash_map<proto::connections::Medium, LinkProfile> medium_links_
+      ABSL_GUARDED_BY(link_mutex_);
+  absl::flat_hash_map<LinkKey, LinkProfile> links_ ABSL_GUARDED_BY(link_mutex_);
 };
 
 }  // namespace nearby
@@ -0,0 +1,155 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/strings/str_cat.h"
+#include "platform/api/platform.h"
+#include "platform/api/wifi_lan.h"
+#include "platform/base/medium_environment.h"
+#include "platform/base/nsd_service_info.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+constexpr char kServiceType[] = "_venue._tcp";
+
+std::unique_ptr<api::WifiLanMedium> CreateMedium() {
+  return api::ImplementationPlatform::CreateWifiLanMedium();
+}
+
+NsdServiceInfo MakeServiceInfo(const std::string& service_type, int index) {
+  NsdServiceInfo service_info;
+  service_info.SetServiceName(absl::StrCat("device-", index));
+  service_info.SetServiceType(service_type);
+  return service_info;
+}
+
+// A venue of |devices| devices advertising the same service, and as many
+// bystanders advertising and discovering services of their own.
+class Venue {
+ public:
+  explicit Venue(int devices) {
+    for (int i = 0; i < devices; ++i) {
+      auto advertiser = CreateMedium();
+      advertiser->StartAdvertising(MakeServiceInfo(kServiceType, i));
+      mediums_.push_back(std::move(advertiser));
+
+      std::string bystander_type = absl::StrCat("_bystander", i, "._tcp");
+      auto bystander = CreateMedium();
+      bystander->StartAdvertising(MakeServiceInfo(bystander_type, i));
+      bystander->StartDiscovery(bystander_type, {});
+      mediums_.push_back(std::move(bystander));
+    }
+  }
+
+ private:
+  std::vector<std::unique_ptr<api::WifiLanMedium>> mediums_;
+};
+
+// Discovery latency: the time it takes a device that walks into the venue to
+// discover every device advertising the service it is looking for.
+void BM_WifiLanDiscoveryLatency(benchmark::State& state) {
+  int devices = state.range(0);
+  auto& env = MediumEnvironment::Instance();
+  env.Stop();
+  env.Start({.notification_threads = static_cast<int>(state.range(1))});
+  {
+    Venue venue(devices);
+    std::unique_ptr<api::WifiLanMedium> medium;
+    std::atomic<int> discovered{0};
+    for (auto _ : state) {
+      state.PauseTiming();
+      if (medium) medium->StopDiscovery(kServiceType);
+      medium = CreateMedium();
+      env.Sync();
+      discovered = 0;
+      state.ResumeTiming();
+      medium->StartDiscovery(
+          kServiceType,
+          {.service_discovered_cb = [&discovered](NsdServiceInfo) {
+            discovered++;
+          }});
+      env.Sync();
+      if (discovered != devices) {
+        state.SkipWithError("Not every device was discovered.");
+      }
+    }
+    medium->StopDiscovery(kServiceType);
+    env.Sync();
+  }
+  env.Stop();
+  env.Start();
+  state.counters["devices"] = devices;
+}
+BENCHMARK(BM_WifiLanDiscoveryLatency)
+    ->ArgNames({"devices", "threads"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 8}})
+    ->UseRealTime();
+
+// Advertising fan-out: the time it takes every device of the venue that
+// discovers a service to hear about a new device advertising it.
+void BM_WifiLanAdvertisingFanOut(benchmark::State& state) {
+  int devices = state.range(0);
+  auto& env = MediumEnvironment::Instance();
+  env.Stop();
+  env.Start({.notification_threads = static_cast<int>(state.range(1))});
+  {
+    Venue venue(devices);
+    std::atomic<int> discovered{0};
+    std::vector<std::unique_ptr<api::WifiLanMedium>> discoverers;
+    for (int i = 0; i < devices; ++i) {
+      auto discoverer = CreateMedium();
+      discoverer->StartDiscovery(
+          kServiceType,
+          {.service_discovered_cb = [&discovered](NsdServiceInfo) {
+            discovered++;
+          }});
+      discoverers.push_back(std::move(discoverer));
+    }
+    auto advertiser = CreateMedium();
+    NsdServiceInfo service_info = MakeServiceInfo(kServiceType, devices);
+    bool advertising = false;
+    for (auto _ : state) {
+      state.PauseTiming();
+      if (advertising) advertiser->StopAdvertising(service_info);
+      env.Sync();
+      discovered = 0;
+      state.ResumeTiming();
+      advertising = advertiser->StartAdvertising(service_info);
+      env.Sync();
+      if (discovered != devices) {
+        state.SkipWithError("Not every device discovered the advertiser.");
+      }
+    }
+    advertiser->StopAdvertising(service_info);
+    env.Sync();
+  }
+  env.Stop();
+  env.Start();
+  state.counters["devices"] = devices;
+}
+BENCHMARK(BM_WifiLanAdvertisingFanOut)
+    ->ArgNames({"devices", "threads"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 8}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,202 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/medium_environment.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "platform/api/ble.h"
+#include "platform/api/bluetooth_adapter.h"
+#include "platform/api/platform.h"
+#include "platform/api/wifi_lan.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/nsd_service_info.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::IsEmpty;
+
+constexpr char kServiceType[] = "_service._tcp";
+constexpr char kOtherServiceType[] = "_other._tcp";
+constexpr char kServiceId[] = "com.google.location.nearby.apps.test";
+constexpr char kOtherServiceId[] = "com.google.location.nearby.apps.other";
+
+NsdServiceInfo MakeServiceInfo(const std::string& service_name,
+                               const std::string& service_type) {
+  NsdServiceInfo service_info;
+  service_info.SetServiceName(service_name);
+  service_info.SetServiceType(service_type);
+  return service_info;
+}
+
+// Records the events a discovering medium is notified of, in order.
+class Events {
+ public:
+  api::WifiLanMedium::DiscoveredServiceCallback WifiLanCallback() {
+    return {
+        .service_discovered_cb =
+            [this](NsdServiceInfo service_info) {
+              Add(absl::StrCat("found ", service_info.GetServiceName()));
+            },
+        .service_lost_cb =
+            [this](NsdServiceInfo service_info) {
+              Add(absl::StrCat("lost ", service_info.GetServiceName()));
+            },
+    };
+  }
+
+  api::BleMedium::DiscoveredPeripheralCallback BleCallback() {
+    return {
+        .peripheral_discovered_cb =
+            [this](api::BlePeripheral&, const std::string& service_id,
+                   bool) { Add(absl::StrCat("found ", service_id)); },
+    };
+  }
+
+  std::vector<std::string> Get() const {
+    absl::MutexLock lock(&mutex_);
+    return events_;
+  }
+
+ private:
+  void Add(std::string event) {
+    absl::MutexLock lock(&mutex_);
+    events_.push_back(std::move(event));
+  }
+
+  mutable absl::Mutex mutex_;
+  std::vector<std::string> events_ ABSL_GUARDED_BY(mutex_);
+};
+
+class MediumEnvironmentTest : public ::testing::Test {
+ protected:
+  MediumEnvironmentTest() { env_.Stop(); }
+
+  MediumEnvironment& env_{MediumEnvironment::Instance()};
+};
+
+TEST_F(MediumEnvironmentTest, WifiLanDiscoveryOnlyReportsItsServiceType) {
+  env_.Start();
+  auto discoverer = api::ImplementationPlatform::CreateWifiLanMedium();
+  auto advertiser = api::ImplementationPlatform::CreateWifiLanMedium();
+  auto other_advertiser = api::ImplementationPlatform::CreateWifiLanMedium();
+  Events events;
+
+  discoverer->StartDiscovery(kServiceType, events.WifiLanCallback());
+  advertiser->StartAdvertising(MakeServiceInfo("device", kServiceType));
+  other_advertiser->StartAdvertising(
+      MakeServiceInfo("other device", kOtherServiceType));
+  env_.Sync();
+
+  EXPECT_THAT(events.Get(), ElementsAre("found device"));
+  discoverer->StopDiscovery(kServiceType);
+  advertiser->StopAdvertising(MakeServiceInfo("device", kServiceType));
+  other_advertiser->StopAdvertising(
+      MakeServiceInfo("other device", kOtherServiceType));
+  env_.Sync(false);
+  env_.Stop();
+}
+
+TEST_F(MediumEnvironmentTest, WifiLanStopDiscoveryRemovesCallback) {
+  env_.Start();
+  auto discoverer = api::ImplementationPlatform::CreateWifiLanMedium();
+  auto advertiser = api::ImplementationPlatform::CreateWifiLanMedium();
+  Events stopped_events;
+  Events events;
+
+  discoverer->StartDiscovery(kServiceType, stopped_events.WifiLanCallback());
+  discoverer->StopDiscovery(kServiceType);
+  // Discovery started again reports to the new callback only.
+  discoverer->StartDiscovery(kServiceType, events.WifiLanCallback());
+  advertiser->StartAdvertising(MakeServiceInfo("device", kServiceType));
+  env_.Sync();
+  discoverer->StopDiscovery(kServiceType);
+  advertiser->StopAdvertising(MakeServiceInfo("device", kServiceType));
+  env_.Sync();
+
+  EXPECT_THAT(stopped_events.Get(), IsEmpty());
+  EXPECT_THAT(events.Get(), ElementsAre("found device"));
+  env_.Stop();
+}
+
+TEST_F(MediumEnvironmentTest, BleScanningOnlyReportsItsServiceId) {
+  env_.Start();
+  auto scanner_adapter = api::ImplementationPlatform::CreateBluetoothAdapter();
+  auto adapter = api::ImplementationPlatform::CreateBluetoothAdapter();
+  auto other_adapter = api::ImplementationPlatform::CreateBluetoothAdapter();
+  auto scanner = api::ImplementationPlatform::CreateBleMedium(*scanner_adapter);
+  auto advertiser = api::ImplementationPlatform::CreateBleMedium(*adapter);
+  auto other_advertiser =
+      api::ImplementationPlatform::CreateBleMedium(*other_adapter);
+  ByteArray advertisement_bytes{std::string("\x0a\x0b\x0c\x0d")};
+  Events events;
+
+  scanner->StartScanning(kServiceId, {}, events.BleCallback());
+  advertiser->StartAdvertising(kServiceId, advertisement_bytes, {});
+  other_advertiser->StartAdvertising(kOtherServiceId, advertisement_bytes, {});
+  env_.Sync();
+
+  EXPECT_THAT(events.Get(), ElementsAre(absl::StrCat("found ", kServiceId)));
+  scanner->StopScanning(kServiceId);
+  advertiser->StopAdvertising(kServiceId);
+  other_advertiser->StopAdvertising(kOtherServiceId);
+  env_.Sync(false);
+  env_.Stop();
+}
+
+TEST_F(MediumEnvironmentTest, NotificationThreadsKeepOrderPerSubscriber) {
+  constexpr int kDiscoverers = 4;
+  constexpr int kAdvertisers = 20;
+  env_.Start({.notification_threads = 3});
+  std::vector<std::unique_ptr<api::WifiLanMedium>> discoverers;
+  std::vector<Events> events(kDiscoverers);
+  for (int i = 0; i < kDiscoverers; ++i) {
+    discoverers.push_back(api::ImplementationPlatform::CreateWifiLanMedium());
+    discoverers.back()->StartDiscovery(kServiceType,
+                                       events[i].WifiLanCallback());
+  }
+
+  std::vector<std::unique_ptr<api::WifiLanMedium>> advertisers;
+  std::vector<std::string> expected;
+  for (int i = 0; i < kAdvertisers; ++i) {
+    std::string name = absl::StrCat("device ", i);
+    advertisers.push_back(api::ImplementationPlatform::CreateWifiLanMedium());
+    advertisers.back()->StartAdvertising(MakeServiceInfo(name, kServiceType));
+    advertisers.back()->StopAdvertising(MakeServiceInfo(name, kServiceType));
+    expected.push_back(absl::StrCat("found ", name));
+    expected.push_back(absl::StrCat("lost ", name));
+  }
+  env_.Sync();
+
+  for (int i = 0; i < kDiscoverers; ++i) {
+    EXPECT_THAT(events[i].Get(), ElementsAreArray(expected));
+    discoverers[i]->StopDiscovery(kServiceType);
+  }
+  env_.Sync(false);
+  env_.Stop();
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
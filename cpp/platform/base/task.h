@@ -0,0 +1,158 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_TASK_H_
+#define PLATFORM_BASE_TASK_H_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace location {
+namespace nearby {
+
+// A move-only callable that takes no arguments and returns nothing; the unit
+// of work executors run.
+//
+// Unlike Runnable, a Task keeps callables of up to kInlineSize bytes within
+// itself, so handing a typical closure over to an executor does not allocate.
+// Larger callables, and those that may throw while being moved, are kept on
+// the heap. Callables do not have to be copyable, and any Runnable converts to
+// a Task.
+class Task {
+ public:
+  static constexpr std::size_t kInlineSize = 12 * sizeof(void*);
+
+  Task() = default;
+  Task(std::nullptr_t) {}  // NOLINT
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<F>, Task>::value>,
+            typename = decltype(std::declval<std::decay_t<F>&>()())>
+  Task(F&& callable) {  // NOLINT
+    Emplace(std::forward<F>(callable));
+  }
+  Task(Task&& other) noexcept { MoveFrom(other); }
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() { Reset(); }
+
+  // Returns false for a default-constructed or moved-from Task, and for one
+  // made of an empty Runnable.
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // Runs the callable; the task must not be empty.
+  void operator()() { ops_->invoke(&storage_); }
+
+ private:
+  template <typename F>
+  using StoredInline = std::integral_constant<
+      bool, sizeof(F) <= kInlineSize &&
+                alignof(F) <= alignof(std::max_align_t) &&
+                std::is_nothrow_move_constructible<F>::value>;
+
+  struct Ops {
+    void (*invoke)(void* storage);
+    // Move-constructs the callable at |to| out of the one at |from|, which is
+    // then destroyed.
+    void (*relocate)(void* from, void* to);
+    void (*destroy)(void* storage);
+  };
+
+  template <typename F>
+  struct InlineOps {
+    static F* Get(void* storage) { return static_cast<F*>(storage); }
+    static void Invoke(void* storage) { (*Get(storage))(); }
+    static void Relocate(void* from, void* to) {
+      new (to) F(std::move(*Get(from)));
+      Get(from)->~F();
+    }
+    static void Destroy(void* storage) { Get(storage)->~F(); }
+    static const Ops* GetOps() {
+      static constexpr Ops ops = {&Invoke, &Relocate, &Destroy};
+      return &ops;
+    }
+  };
+
+  template <typename F>
+  struct HeapOps {
+    static F* Get(void* storage) { return *static_cast<F**>(storage); }
+    static void Invoke(void* storage) { (*Get(storage))(); }
+    static void Relocate(void* from, void* to) { new (to) F*(Get(from)); }
+    static void Destroy(void* storage) { delete Get(storage); }
+    static const Ops* GetOps() {
+      static constexpr Ops ops = {&Invoke, &Relocate, &Destroy};
+      return &ops;
+    }
+  };
+
+  template <typename F>
+  static bool IsEmpty(const F&) {
+    return false;
+  }
+  template <typename R>
+  static bool IsEmpty(const std::function<R()>& callable) {
+    return !callable;
+  }
+  template <typename R>
+  static bool IsEmpty(R (*callable)()) {
+    return callable == nullptr;
+  }
+
+  template <typename F>
+  void Emplace(F&& callable) {
+    using Callable = std::decay_t<F>;
+    if (IsEmpty(callable)) return;
+    Construct<Callable>(std::forward<F>(callable), StoredInline<Callable>());
+  }
+  template <typename Callable, typename F>
+  void Construct(F&& callable, std::true_type) {
+    new (&storage_) Callable(std::forward<F>(callable));
+    ops_ = InlineOps<Callable>::GetOps();
+  }
+  template <typename Callable, typename F>
+  void Construct(F&& callable, std::false_type) {
+    new (&storage_) Callable*(new Callable(std::forward<F>(callable)));
+    ops_ = HeapOps<Callable>::GetOps();
+  }
+
+  void MoveFrom(Task& other) {
+    if (other.ops_ == nullptr) return;
+    other.ops_->relocate(&other.storage_, &storage_);
+    ops_ = other.ops_;
+    other.ops_ = nullptr;
+  }
+  void Reset() {
+    if (ops_ == nullptr) return;
+    ops_->destroy(&storage_);
+    ops_ = nullptr;
+  }
+
+  const Ops* ops_ = nullptr;
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_TASK_H_
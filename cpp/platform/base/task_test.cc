@@ -0,0 +1,95 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/task.h"
+
+#include <array>
+#include <memory>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "platform/base/runnable.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+TEST(TaskTest, DefaultTaskIsEmpty) {
+  Task task;
+  EXPECT_FALSE(task);
+  Task null_task = nullptr;
+  EXPECT_FALSE(null_task);
+  Task empty_runnable_task = Runnable();
+  EXPECT_FALSE(empty_runnable_task);
+}
+
+TEST(TaskTest, RunsSmallCallable) {
+  int count = 0;
+  Task task = [&count]() { count++; };
+  EXPECT_TRUE(task);
+  task();
+  task();
+  EXPECT_EQ(count, 2);
+}
+
+TEST(TaskTest, RunsLargeCallable) {
+  std::array<char, 2 * Task::kInlineSize> data{};
+  data.back() = 42;
+  int result = 0;
+  Task task = [data, &result]() { result = data.back(); };
+  Task moved = std::move(task);
+  EXPECT_FALSE(task);  // NOLINT
+  moved();
+  EXPECT_EQ(result, 42);
+}
+
+TEST(TaskTest, RunsRunnable) {
+  int count = 0;
+  Runnable runnable = [&count]() { count++; };
+  Task task = runnable;
+  task();
+  runnable();
+  EXPECT_EQ(count, 2);
+}
+
+TEST(TaskTest, TakesMoveOnlyCallable) {
+  auto value = std::make_unique<int>(5);
+  int result = 0;
+  Task task = [value = std::move(value), &result]() { result = *value; };
+  Task other;
+  other = std::move(task);
+  other();
+  EXPECT_EQ(result, 5);
+}
+
+TEST(TaskTest, DestroysCallableOnce) {
+  auto counter = std::make_shared<int>(0);
+  {
+    Task task = [counter]() {};
+    Task moved = std::move(task);
+    EXPECT_EQ(counter.use_count(), 2);
+    moved = nullptr;
+    EXPECT_EQ(counter.use_count(), 1);
+    std::array<char, 2 * Task::kInlineSize> data{};
+    moved = [counter, data]() {};
+    task = std::move(moved);
+    EXPECT_EQ(counter.use_count(), 2);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,322 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/virtual_clock.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/time/clock.h"
+
+namespace location {
+namespace nearby {
+
+namespace {
+
+// Every run starts at 2020-01-01 00:00:00 UTC, so that timestamps do not
+// change from run to run.
+constexpr std::int64_t kStartUnixSeconds = 1577836800;
+
+// The clock signals an expired waiter without holding the waiter's mutex, so
+// the waiter may miss the signal if it comes right before it blocks. A timed
+// wait re-checks its state this often (in real time) to cover that window.
+constexpr absl::Duration kExpiryPollInterval = absl::Milliseconds(10);
+
+// Generation of the tracked task the current thread runs, or 0 if none.
+thread_local std::uint64_t running_generation = 0;
+
+}  // namespace
+
+VirtualClock& VirtualClock::Instance() {
+  static VirtualClock* instance = new VirtualClock();
+  return *instance;
+}
+
+void VirtualClock::Start(Mode mode) {
+  Stop();
+  absl::MutexLock lock(&mutex_);
+  started_ = true;
+  mode_ = mode;
+  generation_++;
+  now_ = absl::FromUnixSeconds(kStartUnixSeconds);
+  busy_ = 0;
+  advancing_ = false;
+  if (mode_ == Mode::kAuto) {
+    stop_ticker_ = false;
+    ticker_ = std::thread([this]() { RunTicker(); });
+  }
+}
+
+void VirtualClock::Stop() {
+  std::thread ticker;
+  std::map<TimerKey, Timer> dropped;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (!started_) return;
+    started_ = false;
+    generation_++;
+    for (Waiter* waiter : waiters_) {
+      if (!waiter->woken) WakeLocked(waiter, /*timed_out=*/false);
+    }
+    dropped.swap(timers_);
+    timer_deadlines_.clear();
+    stop_ticker_ = true;
+    ticker.swap(ticker_);
+    cond_.SignalAll();
+  }
+  if (ticker.joinable()) ticker.join();
+}
+
+bool VirtualClock::IsStarted() const {
+  return started_.load(std::memory_order_acquire);
+}
+
+absl::Time VirtualClock::Now() const {
+  if (!IsStarted()) return absl::Now();
+  absl::MutexLock lock(&mutex_);
+  return started_ ? now_ : absl::Now();
+}
+
+void VirtualClock::AdvanceBy(absl::Duration duration) {
+  absl::MutexLock lock(&mutex_);
+  while (started_ && advancing_) cond_.Wait(&mutex_);
+  if (!started_) return;
+  std::uint64_t generation = generation_;
+  absl::Time target = now_ + std::max(duration, absl::ZeroDuration());
+  advancing_ = true;
+  while (true) {
+    WaitForIdleLocked();
+    if (generation_ != generation) return;
+    if (NextDeadlineLocked() > target) break;
+    StepLocked();
+  }
+  now_ = std::max(now_, target);
+  advancing_ = false;
+  cond_.SignalAll();
+}
+
+void VirtualClock::WaitForIdle() {
+  absl::MutexLock lock(&mutex_);
+  WaitForIdleLocked();
+}
+
+Task VirtualClock::Track(Task task) {
+  if (!IsStarted()) return task;
+  std::uint64_t generation;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (!started_) return task;
+    generation = generation_;
+    busy_++;
+  }
+  return [task = std::move(task), token = BusyToken(this, generation),
+          generation]() mutable {
+    std::uint64_t outer = std::exchange(running_generation, generation);
+    task();
+    running_generation = outer;
+    token.Release();
+  };
+}
+
+std::uint64_t VirtualClock::AddTimer(const void* owner, absl::Duration delay,
+                                     Task task) {
+  absl::MutexLock lock(&mutex_);
+  if (!started_) return 0;
+  std::uint64_t id = ++next_timer_id_;
+  absl::Time deadline = now_ + std::max(delay, absl::ZeroDuration());
+  timers_.emplace(TimerKey(deadline, id), Timer{owner, std::move(task)});
+  timer_deadlines_.emplace(id, deadline);
+  cond_.SignalAll();
+  return id;
+}
+
+void VirtualClock::CancelTimer(std::uint64_t id) {
+  Task dropped;
+  absl::MutexLock lock(&mutex_);
+  auto it = timer_deadlines_.find(id);
+  if (it == timer_deadlines_.end()) return;
+  auto timer = timers_.find(TimerKey(it->second, id));
+  dropped = std::move(timer->second.task);
+  timers_.erase(timer);
+  timer_deadlines_.erase(it);
+  cond_.SignalAll();
+}
+
+void VirtualClock::CancelTimers(const void* owner) {
+  std::vector<Task> dropped;
+  absl::MutexLock lock(&mutex_);
+  while (firing_thread_ != std::thread::id() &&
+         firing_thread_ != std::this_thread::get_id()) {
+    cond_.Wait(&mutex_);
+  }
+  for (auto it = timers_.begin(); it != timers_.end();) {
+    if (it->second.owner == owner) {
+      dropped.push_back(std::move(it->second.task));
+      timer_deadlines_.erase(it->first.second);
+      it = timers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  cond_.SignalAll();
+}
+
+void VirtualClock::SleepFor(absl::Duration duration) {
+  if (IsStarted()) {
+    absl::MutexLock lock(&mutex_);
+    if (started_) {
+      Waiter waiter{nullptr, now_ + duration};
+      AddWaiterLocked(&waiter);
+      while (!waiter.woken) cond_.Wait(&mutex_);
+      RemoveWaiterLocked(&waiter);
+      return;
+    }
+  }
+  absl::SleepFor(duration);
+}
+
+bool VirtualClock::Wait(absl::CondVar* cond, absl::Mutex* mutex,
+                        absl::Time deadline) {
+  if (!IsStarted()) return cond->WaitWithDeadline(mutex, deadline);
+  Waiter waiter{cond, deadline};
+  {
+    absl::MutexLock lock(&mutex_);
+    if (started_) AddWaiterLocked(&waiter);
+  }
+  if (waiter.generation == 0) return cond->WaitWithDeadline(mutex, deadline);
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (waiter.woken) {
+        RemoveWaiterLocked(&waiter);
+        return waiter.timed_out;
+      }
+    }
+    if (deadline == absl::InfiniteFuture()) {
+      cond->Wait(mutex);
+    } else {
+      cond->WaitWithTimeout(mutex, kExpiryPollInterval);
+    }
+  }
+}
+
+void VirtualClock::Notify(absl::CondVar* cond) {
+  // Stop() wakes every virtual waiter, and no new ones wait once it is done.
+  if (IsStarted()) {
+    absl::MutexLock lock(&mutex_);
+    for (Waiter* waiter : waiters_) {
+      if (waiter->cond == cond && !waiter->woken) {
+        WakeLocked(waiter, /*timed_out=*/false);
+      }
+    }
+  }
+  cond->SignalAll();
+}
+
+void VirtualClock::BusyToken::Release() {
+  if (clock_ != nullptr) {
+    std::exchange(clock_, nullptr)->ReleaseBusy(generation_);
+  }
+}
+
+void VirtualClock::ReleaseBusy(std::uint64_t generation) {
+  absl::MutexLock lock(&mutex_);
+  if (generation != generation_ || busy_ == 0) return;
+  if (--busy_ == 0) cond_.SignalAll();
+}
+
+void VirtualClock::AddWaiterLocked(Waiter* waiter) {
+  waiter->generation = generation_;
+  // A task blocked in a wait no longer keeps its executor busy.
+  waiter->counted = running_generation == generation_;
+  if (waiter->counted) busy_--;
+  waiters_.push_back(waiter);
+  if (waiter->deadline <= now_) WakeLocked(waiter, /*timed_out=*/true);
+  cond_.SignalAll();
+}
+
+void VirtualClock::RemoveWaiterLocked(Waiter* waiter) {
+  waiters_.erase(std::find(waiters_.begin(), waiters_.end(), waiter));
+}
+
+void VirtualClock::WakeLocked(Waiter* waiter, bool timed_out) {
+  waiter->woken = true;
+  waiter->timed_out = timed_out;
+  // The task is busy again from here on, not from when its thread gets to
+  // run; otherwise time could move on in between.
+  if (waiter->counted && waiter->generation == generation_) busy_++;
+  if (waiter->cond != nullptr) waiter->cond->SignalAll();
+  cond_.SignalAll();
+}
+
+absl::Time VirtualClock::NextDeadlineLocked() const {
+  absl::Time deadline = absl::InfiniteFuture();
+  if (!timers_.empty()) deadline = timers_.begin()->first.first;
+  for (const Waiter* waiter : waiters_) {
+    if (!waiter->woken) deadline = std::min(deadline, waiter->deadline);
+  }
+  return deadline;
+}
+
+void VirtualClock::StepLocked() {
+  now_ = std::max(now_, NextDeadlineLocked());
+  for (Waiter* waiter : waiters_) {
+    if (!waiter->woken && waiter->deadline <= now_) {
+      WakeLocked(waiter, /*timed_out=*/true);
+    }
+  }
+  std::vector<Task> due;
+  while (!timers_.empty() && timers_.begin()->first.first <= now_) {
+    auto timer = timers_.begin();
+    timer_deadlines_.erase(timer->first.second);
+    due.push_back(std::move(timer->second.task));
+    timers_.erase(timer);
+  }
+  cond_.SignalAll();
+  if (due.empty()) return;
+  // Keep the clock busy until the timers have handed their tasks over to
+  // their executors.
+  std::uint64_t generation = generation_;
+  busy_++;
+  firing_thread_ = std::this_thread::get_id();
+  mutex_.Unlock();
+  for (Task& task : due) task();
+  due.clear();
+  mutex_.Lock();
+  firing_thread_ = std::thread::id();
+  if (generation_ == generation && busy_ > 0) busy_--;
+  cond_.SignalAll();
+}
+
+void VirtualClock::WaitForIdleLocked() {
+  while (started_ && busy_ > 0) cond_.Wait(&mutex_);
+}
+
+void VirtualClock::RunTicker() {
+  absl::MutexLock lock(&mutex_);
+  while (!stop_ticker_) {
+    if (advancing_ || busy_ > 0 ||
+        NextDeadlineLocked() == absl::InfiniteFuture()) {
+      cond_.Wait(&mutex_);
+      continue;
+    }
+    advancing_ = true;
+    StepLocked();
+    advancing_ = false;
+    cond_.SignalAll();
+  }
+}
+
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,194 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_VIRTUAL_CLOCK_H_
+#define PLATFORM_BASE_VIRTUAL_CLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "platform/base/task.h"
+
+namespace location {
+namespace nearby {
+
+// VirtualClock is simulated time for the test platform.
+//
+// While it is started, SystemClock, ScheduledExecutor and the timed waits of
+// the platform implementation read and wait on a virtual Now() instead of the
+// wall clock. Virtual time moves forward on AdvanceBy() and, in kAuto mode,
+// whenever every executor is idle: it then jumps straight to the next
+// deadline. A 30 s keep-alive timeout costs no wall time this way, and timers
+// due at the same instant fire in the order they were scheduled.
+//
+// An executor is idle when it has no queued tasks, and every task it runs is
+// blocked in a ConditionVariable wait, a SystemClock::Sleep() or an accept of
+// a simulated medium. A task blocked on anything else (e.g. a CountDownLatch)
+// keeps the clock from moving on its own; AdvanceBy() still moves it.
+// CountDownLatch timeouts stay in real time, so that tests can keep using them
+// as safety nets.
+//
+// Start the clock before creating the executors and mediums under test, and
+// stop it once they are gone.
+class VirtualClock final {
+ public:
+  enum class Mode {
+    // Time moves on AdvanceBy() only.
+    kManual,
+    // Time also moves whenever every executor is idle.
+    kAuto,
+  };
+
+  static VirtualClock& Instance();
+
+  VirtualClock(const VirtualClock&) = delete;
+  VirtualClock& operator=(const VirtualClock&) = delete;
+
+  // Switches the platform to virtual time. Every run starts at the same
+  // instant.
+  void Start(Mode mode = Mode::kAuto) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Switches the platform back to real time. Pending timers are dropped, and
+  // threads blocked in virtual waits wake up as if spuriously.
+  void Stop() ABSL_LOCKS_EXCLUDED(mutex_);
+  bool IsStarted() const;
+
+  // Returns virtual time, or absl::Now() while the clock is stopped.
+  absl::Time Now() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Moves time forward by |duration|, one deadline at a time. After each
+  // deadline, waits for the executors to go idle, so that the timers set by
+  // whatever just ran fire in turn if they are due before the end.
+  void AdvanceBy(absl::Duration duration) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until every executor is idle, without moving time.
+  void WaitForIdle() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // The following are hooks for the platform implementation. They fall back
+  // to real time while the clock is stopped, without taking mutex_.
+
+  // Returns |task| wrapped so that the executor it is submitted to counts as
+  // busy until it has run, or has been dropped.
+  Task Track(Task task) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Runs |task| on the clock once |delay| has passed in virtual time. Returns
+  // an id for CancelTimer(), or 0 if the clock is stopped; |task| is dropped
+  // then. |owner| is an opaque key for CancelTimers().
+  std::uint64_t AddTimer(const void* owner, absl::Duration delay, Task task)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void CancelTimer(std::uint64_t id) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Drops the timers of |owner|. Blocks while one of them is running.
+  void CancelTimers(const void* owner) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  void SleepFor(absl::Duration duration) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Waits on |cond| with |mutex| held, until Notify(cond) or |deadline|.
+  // Returns true if the wait timed out. |cond| must be signalled through
+  // Notify() for the clock to see the waiter wake up.
+  bool Wait(absl::CondVar* cond, absl::Mutex* mutex,
+            absl::Time deadline = absl::InfiniteFuture())
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) ABSL_LOCKS_EXCLUDED(mutex_);
+  void Notify(absl::CondVar* cond) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // A thread blocked in Wait() or SleepFor().
+  struct Waiter {
+    absl::CondVar* cond;  // nullptr for SleepFor().
+    absl::Time deadline;
+    std::uint64_t generation;
+    // Whether the waiter released the hold of its task on busy_.
+    bool counted = false;
+    bool woken = false;
+    bool timed_out = false;
+  };
+
+  struct Timer {
+    const void* owner;
+    Task task;
+  };
+
+  // Keeps busy_ up for a tracked task until released or destroyed.
+  class BusyToken {
+   public:
+    BusyToken(VirtualClock* clock, std::uint64_t generation)
+        : clock_(clock), generation_(generation) {}
+    BusyToken(BusyToken&& other) noexcept
+        : clock_(std::exchange(other.clock_, nullptr)),
+          generation_(other.generation_) {}
+    BusyToken& operator=(BusyToken&&) = delete;
+    ~BusyToken() { Release(); }
+
+    void Release();
+
+   private:
+    VirtualClock* clock_;
+    std::uint64_t generation_;
+  };
+
+  // Timers are ordered by deadline, then by the order they were added in.
+  using TimerKey = std::pair<absl::Time, std::uint64_t>;
+
+  VirtualClock() = default;
+  ~VirtualClock() = default;
+
+  void ReleaseBusy(std::uint64_t generation) ABSL_LOCKS_EXCLUDED(mutex_);
+  void AddWaiterLocked(Waiter* waiter) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RemoveWaiterLocked(Waiter* waiter) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void WakeLocked(Waiter* waiter, bool timed_out)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  absl::Time NextDeadlineLocked() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Moves time to the next deadline, wakes the waiters and runs the timers
+  // due then.
+  void StepLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void WaitForIdleLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RunTicker() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  mutable absl::Mutex mutex_;
+  // Signalled on every change of the state below.
+  absl::CondVar cond_;
+  // Written with mutex_ held. Read without it by the hooks, so that a stopped
+  // clock costs them no lock.
+  std::atomic<bool> started_{false};
+  Mode mode_ ABSL_GUARDED_BY(mutex_) = Mode::kAuto;
+  // Bumped on every Start() and Stop(), so that tasks and waiters of an
+  // earlier run do not count.
+  std::uint64_t generation_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Time now_ ABSL_GUARDED_BY(mutex_);
+  // Tracked tasks that are queued or running and not blocked in a wait.
+  int busy_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Whether AdvanceBy() or the ticker is moving time.
+  bool advancing_ ABSL_GUARDED_BY(mutex_) = false;
+  // The thread running due timers, if any.
+  std::thread::id firing_thread_ ABSL_GUARDED_BY(mutex_);
+  std::uint64_t next_timer_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::map<TimerKey, Timer> timers_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::uint64_t, absl::Time> timer_deadlines_
+      ABSL_GUARDED_BY(mutex_);
+  std::vector<Waiter*> waiters_ ABSL_GUARDED_BY(mutex_);
+  bool stop_ticker_ ABSL_GUARDED_BY(mutex_) = false;
+  // Moves time in kAuto mode.
+  std::thread ticker_;
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_VIRTUAL_CLOCK_H_
@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/virtual_clock.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "platform/public/condition_variable.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/mutex.h"
+#include "platform/public/mutex_lock.h"
+#include "platform/public/scheduled_executor.h"
+#include "platform/public/single_thread_executor.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+// Real time the tests may take; virtual time spans are way longer.
+constexpr absl::Duration kWallTimeout = absl::Seconds(5);
+
+class VirtualClockTest : public ::testing::Test {
+ protected:
+  void TearDown() override { VirtualClock::Instance().Stop(); }
+};
+
+TEST_F(VirtualClockTest, ManualModeMovesOnlyOnAdvanceBy) {
+  auto& clock = VirtualClock::Instance();
+  clock.Start(VirtualClock::Mode::kManual);
+  absl::Time start = SystemClock::ElapsedRealtime();
+  bool fired = false;
+  ScheduledExecutor executor;
+  executor.Schedule([&fired]() { fired = true; }, absl::Seconds(30));
+
+  clock.AdvanceBy(absl::Seconds(29));
+  EXPECT_FALSE(fired);
+  clock.AdvanceBy(absl::Seconds(1));
+  EXPECT_TRUE(fired);
+  EXPECT_EQ(SystemClock::ElapsedRealtime() - start, absl::Seconds(30));
+}
+
+TEST_F(VirtualClockTest, TimersRunInDeadlineThenScheduleOrder) {
+  auto& clock = VirtualClock::Instance();
+  clock.Start(VirtualClock::Mode::kManual);
+  std::string order;
+  ScheduledExecutor executor;
+  executor.Schedule([&order]() { order += "b"; }, absl::Seconds(2));
+  executor.Schedule([&order]() { order += "a"; }, absl::Seconds(1));
+  executor.Schedule([&order]() { order += "c"; }, absl::Seconds(2));
+  auto canceled =
+      executor.Schedule([&order]() { order += "x"; }, absl::Seconds(1));
+  EXPECT_TRUE(canceled.Cancel());
+
+  clock.AdvanceBy(absl::Seconds(2));
+  EXPECT_EQ(order, "abc");
+}
+
+TEST_F(VirtualClockTest, AutoModeSkipsIdleTime) {
+  VirtualClock::Instance().Start(VirtualClock::Mode::kAuto);
+  absl::Time start = SystemClock::ElapsedRealtime();
+  absl::Time fired_at;
+  CountDownLatch latch(1);
+  ScheduledExecutor executor;
+  executor.Schedule(
+      [&fired_at, &latch]() {
+        fired_at = SystemClock::ElapsedRealtime();
+        latch.CountDown();
+      },
+      absl::Seconds(300));
+
+  EXPECT_TRUE(latch.Await(kWallTimeout).result());
+  EXPECT_EQ(fired_at - start, absl::Seconds(300));
+}
+
+TEST_F(VirtualClockTest, TimedWaitExpiresInVirtualTime) {
+  VirtualClock::Instance().Start(VirtualClock::Mode::kAuto);
+  Mutex mutex;
+  ConditionVariable cond(&mutex);
+  absl::Duration waited;
+  CountDownLatch latch(1);
+  SingleThreadExecutor executor;
+  executor.Execute([&]() {
+    MutexLock lock(&mutex);
+    absl::Time start = SystemClock::ElapsedRealtime();
+    cond.Wait(absl::Seconds(15));
+    waited = SystemClock::ElapsedRealtime() - start;
+    latch.CountDown();
+  });
+
+  EXPECT_TRUE(latch.Await(kWallTimeout).result());
+  EXPECT_EQ(waited, absl::Seconds(15));
+}
+
+TEST_F(VirtualClockTest, NotifyWakesWaiterWithoutMovingTime) {
+  auto& clock = VirtualClock::Instance();
+  clock.Start(VirtualClock::Mode::kManual);
+  Mutex mutex;
+  ConditionVariable cond(&mutex);
+  bool notified = false;
+  absl::Duration waited;
+  CountDownLatch latch(1);
+  SingleThreadExecutor executor;
+  executor.Execute([&]() {
+    MutexLock lock(&mutex);
+    absl::Time start = SystemClock::ElapsedRealtime();
+    while (!notified) cond.Wait(absl::Seconds(30));
+    waited = SystemClock::ElapsedRealtime() - start;
+    latch.CountDown();
+  });
+
+  // The executor is idle once its task blocks in the wait.
+  clock.WaitForIdle();
+  {
+    MutexLock lock(&mutex);
+    notified = true;
+    cond.Notify();
+  }
+  EXPECT_TRUE(latch.Await(kWallTimeout).result());
+  EXPECT_EQ(waited, absl::ZeroDuration());
+}
+
+TEST_F(VirtualClockTest, SleepTakesNoWallTime) {
+  VirtualClock::Instance().Start(VirtualClock::Mode::kAuto);
+  absl::Time start = SystemClock::ElapsedRealtime();
+  absl::Time wall_start = absl::Now();
+
+  SystemClock::Sleep(absl::Hours(1));
+
+  EXPECT_EQ(SystemClock::ElapsedRealtime() - start, absl::Hours(1));
+  EXPECT_LT(absl::Now() - wall_start, kWallTimeout);
+}
+
+TEST_F(VirtualClockTest, StopRestoresRealTime) {
+  auto& clock = VirtualClock::Instance();
+  clock.Start(VirtualClock::Mode::kManual);
+  clock.AdvanceBy(absl::Hours(24));
+  clock.Stop();
+
+  EXPECT_FALSE(clock.IsStarted());
+  EXPECT_LT(absl::AbsDuration(SystemClock::ElapsedRealtime() - absl::Now()),
+            kWallTimeout);
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -23,6 +23,7 @@
 #include "platform/base/cancellation_flag_listener.h"
 #include "platform/base/logging.h"
 #include "platform/base/medium_environment.h"
+#include "platform/base/virtual_clock.h"
 #include "platform/impl/shared/count_down_latch.h"
 
 namespace location {
@@ -38,6 +39,15 @@ void BleSocket::Connect(BleSocket& other) {
   absl::MutexLock lock(&mutex_);
   remote_socket_ = &other;
   input_ = other.output_;
+  if (link_profile_.IsShaped()) {
+    output_->SetLinkProfile(link_profile_);
+    input_->SetLinkProfile(link_profile_);
+  }
+}
+
+void BleSocket::SetLinkProfile(const LinkProfile& profile) {
+  absl::MutexLock lock(&mutex_);
+  link_profile_ = profile;
 }
 
 InputStream& BleSocket::GetInputStream() {
@@ -104,7 +114,7 @@ std::unique_ptr<api::BleSocket> BleServerSocket::Accept(
   absl::MutexLock lock(&mutex_);
   if (closed_) return {};
   while (pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    VirtualClock::Instance().Wait(&cond_, &mutex_);
     if (closed_) break;
   }
   if (closed_) return {};
@@ -114,7 +124,7 @@ std::unique_ptr<api::BleSocket> BleServerSocket::Accept(
   auto local_socket = std::make_unique<BleSocket>(peripheral);
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  VirtualClock::Instance().Notify(&cond_);
   return local_socket;
 }
 
@@ -128,9 +138,9 @@ bool BleServerSocket::Connect(BleSocket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.emplace(&socket);
-  cond_.SignalAll();
+  VirtualClock::Instance().Notify(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    VirtualClock::Instance().Wait(&cond_, &mutex_);
     if (closed_) return false;
   }
   return true;
@@ -155,7 +165,7 @@ Exception BleServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    VirtualClock::Instance().Notify(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
@@ -361,6 +371,8 @@ std::unique_ptr<api::BleSocket> BleMedium::Connect(
 
   BlePeripheral peripheral = static_cast<BlePeripheral&>(remote_peripheral);
   auto socket = std::make_unique<BleSocket>(&peripheral);
+  socket->SetLinkProfile(
+      MediumEnvironment::Instance().GetLinkProfile(*this, *medium));
   // Finally, Request to connect to this socket.
   if (!remote_server_socket->Connect(*socket)) {
     NEARBY_LOGS(ERROR) << "G3 Ble Connect: Failed to connect to existing Ble "
@@ -25,6 +25,7 @@
 #include "platform/api/ble.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/input_stream.h"
+#include "platform/base/link_profile.h"
 #include "platform/base/output_stream.h"
 #include "platform/impl/g3/bluetooth_adapter.h"
 #include "platform/impl/g3/bluetooth_classic.h"
@@ -47,6 +48,10 @@ class BleSocket : public api::BleSocket {
   // from this point on, and until Close is called, connection exists.
   void Connect(BleSocket& other) ABSL_LOCKS_EXCLUDED(mutex_);
 
+  // Shapes both directions of the link this socket forms with the next
+  // Connect(). Called on the client side before connecting.
+  void SetLinkProfile(const LinkProfile& profile) ABSL_LOCKS_EXCLUDED(mutex_);
+
   // Returns the InputStream of this connected BleSocket.
   InputStream& GetInputStream() override ABSL_LOCKS_EXCLUDED(mutex_);
 
@@ -94,6 +99,7 @@ class BleSocket : public api::BleSocket {
   mutable absl::Mutex mutex_;
   BlePeripheral* peripheral_;
   BleSocket* remote_socket_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  LinkProfile link_profile_ ABSL_GUARDED_BY(mutex_);
   bool closed_ ABSL_GUARDED_BY(mutex_) = false;
 };
 
@@ -22,6 +22,7 @@
 #include "platform/base/cancellation_flag_listener.h"
 #include "platform/base/logging.h"
 #include "platform/base/medium_environment.h"
+#include "platform/base/virtual_clock.h"
 #include "platform/impl/g3/bluetooth_adapter.h"
 
 namespace location {
@@ -37,6 +38,15 @@ void BluetoothSocket::Connect(BluetoothSocket& other) {
   absl::MutexLock lock(&mutex_);
   remote_socket_ = &other;
   input_ = other.output_;
+  if (link_profile_.IsShaped()) {
+    output_->SetLinkProfile(link_profile_);
+    input_->SetLinkProfile(link_profile_);
+  }
+}
+
+void BluetoothSocket::SetLinkProfile(const LinkProfile& profile) {
+  absl::MutexLock lock(&mutex_);
+  link_profile_ = profile;
 }
 
 bool BluetoothSocket::IsConnected() const {
@@ -108,7 +118,7 @@ BluetoothDevice* BluetoothSocket::GetRemoteDevice() {
 std::unique_ptr<api::BluetoothSocket> BluetoothServerSocket::Accept() {
   absl::MutexLock lock(&mutex_);
   while (!closed_ && pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    VirtualClock::Instance().Wait(&cond_, &mutex_);
   }
   // whether or not we were running in the wait loop, return early if closed.
   if (closed_) return {};
@@ -118,7 +128,7 @@ std::unique_ptr<api::BluetoothSocket> BluetoothServerSocket::Accept() {
   auto local_socket = std::make_unique<BluetoothSocket>(adapter_);
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  VirtualClock::Instance().Notify(&cond_);
   return local_socket;
 }
 
@@ -132,9 +142,9 @@ bool BluetoothServerSocket::Connect(BluetoothSocket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.emplace(&socket);
-  cond_.SignalAll();
+  VirtualClock::Instance().Notify(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    VirtualClock::Instance().Wait(&cond_, &mutex_);
     if (closed_) return false;
   }
   return true;
@@ -159,7 +169,7 @@ Exception BluetoothServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    VirtualClock::Instance().Notify(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
@@ -240,6 +250,8 @@ std::unique_ptr<api::BluetoothSocket> BluetoothClassicMedium::ConnectToService(
   });
 
   auto socket = std::make_unique<BluetoothSocket>(&GetAdapter());
+  socket->SetLinkProfile(
+      MediumEnvironment::Instance().GetLinkProfile(*this, *medium));
   // Finally, Request to connect to this socket.
   if (!server_socket->Connect(*socket)) {
     NEARBY_LOGS(ERROR)
@@ -25,6 +25,7 @@
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
 #include "platform/base/input_stream.h"
+#include "platform/base/link_profile.h"
 #include "platform/base/listeners.h"
 #include "platform/base/output_stream.h"
 #include "platform/impl/g3/bluetooth_adapter.h"
@@ -45,6 +46,10 @@ class BluetoothSocket : public api::BluetoothSocket {
   // channel. From this point on, and until Close is called, connection exists.
   void Connect(BluetoothSocket& other);
 
+  // Shapes both directions of the link this socket forms with the next
+  // Connect(). Called on the client side before connecting.
+  void SetLinkProfile(const LinkProfile& profile) ABSL_LOCKS_EXCLUDED(mutex_);
+
   // NOTE:
   // It is an undefined behavior if GetInputStream() or GetOutputStream() is
   // called for a not-connected BluetoothSocket, i.e. any object that is not
@@ -101,6 +106,7 @@ class BluetoothSocket : public api::BluetoothSocket {
   mutable absl::Mutex mutex_;
   BluetoothAdapter* adapter_ = nullptr;  // Our Adapter. Read only.
   BluetoothSocket* remote_socket_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  LinkProfile link_profile_ ABSL_GUARDED_BY(mutex_);
   bool closed_ ABSL_GUARDED_BY(mutex_) = false;
 };
 
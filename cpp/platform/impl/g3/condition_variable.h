@@ -18,6 +18,7 @@
 #include "absl/synchronization/mutex.h"
 #include "platform/api/condition_variable.h"
 #include "platform/base/exception.h"
+#include "platform/base/virtual_clock.h"
 #include "platform/impl/g3/mutex.h"
 
 namespace location {
@@ -30,14 +31,15 @@ class ConditionVariable : public api::ConditionVariable {
   ~ConditionVariable() override = default;
 
   Exception Wait() override {
-    cond_var_.Wait(mutex_);
+    VirtualClock::Instance().Wait(&cond_var_, mutex_);
     return {Exception::kSuccess};
   }
   Exception Wait(absl::Duration timeout) override {
-    cond_var_.WaitWithTimeout(mutex_, timeout);
+    auto& clock = VirtualClock::Instance();
+    clock.Wait(&cond_var_, mutex_, clock.Now() + timeout);
     return {Exception::kSuccess};
   }
-  void Notify() override { cond_var_.SignalAll(); }
+  void Notify() override { VirtualClock::Instance().Notify(&cond_var_); }
 
  private:
   absl::Mutex* mutex_;
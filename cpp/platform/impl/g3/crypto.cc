@@ -20,6 +20,7 @@
 #include "absl/strings/string_view.h"
 #include "platform/base/byte_array.h"
 #include "openssl/digest.h"
+#include "openssl/sha.h"
 
 namespace location {
 namespace nearby {
@@ -49,5 +50,28 @@ ByteArray Crypto::Sha256(absl::string_view input) {
   return Hash(input, EVP_sha256());
 }
 
+// BoringSSL picks the SHA extensions, AVX or NEON code path at runtime.
+struct Crypto::Sha256Stream::State {
+  SHA256_CTX context;
+};
+
+Crypto::Sha256Stream::Sha256Stream() : state_(new State) {
+  SHA256_Init(&state_->context);
+}
+
+Crypto::Sha256Stream::~Sha256Stream() = default;
+
+void Crypto::Sha256Stream::Update(absl::string_view input) {
+  SHA256_Update(&state_->context, input.data(), input.size());
+}
+
+ByteArray Crypto::Sha256Stream::Finish() {
+  uint8_t digest_buffer[SHA256_DIGEST_LENGTH];
+  SHA256_Final(digest_buffer, &state_->context);
+  SHA256_Init(&state_->context);
+  return ByteArray{reinterpret_cast<char*>(digest_buffer),
+                   SHA256_DIGEST_LENGTH};
+}
+
 }  // namespace nearby
 }  // namespace location
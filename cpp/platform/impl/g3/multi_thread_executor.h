@@ -16,9 +16,12 @@
 #define PLATFORM_IMPL_G3_MULTI_THREAD_EXECUTOR_H_
 
 #include <atomic>
+#include <cstdint>
 
 #include "absl/time/clock.h"
 #include "platform/api/submittable_executor.h"
+#include "platform/base/task.h"
+#include "platform/base/virtual_clock.h"
 #include "platform/impl/shared/count_down_latch.h"
 #include "thread/threadpool.h"
 
@@ -34,27 +37,40 @@ class MultiThreadExecutor : public api::SubmittableExecutor {
       : thread_pool_(max_parallelism) {
     thread_pool_.StartWorkers();
   }
-  void Execute(Runnable&& runnable) override {
+  void Execute(Task&& runnable) override {
     if (!shutdown_) {
-      thread_pool_.Schedule(std::move(runnable));
+      thread_pool_.Schedule(
+          VirtualClock::Instance().Track(std::move(runnable)));
     }
   }
-  bool DoSubmit(Runnable&& runnable) override {
+  bool DoSubmit(Task&& runnable) override {
     if (shutdown_) return false;
-    thread_pool_.Schedule(std::move(runnable));
+    thread_pool_.Schedule(VirtualClock::Instance().Track(std::move(runnable)));
     return true;
   }
   void Shutdown() override { DoShutdown(); }
   ~MultiThreadExecutor() override { DoShutdown(); }
 
-  void ScheduleAfter(absl::Duration delay, Runnable&& runnable) {
-    if (shutdown_) return;
+  // Returns the id of the timer if the VirtualClock is started, 0 otherwise.
+  std::uint64_t ScheduleAfter(absl::Duration delay, Task&& runnable) {
+    if (shutdown_) return 0;
+    auto& clock = VirtualClock::Instance();
+    if (clock.IsStarted()) {
+      return clock.AddTimer(this, delay,
+                            [this, runnable(std::move(runnable))]() mutable {
+                              Execute(std::move(runnable));
+                            });
+    }
     thread_pool_.ScheduleAt(absl::Now() + delay, std::move(runnable));
+    return 0;
   }
   bool InShutdown() const { return shutdown_; }
 
  private:
-  void DoShutdown() { shutdown_ = true; }
+  void DoShutdown() {
+    shutdown_ = true;
+    VirtualClock::Instance().CancelTimers(this);
+  }
   std::atomic_bool shutdown_ = false;
   ThreadPool thread_pool_;
 };
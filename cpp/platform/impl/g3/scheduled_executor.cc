@@ -15,11 +15,13 @@
 #include "platform/impl/g3/scheduled_executor.h"
 
 #include <atomic>
+#include <cstdint>
 #include <memory>
 
 #include "absl/time/clock.h"
 #include "platform/api/cancelable.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
+#include "platform/base/virtual_clock.h"
 
 namespace location {
 namespace nearby {
@@ -33,11 +35,17 @@ class ScheduledCancelable : public api::Cancelable {
     Status expected = kNotRun;
     while (expected == kNotRun) {
       if (status_.compare_exchange_strong(expected, kCanceled)) {
+        CancelTimer();
         return true;
       }
     }
     return false;
   }
+  // May race with Cancel(): whichever of the two comes last drops the timer.
+  void SetTimerId(std::uint64_t timer_id) {
+    timer_id_ = timer_id;
+    if (status_ == kCanceled) CancelTimer();
+  }
   bool MarkExecuted() {
     Status expected = kNotRun;
     while (expected == kNotRun) {
@@ -54,23 +62,33 @@ class ScheduledCancelable : public api::Cancelable {
     kExecuted,
     kCanceled,
   };
+  // Drops the virtual-time timer too, lest it keeps the clock stepping to its
+  // deadline.
+  void CancelTimer() {
+    std::uint64_t timer_id = timer_id_.exchange(0);
+    if (timer_id != 0) VirtualClock::Instance().CancelTimer(timer_id);
+  }
+
   std::atomic<Status> status_ = kNotRun;
+  std::atomic<std::uint64_t> timer_id_ = 0;
 };
 
 }  // namespace
 
 std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(
-    Runnable&& runnable, absl::Duration delay) {
+    Task&& runnable, absl::Duration delay) {
   auto scheduled_cancelable = std::make_shared<ScheduledCancelable>();
   if (executor_.InShutdown()) {
     return scheduled_cancelable;
   }
-  executor_.ScheduleAfter(
-      delay, [this, scheduled_cancelable, runnable(std::move(runnable))]() {
+  std::uint64_t timer_id = executor_.ScheduleAfter(
+      delay,
+      [this, scheduled_cancelable, runnable(std::move(runnable))]() mutable {
         if (!executor_.InShutdown() && scheduled_cancelable->MarkExecuted()) {
           runnable();
         }
       });
+  scheduled_cancelable->SetTimerId(timer_id);
   return scheduled_cancelable;
 }
 
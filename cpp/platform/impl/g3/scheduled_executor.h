@@ -21,7 +21,7 @@
 #include "absl/time/clock.h"
 #include "platform/api/cancelable.h"
 #include "platform/api/scheduled_executor.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 #include "platform/impl/g3/single_thread_executor.h"
 #include "thread/threadpool.h"
 
@@ -36,10 +36,10 @@ class ScheduledExecutor final : public api::ScheduledExecutor {
   ScheduledExecutor() = default;
   ~ScheduledExecutor() override { executor_.Shutdown(); }
 
-  void Execute(Runnable&& runnable) override {
+  void Execute(Task&& runnable) override {
     executor_.Execute(std::move(runnable));
   }
-  std::shared_ptr<api::Cancelable> Schedule(Runnable&& runnable,
+  std::shared_ptr<api::Cancelable> Schedule(Task&& runnable,
                                             absl::Duration delay) override;
   void Shutdown() override { executor_.Shutdown(); }
 
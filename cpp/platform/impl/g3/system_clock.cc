@@ -16,13 +16,16 @@
 
 #include "absl/time/clock.h"
 #include "platform/base/exception.h"
+#include "platform/base/virtual_clock.h"
 
 namespace location {
 namespace nearby {
 
-absl::Time SystemClock::ElapsedRealtime() { return absl::Now(); }
+absl::Time SystemClock::ElapsedRealtime() {
+  return VirtualClock::Instance().Now();
+}
 Exception SystemClock::Sleep(absl::Duration duration) {
-  absl::SleepFor(duration);
+  VirtualClock::Instance().SleepFor(duration);
   return {Exception::kSuccess};
 }
 
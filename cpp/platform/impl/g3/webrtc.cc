@@ -17,6 +17,7 @@
 #include <memory>
 
 #include "platform/base/medium_environment.h"
+#include "platform/base/virtual_clock.h"
 #include "webrtc/api/task_queue/default_task_queue_factory.h"
 
 namespace location {
@@ -80,7 +81,7 @@ void WebRtcMedium::CreatePeerConnection(
   single_thread_executor_.Execute(
       [&env, callback = std::move(callback),
        peer_connection = std::move(peer_connection)]() {
-        absl::SleepFor(env.GetPeerConnectionLatency());
+        VirtualClock::Instance().SleepFor(env.GetPeerConnectionLatency());
         callback(peer_connection);
       });
 }
@@ -27,6 +27,7 @@
 #include "platform/base/logging.h"
 #include "platform/base/medium_environment.h"
 #include "platform/base/nsd_service_info.h"
+#include "platform/base/virtual_clock.h"
 
 namespace location {
 namespace nearby {
@@ -41,6 +42,15 @@ void WifiLanSocket::Connect(WifiLanSocket& other) {
   absl::MutexLock lock(&mutex_);
   remote_socket_ = &other;
   input_ = other.output_;
+  if (link_profile_.IsShaped()) {
+    output_->SetLinkProfile(link_profile_);
+    input_->SetLinkProfile(link_profile_);
+  }
+}
+
+void WifiLanSocket::SetLinkProfile(const LinkProfile& profile) {
+  absl::MutexLock lock(&mutex_);
+  link_profile_ = profile;
 }
 
 InputStream& WifiLanSocket::GetInputStream() {
@@ -114,7 +124,7 @@ std::string WifiLanServerSocket::GetName(const std::string& ip_address,
 std::unique_ptr<api::WifiLanSocket> WifiLanServerSocket::Accept() {
   absl::MutexLock lock(&mutex_);
   while (!closed_ && pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    VirtualClock::Instance().Wait(&cond_, &mutex_);
   }
   // whether or not we were running in the wait loop, return early if closed.
   if (closed_) return {};
@@ -125,7 +135,7 @@ std::unique_ptr<api::WifiLanSocket> WifiLanServerSocket::Accept() {
   auto local_socket = std::make_unique<WifiLanSocket>();
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  VirtualClock::Instance().Notify(&cond_);
   return local_socket;
 }
 
@@ -139,9 +149,9 @@ bool WifiLanServerSocket::Connect(WifiLanSocket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.insert(&socket);
-  cond_.SignalAll();
+  VirtualClock::Instance().Notify(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    VirtualClock::Instance().Wait(&cond_, &mutex_);
     if (closed_) return false;
   }
   return true;
@@ -166,7 +176,7 @@ Exception WifiLanServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    VirtualClock::Instance().Notify(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
@@ -335,6 +345,7 @@ std::unique_ptr<api::WifiLanSocket> WifiLanMedium::ConnectToService(
   });
 
   auto socket = std::make_unique<WifiLanSocket>();
+  socket->SetLinkProfile(env.GetLinkProfile(*this, *remote_medium));
   // Finally, Request to connect to this socket.
   if (!server_socket->Connect(*socket)) {
     NEARBY_LOGS(ERROR) << "G3 WifiLan Failed to connect to existing WifiLan "
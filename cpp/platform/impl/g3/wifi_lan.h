@@ -25,6 +25,7 @@
 #include "platform/api/wifi_lan.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/input_stream.h"
+#include "platform/base/link_profile.h"
 #include "platform/base/nsd_service_info.h"
 #include "platform/base/output_stream.h"
 #include "platform/impl/g3/multi_thread_executor.h"
@@ -45,6 +46,10 @@ class WifiLanSocket : public api::WifiLanSocket {
   // from this point on, and until Close is called, connection exists.
   void Connect(WifiLanSocket& other) ABSL_LOCKS_EXCLUDED(mutex_);
 
+  // Shapes both directions of the link this socket forms with the next
+  // Connect(). Called on the client side before connecting.
+  void SetLinkProfile(const LinkProfile& profile) ABSL_LOCKS_EXCLUDED(mutex_);
+
   // Returns the InputStream of this connected WifiLanSocket.
   InputStream& GetInputStream() override ABSL_LOCKS_EXCLUDED(mutex_);
 
@@ -87,6 +92,7 @@ class WifiLanSocket : public api::WifiLanSocket {
   std::shared_ptr<Pipe> input_;
   mutable absl::Mutex mutex_;
   WifiLanSocket* remote_socket_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  LinkProfile link_profile_ ABSL_GUARDED_BY(mutex_);
   bool closed_ ABSL_GUARDED_BY(mutex_) = false;
 };
 
@@ -96,6 +96,11 @@ std::unique_ptr<OutputFile> ImplementationPlatform::CreateOutputFile(PayloadId p
   return absl::make_unique<shared::OutputFile>(GetPayloadPath(payload_id));
 }
 
+std::unique_ptr<OutputFile> ImplementationPlatform::CreateOutputFile(PayloadId payload_id,
+                                                                     std::int64_t offset) {
+  return shared::OutputFile::Reopen(GetPayloadPath(payload_id), offset);
+}
+
 std::unique_ptr<LogMessage> ImplementationPlatform::CreateLogMessage(
     const char* file, int line, LogMessage::Severity severity) {
   return absl::make_unique<ios::LogMessage>(file, line, severity);
@@ -14,6 +14,8 @@
 
 #include "third_party/nearby/cpp/platform/api/crypto.h"
 
+#import <CommonCrypto/CommonDigest.h>
+
 #import "third_party/absl/strings/string_view.h"
 #import "third_party/nearby/cpp/platform/impl/ios/Source/Platform/utils.h"
 #import "third_party/nearby/cpp/platform/impl/ios/Source/Shared/GNCUtils.h"
@@ -35,5 +37,24 @@ ByteArray Crypto::Sha256(absl::string_view input) {
   return ByteArrayFromNSData(GNCSha256String(ObjCStringFromCppString(input)));
 }
 
+struct Crypto::Sha256Stream::State {
+  CC_SHA256_CTX context;
+};
+
+Crypto::Sha256Stream::Sha256Stream() : state_(new State) { CC_SHA256_Init(&state_->context); }
+
+Crypto::Sha256Stream::~Sha256Stream() = default;
+
+void Crypto::Sha256Stream::Update(absl::string_view input) {
+  CC_SHA256_Update(&state_->context, input.data(), static_cast<CC_LONG>(input.size()));
+}
+
+ByteArray Crypto::Sha256Stream::Finish() {
+  unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+  CC_SHA256_Final(digest, &state_->context);
+  CC_SHA256_Init(&state_->context);
+  return ByteArray(reinterpret_cast<char*>(digest), CC_SHA256_DIGEST_LENGTH);
+}
+
 }  // namespace nearby
 }  // namespace location
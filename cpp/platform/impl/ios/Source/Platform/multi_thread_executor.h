@@ -16,7 +16,7 @@
 #define PLATFORM_IMPL_IOS_MULTI_THREAD_EXECUTOR_H_
 
 #include "platform/api/submittable_executor.h"
-#import "third_party/nearby/cpp/platform/base/runnable.h"
+#import "third_party/nearby/cpp/platform/base/task.h"
 #import "third_party/nearby/cpp/platform/impl/ios/Source/Platform/scheduled_executor.h"
 
 namespace location {
@@ -33,8 +33,8 @@ class MultiThreadExecutor : public api::SubmittableExecutor {
 
   // api::SubmittableExecutor:
   void Shutdown() override;
-  void Execute(Runnable&& runnable) override;
-  bool DoSubmit(Runnable&& runnable) override;
+  void Execute(Task&& runnable) override;
+  bool DoSubmit(Task&& runnable) override;
 
  private:
   std::unique_ptr<ScheduledExecutor> scheduled_executor_;
@@ -14,7 +14,7 @@
 
 #import "third_party/nearby/cpp/platform/impl/ios/Source/Platform/multi_thread_executor.h"
 
-#include "third_party/nearby/cpp/platform/base/runnable.h"
+#include "third_party/nearby/cpp/platform/base/task.h"
 #import "third_party/nearby/cpp/platform/impl/ios/Source/Platform/scheduled_executor.h"
 
 namespace location {
@@ -27,11 +27,11 @@ MultiThreadExecutor::MultiThreadExecutor(int max_concurrency) {
 
 void MultiThreadExecutor::Shutdown() { scheduled_executor_->Shutdown(); }
 
-void MultiThreadExecutor::Execute(Runnable&& runnable) {
+void MultiThreadExecutor::Execute(Task&& runnable) {
   scheduled_executor_->Execute(std::move(runnable));
 }
 
-bool MultiThreadExecutor::DoSubmit(Runnable&& runnable) {
+bool MultiThreadExecutor::DoSubmit(Task&& runnable) {
   return scheduled_executor_->DoSubmit(std::move(runnable));
 }
 
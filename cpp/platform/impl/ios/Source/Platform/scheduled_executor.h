@@ -21,7 +21,7 @@
 #include <memory>
 
 #include "platform/api/scheduled_executor.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 
 /**
  * The impl class is an Obj-C class so that
@@ -50,10 +50,10 @@ class ScheduledExecutor : public api::ScheduledExecutor {
 
   // api::ScheduledExecutor:
   void Shutdown() override;
-  std::shared_ptr<api::Cancelable> Schedule(Runnable&& runnable, absl::Duration duration) override;
-  void Execute(Runnable&& runnable) override;
+  std::shared_ptr<api::Cancelable> Schedule(Task&& runnable, absl::Duration duration) override;
+  void Execute(Task&& runnable) override;
 
-  bool DoSubmit(Runnable&& runnable);
+  bool DoSubmit(Task&& runnable);
 
  private:
   void Shutdown(std::int64_t timeout_millis);
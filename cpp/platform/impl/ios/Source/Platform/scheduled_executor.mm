@@ -17,23 +17,24 @@
 #import <Foundation/Foundation.h>
 
 #include "third_party/absl/time/time.h"
-#include "third_party/nearby/cpp/platform/base/runnable.h"
+#include "third_party/nearby/cpp/platform/base/task.h"
 #import "third_party/nearby/cpp/platform/impl/ios/Source/Platform/atomic_boolean.h"
 
-// This wraps the C++ Runnable in an Obj-C object for memory management. It is retained by the
-// dispatch block below, and deleted when the block is released.
+// This wraps the C++ Task in an Obj-C object for memory management. It is retained by the
+// dispatch blocks below, and deleted when the block is released. Blocks copy the C++ objects they
+// capture, which a Task can not be.
 @interface GNCRunnableWrapper : NSObject {
  @public
-  location::nearby::Runnable _runnable;
+  location::nearby::Task _runnable;
   std::unique_ptr<location::nearby::ios::AtomicBoolean> _canceled;
 }
 @end
 
 @implementation GNCRunnableWrapper
 
-+ (instancetype)wrapperWithRunnable:(location::nearby::Runnable)runnable {
++ (instancetype)wrapperWithRunnable:(location::nearby::Task &&)runnable {
   GNCRunnableWrapper *wrapper = [[GNCRunnableWrapper alloc] init];
-  wrapper->_runnable = runnable;
+  wrapper->_runnable = std::move(runnable);
   wrapper->_canceled = std::make_unique<location::nearby::ios::AtomicBoolean>(false);
   return wrapper;
 }
@@ -86,7 +87,7 @@ ScheduledExecutor::~ScheduledExecutor() { impl_ = nil; }
 
 void ScheduledExecutor::Shutdown() { Shutdown(kExecutorShutdownDefaultTimeout); }
 
-std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(Runnable &&runnable,
+std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(Task &&runnable,
                                                              absl::Duration duration) {
   if (impl_.shuttingDown) return std::shared_ptr<api::Cancelable>(nullptr);
 
@@ -110,19 +111,19 @@ std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(Runnable &&runnable
   return std::shared_ptr<api::Cancelable>(cancelable);
 }
 
-void ScheduledExecutor::Execute(Runnable &&runnable) {
+void ScheduledExecutor::Execute(Task &&runnable) {
   DoSubmit(std::move(runnable));
 }
 
-bool ScheduledExecutor::DoSubmit(Runnable &&runnable) {
+bool ScheduledExecutor::DoSubmit(Task &&runnable) {
   if (impl_.shuttingDown) {
     return false;
   }
 
   // Submit the runnable to the queue.
-  Runnable local_runnable = std::move(runnable);
+  GNCRunnableWrapper *wrapper = [GNCRunnableWrapper wrapperWithRunnable:std::move(runnable)];
   [impl_.queue addOperationWithBlock:^{
-    local_runnable();
+    wrapper->_runnable();
   }];
   return true;
 }
@@ -14,9 +14,18 @@
 
 #include "platform/impl/shared/file.h"
 
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <cstddef>
 #include <memory>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "platform/base/exception.h"
 
@@ -63,7 +72,27 @@ Exception InputFile::Close() {
 // OutputFile
 
 OutputFile::OutputFile(absl::string_view path)
-    : file_(std::string(path), std::ios::binary) {}
+    : file_(std::string(path), std::ios::binary), path_(path) {}
+
+OutputFile::OutputFile(absl::string_view path, std::int64_t offset)
+    : file_(std::string(path),
+            std::ios::binary | std::ios::in | std::ios::out),
+      path_(path) {
+  if (file_.is_open()) {
+    file_.seekp(offset);
+  }
+}
+
+std::unique_ptr<OutputFile> OutputFile::Reopen(absl::string_view path,
+                                               std::int64_t offset) {
+  std::ifstream existing(std::string(path),
+                         std::ios::binary | std::ios::ate);
+  if (!existing.is_open() || existing.tellg() < offset) {
+    return nullptr;
+  }
+  existing.close();
+  return absl::make_unique<OutputFile>(path, offset);
+}
 
 Exception OutputFile::Write(const ByteArray& data) {
   if (!file_.is_open()) {
@@ -84,6 +113,36 @@ Exception OutputFile::Flush() {
   return {file_.good() ? Exception::kSuccess : Exception::kIo};
 }
 
+Exception OutputFile::Sync() {
+  if (!file_.is_open()) {
+    return {Exception::kIo};
+  }
+
+  file_.flush();
+  if (!file_.good()) {
+    return {Exception::kIo};
+  }
+
+  // std::ofstream has no handle to sync; syncing another descriptor of the
+  // same file writes out all of its cached data.
+#if defined(_WIN32)
+  int fd = _open(path_.c_str(), _O_WRONLY | _O_BINARY);
+  if (fd < 0) {
+    return {Exception::kIo};
+  }
+  bool synced = _commit(fd) == 0;
+  _close(fd);
+#else
+  int fd = open(path_.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return {Exception::kIo};
+  }
+  bool synced = fsync(fd) == 0;
+  close(fd);
+#endif
+  return {synced ? Exception::kSuccess : Exception::kIo};
+}
+
 Exception OutputFile::Close() {
   if (file_.is_open()) {
     file_.close();
@@ -17,6 +17,8 @@
 
 #include <cstdint>
 #include <fstream>
+#include <memory>
+#include <string>
 
 #include "absl/strings/string_view.h"
 #include "platform/api/input_file.h"
@@ -48,16 +50,25 @@ class InputFile final : public api::InputFile {
 class OutputFile final : public api::OutputFile {
  public:
   explicit OutputFile(absl::string_view path);
+  // Opens an existing file for writing at |offset|, keeping the bytes before
+  // it.
+  OutputFile(absl::string_view path, std::int64_t offset);
+  // Same, but returns nullptr if the file doesn't exist or is shorter than
+  // |offset|.
+  static std::unique_ptr<OutputFile> Reopen(absl::string_view path,
+                                            std::int64_t offset);
   ~OutputFile() override = default;
   OutputFile(OutputFile&&) = default;
   OutputFile& operator=(OutputFile&&) = default;
 
   Exception Write(const ByteArray& data) override;
   Exception Flush() override;
+  Exception Sync() override;
   Exception Close() override;
 
  private:
   std::ofstream file_;
+  std::string path_;
 };
 
 }  // namespace shared
@@ -136,6 +136,56 @@ TEST_F(FileTest, OutputFile_Write) {
   AssertEquals(input_file.Read(kMaxSize), "abc");
 }
 
+TEST_F(FileTest, OutputFile_WriteAtOffsetKeepsPrefix) {
+  WriteToFile("abc");
+  OutputFile output_file(path_, 2);
+  EXPECT_EQ(output_file.Write(ByteArray("de")),
+            Exception{Exception::kSuccess});
+  output_file.Close();
+  InputFile input_file(path_, 4);
+  AssertEquals(input_file.Read(4), "abde");
+}
+
+TEST_F(FileTest, OutputFile_WriteAtOffsetNonExistentPath) {
+  OutputFile output_file("/not/a/valid/path.txt", 2);
+  ByteArray bytes("a", 1);
+  EXPECT_TRUE(output_file.Write(bytes).Raised(Exception::kIo));
+}
+
+TEST_F(FileTest, OutputFile_ReopenKeepsPrefix) {
+  WriteToFile("abc");
+  std::unique_ptr<OutputFile> output_file = OutputFile::Reopen(path_, 3);
+  ASSERT_NE(output_file, nullptr);
+  EXPECT_EQ(output_file->Write(ByteArray("d")),
+            Exception{Exception::kSuccess});
+  output_file->Close();
+  InputFile input_file(path_, 4);
+  AssertEquals(input_file.Read(4), "abcd");
+}
+
+TEST_F(FileTest, OutputFile_ReopenShorterFile) {
+  WriteToFile("abc");
+  EXPECT_EQ(OutputFile::Reopen(path_, 4), nullptr);
+}
+
+TEST_F(FileTest, OutputFile_ReopenNonExistentPath) {
+  EXPECT_EQ(OutputFile::Reopen("/not/a/valid/path.txt", 2), nullptr);
+}
+
+TEST_F(FileTest, OutputFile_Sync) {
+  OutputFile output_file(path_);
+  EXPECT_EQ(output_file.Write(ByteArray("abc")),
+            Exception{Exception::kSuccess});
+  EXPECT_EQ(output_file.Sync(), Exception{Exception::kSuccess});
+  InputFile input_file(path_, GetSize());
+  AssertEquals(input_file.Read(kMaxSize), "abc");
+}
+
+TEST_F(FileTest, OutputFile_SyncNonExistentPath) {
+  OutputFile output_file("/not/a/valid/path.txt");
+  EXPECT_TRUE(output_file.Sync().Raised(Exception::kIo));
+}
+
 TEST_F(FileTest, OutputFile_Close) {
   OutputFile output_file(path_);
   output_file.Close();
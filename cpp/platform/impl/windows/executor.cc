@@ -54,19 +54,20 @@ bool Executor::InitializeThreadPool() {
 }
 
 // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-void Executor::Execute(Runnable&& runnable) {
+void Executor::Execute(Task&& runnable) {
   if (shut_down_) {
     NEARBY_LOGS(VERBOSE) << "Warning: " << __func__
                        << ": Attempt to execute on a shut down pool.";
     return;
   }
 
-  if (runnable == nullptr) {
+  if (!runnable) {
     NEARBY_LOGS(VERBOSE) << "Error: " << __func__ << "Runnable was null.";
     return;
   }
 
-  std::unique_ptr<Runner> runner = std::make_unique<Runner>(runnable);
+  std::unique_ptr<Runner> runner =
+      std::make_unique<Runner>(std::move(runnable));
   thread_pool_->Run(std::move(runner));
 }
 
@@ -39,7 +39,7 @@ class Executor : public api::Executor {
   // jobs to finish.
   ~Executor() override {}
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-  void Execute(Runnable&& runnable) override;
+  void Execute(Task&& runnable) override;
 
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/ExecutorService.html#shutdown--
   void Shutdown() override;
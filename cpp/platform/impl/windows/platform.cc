@@ -86,6 +86,11 @@ std::unique_ptr<OutputFile> ImplementationPlatform::CreateOutputFile(
   return absl::make_unique<shared::OutputFile>(GetPayloadPath(payload_id));
 }
 
+std::unique_ptr<OutputFile> ImplementationPlatform::CreateOutputFile(
+    PayloadId payload_id, std::int64_t offset) {
+  return shared::OutputFile::Reopen(GetPayloadPath(payload_id), offset);
+}
+
 // TODO(b/184975123): replace with real implementation.
 std::unique_ptr<LogMessage> ImplementationPlatform::CreateLogMessage(
     const char* file, int line, LogMessage::Severity severity) {
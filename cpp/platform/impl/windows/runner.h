@@ -15,7 +15,9 @@
 #ifndef PLATFORM_IMPL_WINDOWS_RUNNER_H_
 #define PLATFORM_IMPL_WINDOWS_RUNNER_H_
 
-#include "platform/base/runnable.h"
+#include <utility>
+
+#include "platform/base/task.h"
 
 namespace location {
 namespace nearby {
@@ -25,14 +27,14 @@ class ThreadPool;
 
 class Runner {
  public:
-  Runner(std::function<void()> runnable)
-      : thread_pool_(nullptr), runnable_(runnable) {}
+  Runner(Task&& runnable)
+      : thread_pool_(nullptr), runnable_(std::move(runnable)) {}
   void Run() { runnable_(); }
   ~Runner(){}
   ThreadPool* thread_pool_;
 
  private:
-  std::function<void()> runnable_;
+  Task runnable_;
 };
 
 }  // namespace windows
@@ -35,18 +35,18 @@ class ScheduledExecutorException : public std::runtime_error {
 class TimerData {
  public:
   TimerData(ScheduledExecutor* scheduledExecutor,
-            std::function<void()> runnable, HANDLE waitableTimer)
+            Task&& runnable, HANDLE waitableTimer)
       : scheduled_executor_(scheduledExecutor),
         runnable_(std::move(runnable)),
         waitable_timer_handle_(waitableTimer) {}
 
   ScheduledExecutor* GetScheduledExecutor() { return scheduled_executor_; }
-  std::function<void()> GetRunnable() { return runnable_; }
+  Task TakeRunnable() { return std::move(runnable_); }
   HANDLE GetWaitableTimerHandle() { return waitable_timer_handle_; }
 
  private:
   ScheduledExecutor* scheduled_executor_;
-  std::function<void()> runnable_;
+  Task runnable_;
   HANDLE waitable_timer_handle_;
 };
 
@@ -66,11 +66,11 @@ void WINAPI ScheduledExecutor::_TimerProc(LPVOID argToCompletionRoutine,
   }
 
   timerData = static_cast<TimerData*>(argToCompletionRoutine);
-  timerData->GetScheduledExecutor()->Execute(timerData->GetRunnable());
+  timerData->GetScheduledExecutor()->Execute(timerData->TakeRunnable());
 
   // Get the waitable timer and destroy it
   CloseHandle(timerData->GetWaitableTimerHandle());
-  free(timerData);
+  delete timerData;
   return;
 }
 
@@ -83,7 +83,7 @@ ScheduledExecutor::ScheduledExecutor()
 // Exclusive ownership model does not work for this case;
 // using std:shared_ptr<> instead of std::unique_ptr<>.
 std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(
-    Runnable&& runnable, absl::Duration duration) {
+    Task&& runnable, absl::Duration duration) {
   if (shut_down_) {
     NEARBY_LOGS(ERROR)
         << __func__
@@ -111,7 +111,8 @@ std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(
   LARGE_INTEGER dueTime;
   dueTime.QuadPart = -(absl::ToChronoNanoseconds(duration).count() / 100);
 
-  TimerData* timerData = new TimerData(this, runnable, waitableTimer);
+  TimerData* timerData =
+      new TimerData(this, std::move(runnable), waitableTimer);
 
   BOOL result = SetWaitableTimer(waitableTimer, &dueTime, 0, _TimerProc,
                                  timerData, false);
@@ -125,7 +126,7 @@ std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(
 }
 
 // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-void ScheduledExecutor::Execute(Runnable&& runnable) {
+void ScheduledExecutor::Execute(Task&& runnable) {
   if (shut_down_) {
     NEARBY_LOGS(ERROR) << __func__
                        << ": Attempt to Execute on a shut down executor.";
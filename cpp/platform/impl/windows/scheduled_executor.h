@@ -40,11 +40,11 @@ class ScheduledExecutor : public api::ScheduledExecutor {
   // We want Cancelable to live until both caller and executor are done with it.
   // Exclusive ownership model does not work for this case;
   // using std:shared_ptr<> instead if std::unique_ptr<>.
-  std::shared_ptr<api::Cancelable> Schedule(Runnable&& runnable,
+  std::shared_ptr<api::Cancelable> Schedule(Task&& runnable,
                                             absl::Duration duration) override;
 
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-  void Execute(Runnable&& runnable) override;
+  void Execute(Task&& runnable) override;
 
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/ExecutorService.html#shutdown--
   void Shutdown() override;
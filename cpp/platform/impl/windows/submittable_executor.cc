@@ -28,7 +28,7 @@ SubmittableExecutor::SubmittableExecutor(int32_t max_concurrancy)
     : executor_(std::make_unique<nearby::windows::Executor>(max_concurrancy)),
       shut_down_(false) {}
 
-bool SubmittableExecutor::DoSubmit(Runnable&& wrapped_callable) {
+bool SubmittableExecutor::DoSubmit(Task&& wrapped_callable) {
   if (!shut_down_) {
     executor_->Execute(std::move(wrapped_callable));
     return true;
@@ -41,7 +41,7 @@ bool SubmittableExecutor::DoSubmit(Runnable&& wrapped_callable) {
 }
 
 // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-void SubmittableExecutor::Execute(Runnable&& runnable) {
+void SubmittableExecutor::Execute(Task&& runnable) {
   if (!shut_down_) {
     executor_->Execute(std::move(runnable));
   } else {
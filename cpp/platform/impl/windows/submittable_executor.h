@@ -35,10 +35,10 @@ class SubmittableExecutor : public api::SubmittableExecutor {
   // Submit a callable (with no delay).
   // Returns true, if callable was submitted, false otherwise.
   // Callable is not submitted if shutdown is in progress.
-  bool DoSubmit(Runnable&& wrapped_callable) override;
+  bool DoSubmit(Task&& wrapped_callable) override;
 
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/Executor.html#execute-java.lang.Runnable-
-  void Execute(Runnable&& runnable) override;
+  void Execute(Task&& runnable) override;
 
   // https://docs.oracle.com/javase/8/docs/api/java/util/concurrent/ExecutorService.html#shutdown--
   void Shutdown() override;
@@ -15,6 +15,7 @@
 #ifndef PLATFORM_PUBLIC_ATOMIC_BOOLEAN_H_
 #define PLATFORM_PUBLIC_ATOMIC_BOOLEAN_H_
 
+#include <atomic>
 #include <memory>
 
 #include "platform/api/atomic_boolean.h"
@@ -23,6 +24,8 @@
 namespace location {
 namespace nearby {
 
+#ifdef NEARBY_USE_PLATFORM_ATOMICS
+
 // A boolean value that may be updated atomically.
 // See documentation in
 // cpp/platform/api/atomic_boolean.h
@@ -44,6 +47,38 @@ class AtomicBoolean final : public api::AtomicBoolean {
   std::unique_ptr<api::AtomicBoolean> impl_;
 };
 
+#else
+
+// A boolean value that may be updated atomically.
+// See documentation in
+// cpp/platform/api/atomic_boolean.h
+//
+// Kept inline in a std::atomic<bool>, so Get() and Set() compile down to
+// single instructions. Platforms that can not rely on std::atomic define
+// NEARBY_USE_PLATFORM_ATOMICS to go through
+// ImplementationPlatform::CreateAtomicBoolean() instead.
+class AtomicBoolean final {
+ public:
+  explicit AtomicBoolean(bool value = false) : value_(value) {}
+  ~AtomicBoolean() = default;
+  AtomicBoolean(AtomicBoolean&& other) : value_(other.Get()) {}
+  AtomicBoolean& operator=(AtomicBoolean&& other) {
+    Set(other.Get());
+    return *this;
+  }
+
+  bool Get() const { return value_.load(); }
+  // Returns the previous value.
+  bool Set(bool value) { return value_.exchange(value); }
+
+  explicit operator bool() const { return Get(); }
+
+ private:
+  std::atomic<bool> value_;
+};
+
+#endif  // NEARBY_USE_PLATFORM_ATOMICS
+
 }  // namespace nearby
 }  // namespace location
 
@@ -15,8 +15,12 @@
 #ifndef PLATFORM_PUBLIC_ATOMIC_REFERENCE_H_
 #define PLATFORM_PUBLIC_ATOMIC_REFERENCE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 #include "platform/api/atomic_reference.h"
 #include "platform/api/platform.h"
@@ -26,14 +30,57 @@
 namespace location {
 namespace nearby {
 
+namespace atomic_reference_internal {
+
+// How an AtomicReference<T> keeps its value.
+enum class Storage {
+  // In an api::AtomicUint32 from ImplementationPlatform.
+  kPlatform,
+  // Inline, in a std::atomic<T>.
+  kAtomic,
+  // Inline, behind a sequence lock.
+  kSeqLock,
+  // Behind a Mutex.
+  kMutex,
+};
+
+template <typename T>
+constexpr Storage GetStorage() {
+#ifdef NEARBY_USE_PLATFORM_ATOMICS
+  return sizeof(T) <= sizeof(std::uint32_t) &&
+                 std::is_trivially_copyable<T>::value
+             ? Storage::kPlatform
+             : Storage::kMutex;
+#else
+  // Sizes the CPU can load and store in one go; other sizes would make
+  // std::atomic<T> take a lock, or need libatomic.
+  return !std::is_trivially_copyable<T>::value ||
+                 !std::is_default_constructible<T>::value
+             ? Storage::kMutex
+         : sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+                 sizeof(T) == 8
+             ? Storage::kAtomic
+             : Storage::kSeqLock;
+#endif
+}
+
+}  // namespace atomic_reference_internal
+
 // An object reference that may be updated atomically.
-template <typename, typename = void>
+//
+// Small trivially copyable values are kept in a std::atomic<T>, larger ones
+// behind a sequence lock, so readers on hot paths never take a lock or make a
+// virtual call. Other values are guarded by a Mutex. Platforms that can not
+// rely on std::atomic define NEARBY_USE_PLATFORM_ATOMICS to keep values of up
+// to 32 bits in an api::AtomicUint32, and the rest behind a Mutex.
+template <typename T, typename = void>
 class AtomicReference;
 
 // Platform-based atomic type, for something convertible to std::uint32_t.
 template <typename T>
-class AtomicReference<T, std::enable_if_t<sizeof(T) <= sizeof(std::uint32_t) &&
-                                          std::is_trivially_copyable<T>::value>>
+class AtomicReference<
+    T, std::enable_if_t<atomic_reference_internal::GetStorage<T>() ==
+                        atomic_reference_internal::Storage::kPlatform>>
     final {
  public:
   using Platform = api::ImplementationPlatform;
@@ -51,12 +98,95 @@ class AtomicReference<T, std::enable_if_t<sizeof(T) <= sizeof(std::uint32_t) &&
   std::unique_ptr<api::AtomicUint32> impl_;
 };
 
+// Atomic type for trivially copyable values the CPU can access atomically.
+template <typename T>
+class AtomicReference<
+    T, std::enable_if_t<atomic_reference_internal::GetStorage<T>() ==
+                        atomic_reference_internal::Storage::kAtomic>>
+    final {
+ public:
+  explicit AtomicReference(T value) : value_(value) {}
+  ~AtomicReference() = default;
+  AtomicReference(AtomicReference&& other) : value_(other.Get()) {}
+  AtomicReference& operator=(AtomicReference&& other) {
+    Set(other.Get());
+    return *this;
+  }
+
+  T Get() const { return value_.load(); }
+  void Set(T value) { value_.store(value); }
+
+ private:
+  std::atomic<T> value_;
+};
+
+// Atomic type for larger trivially copyable values.
+//
+// Readers copy the value out word by word, and retry if a writer got in the
+// way, which the sequence number tells: it is odd while a write is in
+// progress, and changes with every write. Readers never block writers, and
+// writers only wait for each other.
+template <typename T>
+class AtomicReference<
+    T, std::enable_if_t<atomic_reference_internal::GetStorage<T>() ==
+                        atomic_reference_internal::Storage::kSeqLock>>
+    final {
+ public:
+  explicit AtomicReference(T value) { Set(value); }
+  ~AtomicReference() = default;
+  AtomicReference(AtomicReference&& other) { Set(other.Get()); }
+  AtomicReference& operator=(AtomicReference&& other) {
+    Set(other.Get());
+    return *this;
+  }
+
+  T Get() const {
+    Words words;
+    std::uint32_t sequence;
+    do {
+      sequence = sequence_.load(std::memory_order_acquire);
+      for (std::size_t i = 0; i < kWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) != 0 ||
+             sequence != sequence_.load(std::memory_order_relaxed));
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  void Set(T value) {
+    Words words{};
+    std::memcpy(words, &value, sizeof(T));
+    std::uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    while ((sequence & 1) != 0 ||
+           !sequence_.compare_exchange_weak(sequence, sequence + 1,
+                                            std::memory_order_acquire)) {
+      sequence = sequence_.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+ private:
+  static constexpr std::size_t kWords =
+      (sizeof(T) + sizeof(std::uintptr_t) - 1) / sizeof(std::uintptr_t);
+  using Words = std::uintptr_t[kWords];
+
+  std::atomic<std::uint32_t> sequence_{0};
+  std::atomic<std::uintptr_t> words_[kWords] = {};
+};
+
 // Atomic type that is using Platform mutex to provide atomicity.
 // Supports any copyable type.
 template <typename T>
-class AtomicReference<T,
-                      std::enable_if_t<(sizeof(T) > sizeof(std::uint32_t) ||
-                                        !std::is_trivially_copyable<T>::value)>>
+class AtomicReference<
+    T, std::enable_if_t<atomic_reference_internal::GetStorage<T>() ==
+                        atomic_reference_internal::Storage::kMutex>>
     final {
  public:
   explicit AtomicReference(T value) {
@@ -14,6 +14,12 @@
 
 #include "platform/public/atomic_reference.h"
 
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace location {
@@ -42,6 +48,11 @@ bool operator!=(const BigSizedStruct& a, const BigSizedStruct& b) {
   return !(a == b);
 }
 
+struct Position {
+  std::int32_t x = 0;
+  std::int32_t y = 0;
+};
+
 }  // namespace
 
 TEST(AtomicReferenceTest, SupportIntegralTypes) {
@@ -78,6 +89,53 @@ TEST(AtomicReferenceTest, SetTakesCopyOfValue) {
   EXPECT_EQ(v2, v1);
 }
 
+TEST(AtomicReferenceTest, SupportSmallStructs) {
+  AtomicReference<Position> atomic_ref({});
+  atomic_ref.Set({3, 4});
+  Position position = atomic_ref.Get();
+  EXPECT_EQ(position.x, 3);
+  EXPECT_EQ(position.y, 4);
+}
+
+TEST(AtomicReferenceTest, ReadersNeverSeeHalfWrittenStructs) {
+  BigSizedStruct ones;
+  BigSizedStruct twos;
+  for (int i = 0; i < 100; ++i) {
+    ones.data[i] = 1;
+    twos.data[i] = 2;
+  }
+  AtomicReference<BigSizedStruct> atomic_ref(ones);
+  std::atomic<bool> done{false};
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 2; ++i) {
+    writers.emplace_back([&]() {
+      while (!done) {
+        atomic_ref.Set(twos);
+        atomic_ref.Set(ones);
+      }
+    });
+  }
+  for (int i = 0; i < 100000; ++i) {
+    BigSizedStruct value = atomic_ref.Get();
+    ASSERT_TRUE(value == ones || value == twos);
+  }
+  done = true;
+  for (auto& writer : writers) writer.join();
+}
+
+TEST(AtomicReferenceTest, CanBeMoved) {
+  AtomicReference<BigSizedStruct> big_ref({});
+  BigSizedStruct value;
+  value.data[99] = 7;
+  big_ref.Set(value);
+  AtomicReference<BigSizedStruct> other_big_ref(std::move(big_ref));
+  EXPECT_EQ(other_big_ref.Get(), value);
+
+  AtomicReference<int> int_ref(5);
+  AtomicReference<int> other_int_ref(std::move(int_ref));
+  EXPECT_EQ(other_int_ref.Get(), 5);
+}
+
 TEST(AtomicReferenceTest, SupportObjects) {
   std::string s{"test"};
   AtomicReference<std::string> atomic_ref({});
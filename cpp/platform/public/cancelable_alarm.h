@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 
+#include "platform/base/task.h"
 #include "platform/public/cancelable.h"
 #include "platform/public/mutex.h"
 #include "platform/public/mutex_lock.h"
@@ -36,7 +37,7 @@ namespace nearby {
 class CancelableAlarm {
  public:
   CancelableAlarm() = default;
-  CancelableAlarm(absl::string_view name, std::function<void()>&& runnable,
+  CancelableAlarm(absl::string_view name, Task&& runnable,
                   absl::Duration delay, ScheduledExecutor* scheduled_executor)
       : name_(name),
         cancelable_(scheduled_executor->Schedule(std::move(runnable), delay)) {}
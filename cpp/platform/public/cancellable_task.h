@@ -18,7 +18,7 @@
 #include <utility>
 
 #include "platform/base/feature_flags.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 #include "platform/public/atomic_boolean.h"
 #include "platform/public/future.h"
 
@@ -31,7 +31,7 @@ namespace nearby {
  */
 class CancellableTask {
  public:
-  explicit CancellableTask(Runnable&& runnable)
+  explicit CancellableTask(Task&& runnable)
       : runnable_{std::move(runnable)} {}
 
   /**
@@ -61,7 +61,7 @@ class CancellableTask {
  private:
   AtomicBoolean started_or_cancelled_;
   Future<bool> finished_;
-  Runnable runnable_;
+  Task runnable_;
 };
 
 }  // namespace nearby
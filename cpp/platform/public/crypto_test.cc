@@ -44,5 +44,25 @@ TEST(CryptoTest, Sha256ReturnsEmptyOnError) {
   EXPECT_EQ(Crypto::Sha256(""), ByteArray{});
 }
 
+TEST(CryptoTest, Sha256StreamMatchesSha256) {
+  Crypto::Sha256Stream stream;
+
+  stream.Update("str");
+  stream.Update("");
+  stream.Update("ing");
+
+  EXPECT_EQ(stream.Finish(), Crypto::Sha256("string"));
+}
+
+TEST(CryptoTest, Sha256StreamStartsOverAfterFinish) {
+  Crypto::Sha256Stream stream;
+  stream.Update("other");
+  stream.Finish();
+
+  stream.Update("string");
+
+  EXPECT_EQ(stream.Finish(), Crypto::Sha256("string"));
+}
+
 }  // namespace nearby
 }  // namespace location
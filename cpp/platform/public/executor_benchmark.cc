@@ -0,0 +1,127 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "platform/base/runnable.h"
+#include "platform/base/task.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/single_thread_executor.h"
+
+// Counts heap allocations, to report them per posted task.
+namespace {
+std::atomic<std::int64_t> allocations{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace location {
+namespace nearby {
+namespace {
+
+// A closure about the size of the status updates PayloadManager posts.
+struct Closure {
+  void* owner;
+  std::shared_ptr<int> state;
+  std::int64_t payload_id;
+  std::int64_t offset;
+  std::int64_t total_size;
+
+  void operator()() const { benchmark::DoNotOptimize(payload_id + offset); }
+};
+
+Closure MakeClosure(const std::shared_ptr<int>& state) {
+  return Closure{nullptr, state, 1, 2, 3};
+}
+
+// The path a task took through SubmittableExecutor::Execute() while
+// executors took Runnables: each wrapper copied the Runnable it was given,
+// and got wrapped in a Runnable of its own.
+struct CopyingWrapper {
+  void operator()() const { runnable(); }
+  Runnable runnable;
+};
+
+void BM_PostRunnable(benchmark::State& state) {
+  auto shared_state = std::make_shared<int>(0);
+  std::int64_t start = allocations.load();
+  for (auto _ : state) {
+    Runnable runnable = MakeClosure(shared_state);
+    Runnable checked = CopyingWrapper{runnable};
+    Runnable monitored = CopyingWrapper{checked};
+    monitored();
+  }
+  state.counters["allocs_per_post"] = benchmark::Counter(
+      allocations.load() - start, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PostRunnable);
+
+struct MovingWrapper {
+  void operator()() { task(); }
+  Task task;
+};
+
+void BM_PostTask(benchmark::State& state) {
+  auto shared_state = std::make_shared<int>(0);
+  std::int64_t start = allocations.load();
+  for (auto _ : state) {
+    Task task = MakeClosure(shared_state);
+    Task monitored = MovingWrapper{std::move(task)};
+    monitored();
+  }
+  state.counters["allocs_per_post"] = benchmark::Counter(
+      allocations.load() - start, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PostTask);
+
+// End to end: posts a batch of tasks to a SingleThreadExecutor and waits for
+// them to run.
+void BM_SingleThreadExecutorExecute(benchmark::State& state) {
+  constexpr int kBatchSize = 1000;
+  SingleThreadExecutor executor;
+  auto shared_state = std::make_shared<int>(0);
+  std::int64_t start = allocations.load();
+  for (auto _ : state) {
+    CountDownLatch latch(kBatchSize);
+    for (int i = 0; i < kBatchSize; ++i) {
+      executor.Execute("benchmark", [closure = MakeClosure(shared_state),
+                                     &latch]() {
+        closure();
+        latch.CountDown();
+      });
+    }
+    latch.Await();
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+  state.counters["allocs_per_post"] = benchmark::Counter(
+      static_cast<double>(allocations.load() - start) / kBatchSize,
+      benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SingleThreadExecutorExecute);
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,429 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/public/executor_service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "platform/api/platform.h"
+#include "platform/base/feature_flags.h"
+#include "platform/public/metrics.h"
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+
+namespace {
+
+// The queue whose task the current thread is running, if any.
+thread_local const void* current_queue = nullptr;
+
+Gauge* GetThreadsGauge() {
+  static Gauge* gauge = MetricsRegistry::GetInstance().GetGauge(
+      "nearby_executor_service_threads",
+      "Worker threads of the shared executor service.");
+  return gauge;
+}
+
+// Lets a delayed task be canceled until it starts running on its queue.
+class ScheduledCancelable : public api::Cancelable {
+ public:
+  bool Cancel() override {
+    Status expected = kNotRun;
+    return status_.compare_exchange_strong(expected, kCanceled);
+  }
+  bool MarkExecuted() {
+    Status expected = kNotRun;
+    return status_.compare_exchange_strong(expected, kExecuted);
+  }
+
+ private:
+  enum Status {
+    kNotRun,
+    kExecuted,
+    kCanceled,
+  };
+  std::atomic<Status> status_{kNotRun};
+};
+
+}  // namespace
+
+struct ExecutorService::Queue {
+  Queue(const std::string& name, int max_concurrency, TaskType type)
+      : name(name), max_concurrency(max_concurrency), type(type) {}
+
+  const std::string name;
+  const int max_concurrency;
+  const TaskType type;
+  std::deque<Task> tasks;
+  // Tasks being run by workers, and entries of the queue on a ready list.
+  int running = 0;
+  int activations = 0;
+  bool shutdown = false;
+};
+
+struct ExecutorService::Worker {
+  std::unique_ptr<api::SubmittableExecutor> thread;
+  int tid = 0;
+  std::shared_ptr<Queue> queue;
+  absl::Time since;
+};
+
+class ExecutorService::QueueExecutor : public api::SubmittableExecutor {
+ public:
+  QueueExecutor(ExecutorService* service, std::shared_ptr<Queue> queue)
+      : service_(service), queue_(std::move(queue)) {}
+  ~QueueExecutor() override { service_->DrainQueue(*queue_); }
+
+  void Execute(Task&& runnable) override {
+    service_->Post(queue_, std::move(runnable));
+  }
+  bool DoSubmit(Task&& runnable) override {
+    return service_->Post(queue_, std::move(runnable));
+  }
+  void Shutdown() override { service_->ShutdownQueue(*queue_); }
+
+ private:
+  ExecutorService* service_;
+  std::shared_ptr<Queue> queue_;
+};
+
+class ExecutorService::ScheduledQueueExecutor : public api::ScheduledExecutor {
+ public:
+  ScheduledQueueExecutor(ExecutorService* service,
+                         std::shared_ptr<Queue> queue)
+      : service_(service), queue_(std::move(queue)) {}
+  ~ScheduledQueueExecutor() override { service_->DrainQueue(*queue_); }
+
+  void Execute(Task&& runnable) override {
+    service_->Post(queue_, std::move(runnable));
+  }
+  void Shutdown() override { service_->ShutdownQueue(*queue_); }
+
+  // The delay runs out on the timer of the service, which then posts the task
+  // to this queue; a queue that is shut down by then drops it.
+  std::shared_ptr<api::Cancelable> Schedule(Task&& runnable,
+                                            absl::Duration delay) override {
+    auto cancelable = std::make_shared<ScheduledCancelable>();
+    service_->GetTimer()->Schedule(
+        [service = service_, queue = queue_, cancelable,
+         runnable = std::move(runnable)]() mutable {
+          service->Post(queue, [cancelable,
+                                runnable = std::move(runnable)]() mutable {
+            if (cancelable->MarkExecuted()) runnable();
+          });
+        },
+        delay);
+    return cancelable;
+  }
+
+ private:
+  ExecutorService* service_;
+  std::shared_ptr<Queue> queue_;
+};
+
+ExecutorService& ExecutorService::GetInstance() {
+  static ExecutorService* instance = new ExecutorService();
+  return *instance;
+}
+
+std::unique_ptr<api::SubmittableExecutor> ExecutorService::CreateExecutor(
+    const std::string& name, int max_concurrency, TaskType type) {
+  if (!FeatureFlags::GetInstance().GetFlags().enable_shared_executors) {
+    using Platform = api::ImplementationPlatform;
+    return max_concurrency == 1
+               ? Platform::CreateSingleThreadExecutor()
+               : Platform::CreateMultiThreadExecutor(max_concurrency);
+  }
+  return GetInstance().CreateQueue(name, max_concurrency, type);
+}
+
+std::unique_ptr<api::ScheduledExecutor>
+ExecutorService::CreateScheduledExecutor(const std::string& name,
+                                         TaskType type) {
+  if (!FeatureFlags::GetInstance().GetFlags().enable_shared_executors) {
+    return api::ImplementationPlatform::CreateScheduledExecutor();
+  }
+  return GetInstance().CreateScheduledQueue(name, type);
+}
+
+ExecutorService::ExecutorService() : ExecutorService(Options()) {}
+
+ExecutorService::ExecutorService(const Options& options) : options_(options) {}
+
+ExecutorService::~ExecutorService() {
+  std::unique_ptr<api::ScheduledExecutor> timer;
+  {
+    MutexLock lock(&timer_mutex_);
+    timer = std::move(timer_);
+  }
+  // Delayed tasks may still post to queues until the timer is gone.
+  timer.reset();
+  {
+    MutexLock lock(&mutex_);
+    shutdown_ = true;
+    cond_.Notify();
+    while (!workers_.empty()) cond_.Wait();
+  }
+  ReapWorkers();
+}
+
+void ExecutorService::SetOptions(const Options& options) {
+  MutexLock lock(&mutex_);
+  options_ = options;
+  DispatchLocked();
+  // Idle workers may have to exit under the new limits.
+  cond_.Notify();
+}
+
+ExecutorService::Options ExecutorService::GetOptions() const {
+  MutexLock lock(&mutex_);
+  return options_;
+}
+
+std::unique_ptr<api::SubmittableExecutor> ExecutorService::CreateQueue(
+    const std::string& name, int max_concurrency, TaskType type) {
+  return std::make_unique<QueueExecutor>(
+      this, std::make_shared<Queue>(name, std::max(max_concurrency, 1), type));
+}
+
+std::unique_ptr<api::ScheduledExecutor> ExecutorService::CreateScheduledQueue(
+    const std::string& name, TaskType type) {
+  return std::make_unique<ScheduledQueueExecutor>(
+      this, std::make_shared<Queue>(name, 1, type));
+}
+
+std::vector<ExecutorService::ThreadInfo> ExecutorService::GetThreads() const {
+  MutexLock lock(&mutex_);
+  std::vector<ThreadInfo> threads;
+  threads.reserve(workers_.size());
+  for (const auto& worker : workers_) {
+    ThreadInfo info;
+    info.tid = worker->tid;
+    if (worker->queue != nullptr) info.queue = worker->queue->name;
+    info.since = worker->since;
+    threads.push_back(std::move(info));
+  }
+  return threads;
+}
+
+std::string ExecutorService::DumpThreads() const {
+  absl::Time now = SystemClock::ElapsedRealtime();
+  std::string dump;
+  for (const ThreadInfo& thread : GetThreads()) {
+    absl::StrAppend(&dump, "thread ", thread.tid, ": ",
+                    thread.queue.empty() ? "idle" : thread.queue, " for ",
+                    absl::FormatDuration(now - thread.since), "\n");
+  }
+  MutexLock lock(&mutex_);
+  for (const auto* ready : {&ready_blocking_, &ready_short_lived_}) {
+    for (const auto& queue : *ready) {
+      absl::StrAppend(&dump, "waiting: ", queue->name, "\n");
+    }
+  }
+  return dump;
+}
+
+bool ExecutorService::Post(const std::shared_ptr<Queue>& queue, Task&& task) {
+  ReapWorkers();
+  MutexLock lock(&mutex_);
+  if (queue->shutdown) return false;
+  queue->tasks.push_back(std::move(task));
+  ActivateLocked(queue);
+  DispatchLocked();
+  return true;
+}
+
+void ExecutorService::ShutdownQueue(Queue& queue) {
+  MutexLock lock(&mutex_);
+  queue.shutdown = true;
+}
+
+void ExecutorService::DrainQueue(Queue& queue) {
+  MutexLock lock(&mutex_);
+  queue.shutdown = true;
+  // A task may destroy the executor of its own queue.
+  int self = current_queue == &queue ? 1 : 0;
+  while (!queue.tasks.empty() || queue.running > self) cond_.Wait();
+}
+
+void ExecutorService::ActivateLocked(const std::shared_ptr<Queue>& queue) {
+  auto& ready = queue->type == TaskType::kBlocking ? ready_blocking_
+                                                   : ready_short_lived_;
+  while (queue->activations < static_cast<int>(queue->tasks.size()) &&
+         queue->running + queue->activations < queue->max_concurrency) {
+    queue->activations++;
+    ready.push_back(queue);
+  }
+}
+
+void ExecutorService::DispatchLocked() {
+  int short_lived =
+      std::min(static_cast<int>(ready_short_lived_.size()),
+               std::max(options_.max_threads - short_lived_workers_, 0));
+  int blocking = static_cast<int>(ready_blocking_.size());
+  if (options_.max_blocking_threads > 0) {
+    blocking = std::min(
+        blocking,
+        std::max(options_.max_blocking_threads - blocking_workers_, 0));
+  }
+  int needed = blocking + short_lived - wakeups_ - starting_workers_;
+  bool notify = false;
+  for (; needed > 0; --needed) {
+    if (idle_workers_ > wakeups_) {
+      wakeups_++;
+      notify = true;
+    } else {
+      StartWorkerLocked();
+    }
+  }
+  if (notify) cond_.Notify();
+}
+
+std::shared_ptr<ExecutorService::Queue>
+ExecutorService::TakeReadyQueueLocked() {
+  std::shared_ptr<Queue> queue;
+  if (!ready_blocking_.empty() &&
+      (options_.max_blocking_threads <= 0 ||
+       blocking_workers_ < options_.max_blocking_threads)) {
+    queue = std::move(ready_blocking_.front());
+    ready_blocking_.pop_front();
+    blocking_workers_++;
+  } else if (!ready_short_lived_.empty() &&
+             short_lived_workers_ < options_.max_threads) {
+    queue = std::move(ready_short_lived_.front());
+    ready_short_lived_.pop_front();
+    short_lived_workers_++;
+  }
+  return queue;
+}
+
+void ExecutorService::StartWorkerLocked() {
+  auto worker = std::make_unique<Worker>();
+  Worker* started = worker.get();
+  worker->since = SystemClock::ElapsedRealtime();
+  worker->thread = api::ImplementationPlatform::CreateSingleThreadExecutor();
+  workers_.push_back(std::move(worker));
+  starting_workers_++;
+  GetThreadsGauge()->Add(1);
+  started->thread->Execute([this, started]() { RunWorker(started); });
+}
+
+void ExecutorService::RunWorker(Worker* worker) {
+  std::shared_ptr<Queue> queue;
+  Task task;
+  {
+    MutexLock lock(&mutex_);
+    worker->tid = api::GetCurrentTid();
+    starting_workers_--;
+  }
+  while (true) {
+    {
+      MutexLock lock(&mutex_);
+      if (queue != nullptr) FinishTaskLocked(*worker, std::move(queue));
+      queue = WaitForQueueLocked(*worker);
+      if (queue == nullptr) {
+        // Hand the worker over to ReapWorkers(); it must not be touched past
+        // this point.
+        auto it = std::find_if(
+            workers_.begin(), workers_.end(),
+            [worker](const auto& item) { return item.get() == worker; });
+        exited_workers_.push_back(std::move(*it));
+        workers_.erase(it);
+        GetThreadsGauge()->Add(-1);
+        cond_.Notify();
+        return;
+      }
+      task = std::move(queue->tasks.front());
+      queue->tasks.pop_front();
+      queue->activations--;
+      queue->running++;
+      worker->queue = queue;
+      worker->since = SystemClock::ElapsedRealtime();
+      // Get other workers going on whatever is left.
+      DispatchLocked();
+    }
+    current_queue = queue.get();
+    task();
+    // Whatever the task holds on to goes away before the next one starts.
+    task = Task();
+    current_queue = nullptr;
+  }
+}
+
+std::shared_ptr<ExecutorService::Queue> ExecutorService::WaitForQueueLocked(
+    Worker& worker) {
+  while (!shutdown_) {
+    std::shared_ptr<Queue> queue = TakeReadyQueueLocked();
+    if (queue != nullptr) return queue;
+
+    idle_workers_++;
+    absl::Time idle_since = SystemClock::ElapsedRealtime();
+    while (!shutdown_ && wakeups_ == 0) {
+      absl::Duration idle = SystemClock::ElapsedRealtime() - idle_since;
+      if (idle >= options_.idle_timeout) {
+        if (idle_workers_ - wakeups_ > options_.max_idle_threads) {
+          idle_workers_--;
+          return nullptr;
+        }
+        idle_since = SystemClock::ElapsedRealtime();
+        idle = absl::ZeroDuration();
+      }
+      cond_.Wait(options_.idle_timeout - idle);
+    }
+    idle_workers_--;
+    if (wakeups_ > 0) wakeups_--;
+  }
+  return nullptr;
+}
+
+void ExecutorService::FinishTaskLocked(Worker& worker,
+                                       std::shared_ptr<Queue> queue) {
+  queue->running--;
+  if (queue->type == TaskType::kShortLived) {
+    short_lived_workers_--;
+  } else {
+    blocking_workers_--;
+  }
+  worker.queue = nullptr;
+  worker.since = SystemClock::ElapsedRealtime();
+  ActivateLocked(queue);
+  if (queue->shutdown && queue->tasks.empty()) cond_.Notify();
+}
+
+void ExecutorService::ReapWorkers() {
+  std::vector<std::unique_ptr<Worker>> exited;
+  {
+    MutexLock lock(&mutex_);
+    if (exited_workers_.empty()) return;
+    exited.swap(exited_workers_);
+  }
+  // Their threads are done with RunWorker(); this waits for them to finish.
+  for (auto& worker : exited) worker->thread->Shutdown();
+}
+
+api::ScheduledExecutor* ExecutorService::GetTimer() {
+  MutexLock lock(&timer_mutex_);
+  if (timer_ == nullptr) {
+    timer_ = api::ImplementationPlatform::CreateScheduledExecutor();
+  }
+  return timer_.get();
+}
+
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,184 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_PUBLIC_EXECUTOR_SERVICE_H_
+#define PLATFORM_PUBLIC_EXECUTOR_SERVICE_H_
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
+#include "platform/api/scheduled_executor.h"
+#include "platform/api/submittable_executor.h"
+#include "platform/base/task.h"
+#include "platform/public/condition_variable.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+
+// A pool of worker threads shared by the executors of all the Core instances
+// of a process, instead of each executor keeping threads of its own.
+//
+// Executors are named queues on top of the pool. A queue takes a worker only
+// while it has tasks to run and runs at most |max_concurrency| of them at a
+// time, in order, so a queue with a concurrency of 1 keeps the serial
+// semantics of a SingleThreadExecutor. Workers go from queue to queue one task
+// at a time; those left idle exit after a while.
+//
+// Queues of short-lived tasks, like alarms, share at most max_threads workers.
+// Tasks that may block for long, like read loops or anything doing I/O, go on
+// blocking queues. Those get a worker of their own whenever they are ready to
+// run, so that they can not starve the pool, and give it back once they run
+// dry. max_threads therefore does not bound the threads of the pool: on top of
+// the short-lived workers, there is one worker for every blocking task that is
+// running, up to max_blocking_threads if that is set.
+class ExecutorService {
+ public:
+  struct Options {
+    // Most workers running tasks of short-lived queues at a time. Workers
+    // running tasks of blocking queues don't count towards it.
+    int max_threads = 8;
+    // Most workers running tasks of blocking queues at a time; 0 means
+    // unlimited. Past it, blocking tasks that are ready wait for one of the
+    // running ones to finish, in the order they became ready. Blocking tasks
+    // may wait for each other, so the limit has to stay above the number of
+    // them that may run at once, e.g. the read loops of all endpoints.
+    int max_blocking_threads = 0;
+    // Idle workers kept for later work; the others exit once they have been
+    // idle for idle_timeout.
+    int max_idle_threads = 4;
+    absl::Duration idle_timeout = absl::Seconds(30);
+  };
+
+  enum class TaskType {
+    // Tasks that finish quickly and never wait for other tasks.
+    kShortLived,
+    // Tasks that may block, e.g. on I/O or on tasks of other queues.
+    kBlocking,
+  };
+
+  // A worker thread, and the queue it is running a task of.
+  struct ThreadInfo {
+    int tid = 0;
+    // Empty while the worker is idle.
+    std::string queue;
+    // When the worker started its current task, or went idle.
+    absl::Time since;
+  };
+
+  // The service shared by the executors that FeatureFlags route to it.
+  static ExecutorService& GetInstance();
+
+  // Returns an executor for the queue |name|: a queue of GetInstance() if
+  // FeatureFlags enable shared executors, or else an executor of the platform
+  // with threads of its own.
+  static std::unique_ptr<api::SubmittableExecutor> CreateExecutor(
+      const std::string& name, int max_concurrency, TaskType type);
+  static std::unique_ptr<api::ScheduledExecutor> CreateScheduledExecutor(
+      const std::string& name, TaskType type);
+
+  ExecutorService();
+  explicit ExecutorService(const Options& options);
+  ~ExecutorService();
+  ExecutorService(const ExecutorService&) = delete;
+  ExecutorService& operator=(const ExecutorService&) = delete;
+
+  // Changes the limits of the pool. Takes effect as workers pick up tasks or
+  // go idle; running tasks are never interrupted.
+  void SetOptions(const Options& options) ABSL_LOCKS_EXCLUDED(mutex_);
+  Options GetOptions() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns a new queue of the pool. The queue must not outlive the service.
+  // Destroying the queue waits for the tasks already on it to run.
+  std::unique_ptr<api::SubmittableExecutor> CreateQueue(
+      const std::string& name, int max_concurrency, TaskType type)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Same as CreateQueue(), with a concurrency of 1, for tasks that may also be
+  // scheduled to run after a delay.
+  std::unique_ptr<api::ScheduledExecutor> CreateScheduledQueue(
+      const std::string& name, TaskType type) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Debugging: lists the workers of the pool and what they are busy with.
+  std::vector<ThreadInfo> GetThreads() const ABSL_LOCKS_EXCLUDED(mutex_);
+  // Same as GetThreads(), one worker per line, with the queues that have tasks
+  // waiting for a worker.
+  std::string DumpThreads() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  class QueueExecutor;
+  class ScheduledQueueExecutor;
+  struct Queue;
+  struct Worker;
+
+  // Queues |task| on |queue|. Returns false if the queue is shut down.
+  bool Post(const std::shared_ptr<Queue>& queue, Task&& task)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Stops |queue| from taking tasks.
+  void ShutdownQueue(Queue& queue) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Waits for the tasks on |queue| to run, after ShutdownQueue().
+  void DrainQueue(Queue& queue) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Hands |queue| over to a worker if it has tasks and room to run them.
+  void ActivateLocked(const std::shared_ptr<Queue>& queue)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Wakes or starts a worker for the queues that are ready to run.
+  void DispatchLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns a queue a worker may run a task of, or nullptr.
+  std::shared_ptr<Queue> TakeReadyQueueLocked()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Starts a worker, which goes looking for a queue right away.
+  void StartWorkerLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RunWorker(Worker* worker) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Waits for a queue |worker| may run a task of. Returns nullptr once the
+  // worker is to exit.
+  std::shared_ptr<Queue> WaitForQueueLocked(Worker& worker)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Books the end of the task |worker| ran from |queue|.
+  void FinishTaskLocked(Worker& worker, std::shared_ptr<Queue> queue)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Destroys the workers that have exited.
+  void ReapWorkers() ABSL_LOCKS_EXCLUDED(mutex_);
+  api::ScheduledExecutor* GetTimer() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  mutable Mutex mutex_;
+  // Notified when a queue becomes ready, a queue drains, or on shutdown.
+  ConditionVariable cond_{&mutex_};
+  Options options_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::unique_ptr<Worker>> workers_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::unique_ptr<Worker>> exited_workers_ ABSL_GUARDED_BY(mutex_);
+  // Queues waiting for a worker, once for every task they may run at once.
+  std::deque<std::shared_ptr<Queue>> ready_short_lived_ ABSL_GUARDED_BY(mutex_);
+  std::deque<std::shared_ptr<Queue>> ready_blocking_ ABSL_GUARDED_BY(mutex_);
+  // Workers started by DispatchLocked() that have yet to look for a queue.
+  int starting_workers_ ABSL_GUARDED_BY(mutex_) = 0;
+  int idle_workers_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Idle workers that were woken up, and have yet to look for a queue.
+  int wakeups_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Workers running tasks of short-lived queues.
+  int short_lived_workers_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Workers running tasks of blocking queues.
+  int blocking_workers_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  // Fires the delayed tasks of all scheduled queues; created on first use.
+  Mutex timer_mutex_;
+  std::unique_ptr<api::ScheduledExecutor> timer_ ABSL_GUARDED_BY(timer_mutex_);
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_PUBLIC_EXECUTOR_SERVICE_H_
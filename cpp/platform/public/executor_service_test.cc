@@ -0,0 +1,212 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/public/executor_service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "platform/public/count_down_latch.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+using TaskType = ExecutorService::TaskType;
+
+ExecutorService::Options MakeOptions(int max_threads) {
+  ExecutorService::Options options;
+  options.max_threads = max_threads;
+  return options;
+}
+
+TEST(ExecutorServiceTest, SerialQueueRunsTasksInOrder) {
+  ExecutorService service;
+  std::vector<int> order;
+  {
+    auto queue = service.CreateQueue("serial", 1, TaskType::kShortLived);
+    for (int i = 0; i < 100; ++i) {
+      queue->Execute([&order, i]() { order.push_back(i); });
+    }
+    // Destroying the queue waits for its tasks.
+  }
+  ASSERT_EQ(order.size(), 100);
+  EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+}
+
+TEST(ExecutorServiceTest, QueueDropsTasksAfterShutdown) {
+  ExecutorService service;
+  auto queue = service.CreateQueue("queue", 1, TaskType::kShortLived);
+  queue->Shutdown();
+  EXPECT_FALSE(queue->DoSubmit([]() {}));
+}
+
+TEST(ExecutorServiceTest, QueuesShareWorkers) {
+  ExecutorService service(MakeOptions(2));
+  CountDownLatch latch(20);
+  std::vector<std::unique_ptr<api::SubmittableExecutor>> queues;
+  for (int i = 0; i < 20; ++i) {
+    queues.push_back(service.CreateQueue("queue", 1, TaskType::kShortLived));
+    queues.back()->Execute([&latch]() { latch.CountDown(); });
+  }
+  EXPECT_TRUE(latch.Await(absl::Seconds(5)).result());
+  EXPECT_LE(service.GetThreads().size(), 2);
+}
+
+TEST(ExecutorServiceTest, ShortLivedTasksStayWithinThreadLimit) {
+  ExecutorService service(MakeOptions(2));
+  absl::Mutex mutex;
+  int running = 0;
+  int max_running = 0;
+  absl::Notification release;
+  CountDownLatch done(4);
+  std::vector<std::unique_ptr<api::SubmittableExecutor>> queues;
+  for (int i = 0; i < 4; ++i) {
+    queues.push_back(service.CreateQueue("queue", 1, TaskType::kShortLived));
+    queues.back()->Execute([&]() {
+      {
+        absl::MutexLock lock(&mutex);
+        max_running = std::max(max_running, ++running);
+      }
+      release.WaitForNotificationWithTimeout(absl::Milliseconds(100));
+      {
+        absl::MutexLock lock(&mutex);
+        --running;
+      }
+      done.CountDown();
+    });
+  }
+  EXPECT_TRUE(done.Await(absl::Seconds(5)).result());
+  release.Notify();
+  absl::MutexLock lock(&mutex);
+  EXPECT_EQ(max_running, 2);
+}
+
+TEST(ExecutorServiceTest, BlockingTasksGetThreadsBeyondLimit) {
+  ExecutorService service(MakeOptions(1));
+  CountDownLatch started(3);
+  CountDownLatch done(3);
+  std::vector<std::unique_ptr<api::SubmittableExecutor>> queues;
+  for (int i = 0; i < 3; ++i) {
+    queues.push_back(service.CreateQueue("reader", 1, TaskType::kBlocking));
+    // Each task waits for all of them to start, which only works if they
+    // run at the same time.
+    queues.back()->Execute([&started, &done]() {
+      started.CountDown();
+      if (started.Await(absl::Seconds(5)).result()) done.CountDown();
+    });
+  }
+  EXPECT_TRUE(done.Await(absl::Seconds(5)).result());
+}
+
+TEST(ExecutorServiceTest, BlockingTasksWaitPastBlockingThreadLimit) {
+  ExecutorService::Options options = MakeOptions(1);
+  options.max_blocking_threads = 1;
+  ExecutorService service(options);
+  absl::Notification release;
+  absl::Notification second_started;
+  auto first = service.CreateQueue("reader", 1, TaskType::kBlocking);
+  auto second = service.CreateQueue("reader", 1, TaskType::kBlocking);
+  first->Execute([&release]() {
+    release.WaitForNotificationWithTimeout(absl::Seconds(5));
+  });
+  second->Execute([&second_started]() { second_started.Notify(); });
+
+  EXPECT_FALSE(
+      second_started.WaitForNotificationWithTimeout(absl::Milliseconds(100)));
+  release.Notify();
+  EXPECT_TRUE(second_started.WaitForNotificationWithTimeout(absl::Seconds(5)));
+}
+
+TEST(ExecutorServiceTest, ConcurrentQueueRunsUpToItsConcurrency) {
+  ExecutorService service;
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  {
+    auto queue = service.CreateQueue("concurrent", 2, TaskType::kBlocking);
+    for (int i = 0; i < 6; ++i) {
+      queue->Execute([&running, &max_running]() {
+        int now = ++running;
+        int seen = max_running;
+        while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+        }
+        absl::SleepFor(absl::Milliseconds(20));
+        --running;
+      });
+    }
+  }
+  EXPECT_EQ(max_running, 2);
+}
+
+TEST(ExecutorServiceTest, GetThreadsListsTheQueueOfEachThread) {
+  ExecutorService service;
+  absl::Notification started;
+  absl::Notification release;
+  auto queue = service.CreateQueue("endpoint-reader", 1, TaskType::kBlocking);
+  queue->Execute([&started, &release]() {
+    started.Notify();
+    release.WaitForNotification();
+  });
+  started.WaitForNotification();
+
+  std::vector<ExecutorService::ThreadInfo> threads = service.GetThreads();
+  ASSERT_EQ(threads.size(), 1);
+  EXPECT_EQ(threads[0].queue, "endpoint-reader");
+  EXPECT_NE(threads[0].tid, 0);
+  EXPECT_THAT(service.DumpThreads(), testing::HasSubstr("endpoint-reader"));
+  release.Notify();
+}
+
+TEST(ExecutorServiceTest, IdleThreadsExit) {
+  ExecutorService::Options options;
+  options.max_idle_threads = 0;
+  options.idle_timeout = absl::Milliseconds(10);
+  ExecutorService service(options);
+  absl::Notification done;
+  auto queue = service.CreateQueue("queue", 1, TaskType::kShortLived);
+  queue->Execute([&done]() { done.Notify(); });
+  done.WaitForNotification();
+
+  absl::Time deadline = absl::Now() + absl::Seconds(5);
+  while (!service.GetThreads().empty() && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(5));
+  }
+  EXPECT_TRUE(service.GetThreads().empty());
+}
+
+TEST(ExecutorServiceTest, ScheduledQueueRunsAndCancelsDelayedTasks) {
+  ExecutorService service;
+  auto queue = service.CreateScheduledQueue("alarms", TaskType::kShortLived);
+  absl::Notification fired;
+  std::atomic_bool canceled_ran{false};
+  auto canceled = queue->Schedule([&canceled_ran]() { canceled_ran = true; },
+                                  absl::Milliseconds(10));
+  queue->Schedule([&fired]() { fired.Notify(); }, absl::Milliseconds(50));
+  EXPECT_TRUE(canceled->Cancel());
+
+  EXPECT_TRUE(fired.WaitForNotificationWithTimeout(absl::Seconds(5)));
+  EXPECT_FALSE(canceled_ran);
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
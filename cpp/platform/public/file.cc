@@ -58,6 +58,8 @@ PayloadId InputFile::GetPayloadId() const { return id_; }
 
 OutputFile::OutputFile(PayloadId payload_id)
     : impl_(Platform::CreateOutputFile(payload_id)), id_(payload_id) {}
+OutputFile::OutputFile(PayloadId payload_id, std::int64_t offset)
+    : impl_(Platform::CreateOutputFile(payload_id, offset)), id_(payload_id) {}
 OutputFile::~OutputFile() = default;
 OutputFile::OutputFile(OutputFile&&) noexcept = default;
 OutputFile& OutputFile::operator=(OutputFile&&) noexcept = default;
@@ -72,6 +74,10 @@ Exception OutputFile::Write(const ByteArray& data) {
 // down to the applicable transport layer.
 Exception OutputFile::Flush() { return impl_->Flush(); }
 
+// Ensures that all data written by previous calls to Write() is on the
+// storage device.
+Exception OutputFile::Sync() { return impl_->Sync(); }
+
 // Disallows further writes to the file and frees system resources,
 // associated with it.
 Exception OutputFile::Close() { return impl_->Close(); }
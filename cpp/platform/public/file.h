@@ -77,6 +77,10 @@ class OutputFile final {
  public:
   using Platform = api::ImplementationPlatform;
   explicit OutputFile(PayloadId payload_id);
+  // Reopens the file of a partially received payload; the first |offset|
+  // bytes are kept, and writes continue right after them.
+  // The result is not valid if the file no longer holds |offset| bytes.
+  OutputFile(PayloadId payload_id, std::int64_t offset);
   ~OutputFile();
   OutputFile(OutputFile&&) noexcept;
   OutputFile& operator=(OutputFile&&) noexcept;
@@ -89,6 +93,11 @@ class OutputFile final {
   // down to the applicable transport layer.
   Exception Flush();
 
+  // Ensures that all data written by previous calls to Write() is on the
+  // storage device, and survives a crash or a power loss.
+  // Returns Exception::kIo on error, Exception::kSuccess otherwise.
+  Exception Sync();
+
   // Disallows further writes to the file and frees system resources,
   // associated with it.
   Exception Close();
@@ -105,6 +114,10 @@ class OutputFile final {
   // Returns payload id of this file. The closest "file" equivalent is inode.
   PayloadId GetPayloadId() const;
 
+  // Returns true if a file was opened; the other methods must not be called
+  // otherwise.
+  bool IsValid() const { return impl_ != nullptr; }
+
  private:
   std::unique_ptr<api::OutputFile> impl_;
   PayloadId id_;
@@ -14,11 +14,15 @@
 
 #include "platform/public/logging.h"
 
+#include <cstdint>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace {
 
+using ::location::nearby::AsyncLogging;
+
 TEST(LoggingTest, CanLog) {
   NEARBY_LOG_SET_SEVERITY(INFO);
   int num = 42;
@@ -49,4 +53,55 @@ TEST(LoggingTest, CanStream_LoggingDisabled) {
   EXPECT_EQ(num, 42);
 }
 
+TEST(LoggingTest, CanLogAsync) {
+  NEARBY_LOG_SET_SEVERITY(INFO);
+  AsyncLogging::Options options;
+  options.max_messages_per_site_per_second = 0;
+  AsyncLogging& async_logging = AsyncLogging::GetInstance();
+  async_logging.Start(options);
+  std::int64_t written = async_logging.GetStats().written;
+
+  int num = 42;
+  for (int i = 0; i < 10; ++i) {
+    NEARBY_LOGS(INFO) << "The answer to everything: " << num++;
+    NEARBY_LOG(INFO, "The answer to everything: %d", num++);
+  }
+  async_logging.Flush();
+
+  EXPECT_EQ(num, 62);
+  EXPECT_EQ(async_logging.GetStats().written, written + 20);
+  async_logging.Stop();
+  EXPECT_FALSE(async_logging.IsRunning());
+}
+
+TEST(LoggingTest, CanStream_RateLimited) {
+  NEARBY_LOG_SET_SEVERITY(INFO);
+  AsyncLogging::Options options;
+  options.max_messages_per_site_per_second = 3;
+  AsyncLogging& async_logging = AsyncLogging::GetInstance();
+  async_logging.Start(options);
+  std::int64_t suppressed = async_logging.GetStats().suppressed;
+
+  int num = 42;
+  for (int i = 0; i < 100; ++i) {
+    NEARBY_LOGS(INFO) << "The answer to everything: " << num++;
+  }
+  async_logging.Stop();
+
+  // num++ is only evaluated for the messages that got through; the loop may
+  // straddle two rate limiting windows.
+  EXPECT_GE(num, 45);
+  EXPECT_LE(num, 48);
+  EXPECT_EQ(async_logging.GetStats().suppressed, suppressed + 142 - num);
+}
+
+TEST(LoggingTest, CanStream_NotRateLimitedWhenSynchronous) {
+  NEARBY_LOG_SET_SEVERITY(INFO);
+  int num = 42;
+  for (int i = 0; i < 100; ++i) {
+    NEARBY_LOGS(INFO) << "The answer to everything: " << num++;
+  }
+  EXPECT_EQ(num, 142);
+}
+
 }  // namespace
@@ -0,0 +1,330 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/public/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "platform/public/logging.h"
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+
+namespace {
+
+// Returns the position of the highest set bit of |value|, which is not 0.
+int HighestBit(std::uint64_t value) {
+  int bit = 0;
+  for (int shift = 32; shift > 0; shift >>= 1) {
+    if (value >> shift) {
+      value >>= shift;
+      bit += shift;
+    }
+  }
+  return bit;
+}
+
+std::string EscapeLabelValue(absl::string_view value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Renders |labels| as they appear between the braces of a series.
+std::string RenderLabels(const MetricLabels& labels) {
+  std::string rendered;
+  for (const auto& label : labels) {
+    if (!rendered.empty()) rendered += ",";
+    absl::StrAppend(&rendered, label.first, "=\"",
+                    EscapeLabelValue(label.second), "\"");
+  }
+  return rendered;
+}
+
+std::string SeriesName(absl::string_view name, absl::string_view labels) {
+  if (labels.empty()) return std::string(name);
+  return absl::StrCat(name, "{", labels, "}");
+}
+
+// Renders a histogram bucket series: the labels of the histogram plus "le".
+std::string BucketSeriesName(absl::string_view name, absl::string_view labels,
+                             absl::string_view le) {
+  return absl::StrCat(name, "_bucket{", labels, labels.empty() ? "" : ",",
+                      "le=\"", le, "\"}");
+}
+
+void AppendHeader(std::string* text, absl::string_view name,
+                  absl::string_view help, absl::string_view type) {
+  absl::StrAppend(text, "# HELP ", name, " ", help, "\n");
+  absl::StrAppend(text, "# TYPE ", name, " ", type, "\n");
+}
+
+}  // namespace
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr int Histogram::kSubBucketBits;
+constexpr int Histogram::kSubBuckets;
+constexpr int Histogram::kMaxBits;
+constexpr int Histogram::kBuckets;
+
+int Histogram::BucketIndex(std::int64_t value) {
+  if (value < kSubBuckets) return std::max<std::int64_t>(value, 0);
+  int bit = HighestBit(value);
+  if (bit >= kMaxBits) return kBuckets - 1;
+  int shift = bit - kSubBucketBits;
+  int sub_bucket = (value >> shift) & (kSubBuckets - 1);
+  return (shift + 1) * kSubBuckets + sub_bucket;
+}
+
+std::int64_t Histogram::BucketUpperBound(int index) {
+  if (index < kSubBuckets) return index;
+  if (index == kBuckets - 1) return std::numeric_limits<std::int64_t>::max();
+  int shift = index / kSubBuckets - 1;
+  int sub_bucket = index % kSubBuckets;
+  std::int64_t lower_bound = static_cast<std::int64_t>(kSubBuckets + sub_bucket)
+                             << shift;
+  return lower_bound + (std::int64_t{1} << shift) - 1;
+}
+
+void Histogram::Record(std::int64_t value) {
+  if (value < 0) value = 0;
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  std::int64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const {
+  Snapshot snapshot;
+  // Buckets are read one by one while values keep coming in, so the count is
+  // taken from the buckets to keep the snapshot consistent with itself.
+  for (int i = 0; i < kBuckets; ++i) {
+    std::int64_t count = buckets_[i].load(std::memory_order_relaxed);
+    if (count == 0) continue;
+    snapshot.buckets.emplace_back(BucketUpperBound(i), count);
+    snapshot.count += count;
+  }
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+std::int64_t Histogram::Snapshot::Percentile(double quantile) const {
+  if (count == 0) return 0;
+  auto rank = static_cast<std::int64_t>(
+      std::ceil(std::min(std::max(quantile, 0.0), 1.0) * count));
+  std::int64_t seen = 0;
+  for (const auto& bucket : buckets) {
+    seen += bucket.second;
+    if (seen >= rank) return std::min(bucket.first, max);
+  }
+  return max;
+}
+
+MetricsRegistry& MetricsRegistry::GetInstance() {
+  static MetricsRegistry* instance = new MetricsRegistry();
+  return *instance;
+}
+
+Counter* MetricsRegistry::GetCounter(absl::string_view name,
+                                     absl::string_view help,
+                                     const MetricLabels& labels) {
+  MutexLock lock(&mutex_);
+  auto& counter = GetFamilyLocked(name, help, Type::kCounter)
+                      .counters[RenderLabels(labels)];
+  if (counter == nullptr) counter = std::make_unique<Counter>();
+  return counter.get();
+}
+
+Gauge* MetricsRegistry::GetGauge(absl::string_view name,
+                                 absl::string_view help,
+                                 const MetricLabels& labels) {
+  MutexLock lock(&mutex_);
+  auto& gauge =
+      GetFamilyLocked(name, help, Type::kGauge).gauges[RenderLabels(labels)];
+  if (gauge == nullptr) gauge = std::make_unique<Gauge>();
+  return gauge.get();
+}
+
+Histogram* MetricsRegistry::GetHistogram(absl::string_view name,
+                                         absl::string_view help,
+                                         const MetricLabels& labels) {
+  MutexLock lock(&mutex_);
+  auto& histogram = GetFamilyLocked(name, help, Type::kHistogram)
+                        .histograms[RenderLabels(labels)];
+  if (histogram == nullptr) histogram = std::make_unique<Histogram>();
+  return histogram.get();
+}
+
+std::shared_ptr<Counter> MetricsRegistry::GetScopedCounter(
+    absl::string_view name, absl::string_view help,
+    const MetricLabels& labels) {
+  MutexLock lock(&mutex_);
+  PruneScopedCountersLocked();
+  auto& weak_counter = GetFamilyLocked(name, help, Type::kCounter)
+                           .scoped_counters[RenderLabels(labels)];
+  std::shared_ptr<Counter> counter = weak_counter.lock();
+  if (counter == nullptr) {
+    counter = std::make_shared<Counter>();
+    weak_counter = counter;
+  }
+  return counter;
+}
+
+MetricsRegistry::Snapshot MetricsRegistry::GetSnapshot() {
+  MutexLock lock(&mutex_);
+  PruneScopedCountersLocked();
+  Snapshot snapshot;
+  for (const auto& item : families_) {
+    const std::string& name = item.first;
+    const Family& family = item.second;
+    switch (family.type) {
+      case Type::kCounter:
+        for (const auto& series : family.counters) {
+          snapshot.counters[SeriesName(name, series.first)] =
+              series.second->Value();
+        }
+        for (const auto& series : family.scoped_counters) {
+          if (auto counter = series.second.lock()) {
+            snapshot.counters[SeriesName(name, series.first)] =
+                counter->Value();
+          }
+        }
+        break;
+      case Type::kGauge:
+        for (const auto& series : family.gauges) {
+          snapshot.gauges[SeriesName(name, series.first)] =
+              series.second->Value();
+        }
+        break;
+      case Type::kHistogram:
+        for (const auto& series : family.histograms) {
+          snapshot.histograms[SeriesName(name, series.first)] =
+              series.second->GetSnapshot();
+        }
+        break;
+    }
+  }
+  return snapshot;
+}
+
+std::string MetricsRegistry::ExportText() {
+  MutexLock lock(&mutex_);
+  PruneScopedCountersLocked();
+  std::string text;
+  for (const auto& item : families_) {
+    const std::string& name = item.first;
+    const Family& family = item.second;
+    switch (family.type) {
+      case Type::kCounter:
+        AppendHeader(&text, name, family.help, "counter");
+        for (const auto& series : family.counters) {
+          absl::StrAppend(&text, SeriesName(name, series.first), " ",
+                          series.second->Value(), "\n");
+        }
+        for (const auto& series : family.scoped_counters) {
+          if (auto counter = series.second.lock()) {
+            absl::StrAppend(&text, SeriesName(name, series.first), " ",
+                            counter->Value(), "\n");
+          }
+        }
+        break;
+      case Type::kGauge:
+        AppendHeader(&text, name, family.help, "gauge");
+        for (const auto& series : family.gauges) {
+          absl::StrAppend(&text, SeriesName(name, series.first), " ",
+                          series.second->Value(), "\n");
+        }
+        break;
+      case Type::kHistogram:
+        AppendHeader(&text, name, family.help, "histogram");
+        for (const auto& series : family.histograms) {
+          Histogram::Snapshot snapshot = series.second->GetSnapshot();
+          std::int64_t cumulative_count = 0;
+          for (const auto& bucket : snapshot.buckets) {
+            cumulative_count += bucket.second;
+            absl::StrAppend(&text,
+                            BucketSeriesName(name, series.first,
+                                             absl::StrCat(bucket.first)),
+                            " ", cumulative_count, "\n");
+          }
+          absl::StrAppend(&text, BucketSeriesName(name, series.first, "+Inf"),
+                          " ", snapshot.count, "\n");
+          absl::StrAppend(&text, SeriesName(absl::StrCat(name, "_sum"),
+                                            series.first),
+                          " ", snapshot.sum, "\n");
+          absl::StrAppend(&text, SeriesName(absl::StrCat(name, "_count"),
+                                            series.first),
+                          " ", snapshot.count, "\n");
+        }
+        break;
+    }
+  }
+  return text;
+}
+
+MetricsRegistry::Family& MetricsRegistry::GetFamilyLocked(
+    absl::string_view name, absl::string_view help, Type type) {
+  auto it = families_.find(name);
+  if (it == families_.end()) {
+    Family family;
+    family.type = type;
+    family.help = std::string(help);
+    it = families_.emplace(std::string(name), std::move(family)).first;
+  } else if (it->second.type != type) {
+    // The metric still works for the caller, but is not exported.
+    NEARBY_LOGS(WARNING) << "Metric " << name
+                         << " is used with more than one type.";
+  }
+  return it->second;
+}
+
+void MetricsRegistry::PruneScopedCountersLocked() {
+  for (auto& item : families_) {
+    auto& scoped_counters = item.second.scoped_counters;
+    for (auto it = scoped_counters.begin(); it != scoped_counters.end();) {
+      if (it->second.expired()) {
+        it = scoped_counters.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+}  // namespace nearby
+}  // namespace location
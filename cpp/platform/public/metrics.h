@@ -0,0 +1,183 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_PUBLIC_METRICS_H_
+#define PLATFORM_PUBLIC_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/btree_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+
+// Label names and values of a metric, e.g. {{"medium", "WIFI_LAN"}}.
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// A count that only goes up.
+class Counter {
+ public:
+  void Increment(std::int64_t delta = 1) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  std::int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<std::int64_t> value_{0};
+};
+
+// A value that goes up and down, e.g. a queue depth.
+class Gauge {
+ public:
+  void Set(std::int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+  void Add(std::int64_t delta) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  std::int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<std::int64_t> value_{0};
+};
+
+// A distribution of non-negative values, usually latencies in microseconds.
+//
+// Buckets are log-linear, like in HdrHistogram: values are grouped by their
+// highest set bit, and each such group is split into kSubBuckets buckets of
+// equal width. Every bucket is thus within 1/kSubBuckets of the values in it,
+// whatever their magnitude. Values of 2^kMaxBits and up share an overflow
+// bucket.
+class Histogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxBits = 40;
+  static constexpr int kBuckets =
+      (kMaxBits - kSubBucketBits + 1) * kSubBuckets + 1;
+
+  struct Snapshot {
+    // Returns the upper bound of the bucket holding the |quantile| (0..1)
+    // of the recorded values, or 0 if there are none.
+    std::int64_t Percentile(double quantile) const;
+
+    std::int64_t count = 0;
+    std::int64_t sum = 0;
+    std::int64_t max = 0;
+    // Non-empty buckets as {inclusive upper bound, count}, by upper bound.
+    std::vector<std::pair<std::int64_t, std::int64_t>> buckets;
+  };
+
+  void Record(std::int64_t value);
+  // Records |duration| in microseconds.
+  void Record(absl::Duration duration) {
+    Record(absl::ToInt64Microseconds(duration));
+  }
+
+  Snapshot GetSnapshot() const;
+
+  static int BucketIndex(std::int64_t value);
+  static std::int64_t BucketUpperBound(int index);
+
+ private:
+  std::array<std::atomic<std::int64_t>, kBuckets> buckets_{};
+  std::atomic<std::int64_t> sum_{0};
+  std::atomic<std::int64_t> max_{0};
+};
+
+// A registry of named metrics, rendered on demand in the Prometheus text
+// exposition format.
+//
+// Looking a metric up takes a lock; recording into it does not. Callers keep
+// the returned metric around and record into it with a few relaxed atomic
+// operations, so instrumentation costs next to nothing when nobody scrapes.
+class MetricsRegistry {
+ public:
+  struct Snapshot {
+    // Keyed by series name, e.g. "nearby_bwu_attempts_total{medium="BLE"}".
+    absl::btree_map<std::string, std::int64_t> counters;
+    absl::btree_map<std::string, std::int64_t> gauges;
+    absl::btree_map<std::string, Histogram::Snapshot> histograms;
+  };
+
+  // The registry the library records its metrics into.
+  static MetricsRegistry& GetInstance();
+
+  MetricsRegistry() = default;
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Return the metric named |name| with |labels|, creating it on first use.
+  // These metrics live as long as the registry. |help| is a one-line
+  // description of the metric; the first one given for a name is used.
+  Counter* GetCounter(absl::string_view name, absl::string_view help,
+                      const MetricLabels& labels = {})
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  Gauge* GetGauge(absl::string_view name, absl::string_view help,
+                  const MetricLabels& labels = {}) ABSL_LOCKS_EXCLUDED(mutex_);
+  Histogram* GetHistogram(absl::string_view name, absl::string_view help,
+                          const MetricLabels& labels = {})
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Like GetCounter(), but the series is dropped from the registry once no
+  // caller holds on to it. Meant for series labeled with short-lived things,
+  // such as endpoints, which would otherwise pile up in a long-lived process.
+  std::shared_ptr<Counter> GetScopedCounter(absl::string_view name,
+                                            absl::string_view help,
+                                            const MetricLabels& labels)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  Snapshot GetSnapshot() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Renders all metrics in the Prometheus text exposition format, version
+  // 0.0.4.
+  std::string ExportText() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  enum class Type { kCounter, kGauge, kHistogram };
+
+  // All series of a metric name. Series are keyed by their rendered labels,
+  // e.g. medium="BLE", which are empty for an unlabeled metric.
+  struct Family {
+    Type type;
+    std::string help;
+    absl::btree_map<std::string, std::unique_ptr<Counter>> counters;
+    absl::btree_map<std::string, std::weak_ptr<Counter>> scoped_counters;
+    absl::btree_map<std::string, std::unique_ptr<Gauge>> gauges;
+    absl::btree_map<std::string, std::unique_ptr<Histogram>> histograms;
+  };
+
+  Family& GetFamilyLocked(absl::string_view name, absl::string_view help,
+                          Type type) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Drops scoped series that nobody holds on to anymore.
+  void PruneScopedCountersLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Mutex mutex_;
+  absl::btree_map<std::string, Family> families_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_PUBLIC_METRICS_H_
@@ -0,0 +1,147 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/public/metrics.h"
+
+#include <memory>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Not;
+using ::testing::Pair;
+
+TEST(MetricsTest, CounterAndGaugeKeepTheirValues) {
+  Counter counter;
+  counter.Increment();
+  counter.Increment(41);
+  EXPECT_EQ(counter.Value(), 42);
+
+  Gauge gauge;
+  gauge.Set(10);
+  gauge.Add(-3);
+  EXPECT_EQ(gauge.Value(), 7);
+}
+
+TEST(MetricsTest, HistogramBucketsHoldTheirValues) {
+  int last_index = 0;
+  for (std::int64_t value = 0; value < (std::int64_t{1} << 20); ++value) {
+    int index = Histogram::BucketIndex(value);
+    ASSERT_GE(index, last_index);
+    std::int64_t upper_bound = Histogram::BucketUpperBound(index);
+    ASSERT_GE(upper_bound, value);
+    // Buckets are never wider than 1/kSubBuckets of their values.
+    ASSERT_LE(upper_bound - value, value / Histogram::kSubBuckets);
+    last_index = index;
+  }
+  EXPECT_EQ(Histogram::BucketIndex(-1), 0);
+  EXPECT_EQ(Histogram::BucketIndex(std::int64_t{1} << 50),
+            Histogram::kBuckets - 1);
+}
+
+TEST(MetricsTest, HistogramReportsPercentiles) {
+  Histogram histogram;
+  for (int i = 1; i <= 100; ++i) {
+    histogram.Record(i);
+  }
+  histogram.Record(absl::Milliseconds(1));
+
+  Histogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(snapshot.count, 101);
+  EXPECT_EQ(snapshot.sum, 5050 + 1000);
+  EXPECT_EQ(snapshot.max, 1000);
+  EXPECT_EQ(snapshot.Percentile(0.0), 1);
+  EXPECT_NEAR(snapshot.Percentile(0.5), 51, 51 / Histogram::kSubBuckets);
+  EXPECT_NEAR(snapshot.Percentile(0.99), 100, 100 / Histogram::kSubBuckets);
+  EXPECT_EQ(snapshot.Percentile(1.0), 1000);
+  EXPECT_EQ(Histogram().GetSnapshot().Percentile(0.5), 0);
+}
+
+TEST(MetricsTest, RegistryReturnsTheSameMetricForTheSameSeries) {
+  MetricsRegistry registry;
+  Counter* counter = registry.GetCounter("frames_total", "Frames.");
+  EXPECT_EQ(registry.GetCounter("frames_total", "Frames."), counter);
+  EXPECT_NE(registry.GetCounter("frames_total", "Frames.", {{"medium", "BLE"}}),
+            counter);
+}
+
+TEST(MetricsTest, SnapshotHasAllSeries) {
+  MetricsRegistry registry;
+  registry.GetCounter("frames_total", "Frames.", {{"medium", "BLE"}})
+      ->Increment(3);
+  registry.GetGauge("queued_tasks", "Tasks.")->Set(2);
+  registry.GetHistogram("latency_micros", "Latency.")->Record(5);
+
+  MetricsRegistry::Snapshot snapshot = registry.GetSnapshot();
+  EXPECT_THAT(snapshot.counters,
+              ElementsAre(Pair("frames_total{medium=\"BLE\"}", 3)));
+  EXPECT_THAT(snapshot.gauges, ElementsAre(Pair("queued_tasks", 2)));
+  ASSERT_EQ(snapshot.histograms.count("latency_micros"), 1);
+  EXPECT_EQ(snapshot.histograms["latency_micros"].count, 1);
+}
+
+TEST(MetricsTest, ExportsPrometheusText) {
+  MetricsRegistry registry;
+  registry.GetCounter("frames_total", "Frames.", {{"medium", "BLE"}})
+      ->Increment(3);
+  registry.GetGauge("queued_tasks", "Tasks.")->Set(2);
+  Histogram* histogram = registry.GetHistogram(
+      "latency_micros", "Latency.", {{"endpoint", "a\"b"}});
+  histogram->Record(3);
+  histogram->Record(3);
+  histogram->Record(20);
+
+  EXPECT_EQ(registry.ExportText(),
+            "# HELP frames_total Frames.\n"
+            "# TYPE frames_total counter\n"
+            "frames_total{medium=\"BLE\"} 3\n"
+            "# HELP latency_micros Latency.\n"
+            "# TYPE latency_micros histogram\n"
+            "latency_micros_bucket{endpoint=\"a\\\"b\",le=\"3\"} 2\n"
+            "latency_micros_bucket{endpoint=\"a\\\"b\",le=\"21\"} 3\n"
+            "latency_micros_bucket{endpoint=\"a\\\"b\",le=\"+Inf\"} 3\n"
+            "latency_micros_sum{endpoint=\"a\\\"b\"} 26\n"
+            "latency_micros_count{endpoint=\"a\\\"b\"} 3\n"
+            "# HELP queued_tasks Tasks.\n"
+            "# TYPE queued_tasks gauge\n"
+            "queued_tasks 2\n");
+}
+
+TEST(MetricsTest, ScopedCounterIsDroppedWhenReleased) {
+  MetricsRegistry registry;
+  std::shared_ptr<Counter> counter = registry.GetScopedCounter(
+      "bytes_total", "Bytes.", {{"endpoint_id", "ABCD"}});
+  counter->Increment(10);
+  EXPECT_EQ(registry.GetScopedCounter("bytes_total", "Bytes.",
+                                      {{"endpoint_id", "ABCD"}}),
+            counter);
+  EXPECT_THAT(registry.GetSnapshot().counters,
+              ElementsAre(Pair("bytes_total{endpoint_id=\"ABCD\"}", 10)));
+
+  counter.reset();
+
+  EXPECT_TRUE(registry.GetSnapshot().counters.empty());
+  EXPECT_THAT(registry.ExportText(), Not(HasSubstr("ABCD")));
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
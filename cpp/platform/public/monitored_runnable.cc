@@ -15,6 +15,7 @@
 #include "platform/public/monitored_runnable.h"
 
 #include "platform/public/logging.h"
+#include "platform/public/metrics.h"
 #include "platform/public/pending_job_registry.h"
 
 namespace location {
@@ -23,22 +24,68 @@ namespace nearby {
 namespace {
 absl::Duration kMinReportedStartDelay = absl::Seconds(5);
 absl::Duration kMinReportedTaskDuration = absl::Seconds(10);
+
+struct ExecutorMetrics {
+  Gauge* queued_tasks;
+  Gauge* running_tasks;
+  Histogram* start_delay;
+  Histogram* task_duration;
+};
+
+const ExecutorMetrics& GetExecutorMetrics() {
+  static const ExecutorMetrics* metrics = [] {
+    MetricsRegistry& registry = MetricsRegistry::GetInstance();
+    return new ExecutorMetrics{
+        registry.GetGauge("nearby_executor_queued_tasks",
+                          "Tasks waiting for an executor thread."),
+        registry.GetGauge("nearby_executor_running_tasks",
+                          "Tasks running on executor threads."),
+        registry.GetHistogram("nearby_executor_start_delay_micros",
+                              "Time tasks waited for an executor thread, in "
+                              "microseconds."),
+        registry.GetHistogram("nearby_executor_task_duration_micros",
+                              "Time tasks ran for, in microseconds."),
+    };
+  }();
+  return *metrics;
+}
 }  // namespace
 
-MonitoredRunnable::MonitoredRunnable(Runnable&& runnable)
-    : runnable_{runnable} {}
+MonitoredRunnable::MonitoredRunnable(ThreadCheckRunnable&& runnable)
+    : runnable_{std::move(runnable)} {
+  GetExecutorMetrics().queued_tasks->Add(1);
+}
 
 MonitoredRunnable::MonitoredRunnable(const std::string& name,
-                                     Runnable&& runnable)
-    : name_{name}, runnable_{runnable} {
+                                     ThreadCheckRunnable&& runnable)
+    : name_{name}, runnable_{std::move(runnable)} {
+  GetExecutorMetrics().queued_tasks->Add(1);
   PendingJobRegistry::GetInstance().AddPendingJob(name_, post_time_);
 }
 
-MonitoredRunnable::~MonitoredRunnable() = default;
+MonitoredRunnable::MonitoredRunnable(MonitoredRunnable&& other) noexcept
+    : name_{std::move(other.name_)},
+      runnable_{std::move(other.runnable_)},
+      post_time_{other.post_time_},
+      queued_{other.queued_} {
+  other.queued_ = false;
+}
+
+MonitoredRunnable::~MonitoredRunnable() {
+  // A task dropped by an executor that shut down is no longer queued either.
+  if (queued_) GetExecutorMetrics().queued_tasks->Add(-1);
+}
 
-void MonitoredRunnable::operator()() const {
+void MonitoredRunnable::operator()() {
+  const ExecutorMetrics& metrics = GetExecutorMetrics();
   auto start_time = SystemClock::ElapsedRealtime();
   auto start_delay = start_time - post_time_;
+  if (queued_) {
+    queued_ = false;
+    metrics.queued_tasks->Add(-1);
+  }
+  metrics.start_delay->Record(start_delay);
+  metrics.running_tasks->Add(1);
   if (start_delay >= kMinReportedStartDelay) {
     NEARBY_LOGS(INFO) << "Task: \"" << name_ << "\" started after "
                       << absl::ToInt64Seconds(start_delay) << " seconds";
@@ -47,6 +94,8 @@ void MonitoredRunnable::operator()() const {
   PendingJobRegistry::GetInstance().AddRunningJob(name_, post_time_);
   runnable_();
   auto task_duration = SystemClock::ElapsedRealtime() - start_time;
+  metrics.running_tasks->Add(-1);
+  metrics.task_duration->Record(task_duration);
   if (task_duration >= kMinReportedTaskDuration) {
     NEARBY_LOGS(INFO) << "Task: \"" << name_ << "\" finished after "
                       << absl::ToInt64Seconds(task_duration) << " seconds";
@@ -18,8 +18,8 @@
 #include <string>
 
 #include "absl/time/time.h"
-#include "platform/base/runnable.h"
 #include "platform/public/system_clock.h"
+#include "platform/public/thread_check_runnable.h"
 
 namespace location {
 namespace nearby {
@@ -30,16 +30,22 @@ namespace nearby {
 // to run for longer periods of time (minutes).
 class MonitoredRunnable {
  public:
-  explicit MonitoredRunnable(Runnable&& runnable);
-  MonitoredRunnable(const std::string& name, Runnable&& runnable);
+  explicit MonitoredRunnable(ThreadCheckRunnable&& runnable);
+  MonitoredRunnable(const std::string& name, ThreadCheckRunnable&& runnable);
+  MonitoredRunnable(MonitoredRunnable&& other) noexcept;
+  MonitoredRunnable& operator=(MonitoredRunnable&&) = delete;
   ~MonitoredRunnable();
 
-  void operator()() const;
+  void operator()();
 
  private:
-  const std::string name_;
-  Runnable runnable_;
+  std::string name_;
+  // Held by value rather than as a Task, so that the executor gets the whole
+  // runnable in a single allocation.
+  ThreadCheckRunnable runnable_;
   absl::Time post_time_ = SystemClock::ElapsedRealtime();
+  // True until the runnable starts running, or is dropped without running.
+  bool queued_ = true;
 };
 
 }  // namespace nearby
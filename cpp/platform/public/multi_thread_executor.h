@@ -15,8 +15,11 @@
 #ifndef PLATFORM_PUBLIC_MULTI_THREAD_EXECUTOR_H_
 #define PLATFORM_PUBLIC_MULTI_THREAD_EXECUTOR_H_
 
+#include <string>
+
 #include "absl/base/thread_annotations.h"
 #include "platform/api/platform.h"
+#include "platform/public/executor_service.h"
 #include "platform/public/submittable_executor.h"
 
 namespace location {
@@ -29,9 +32,16 @@ namespace nearby {
 class ABSL_LOCKABLE MultiThreadExecutor final : public SubmittableExecutor {
  public:
   using Platform = api::ImplementationPlatform;
+  using TaskType = ExecutorService::TaskType;
   explicit MultiThreadExecutor(int max_parallelism)
       : SubmittableExecutor(
             Platform::CreateMultiThreadExecutor(max_parallelism)) {}
+  // Runs up to |max_parallelism| tasks at a time as the queue |queue_name| of
+  // the ExecutorService, if FeatureFlags enable shared executors.
+  MultiThreadExecutor(const std::string& queue_name, int max_parallelism,
+                      TaskType type = TaskType::kBlocking)
+      : SubmittableExecutor(ExecutorService::CreateExecutor(
+            queue_name, max_parallelism, type)) {}
   MultiThreadExecutor(MultiThreadExecutor&&) = default;
   MultiThreadExecutor& operator=(MultiThreadExecutor&&) = default;
   ~MultiThreadExecutor() override = default;
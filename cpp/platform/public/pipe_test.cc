@@ -21,6 +21,8 @@
 #include <string>
 
 #include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "platform/base/link_profile.h"
 #include "platform/base/prng.h"
 #include "platform/base/runnable.h"
 
@@ -154,6 +156,91 @@ TEST(PipeTest, RepeatedClose) {
   EXPECT_TRUE(input_stream.Close().Ok());
 }
 
+TEST(PipeTest, LatencyDelaysRead) {
+  Pipe pipe;
+  pipe.SetLinkProfile(LinkProfile{.latency = absl::Milliseconds(200)});
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  std::string data("ABCD");
+  absl::Time start = absl::Now();
+  EXPECT_TRUE(output_stream.Write(ByteArray(data)).Ok());
+  // Latency doesn't hold the writer back, only the reader.
+  EXPECT_LT(absl::Now() - start, absl::Milliseconds(200));
+
+  ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(200));
+  EXPECT_TRUE(read_data.ok());
+  EXPECT_EQ(data, std::string(read_data.result()));
+}
+
+TEST(PipeTest, BandwidthCapsThroughput) {
+  Pipe pipe;
+  pipe.SetLinkProfile(LinkProfile{.bandwidth_bytes_per_second = 10 * 1024});
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  // 5KB over a 10KB/s link take at least half a second to get through.
+  std::string data(1024, 'A');
+  absl::Time start = absl::Now();
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(output_stream.Write(ByteArray(data)).Ok());
+  }
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(500));
+
+  for (int i = 0; i < 5; ++i) {
+    ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+    EXPECT_TRUE(read_data.ok());
+    EXPECT_EQ(data, std::string(read_data.result()));
+  }
+}
+
+TEST(PipeTest, JitterKeepsChunksInOrder) {
+  Pipe pipe;
+  pipe.SetLinkProfile(LinkProfile{.latency = absl::Milliseconds(10),
+                                  .jitter = absl::Milliseconds(50)});
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  for (char c = 'A'; c <= 'J'; ++c) {
+    EXPECT_TRUE(output_stream.Write(ByteArray(std::string(1, c))).Ok());
+  }
+  EXPECT_TRUE(output_stream.Close().Ok());
+
+  std::string actual_data;
+  while (true) {
+    ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+    ASSERT_TRUE(read_data.ok());
+    if (read_data.result().Empty()) break;
+    actual_data += std::string(read_data.result());
+  }
+  EXPECT_EQ("ABCDEFGHIJ", actual_data);
+}
+
+TEST(PipeTest, StallHoldsWriter) {
+  Pipe pipe;
+  pipe.SetLinkProfile(LinkProfile{.stall_probability = 1,
+                                  .stall_duration = absl::Milliseconds(200)});
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  absl::Time start = absl::Now();
+  EXPECT_TRUE(output_stream.Write(ByteArray("ABCD")).Ok());
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(200));
+}
+
+TEST(PipeTest, DisconnectAfterBytesFailsBothEnds) {
+  Pipe pipe;
+  pipe.SetLinkProfile(LinkProfile{.disconnect_after_bytes = 6});
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  EXPECT_TRUE(output_stream.Write(ByteArray("ABCD")).Ok());
+  EXPECT_TRUE(output_stream.Write(ByteArray("EFGH")).Raised(Exception::kIo));
+
+  ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+  EXPECT_TRUE(read_data.GetException().Raised(Exception::kIo));
+}
+
 class Thread {
  public:
   Thread() : thread_(), attr_(), runnable_() {
@@ -18,14 +18,16 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/time/time.h"
 #include "platform/api/platform.h"
 #include "platform/api/scheduled_executor.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 #include "platform/public/cancelable.h"
 #include "platform/public/cancellable_task.h"
+#include "platform/public/executor_service.h"
 #include "platform/public/lockable.h"
 #include "platform/public/monitored_runnable.h"
 #include "platform/public/mutex.h"
@@ -43,8 +45,14 @@ namespace nearby {
 class ABSL_LOCKABLE ScheduledExecutor final : public Lockable {
  public:
   using Platform = api::ImplementationPlatform;
+  using TaskType = ExecutorService::TaskType;
 
   ScheduledExecutor() : impl_(Platform::CreateScheduledExecutor()) {}
+  // Runs its tasks as the serial queue |queue_name| of the ExecutorService,
+  // if FeatureFlags enable shared executors. Alarms are usually short-lived.
+  explicit ScheduledExecutor(const std::string& queue_name,
+                             TaskType type = TaskType::kShortLived)
+      : impl_(ExecutorService::CreateScheduledExecutor(queue_name, type)) {}
   ScheduledExecutor(ScheduledExecutor&& other) { *this = std::move(other); }
   ~ScheduledExecutor() {
     MutexLock lock(&mutex_);
@@ -60,7 +68,7 @@ class ABSL_LOCKABLE ScheduledExecutor final : public Lockable {
     }
     return *this;
   }
-  void Execute(const std::string& name, Runnable&& runnable)
+  void Execute(const std::string& name, Task&& runnable)
       ABSL_LOCKS_EXCLUDED(mutex_) {
     MutexLock lock(&mutex_);
     if (impl_)
@@ -68,7 +76,7 @@ class ABSL_LOCKABLE ScheduledExecutor final : public Lockable {
           name, ThreadCheckRunnable(this, std::move(runnable))));
   }
 
-  void Execute(Runnable&& runnable) ABSL_LOCKS_EXCLUDED(mutex_) {
+  void Execute(Task&& runnable) ABSL_LOCKS_EXCLUDED(mutex_) {
     MutexLock lock(&mutex_);
     if (impl_) impl_->Execute(ThreadCheckRunnable(this, std::move(runnable)));
   }
@@ -78,7 +86,7 @@ class ABSL_LOCKABLE ScheduledExecutor final : public Lockable {
     DoShutdown();
   }
 
-  Cancelable Schedule(Runnable&& runnable, absl::Duration duration)
+  Cancelable Schedule(Task&& runnable, absl::Duration duration)
       ABSL_LOCKS_EXCLUDED(mutex_) {
     MutexLock lock(&mutex_);
     if (impl_) {
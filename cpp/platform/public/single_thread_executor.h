@@ -15,7 +15,10 @@
 #ifndef PLATFORM_PUBLIC_SINGLE_THREAD_EXECUTOR_H_
 #define PLATFORM_PUBLIC_SINGLE_THREAD_EXECUTOR_H_
 
+#include <string>
+
 #include "absl/base/thread_annotations.h"
+#include "platform/public/executor_service.h"
 #include "platform/public/submittable_executor.h"
 
 namespace location {
@@ -28,8 +31,15 @@ namespace nearby {
 class ABSL_LOCKABLE SingleThreadExecutor final : public SubmittableExecutor {
  public:
   using Platform = api::ImplementationPlatform;
+  using TaskType = ExecutorService::TaskType;
   SingleThreadExecutor()
       : SubmittableExecutor(Platform::CreateSingleThreadExecutor()) {}
+  // Runs its tasks as the serial queue |queue_name| of the ExecutorService,
+  // if FeatureFlags enable shared executors.
+  explicit SingleThreadExecutor(const std::string& queue_name,
+                                TaskType type = TaskType::kBlocking)
+      : SubmittableExecutor(
+            ExecutorService::CreateExecutor(queue_name, 1, type)) {}
   ~SingleThreadExecutor() override = default;
   SingleThreadExecutor(SingleThreadExecutor&&) = default;
   SingleThreadExecutor& operator=(SingleThreadExecutor&&) = default;
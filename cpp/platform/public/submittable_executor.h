@@ -24,7 +24,7 @@
 #include "platform/api/executor.h"
 #include "platform/api/submittable_executor.h"
 #include "platform/base/callable.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 #include "platform/public/future.h"
 #include "platform/public/lockable.h"
 #include "platform/public/monitored_runnable.h"
@@ -58,7 +58,7 @@ class ABSL_LOCKABLE SubmittableExecutor : public api::SubmittableExecutor,
     }
     return *this;
   }
-  void Execute(const std::string& name, Runnable&& runnable)
+  void Execute(const std::string& name, Task&& runnable)
       ABSL_LOCKS_EXCLUDED(mutex_) {
     MutexLock lock(&mutex_);
     if (impl_)
@@ -66,7 +66,7 @@ class ABSL_LOCKABLE SubmittableExecutor : public api::SubmittableExecutor,
           name, ThreadCheckRunnable(this, std::move(runnable))));
   }
 
-  void Execute(Runnable&& runnable) ABSL_LOCKS_EXCLUDED(mutex_) override {
+  void Execute(Task&& runnable) ABSL_LOCKS_EXCLUDED(mutex_) override {
     MutexLock lock(&mutex_);
     if (impl_)
       impl_->Execute(
@@ -116,7 +116,7 @@ class ABSL_LOCKABLE SubmittableExecutor : public api::SubmittableExecutor,
   // Submit a callable (with no delay).
   // Returns true, if callable was submitted, false otherwise.
   // Callable is not submitted if shutdown is in progress.
-  bool DoSubmit(Runnable&& wrapped_callable)
+  bool DoSubmit(Task&& wrapped_callable)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) override {
     return impl_ ? impl_->DoSubmit(std::move(wrapped_callable)) : false;
   }
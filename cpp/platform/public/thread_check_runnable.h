@@ -18,7 +18,7 @@
 #include <utility>
 
 #include "absl/base/thread_annotations.h"
-#include "platform/base/runnable.h"
+#include "platform/base/task.h"
 #include "platform/public/lockable.h"
 
 namespace location {
@@ -28,17 +28,17 @@ namespace nearby {
 // This class helps with thread safety analysis.
 class ThreadCheckRunnable {
  public:
-  ThreadCheckRunnable(const Lockable *lockable, Runnable &&runnable)
-      : lockable_{lockable}, runnable_{runnable} {}
+  ThreadCheckRunnable(const Lockable *lockable, Task &&runnable)
+      : lockable_{lockable}, runnable_{std::move(runnable)} {}
 
-  void operator()() const {
+  void operator()() {
     ThreadLockHolder thread_lock(lockable_);
     runnable_();
   }
 
  private:
   Lockable const *lockable_;
-  Runnable runnable_;
+  Task runnable_;
 };
 
 }  // namespace nearby
@@ -0,0 +1,204 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/public/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+
+namespace {
+
+thread_local TraceSpan* current_span = nullptr;
+
+void SetEndpointId(Tracer::Event* event, absl::string_view endpoint_id) {
+  std::size_t length = std::min<std::size_t>(endpoint_id.size(),
+                                             Tracer::kMaxEndpointIdLength);
+  std::memcpy(event->endpoint_id, endpoint_id.data(), length);
+  event->endpoint_id[length] = '\0';
+}
+
+std::string EscapeJson(absl::string_view value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      absl::StrAppend(&escaped, "\\u00", absl::Hex(c, absl::kZeroPad2));
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void AppendEvent(std::string* json, int thread_id,
+                 const Tracer::Event& event) {
+  if (json->back() != '[') *json += ",\n";
+  absl::StrAppend(json, "{\"name\":\"", EscapeJson(event.name),
+                  "\",\"cat\":\"nearby\",\"ph\":\"X\",\"pid\":1,\"tid\":",
+                  thread_id, ",\"ts\":", absl::ToUnixMicros(event.start),
+                  ",\"dur\":", absl::ToInt64Microseconds(event.duration),
+                  ",\"args\":{");
+  std::string args;
+  if (event.endpoint_id[0] != '\0') {
+    absl::StrAppend(&args, "\"endpoint_id\":\"",
+                    EscapeJson(event.endpoint_id), "\"");
+  }
+  if (event.payload_id >= 0) {
+    absl::StrAppend(&args, args.empty() ? "" : ",",
+                    "\"payload_id\":", event.payload_id);
+  }
+  if (event.offset >= 0) {
+    absl::StrAppend(&args, args.empty() ? "" : ",",
+                    "\"offset\":", event.offset);
+  }
+  absl::StrAppend(json, args, "}}");
+}
+
+}  // namespace
+
+// C++14 requires to declare this.
+// TODO(apolyudov): remove when migration to c++17 is possible.
+constexpr int Tracer::kEventsPerThread;
+constexpr int Tracer::kMaxRetiredThreads;
+constexpr int Tracer::kMaxEndpointIdLength;
+
+struct Tracer::ThreadBuffer {
+  explicit ThreadBuffer(int thread_id) : thread_id(thread_id) {}
+
+  const int thread_id;
+  // Set once the thread is gone.
+  std::atomic<bool> retired{false};
+  Mutex mutex;
+  // A ring buffer; once full, |next| is where the oldest event is.
+  std::vector<Event> events ABSL_GUARDED_BY(mutex);
+  std::size_t next ABSL_GUARDED_BY(mutex) = 0;
+};
+
+Tracer& Tracer::GetInstance() {
+  static Tracer* instance = new Tracer();
+  return *instance;
+}
+
+void Tracer::Record(const Event& event) {
+  ThreadBuffer& buffer = GetThreadBuffer();
+  MutexLock lock(&buffer.mutex);
+  if (buffer.events.size() < kEventsPerThread) {
+    buffer.events.push_back(event);
+  } else {
+    buffer.events[buffer.next] = event;
+    buffer.next = (buffer.next + 1) % kEventsPerThread;
+  }
+}
+
+std::string Tracer::ExportChromeTrace() {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    MutexLock lock(&mutex_);
+    buffers = buffers_;
+  }
+  std::string json = "{\"traceEvents\":[";
+  for (const auto& buffer : buffers) {
+    MutexLock lock(&buffer->mutex);
+    std::size_t size = buffer->events.size();
+    for (std::size_t i = 0; i < size; ++i) {
+      AppendEvent(&json, buffer->thread_id,
+                  buffer->events[(buffer->next + i) % size]);
+    }
+  }
+  json += "],\"displayTimeUnit\":\"ms\"}\n";
+  return json;
+}
+
+void Tracer::Clear() {
+  MutexLock lock(&mutex_);
+  buffers_.erase(
+      std::remove_if(buffers_.begin(), buffers_.end(),
+                     [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                       return buffer->retired.load();
+                     }),
+      buffers_.end());
+  for (const auto& buffer : buffers_) {
+    MutexLock buffer_lock(&buffer->mutex);
+    buffer->events.clear();
+    buffer->next = 0;
+  }
+}
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer() {
+  // Marks the buffer of a thread as retired when the thread goes away.
+  struct Holder {
+    ~Holder() {
+      if (buffer != nullptr) buffer->retired = true;
+    }
+    std::shared_ptr<ThreadBuffer> buffer;
+  };
+  thread_local Holder holder;
+  if (holder.buffer == nullptr) holder.buffer = AddThreadBuffer();
+  return *holder.buffer;
+}
+
+std::shared_ptr<Tracer::ThreadBuffer> Tracer::AddThreadBuffer() {
+  MutexLock lock(&mutex_);
+  int retired = std::count_if(buffers_.begin(), buffers_.end(),
+                              [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                                return buffer->retired.load();
+                              });
+  for (auto it = buffers_.begin();
+       it != buffers_.end() && retired >= kMaxRetiredThreads;) {
+    if ((*it)->retired) {
+      it = buffers_.erase(it);
+      --retired;
+    } else {
+      ++it;
+    }
+  }
+  buffers_.push_back(std::make_shared<ThreadBuffer>(next_thread_id_++));
+  return buffers_.back();
+}
+
+TraceSpan::TraceSpan(const char* name, absl::string_view endpoint_id,
+                     std::int64_t payload_id, std::int64_t offset)
+    : parent_(current_span) {
+  if (parent_ != nullptr) event_ = parent_->event_;
+  event_.name = name;
+  if (!endpoint_id.empty()) SetEndpointId(&event_, endpoint_id);
+  if (payload_id >= 0) event_.payload_id = payload_id;
+  if (offset >= 0) event_.offset = offset;
+  current_span = this;
+  event_.start = SystemClock::ElapsedRealtime();
+}
+
+TraceSpan::~TraceSpan() {
+  event_.duration = SystemClock::ElapsedRealtime() - event_.start;
+  current_span = parent_;
+  Tracer::GetInstance().Record(event_);
+}
+
+void TraceSpan::SetPayload(std::int64_t payload_id, std::int64_t offset) {
+  event_.payload_id = payload_id;
+  event_.offset = offset;
+}
+
+}  // namespace nearby
+}  // namespace location
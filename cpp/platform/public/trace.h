@@ -0,0 +1,125 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_PUBLIC_TRACE_H_
+#define PLATFORM_PUBLIC_TRACE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "platform/public/mutex.h"
+
+// Spans of the payload transfer pipeline, e.g. a chunk being read from disk or
+// encrypted, are only traced when built with -DNEARBY_TRACE. Otherwise these
+// macros expand to nothing and tracing costs nothing at all.
+//
+// NEARBY_TRACE_SPAN(span, name, endpoint_id, payload_id, offset) starts a span
+// that ends when |span| goes out of scope. Tags that are left out are taken
+// from the span that encloses it on the same thread.
+#ifdef NEARBY_TRACE
+#define NEARBY_TRACE_SPAN(span, ...) \
+  ::location::nearby::TraceSpan span(__VA_ARGS__)
+#define NEARBY_TRACE_SET_PAYLOAD(span, payload_id, offset) \
+  span.SetPayload(payload_id, offset)
+#else
+#define NEARBY_TRACE_SPAN(span, ...)
+#define NEARBY_TRACE_SET_PAYLOAD(span, payload_id, offset)
+#endif
+
+namespace location {
+namespace nearby {
+
+// Collects finished spans in per-thread ring buffers, and renders them as
+// Chrome trace JSON, which chrome://tracing and Perfetto can open.
+//
+// Recording a span only takes the lock of the ring buffer of the recording
+// thread, which nobody else takes unless a trace is being exported.
+class Tracer {
+ public:
+  // Each thread keeps its latest kEventsPerThread spans.
+  static constexpr int kEventsPerThread = 4096;
+  // Buffers of threads that are gone are kept, up to this many, so their
+  // spans make it into the next export.
+  static constexpr int kMaxRetiredThreads = 64;
+  // Endpoint ids are truncated to this length.
+  static constexpr int kMaxEndpointIdLength = 15;
+
+  struct Event {
+    const char* name = nullptr;
+    absl::Time start;
+    absl::Duration duration;
+    char endpoint_id[kMaxEndpointIdLength + 1] = {};
+    std::int64_t payload_id = -1;
+    std::int64_t offset = -1;
+  };
+
+  static Tracer& GetInstance();
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  // Records a finished span for the calling thread.
+  void Record(const Event& event);
+
+  // Renders the buffered spans of all threads in the Chrome trace event
+  // format, as complete ("X") events. Spans stay buffered.
+  std::string ExportChromeTrace() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Drops all buffered spans.
+  void Clear() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct ThreadBuffer;
+
+  Tracer() = default;
+
+  ThreadBuffer& GetThreadBuffer();
+  std::shared_ptr<ThreadBuffer> AddThreadBuffer() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  Mutex mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_ ABSL_GUARDED_BY(mutex_);
+  int next_thread_id_ ABSL_GUARDED_BY(mutex_) = 1;
+};
+
+// A span that is recorded into the Tracer when it goes out of scope. Use it
+// through NEARBY_TRACE_SPAN, so it is compiled out of regular builds.
+class TraceSpan {
+ public:
+  // Empty |endpoint_id| and negative |payload_id| or |offset| are inherited
+  // from the enclosing span on this thread, if any.
+  explicit TraceSpan(const char* name, absl::string_view endpoint_id = {},
+                     std::int64_t payload_id = -1, std::int64_t offset = -1);
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  // Tags the span with a payload that is only known once it has started,
+  // e.g. after an incoming frame is parsed.
+  void SetPayload(std::int64_t payload_id, std::int64_t offset);
+
+ private:
+  Tracer::Event event_;
+  TraceSpan* parent_;
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_PUBLIC_TRACE_H_
@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/public/trace.h"
+
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+using ::testing::StartsWith;
+
+class TraceTest : public ::testing::Test {
+ protected:
+  void SetUp() override { Tracer::GetInstance().Clear(); }
+};
+
+TEST_F(TraceTest, NestedSpansInheritTags) {
+  {
+    TraceSpan outer("Outer", "ABCD", 42, 1024);
+    TraceSpan inner("Inner");
+    TraceSpan other_offset("OtherOffset", {}, -1, 2048);
+  }
+  TraceSpan untagged("Untagged");
+  untagged.SetPayload(7, 0);
+
+  std::string trace = Tracer::GetInstance().ExportChromeTrace();
+
+  EXPECT_THAT(trace, StartsWith("{\"traceEvents\":["));
+  EXPECT_THAT(trace, HasSubstr("\"name\":\"Outer\",\"cat\":\"nearby\","
+                               "\"ph\":\"X\""));
+  EXPECT_THAT(trace, HasSubstr("\"args\":{\"endpoint_id\":\"ABCD\","
+                               "\"payload_id\":42,\"offset\":1024}"));
+  EXPECT_THAT(trace, HasSubstr("\"args\":{\"endpoint_id\":\"ABCD\","
+                               "\"payload_id\":42,\"offset\":2048}"));
+  // Spans show up once they end.
+  EXPECT_THAT(trace, Not(HasSubstr("Untagged")));
+}
+
+TEST_F(TraceTest, SpanWithoutTagsHasNoArgs) {
+  { TraceSpan span("Lonely"); }
+
+  EXPECT_THAT(Tracer::GetInstance().ExportChromeTrace(),
+              HasSubstr("\"name\":\"Lonely\""));
+  EXPECT_THAT(Tracer::GetInstance().ExportChromeTrace(),
+              HasSubstr("\"args\":{}}"));
+}
+
+TEST_F(TraceTest, RingBufferKeepsLatestSpans) {
+  { TraceSpan span("First"); }
+  for (int i = 0; i < Tracer::kEventsPerThread; ++i) {
+    TraceSpan span("Later");
+  }
+
+  std::string trace = Tracer::GetInstance().ExportChromeTrace();
+
+  EXPECT_THAT(trace, Not(HasSubstr("First")));
+  EXPECT_THAT(trace, HasSubstr("Later"));
+}
+
+TEST_F(TraceTest, KeepsSpansOfFinishedThreads) {
+  {
+    SingleThreadExecutor executor;
+    executor.Execute([]() { TraceSpan span("OnOtherThread", "WXYZ"); });
+  }
+
+  EXPECT_THAT(Tracer::GetInstance().ExportChromeTrace(),
+              HasSubstr("\"name\":\"OnOtherThread\""));
+
+  Tracer::GetInstance().Clear();
+
+  EXPECT_THAT(Tracer::GetInstance().ExportChromeTrace(),
+              Not(HasSubstr("OnOtherThread")));
+}
+
+TEST_F(TraceTest, TruncatesLongEndpointIds) {
+  { TraceSpan span("Span", "0123456789abcdefXYZ"); }
+
+  EXPECT_THAT(Tracer::GetInstance().ExportChromeTrace(),
+              HasSubstr("\"endpoint_id\":\"0123456789abcde\""));
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -126,6 +126,58 @@ TEST_P(WifiLanMediumTest, CanConnectToService) {
   env_.Stop();
 }
 
+TEST_P(WifiLanMediumTest, LinkProfileShapesSocketData) {
+  FeatureFlags feature_flags = GetParam();
+  env_.SetFeatureFlags(feature_flags);
+  env_.Start();
+  WifiLanMedium wifi_lan_a;
+  WifiLanMedium wifi_lan_b;
+  env_.SetLinkProfile(wifi_lan_a.GetImpl(), wifi_lan_b.GetImpl(),
+                      LinkProfile{.latency = absl::Milliseconds(200)});
+
+  WifiLanServerSocket server_socket = wifi_lan_b.ListenForService();
+  EXPECT_TRUE(server_socket.IsValid());
+  NsdServiceInfo nsd_service_info;
+  nsd_service_info.SetServiceName(std::string(kServiceInfoName));
+  nsd_service_info.SetServiceType(std::string(kServiceType));
+  nsd_service_info.SetIPAddress(server_socket.GetIPAddress());
+  nsd_service_info.SetPort(server_socket.GetPort());
+  wifi_lan_b.StartAdvertising(nsd_service_info);
+  env_.Sync();
+
+  WifiLanSocket socket_a;
+  WifiLanSocket socket_b;
+  {
+    CancellationFlag flag;
+    SingleThreadExecutor server_executor;
+    SingleThreadExecutor client_executor;
+    client_executor.Execute([&wifi_lan_a, &socket_a, &server_socket, &flag]() {
+      socket_a = wifi_lan_a.ConnectToService(
+          server_socket.GetIPAddress(), server_socket.GetPort(), &flag);
+    });
+    server_executor.Execute(
+        [&socket_b, &server_socket]() { socket_b = server_socket.Accept(); });
+  }
+  ASSERT_TRUE(socket_a.IsValid());
+  ASSERT_TRUE(socket_b.IsValid());
+
+  // Both directions of the link are shaped.
+  absl::Time start = absl::Now();
+  EXPECT_TRUE(socket_a.GetOutputStream().Write(ByteArray("ping")).Ok());
+  ExceptionOr<ByteArray> ping = socket_b.GetInputStream().Read(1024);
+  EXPECT_TRUE(ping.ok());
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(200));
+
+  start = absl::Now();
+  EXPECT_TRUE(socket_b.GetOutputStream().Write(ByteArray("pong")).Ok());
+  ExceptionOr<ByteArray> pong = socket_a.GetInputStream().Read(1024);
+  EXPECT_TRUE(pong.ok());
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(200));
+
+  server_socket.Close();
+  env_.Stop();
+}
+
 TEST_P(WifiLanMediumTest, CanCancelConnect) {
   FeatureFlags feature_flags = GetParam();
   env_.SetFeatureFlags(feature_flags);